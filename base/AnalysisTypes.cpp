@@ -20,7 +20,7 @@
 #include <string>
 #include <map>
 #include <algorithm>
-#include <cmath> // fabs, pow
+#include <cmath> // fabs, pow, log, exp
 
 #include "base/NotationTypes.h"
 #include "AnalysisTypes.h"
@@ -82,11 +82,20 @@ void
 AnalysisHelper::labelChords(CompositionTimeSliceAdapter &c, Segment &s,
                             const Rosegarden::Quantizer *quantizer)
 {
-
     Key key;
     if (c.begin() != c.end()) key = getKeyForEvent(*c.begin(), s);
     else key = getKeyForEvent(nullptr, s);
 
+    labelChords(c, s, quantizer, key);
+}
+
+void
+AnalysisHelper::labelChords(CompositionTimeSliceAdapter &c, Segment &s,
+                            const Rosegarden::Quantizer *quantizer,
+                            const Key &initialKey)
+{
+    Key key = initialKey;
+
     //Profiler profiler("AnalysisHelper::labelChords", true);
 
     for (CompositionTimeSliceAdapter::iterator i = c.begin(); i != c.end(); ++i) {
@@ -306,6 +315,7 @@ AnalysisHelper::makeHarmonyGuessList(CompositionTimeSliceAdapter &c,
     checkHarmonyTable();
 
     PitchProfile p; // defaults to all zeroes
+    std::vector<double> scores(m_harmonyTable.size());
     TimeSignature timeSig;
     timeT timeSigTime = 0;
     timeT nextSigTime = (*c.begin())->getAbsoluteTime();
@@ -389,12 +399,12 @@ AnalysisHelper::makeHarmonyGuessList(CompositionTimeSliceAdapter &c,
 
         possibleChords.reserve(m_harmonyTable.size());
 
-        for (HarmonyTable::iterator j = m_harmonyTable.begin();
-             j != m_harmonyTable.end();
-             ++j)
+        scoreHarmonyTable(np, scores);
+
+        for (size_t j = 0; j < m_harmonyTable.size(); ++j)
         {
-            double score = np.productScorer(j->first);
-            possibleChords.push_back(ChordPossibility(score, j->second));
+            possibleChords.push_back(ChordPossibility(scores[j],
+                                                      m_harmonyTable[j].second));
         }
 
         // 3. Save a short list of the nearest chords in the
@@ -590,6 +600,39 @@ AnalysisHelper::refineHarmonyGuessList(CompositionTimeSliceAdapter &/* c */,
 }
 
 AnalysisHelper::HarmonyTable AnalysisHelper::m_harmonyTable;
+std::vector<double> AnalysisHelper::m_harmonyWeights;
+
+void
+AnalysisHelper::scoreHarmonyTable(const PitchProfile &np,
+                                  std::vector<double> &scores)
+{
+    // Equivalent to np.productScorer(m_harmonyTable[j].first) for
+    // every j, but done in the log domain so that the whole table is
+    // scored with one (96x12) matrix-vector product over contiguous
+    // arrays, which the compiler can vectorise.  A zero component is
+    // given a huge (but finite, so that 0 * it is still 0) negative
+    // logarithm, making the score 0 just as productScorer would.
+
+    const double logOfZero = -1e300;
+
+    double logProfile[12];
+    for (int i = 0; i < 12; ++i)
+        logProfile[i] = (np[i] > 0) ? log(np[i]) : logOfZero;
+
+    const size_t rows = m_harmonyTable.size();
+    const double *weights = &m_harmonyWeights[0];
+
+    for (size_t j = 0; j < rows; ++j)
+    {
+        const double *row = weights + j * 12;
+        double sum = 0;
+        for (int i = 0; i < 12; ++i)
+        {
+            sum += row[i] * logProfile[i];
+        }
+        scores[j] = exp(sum);
+    }
+}
 
 void
 AnalysisHelper::checkHarmonyTable()
@@ -637,6 +680,24 @@ AnalysisHelper::checkHarmonyTable()
         }
     }
 
+    // Row j of the weight matrix holds 1/n for each of the n pitch
+    // classes present in m_harmonyTable[j], and 0 elsewhere.
+
+    m_harmonyWeights.assign(m_harmonyTable.size() * 12, 0.);
+
+    for (size_t j = 0; j < m_harmonyTable.size(); ++j)
+    {
+        const PitchProfile &profile = m_harmonyTable[j].first;
+
+        int present = 0;
+        for (int k = 0; k < 12; ++k)
+            if (profile[k] > 0) ++present;
+
+        for (int k = 0; k < 12; ++k)
+            if (profile[k] > 0)
+                m_harmonyWeights[j * 12 + k] = 1. / present;
+    }
+
 }
 
 AnalysisHelper::ProgressionMap AnalysisHelper::m_progressionMap;
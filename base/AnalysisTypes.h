@@ -131,6 +131,14 @@ public:
     void labelChords(CompositionTimeSliceAdapter &c, Segment &s,
                      const Quantizer *quantizer);
 
+    /**
+     * As above, naming the chords in the given key until the timeslice
+     * reaches a key change.  For labelling part of a piece, as the
+     * Segment may not hold the key in force at the start.
+     */
+    void labelChords(CompositionTimeSliceAdapter &c, Segment &s,
+                     const Quantizer *quantizer, const Key &initialKey);
+
     /**
      * Returns a time signature that is probably reasonable for the
      * given timeslice.
@@ -204,9 +212,20 @@ protected:
     typedef std::vector<std::pair<PitchProfile, ChordLabel> > HarmonyTable;
     static HarmonyTable m_harmonyTable;
 
+    /// For use by guessHarmonies (makeHarmonyGuessList).  Row j (of
+    /// 12) holds the productScorer() exponent for each pitch class of
+    /// m_harmonyTable[j], so the table can be scored as a matrix product.
+    static std::vector<double> m_harmonyWeights;
+
     /// For use by guessHarmonies (makeHarmonyGuessList)
     void checkHarmonyTable();
 
+    /// For use by guessHarmonies (makeHarmonyGuessList).  Scores the
+    /// normalized profile against every entry of m_harmonyTable at once;
+    /// scores must already be sized to match the table.
+    void scoreHarmonyTable(const PitchProfile &np,
+                           std::vector<double> &scores);
+
     /// For use by guessHarmonies (refineHarmonyGuessList)
     // #### grep ProgressionMap to something else
     struct ChordProgression {
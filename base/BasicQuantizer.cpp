@@ -82,18 +82,28 @@ void
 BasicQuantizer::quantizeSingle(Segment *s, Segment::iterator i) const
 {
     timeT d = getFromSource(*i, DurationValue);
+    timeT t = getFromSource(*i, AbsoluteTimeValue);
 
-    if (d == 0 && (*i)->isa(Note::EventType)) {
-        s->erase(i);
-        return;
+    timeT barStart = (m_unit == 0 ? 0 : s->getBarStartForTime(t));
+
+    switch (quantizeValues((*i)->isa(Note::EventType), barStart, t, d)) {
+    case EraseEvent: s->erase(i); break;
+    case SetEvent: setToTarget(s, i, t, d); break;
+    case LeaveEvent: break;
     }
+}
 
-    if (m_unit == 0) return;
+Quantizer::QuantizeAction
+BasicQuantizer::quantizeValues(bool isNote, timeT barStart,
+                               timeT &t, timeT &d) const
+{
+    if (d == 0 && isNote) {
+        return EraseEvent;
+    }
 
-    timeT t = getFromSource(*i, AbsoluteTimeValue);
-    timeT d0(d), t0(t);
+    if (m_unit == 0) return LeaveEvent;
 
-    timeT barStart = s->getBarStartForTime(t);
+    timeT d0(d), t0(t);
 
     t -= barStart;
 
@@ -155,7 +165,8 @@ BasicQuantizer::quantizeSingle(Segment *s, Segment::iterator i) const
         if (d >= d1 - close && d <= d1 + close) d = d1;
     }
 
-    if (t0 != t || d0 != d) setToTarget(s, i, t, d);
+    if (t0 != t || d0 != d) return SetEvent;
+    return LeaveEvent;
 }
 
 
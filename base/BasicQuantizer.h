@@ -72,6 +72,14 @@ protected:
     void quantizeSingle(Segment *,
                                 Segment::iterator) const override;
 
+    // With no unit, all there is to do is drop zero-length notes, which
+    // needs no bar starts, so the serial path does it without looking
+    // at the composition (the segment may not be in one)
+    bool isBarLocal() const override { return m_unit != 0; }
+
+    QuantizeAction quantizeValues(bool isNote, timeT barStart,
+                                  timeT &t, timeT &d) const override;
+
 private:
     BasicQuantizer &operator=(const BasicQuantizer &); // not provided
 
@@ -0,0 +1,160 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[ControllerThinner]"
+
+#include "ControllerThinner.h"
+
+#include "base/Event.h"
+#include "base/MidiTypes.h"
+
+#include <map>
+#include <stdlib.h>
+
+namespace Rosegarden
+{
+
+// Stream key used for pitch bend, as controller numbers are 0 to 127
+static const int PitchBendStream = -1;
+
+// Pitch bend has 14 bits to a controller's 7
+static const int PitchBendToleranceScale = 128;
+
+ControllerThinner::ControllerThinner(int tolerance, timeT minInterval) :
+    m_tolerance(tolerance < 0 ? 0 : tolerance),
+    m_minInterval(minInterval < 0 ? 0 : minInterval)
+{
+}
+
+static bool
+getStreamAndValue(const Event *e, int &stream, int &value)
+{
+    if (e->isa(Controller::EventType)) {
+        if (!e->has(Controller::NUMBER) || !e->has(Controller::VALUE)) {
+            return false;
+        }
+        stream = e->get<Int>(Controller::NUMBER);
+        value = e->get<Int>(Controller::VALUE);
+        return true;
+    }
+
+    if (e->isa(PitchBend::EventType)) {
+        if (!e->has(PitchBend::MSB) || !e->has(PitchBend::LSB)) {
+            return false;
+        }
+        stream = PitchBendStream;
+        value = (e->get<Int>(PitchBend::MSB) << 7) |
+                 e->get<Int>(PitchBend::LSB);
+        return true;
+    }
+
+    return false;
+}
+
+bool
+ControllerThinner::isThinnable(const Event *e)
+{
+    int stream, value;
+    return getStreamAndValue(e, stream, value);
+}
+
+std::vector<Event *>
+ControllerThinner::getRedundantEvents(const std::vector<Event *> &events)
+{
+    m_report = Report();
+
+    typedef std::map<int, std::vector<Event *> > StreamMap;
+    StreamMap streams;
+
+    for (size_t i = 0; i < events.size(); ++i) {
+        int stream, value;
+        if (!getStreamAndValue(events[i], stream, value)) continue;
+        streams[stream].push_back(events[i]);
+        ++m_report.examined;
+    }
+
+    std::vector<Event *> redundant;
+
+    for (StreamMap::const_iterator i = streams.begin();
+         i != streams.end(); ++i) {
+        int tolerance = m_tolerance;
+        if (i->first == PitchBendStream) {
+            tolerance *= PitchBendToleranceScale;
+        }
+        thinStream(i->second, tolerance, redundant);
+    }
+
+    m_report.removed = int(redundant.size());
+
+    return redundant;
+}
+
+void
+ControllerThinner::thinStream(const std::vector<Event *> &stream,
+                              int tolerance,
+                              std::vector<Event *> &redundant)
+{
+    if (stream.empty()) return;
+
+    int key, value;
+
+    // The value in force before the first event is unknown, so the
+    // first event is always kept.
+    getStreamAndValue(stream[0], key, value);
+    int heldValue = value;
+    timeT heldTime = stream[0]->getAbsoluteTime();
+
+    for (size_t i = 1; i < stream.size(); ++i) {
+
+        Event *e = stream[i];
+        getStreamAndValue(e, key, value);
+
+        const timeT time = e->getAbsoluteTime();
+        const int deviation = abs(value - heldValue);
+        const bool isLast = (i + 1 == stream.size());
+
+        // An event followed by another at the same time is never
+        // actually held, so it can go without any deviation.
+        if (!isLast && stream[i + 1]->getAbsoluteTime() == time) {
+            redundant.push_back(e);
+            continue;
+        }
+
+        bool keep = (deviation > tolerance) || (isLast && deviation > 0);
+
+        if (keep && !isLast && m_minInterval > 0 &&
+            time - heldTime < m_minInterval) {
+            // Too soon after the last one kept, unless the stream
+            // rests here
+            const timeT next = stream[i + 1]->getAbsoluteTime();
+            keep = (next - time >= m_minInterval);
+        }
+
+        if (keep) {
+            heldValue = value;
+            heldTime = time;
+        } else {
+            redundant.push_back(e);
+            int &maxDeviation = (key == PitchBendStream ?
+                                 m_report.maxPitchBendDeviation :
+                                 m_report.maxDeviation);
+            if (deviation > maxDeviation) maxDeviation = deviation;
+        }
+    }
+}
+
+}
@@ -0,0 +1,111 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_CONTROLLERTHINNER_H
+#define RG_CONTROLLERTHINNER_H
+
+#include "base/TimeT.h"
+
+#include <vector>
+
+namespace Rosegarden
+{
+
+class Event;
+
+/**
+ * Finds the redundant events in dense Controller and PitchBend
+ * streams, such as those recorded from a hardware controller or
+ * generated by PitchBendSequenceDialog and the parameter patterns.
+ *
+ * A controller holds its value until the next event arrives, so the
+ * curve being simplified is a step function rather than a line
+ * through the points.  An event can be dropped when the value already
+ * being held is within the tolerance of it.  Because of that, the
+ * deviation reported is exact: it is the largest difference, at any
+ * time, between the value the original events would have held and the
+ * value the remaining events hold.
+ *
+ * With a minimum interval, an event that comes sooner than that after
+ * the last event kept in its stream is dropped too, unless it is the
+ * value the stream then rests on for at least the interval.  This
+ * trades accuracy for bandwidth, and the report says by how much.
+ *
+ * Each controller number, and pitch bend, is thinned separately.  The
+ * last event of each stream is kept unless it repeats the value held,
+ * so a thinned stream always ends on the same value.  Other event
+ * types are ignored.
+ */
+class ControllerThinner
+{
+public:
+    /**
+     * tolerance is in 7-bit controller steps.  For pitch bend it is
+     * scaled up to the 14-bit range, so one unit of tolerance means
+     * the same proportion of the range for both.  minInterval is in
+     * timeT; 0 disables it.
+     */
+    ControllerThinner(int tolerance = 0, timeT minInterval = 0);
+
+    int getTolerance() const { return m_tolerance; }
+    timeT getMinInterval() const { return m_minInterval; }
+
+    /// Whether thinning could remove anything other than repeated values
+    bool isLossy() const { return m_tolerance > 0 || m_minInterval > 0; }
+
+    /// Whether the event is of a type that this thins
+    static bool isThinnable(const Event *e);
+
+    struct Report
+    {
+        Report() :
+            examined(0), removed(0),
+            maxDeviation(0), maxPitchBendDeviation(0) { }
+
+        /// Controller and PitchBend events looked at
+        int examined;
+        /// How many of those can be removed
+        int removed;
+        /// Largest change in any held controller value, 0 to 127
+        int maxDeviation;
+        /// Largest change in held pitch bend, 0 to 16383
+        int maxPitchBendDeviation;
+    };
+
+    /**
+     * Return the events that can be removed from the given ones,
+     * which must be in time order, as a Segment or EventSelection
+     * holds them.  The report on what was found replaces any earlier
+     * one.
+     */
+    std::vector<Event *> getRedundantEvents(const std::vector<Event *> &events);
+
+    const Report &getReport() const { return m_report; }
+
+private:
+    void thinStream(const std::vector<Event *> &stream, int tolerance,
+                    std::vector<Event *> &redundant);
+
+    int m_tolerance;
+    timeT m_minInterval;
+
+    Report m_report;
+};
+
+}
+
+#endif
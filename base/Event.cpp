@@ -429,6 +429,27 @@ Event::clearNonPersistentProperties()
     if (m_nonPersistentProperties) m_nonPersistentProperties->clear();
 }
 
+bool
+Event::isIdenticalTo(const Event &e) const
+{
+    if (m_data == e.m_data) return true;
+
+    if (m_cachedTime != e.m_cachedTime ||
+        m_cachedSubOrdering != e.m_cachedSubOrdering ||
+        m_data->m_duration != e.m_data->m_duration ||
+        m_data->m_type != e.m_data->m_type) return false;
+
+    // Notation time and duration are held as properties when they
+    // differ from the performance ones, so comparing the property
+    // maps covers those too
+    const PropertyMap *p1 = m_data->m_properties;
+    const PropertyMap *p2 = e.m_data->m_properties;
+    if (p1 && p1->empty()) p1 = nullptr;
+    if (p2 && p2->empty()) p2 = nullptr;
+    if (!p1 || !p2) return p1 == p2;
+    return *p1 == *p2;
+}
+
 void
 Event::unsafeChangeTime(timeT offset)
 {
@@ -88,13 +88,14 @@ public:
     Event(const std::string &type,
           timeT absoluteTime, timeT duration = 0, short subOrdering = 0) :
         m_data(new EventData(type, absoluteTime, duration, subOrdering)),
-        m_nonPersistentProperties(nullptr) { }
+        m_nonPersistentProperties(nullptr) { cacheOrdering(); }
 
     Event(const std::string &type,
           timeT absoluteTime, timeT duration, short subOrdering,
           timeT notationAbsoluteTime, timeT notationDuration) :
         m_data(new EventData(type, absoluteTime, duration, subOrdering)),
         m_nonPersistentProperties(nullptr) {
+        cacheOrdering();
         setNotationAbsoluteTime(notationAbsoluteTime);
         setNotationDuration(notationDuration);
     }
@@ -102,6 +103,20 @@ public:
     Event(const Event &e) :
         m_nonPersistentProperties(nullptr) { share(e); }
 
+    /**
+     * Construct an Event that has nothing but an absolute time and
+     * sub-ordering, for use as the key when searching a Segment or
+     * other container ordered by EventCmp.  This allocates nothing,
+     * unlike a real Event, but the result must not be used for
+     * anything other than such comparisons.
+     */
+    struct SearchKey { };
+    Event(SearchKey, timeT absoluteTime, short subOrdering) :
+        m_data(nullptr),
+        m_nonPersistentProperties(nullptr),
+        m_cachedTime(absoluteTime),
+        m_cachedSubOrdering(subOrdering) { }
+
     // these ctors can't use default args: default has to be obtained from e
 
     Event(const Event &e, timeT absoluteTime) :
@@ -109,6 +124,7 @@ public:
         share(e);
         unshare();
         m_data->m_absoluteTime = absoluteTime;
+        cacheOrdering();
         setNotationAbsoluteTime(absoluteTime);
         setNotationDuration(m_data->m_duration);
     }
@@ -119,6 +135,7 @@ public:
         unshare();
         m_data->m_absoluteTime = absoluteTime;
         m_data->m_duration = duration;
+        cacheOrdering();
         setNotationAbsoluteTime(absoluteTime);
         setNotationDuration(duration);
     }
@@ -130,6 +147,7 @@ public:
         m_data->m_absoluteTime = absoluteTime;
         m_data->m_duration = duration;
         m_data->m_subOrdering = subOrdering;
+        cacheOrdering();
         setNotationAbsoluteTime(absoluteTime);
         setNotationDuration(duration);
     }
@@ -142,6 +160,7 @@ public:
         m_data->m_absoluteTime = absoluteTime;
         m_data->m_duration = duration;
         m_data->m_subOrdering = subOrdering;
+        cacheOrdering();
         setNotationAbsoluteTime(notationAbsoluteTime);
         setNotationDuration(duration);
     }
@@ -154,6 +173,7 @@ public:
         m_data->m_absoluteTime = absoluteTime;
         m_data->m_duration = duration;
         m_data->m_subOrdering = subOrdering;
+        cacheOrdering();
         setNotationAbsoluteTime(notationAbsoluteTime);
         setNotationDuration(notationDuration);
     }
@@ -190,9 +210,9 @@ public:
      * Tests if the Event is of the type in parameter
      */
     bool  isa(const std::string &t) const { return (m_data->m_type == t); }
-    timeT getAbsoluteTime() const    { return m_data->m_absoluteTime; }
+    timeT getAbsoluteTime() const    { return m_cachedTime; }
     timeT getDuration()     const    { return m_data->m_duration; }
-    short getSubOrdering()  const    { return m_data->m_subOrdering; }
+    short getSubOrdering()  const    { return m_cachedSubOrdering; }
 
     /**
      * Tests if the Event has the property/data in parameter
@@ -319,6 +339,13 @@ public:
      */
     void clearNonPersistentProperties();
 
+    /**
+     * Return true if the given Event has the same type, times,
+     * durations, sub-ordering and persistent properties as this one.
+     * Non-persistent properties are not compared.
+     */
+    bool isIdenticalTo(const Event &e) const;
+
     // Move Event in time without any ancillary co-ordination.
     /**
      * UNSAFE.  Don't call this unless you know exactly what you're
@@ -399,12 +426,12 @@ protected:
 
     Event() :
         m_data(new EventData("", 0, 0, 0)),
-        m_nonPersistentProperties(nullptr) { }
+        m_nonPersistentProperties(nullptr) { cacheOrdering(); }
 
     void setType(const std::string &t) { unshare(); m_data->m_type = t; }
-    void setAbsoluteTime(timeT t)      { unshare(); m_data->m_absoluteTime = t; }
+    void setAbsoluteTime(timeT t)      { unshare(); m_data->m_absoluteTime = t; m_cachedTime = t; }
     void setDuration(timeT d)          { unshare(); m_data->m_duration = d; }
-    void setSubOrdering(short o)       { unshare(); m_data->m_subOrdering = o; }
+    void setSubOrdering(short o)       { unshare(); m_data->m_subOrdering = o; m_cachedSubOrdering = o; }
     void setNotationAbsoluteTime(timeT t) { unshare(); m_data->setNotationTime(t); }
     void setNotationDuration(timeT d) { unshare(); m_data->setNotationDuration(d); }
 
@@ -452,9 +479,21 @@ private:
     EventData *m_data;
     PropertyMap *m_nonPersistentProperties; // Unique to an instance
 
+    // Copies of m_data's absolute time and sub-ordering, so that
+    // ordering events in a Segment doesn't have to follow m_data
+    timeT m_cachedTime;
+    short m_cachedSubOrdering;
+
+    void cacheOrdering() {
+        m_cachedTime = m_data->m_absoluteTime;
+        m_cachedSubOrdering = m_data->m_subOrdering;
+    }
+
     void share(const Event &e) {
         m_data = e.m_data;
-        m_data->m_refCount++;
+        if (m_data) m_data->m_refCount++;
+        m_cachedTime = e.m_cachedTime;
+        m_cachedSubOrdering = e.m_cachedSubOrdering;
     }
 
     bool unshare() { // returns true if unshare was necessary
@@ -467,7 +506,7 @@ private:
     }
 
     void lose() {
-        if (--m_data->m_refCount == 0) delete m_data;
+        if (m_data && --m_data->m_refCount == 0) delete m_data;
         delete m_nonPersistentProperties;
         m_nonPersistentProperties = nullptr;
     }
@@ -413,7 +413,7 @@ Instrument::isProgramValid() const
 
     // Check the bank against the list of valid banks.
 
-    BankList validBanks = md->getBanks(isPercussion());
+    const BankList &validBanks = md->getBanks(isPercussion());
 
     bool bankValid = false;
 
@@ -434,7 +434,7 @@ Instrument::isProgramValid() const
     // Check the program change against the list of program changes
     // for this bank.
 
-    ProgramList programList = md->getPrograms(m_program.getBank());
+    const ProgramList &programList = md->getPrograms(m_program.getBank());
 
     bool programChangeValid = false;
 
@@ -503,12 +503,12 @@ Instrument::pickFirstProgram(bool percussion)
     if (!md)
         return;
 
-    BankList banks = md->getBanks(percussion);
+    const BankList &banks = md->getBanks(percussion);
     if (banks.empty())
         return;
 
     // Get the programs for the first bank.
-    ProgramList programs = md->getPrograms(banks.front());
+    const ProgramList &programs = md->getPrograms(banks.front());
     if (programs.empty())
         return;
 
@@ -141,6 +141,10 @@ MidiDevice::MidiDevice(const MidiDevice &dev) :
 
     // generate presentation instruments
     generatePresentationList();
+
+    rebuildProgramIndex();
+    rebuildControlIndex();
+    rebuildBankIndex();
 }
 
 #if 0
@@ -259,6 +263,7 @@ void
 MidiDevice::generateDefaultControllers()
 {
     m_controlList.clear();
+    m_controlIndex.clear();
 
     static std::string controls[][9] = {
         { "Pan", Rosegarden::Controller::EventType, "<none>", "0", "127", "64", "10", "2", "0" },
@@ -313,12 +318,14 @@ void
 MidiDevice::clearBankList()
 {
     m_bankList.clear();
+    rebuildBankIndex();
 }
 
 void
 MidiDevice::clearProgramList()
 {
     m_programList.clear();
+    rebuildProgramIndex();
 }
 
 void
@@ -339,24 +346,100 @@ MidiDevice::clearControlList()
     }
 
     m_controlList.clear();
+    m_controlIndex.clear();
 }
 
 void
 MidiDevice::addProgram(const MidiProgram &prog)
 {
     // Refuse duplicates
-    for (ProgramList::const_iterator it = m_programList.begin();
-         it != m_programList.end(); ++it) {
-        if (it->partialCompare(prog)) return;
-    }
+    int key = getProgramKey(prog);
+    if (m_programIndex.find(key) != m_programIndex.end()) return;
 
+    m_programIndex[key] = m_programList.size();
+    m_bankPrograms[getBankKey(prog.getBank())].push_back(prog);
     m_programList.push_back(prog);
 }
 
+int
+MidiDevice::getBankKey(const MidiBank &bank)
+{
+    // Everything partialCompare() looks at
+    return (bank.isPercussion() ? 0x10000 : 0) |
+        (int(bank.getMSB()) << 8) | int(bank.getLSB());
+}
+
+int
+MidiDevice::getProgramKey(const MidiProgram &program)
+{
+    return (getBankKey(program.getBank()) << 8) | int(program.getProgram());
+}
+
+MidiDevice::ControlKey
+MidiDevice::getControlKey(const std::string &type, MidiByte controllerValue)
+{
+    // Only controllers are told apart by number
+    if (type == Rosegarden::Controller::EventType) {
+        return ControlKey(type, controllerValue);
+    }
+    return ControlKey(type, -1);
+}
+
+void
+MidiDevice::rebuildProgramIndex()
+{
+    m_programIndex.clear();
+    m_bankPrograms.clear();
+
+    for (size_t i = 0; i < m_programList.size(); ++i) {
+        const MidiProgram &program = m_programList[i];
+        // insert() keeps the first of any duplicates
+        if (m_programIndex.insert
+            (std::pair<int, size_t>(getProgramKey(program), i)).second) {
+            m_bankPrograms[getBankKey(program.getBank())].push_back(program);
+        }
+    }
+}
+
+void
+MidiDevice::rebuildControlIndex()
+{
+    m_controlIndex.clear();
+
+    for (size_t i = 0; i < m_controlList.size(); ++i) {
+        const ControlParameter &con = m_controlList[i];
+        m_controlIndex.insert
+            (std::pair<ControlKey, size_t>
+             (getControlKey(con.getType(), con.getControllerValue()), i));
+    }
+}
+
 void 
 MidiDevice::addBank(const MidiBank &bank)
 {
     m_bankList.push_back(bank);
+
+    const int percussion = bank.isPercussion() ? 1 : 0;
+    m_banksByPercussion[percussion].push_back(bank);
+    m_banksByMSB[(percussion << 8) | bank.getMSB()].push_back(bank);
+    m_banksByLSB[(percussion << 8) | bank.getLSB()].push_back(bank);
+}
+
+void
+MidiDevice::rebuildBankIndex()
+{
+    m_banksByPercussion[0].clear();
+    m_banksByPercussion[1].clear();
+    m_banksByMSB.clear();
+    m_banksByLSB.clear();
+
+    for (BankList::const_iterator it = m_bankList.begin();
+         it != m_bankList.end(); ++it) {
+        const int percussion = it->isPercussion() ? 1 : 0;
+        m_banksByPercussion[percussion].push_back(*it);
+        m_banksByMSB[(percussion << 8) | it->getMSB()].push_back(*it);
+        m_banksByLSB[(percussion << 8) | it->getLSB()].push_back(*it);
+    }
 }
 
 void
@@ -366,45 +449,36 @@ MidiDevice::setMetronome(const MidiMetronome &metronome)
     m_metronome = new MidiMetronome(metronome);
 }
 
-BankList
+const BankList &
 MidiDevice::getBanks(bool percussion) const
 {
-    BankList banks;
+    return m_banksByPercussion[percussion ? 1 : 0];
+}
 
-    for (BankList::const_iterator it = m_bankList.begin();
-         it != m_bankList.end(); ++it) {
-        if (it->isPercussion() == percussion) banks.push_back(*it);
-    }
+// The list of banks from one of the bank indices, or an empty one
+static const BankList &
+findBanks(const std::map<int, BankList> &index, bool percussion,
+          MidiByte number)
+{
+    static const BankList noBanks;
+
+    std::map<int, BankList>::const_iterator i =
+        index.find(((percussion ? 1 : 0) << 8) | number);
+    if (i == index.end()) return noBanks;
 
-    return banks;
+    return i->second;
 }
 
-BankList
+const BankList &
 MidiDevice::getBanksByMSB(bool percussion, MidiByte msb) const
 {
-    BankList banks;
-
-    for (BankList::const_iterator it = m_bankList.begin();
-         it != m_bankList.end(); ++it) {
-        if (it->isPercussion() == percussion && it->getMSB() == msb)
-            banks.push_back(*it);
-    }
-
-    return banks;
+    return findBanks(m_banksByMSB, percussion, msb);
 }
 
-BankList
+const BankList &
 MidiDevice::getBanksByLSB(bool percussion, MidiByte lsb) const
 {
-    BankList banks;
-
-    for (BankList::const_iterator it = m_bankList.begin();
-         it != m_bankList.end(); ++it) {
-        if (it->isPercussion() == percussion && it->getLSB() == lsb)
-            banks.push_back(*it);
-    }
-
-    return banks;
+    return findBanks(m_banksByLSB, percussion, lsb);
 }
 
 const MidiBank *
@@ -455,40 +529,37 @@ MidiDevice::getDistinctLSBs(bool percussion, int msb) const
     return v;
 }
 
-ProgramList
+const ProgramList &
 MidiDevice::getPrograms(const MidiBank &bank) const
 {
-    ProgramList programs;
+    static const ProgramList noPrograms;
 
-    for (ProgramList::const_iterator it = m_programList.begin();
-         it != m_programList.end(); ++it) {
-        if (it->getBank().partialCompare(bank)) programs.push_back(*it);
-    }
+    std::map<int, ProgramList>::const_iterator i =
+        m_bankPrograms.find(getBankKey(bank));
+    if (i == m_bankPrograms.end()) return noPrograms;
 
-    return programs;
+    return i->second;
 }
 
-ProgramList
+const ProgramList &
 MidiDevice::getPrograms0thVariation(bool percussion, const MidiBank &bank) const
 {
+    static const ProgramList noPrograms;
+
     // If we aren't in variations mode, just use getPrograms().
     if (m_variationType == NoVariations)
         return getPrograms(bank);
 
     // Get the variation bank list for this bank
-    BankList bankList;
-    if (m_variationType == VariationFromMSB) {
-        bankList = getBanksByLSB(percussion, bank.getLSB());
-    } else {
-        bankList = getBanksByMSB(percussion, bank.getMSB());
-    }
+    const BankList &bankList = (m_variationType == VariationFromMSB) ?
+        getBanksByLSB(percussion, bank.getLSB()) :
+        getBanksByMSB(percussion, bank.getMSB());
 
     if (!bankList.empty()) {
-        MidiBank firstBank = bankList.front();
-        return getPrograms(firstBank);
+        return getPrograms(bankList.front());
     }
 
-    return ProgramList();
+    return noPrograms;
 }
 
 std::string
@@ -521,17 +592,13 @@ MidiDevice::getKeyMappingByName(const std::string &name) const
 const MidiKeyMapping *
 MidiDevice::getKeyMappingForProgram(const MidiProgram &program) const
 {
-    ProgramList::const_iterator it;
+    std::map<int, size_t>::const_iterator i =
+        m_programIndex.find(getProgramKey(program));
+    if (i == m_programIndex.end()) return nullptr;
 
-    for (it = m_programList.begin(); it != m_programList.end(); ++it) {
-        if (it->partialCompare(program)) {
-            std::string kmn = it->getKeyMapping();
-            if (kmn == "") return nullptr;
-            return getKeyMappingByName(kmn);
-        }
-    }
-
-    return nullptr;
+    std::string kmn = m_programList[i->second].getKeyMapping();
+    if (kmn == "") return nullptr;
+    return getKeyMappingByName(kmn);
 }
 
 void
@@ -545,6 +612,9 @@ MidiDevice::setKeyMappingForProgram(const MidiProgram &program,
             it->setKeyMapping(mapping);
         }
     }
+
+    // Update the copies in m_bankPrograms
+    rebuildProgramIndex();
 }
     
 
@@ -699,26 +769,25 @@ MidiDevice::addInstrument(Instrument *instrument)
 std::string
 MidiDevice::getProgramName(const MidiProgram &program) const
 {
-    ProgramList::const_iterator it;
-
-    for (it = m_programList.begin(); it != m_programList.end(); ++it)
-    {
-        if (it->partialCompare(program)) return it->getName();
-    }
+    std::map<int, size_t>::const_iterator i =
+        m_programIndex.find(getProgramKey(program));
+    if (i == m_programIndex.end()) return std::string("");
 
-    return std::string("");
+    return m_programList[i->second].getName();
 }
 
 void
 MidiDevice::replaceBankList(const BankList &bankList)
 {
     m_bankList = bankList;
+    rebuildBankIndex();
 }
 
 void
 MidiDevice::replaceProgramList(const ProgramList &programList)
 {
     m_programList = programList;
+    rebuildProgramIndex();
 }
 
 void
@@ -760,25 +829,10 @@ void
 MidiDevice::mergeProgramList(const ProgramList &programList)
 {
     ProgramList::const_iterator it;
-    ProgramList::iterator oIt;
-    bool clash = false;
 
+    // addProgram() refuses any that clash with ones we already have
     for (it = programList.begin(); it != programList.end(); ++it)
-    {
-        for (oIt = m_programList.begin(); oIt != m_programList.end(); ++oIt)
-        {
-            if (it->partialCompare(*oIt))
-            {
-                clash = true;
-                break;
-            }
-        }
-
-        if (clash == false)
-            addProgram(*it);
-        else
-            clash = false;
-    }
+        addProgram(*it);
 }
 
 void
@@ -811,6 +865,8 @@ MidiDevice::addControlParameter(const ControlParameter &con,
                                 bool propagateToInstruments)
 {
     if (isUniqueControlParameter(con)) { //Don't allow duplicates
+        m_controlIndex[getControlKey(con.getType(), con.getControllerValue())] =
+            m_controlList.size();
         m_controlList.push_back(con);
         if (propagateToInstruments && isVisibleControlParameter(con)) {
             addControlToInstrument(con);
@@ -850,6 +906,7 @@ MidiDevice::addControlParameter(const ControlParameter &con, int index,
 
     // Assign the ControlList we just made.
     m_controlList = controls;
+    rebuildControlIndex();
 }
 
 
@@ -865,6 +922,7 @@ MidiDevice::removeControlParameter(int index)
         {
             removeControlFromInstrument(*it);   
             m_controlList.erase(it);
+            rebuildControlIndex();
             return true;
         }
         i++;
@@ -879,6 +937,7 @@ MidiDevice::modifyControlParameter(const ControlParameter &con, int index)
     if (index < 0 || index > (int)m_controlList.size()) return false;
     removeControlFromInstrument(m_controlList[index]);
     m_controlList[index] = con;
+    rebuildControlIndex();
     addControlToInstrument(con);
     return true;
 }
@@ -896,6 +955,7 @@ MidiDevice::replaceControlParameters(const ControlList &con)
 
     // Clear the Device control list
     m_controlList.clear();
+    m_controlIndex.clear();
     
     // Now add the controllers to the device,    
     ControlList::const_iterator cIt = con.begin();
@@ -963,19 +1023,11 @@ const ControlParameter *
 MidiDevice::
 findControlParameter(std::string type, MidiByte conNumber) const
 {
-    ControlList::const_iterator it = m_controlList.begin();
+    std::map<ControlKey, size_t>::const_iterator i =
+        m_controlIndex.find(getControlKey(type, conNumber));
+    if (i == m_controlIndex.end()) return nullptr;
 
-    for (; it != m_controlList.end(); ++it)
-    {
-        if (it->getType() == type)
-        {
-            if (it->getType() == Rosegarden::Controller::EventType &&
-                it->getControllerValue() != conNumber)
-                { continue; }
-            return &*it;
-        }
-    }
-    return nullptr;
+    return &m_controlList[i->second];
 }
 
 bool 
@@ -1050,25 +1102,14 @@ MidiDevice::getControlParameter(int index) const
 ControlParameter *
 MidiDevice::getControlParameter(const std::string &type, Rosegarden::MidiByte controllerValue)
 {
-    ControlList::iterator it = m_controlList.begin();
-
-    for (; it != m_controlList.end(); ++it)
-    {
-        if (it->getType() == type)
-        {
-            // Return matched on type for most events
-            //
-            if (type != Rosegarden::Controller::EventType) 
-                return &*it;
-            
-            // Also match controller value for Controller events
-            //
-            if (it->getControllerValue() == controllerValue)
-                return  &*it;
-        }
-    }
+    // Matched on type for most events, and also on controller value
+    // for Controller events
+    //
+    std::map<ControlKey, size_t>::const_iterator i =
+        m_controlIndex.find(getControlKey(type, controllerValue));
+    if (i == m_controlIndex.end()) return nullptr;
 
-    return nullptr;
+    return &m_controlList[i->second];
 }
 
 const ControlParameter *
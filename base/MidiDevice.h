@@ -18,6 +18,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 
 #include "Device.h"
 #include "Instrument.h"
@@ -81,18 +82,24 @@ public:
     void clearControlList();
 
     const BankList &getBanks() const { return m_bankList; }
-    BankList getBanks(bool percussion) const;
-    BankList getBanksByMSB(bool percussion, MidiByte msb) const; 
-    BankList getBanksByLSB(bool percussion, MidiByte lsb) const;
+    /// The percussion or non-percussion banks, without copying them.
+    /**
+     * This and the other bank and program views below are valid until
+     * the bank or program list is next changed.
+     */
+    const BankList &getBanks(bool percussion) const;
+    const BankList &getBanksByMSB(bool percussion, MidiByte msb) const;
+    const BankList &getBanksByLSB(bool percussion, MidiByte lsb) const;
     const MidiBank *getBankByName(const std::string &) const;
     
     MidiByteList getDistinctMSBs(bool percussion, int lsb = -1) const;
     MidiByteList getDistinctLSBs(bool percussion, int msb = -1) const;
 
     const ProgramList &getPrograms() const { return m_programList; }
-    ProgramList getPrograms(const MidiBank &bank) const;
+    /// The programs in a bank, without copying them.
+    const ProgramList &getPrograms(const MidiBank &bank) const;
     /// Used by the UI to display all programs in variations mode.
-    ProgramList getPrograms0thVariation(bool percussion, const MidiBank &bank) const;
+    const ProgramList &getPrograms0thVariation(bool percussion, const MidiBank &bank) const;
 
     const KeyMappingList &getKeyMappings() const { return m_keyMappingList; }
     const MidiKeyMapping *getKeyMappingByName(const std::string &) const;
@@ -155,7 +162,8 @@ public:
     //
     ControlList getIPBControlParameters() const;
 
-    // Access ControlParameters (read/write)
+    // Access ControlParameters (read/write).  Don't change the type or
+    // controller number through these; use modifyControlParameter().
     //
     virtual ControlParameter *getControlParameter(int index);
     const ControlParameter *getControlParameter(int index) const override;
@@ -202,6 +210,31 @@ protected:
 
     void generatePresentationList();
 
+    // Keep m_programIndex and m_bankPrograms up to date with
+    // m_programList.  Call after any change to m_programList other than
+    // through addProgram().
+    //
+    void rebuildProgramIndex();
+
+    // Keep m_controlIndex up to date with m_controlList.  Call after
+    // any change to m_controlList other than through
+    // addControlParameter().
+    //
+    void rebuildControlIndex();
+
+    // Keep m_banksByPercussion, m_banksByMSB and m_banksByLSB up to
+    // date with m_bankList.  Call after any change to m_bankList other
+    // than through addBank().
+    //
+    void rebuildBankIndex();
+
+    static int getBankKey(const MidiBank &bank);
+    static int getProgramKey(const MidiProgram &program);
+
+    typedef std::pair<std::string, int> ControlKey;
+    static ControlKey getControlKey(const std::string &type,
+                                    MidiByte controllerValue);
+
     // Push the default IPB controllers to the device's Instruments.
     //
     void deviceToInstrControllerPush();
@@ -217,6 +250,22 @@ protected:
     ProgramList    m_programList;
     BankList       m_bankList;
     ControlList    m_controlList;
+
+    // Lookups for the above, from getProgramKey() to the index of the
+    // first matching program in m_programList, from getBankKey() to the
+    // bank's programs, and from getControlKey() to the index of the
+    // first matching control in m_controlList.
+    //
+    std::map<int, size_t>          m_programIndex;
+    std::map<int, ProgramList>     m_bankPrograms;
+    std::map<ControlKey, size_t>   m_controlIndex;
+
+    // m_bankList split by percussion, and by percussion and MSB or LSB
+    // (percussion in bit 8), for the bank views.
+    //
+    BankList                       m_banksByPercussion[2];
+    std::map<int, BankList>        m_banksByMSB;
+    std::map<int, BankList>        m_banksByLSB;
     KeyMappingList m_keyMappingList;
     MidiMetronome *m_metronome;
     
@@ -24,6 +24,13 @@
 #include <map>
 
 #include <stdio.h>
+#include <stdlib.h>
+
+#include <QMutex>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 using std::cerr;
 using std::endl;
@@ -32,6 +39,12 @@ namespace Rosegarden {
 
 Profiles* Profiles::m_instance = nullptr;
 
+#ifndef NO_TIMING
+// Profiling points are also passed on worker threads, such as those of
+// ParallelSegmentParser
+static QBasicMutex accumulateMutex;
+#endif
+
 Profiles* Profiles::getInstance()
 {
     if (!m_instance) m_instance = new Profiles();
@@ -57,6 +70,8 @@ void Profiles::accumulate(
 )
 {
 #ifndef NO_TIMING    
+    QMutexLocker locker(&accumulateMutex);
+
     ProfilePair &pair(m_profiles[id]);
     ++pair.first;
     pair.second.first += time;
@@ -170,6 +185,97 @@ void Profiles::dump() const
         fprintf(stderr, "%-40s  %d\n", i->second, i->first);
     }
 
+    const char *jsonFile = getenv("RG_PROFILE_JSON");
+    if (jsonFile && *jsonFile) {
+        if (dumpJson(jsonFile)) {
+            fprintf(stderr, "\nProfile written to %s\n", jsonFile);
+        }
+    }
+
+#endif
+}
+
+#ifndef NO_TIMING
+static double toMs(const RealTime &rt)
+{
+    return rt.sec * 1000.0 + rt.nsec / 1000000.0;
+}
+#endif
+
+long Profiles::getPeakRSS()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // bytes on OS X
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+bool Profiles::dumpJson(
+#ifndef NO_TIMING
+    const char *filename
+#else
+    const char *
+#endif
+) const
+{
+#ifndef NO_TIMING
+
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        fprintf(stderr, "Profiles::dumpJson: Failed to open %s\n", filename);
+        return false;
+    }
+
+    fprintf(f, "{\n  \"peakRssKb\": %ld,\n  \"profiles\": [", getPeakRSS());
+
+    bool first = true;
+
+    for (ProfileMap::const_iterator i = m_profiles.begin();
+         i != m_profiles.end(); ++i) {
+
+        const ProfilePair &pp(i->second);
+        if (pp.first == 0) continue;
+
+        RealTime worst;
+        WorstCallMap::const_iterator k = m_worstCalls.find(i->first);
+        if (k != m_worstCalls.end()) worst = k->second.second;
+
+        // Profile names are C++ identifiers and plain text, but be
+        // careful with quotes and backslashes anyway
+        std::string name;
+        for (const char *c = i->first; *c; ++c) {
+            if (*c == '"' || *c == '\\') name += '\\';
+            name += *c;
+        }
+
+        fprintf(f, "%s\n    { \"name\": \"%s\", \"calls\": %d, "
+                "\"totalMs\": %.3f, \"meanMs\": %.3f, \"worstMs\": %.3f, "
+                "\"cpuMs\": %.3f }",
+                first ? "" : ",",
+                name.c_str(),
+                pp.first,
+                toMs(pp.second.second),
+                toMs(pp.second.second) / pp.first,
+                toMs(worst),
+                (double)pp.second.first * 1000.0 / CLOCKS_PER_SEC);
+
+        first = false;
+    }
+
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+
+    return true;
+
+#else
+    return false;
 #endif
 }
 
@@ -52,8 +52,27 @@ public:
     ~Profiles();
 
     void accumulate(const char* id, clock_t time, RealTime rt);
+
+    /**
+     * Print the accumulated profile to stderr.  If the environment
+     * variable RG_PROFILE_JSON is set, also write it to the file it
+     * names, as with dumpJson().
+     */
     void dump() const;
 
+    /**
+     * Write the accumulated profile to the given file as JSON, for
+     * comparing timings between runs or builds.  The file holds the
+     * process's peak resident set size in kilobytes and, for each
+     * profiling point, its call count and its total, mean and worst
+     * real times and total CPU time in milliseconds.  Returns false
+     * if the file could not be written.
+     */
+    bool dumpJson(const char *filename) const;
+
+    /// Peak resident set size of this process in kilobytes, or -1
+    static long getPeakRSS();
+
 protected:
     Profiles();
 
@@ -20,6 +20,7 @@
 #include "base/PropertyName.h"
 #include "base/Exception.h"
 
+#include <QMutex>
 #include <QtGlobal>
 
 namespace Rosegarden 
@@ -30,8 +31,15 @@ PropertyName::intern_map *PropertyName::m_interns = nullptr;
 PropertyName::intern_reverse_map *PropertyName::m_internsReversed = nullptr;
 int PropertyName::m_nextValue = 0;
 
+// Segments may be read on several threads at once (see
+// ParallelSegmentParser).  A QBasicMutex needs no constructor to run,
+// so it is safe to use while other statics are being initialised.
+static QBasicMutex internMutex;
+
 int PropertyName::intern(const string &s)
 {
+    QMutexLocker locker(&internMutex);
+
     if (!m_interns) {
         m_interns = new intern_map;
         m_internsReversed = new intern_reverse_map;
@@ -51,6 +59,8 @@ int PropertyName::intern(const string &s)
 
 string PropertyName::getName() const
 {
+    QMutexLocker locker(&internMutex);
+
     intern_reverse_map::iterator i(m_internsReversed->find(m_value));
     if (i != m_internsReversed->end()) return i->second;
 
@@ -17,10 +17,16 @@
 #include "Quantizer.h"
 
 #include "misc/Debug.h"
+#include "Composition.h"
 #include "Event.h"
+#include "NotationTypes.h"
 #include "Selection.h"  // For EventSelection
 #include "base/Profiler.h"
 
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
 #include <algorithm>  // for std::min/std::max
 #include <utility>  // for std::pair
 
@@ -136,6 +142,54 @@ Quantizer::quantize(EventSelection *selection)
 }
 
 
+void
+Quantizer::quantize(const std::vector<Segment *> &segments) const
+{
+    Q_ASSERT(m_toInsert.size() == 0);
+
+    if (!isBarLocal()) {
+        for (size_t k = 0; k < segments.size(); ++k) {
+            quantize(segments[k]);
+        }
+        return;
+    }
+
+    // Gather the events of all the segments into one side buffer, so
+    // that they can all be shared out between the workers at once.
+
+    BarLocalItems items;
+    std::vector<size_t> segmentEnds;
+
+    for (size_t k = 0; k < segments.size(); ++k) {
+        Segment *s = segments[k];
+        gatherBarLocalItems(s, s->begin(), s->getEndMarker(), items);
+        segmentEnds.push_back(items.size());
+    }
+
+    computeBarLocalItems(items);
+
+    // Then apply the results, one pass per segment.
+
+    size_t start = 0;
+
+    for (size_t k = 0; k < segments.size(); ++k) {
+
+        Segment *s = segments[k];
+        Segment::iterator from = s->begin();
+        Segment::iterator to = s->getEndMarker();
+
+        m_normalizeRegion.first =
+            (from != s->end() ? (*from)->getAbsoluteTime() : s->getStartTime());
+        m_normalizeRegion.second =
+            (to != s->end() ? (*to)->getAbsoluteTime() : s->getEndTime());
+
+        applyBarLocalItems(s, items, start, segmentEnds[k]);
+        insertNewEvents(s);
+
+        start = segmentEnds[k];
+    }
+}
+
 void
 Quantizer::fixQuantizedValues(Segment *s,
                               Segment::iterator from,
@@ -217,12 +271,140 @@ Quantizer::quantizeRange(Segment *s,
     // only used for notation and will be explicitly recalculated when
     // the notation quantization values change.
 
+    if (isBarLocal()) {
+        BarLocalItems items;
+        gatherBarLocalItems(s, from, to, items);
+        computeBarLocalItems(items);
+        applyBarLocalItems(s, items, 0, items.size());
+        return;
+    }
+
     for (Segment::iterator nextFrom = from; from != to; from = nextFrom) {
 
         ++nextFrom;
         quantizeSingle(s, from);
     }
 }
+
+void
+Quantizer::gatherBarLocalItems(Segment *s,
+                               Segment::iterator from,
+                               Segment::iterator to,
+                               BarLocalItems &items) const
+{
+    // Everything that reads or writes the events or the composition
+    // happens here, on the calling thread.  Source times are (nearly)
+    // in order, so we only look up a new bar when we leave the last one.
+
+    Composition *comp = s->getComposition();
+    timeT segmentStart = s->getStartTime();
+    std::pair<timeT, timeT> bar(0, 0);
+
+    for (Segment::iterator i = from; i != to; ++i) {
+
+        BarLocalItem item;
+        item.i = i;
+        item.isNote = (*i)->isa(Note::EventType);
+        item.d = getFromSource(*i, DurationValue);
+        item.t = getFromSource(*i, AbsoluteTimeValue);
+        item.action = LeaveEvent;
+
+        // as in Segment::getBarStartForTime()
+        timeT t = std::max(item.t, segmentStart);
+        if (t < bar.first || t >= bar.second) {
+            bar = comp->getBarRangeForTime(t);
+        }
+        item.barStart = bar.first;
+
+        items.push_back(item);
+    }
+}
+
+class Quantizer::BarLocalTask : public QRunnable
+{
+public:
+    BarLocalTask(const Quantizer *quantizer, BarLocalItems &items,
+                 size_t start, size_t end) :
+        m_quantizer(quantizer), m_items(items), m_start(start), m_end(end) { }
+
+    void run() override {
+        m_quantizer->computeBarLocalRange(m_items, m_start, m_end);
+    }
+
+private:
+    const Quantizer *m_quantizer;
+    BarLocalItems &m_items;
+    size_t m_start;
+    size_t m_end;
+};
+
+void
+Quantizer::computeBarLocalItems(BarLocalItems &items) const
+{
+    // Not worth starting threads for an everyday edit.
+    static const size_t minItemsPerTask = 4096;
+
+    size_t tasks = items.size() / minItemsPerTask;
+    size_t threads = std::max(QThread::idealThreadCount(), 1);
+    if (tasks > threads) tasks = threads;
+
+    if (tasks < 2) {
+        computeBarLocalRange(items, 0, items.size());
+        return;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(int(tasks));
+
+    size_t start = 0;
+
+    for (size_t n = 1; n <= tasks; ++n) {
+
+        size_t end = std::max(start, items.size() * n / tasks);
+
+        // Never split a bar between two tasks.
+        while (end > start && end < items.size() &&
+               items[end].barStart == items[end - 1].barStart) {
+            ++end;
+        }
+
+        if (end == start) continue;
+
+        pool.start(new BarLocalTask(this, items, start, end));
+        start = end;
+    }
+
+    pool.waitForDone();
+}
+
+void
+Quantizer::computeBarLocalRange(BarLocalItems &items,
+                                size_t start, size_t end) const
+{
+    for (size_t k = start; k < end; ++k) {
+        BarLocalItem &item = items[k];
+        item.action = quantizeValues(item.isNote, item.barStart,
+                                     item.t, item.d);
+    }
+}
+
+void
+Quantizer::applyBarLocalItems(Segment *s, BarLocalItems &items,
+                              size_t start, size_t end) const
+{
+    // Erasing an event only invalidates its own iterator, and
+    // setToTarget() defers all insertions to insertNewEvents(), so
+    // the iterators gathered earlier are all still good here.
+
+    for (size_t k = start; k < end; ++k) {
+        BarLocalItem &item = items[k];
+        if (item.action == EraseEvent) {
+            s->erase(item.i);
+        } else if (item.action == SetEvent) {
+            setToTarget(s, item.i, item.t, item.d);
+        }
+    }
+}
     
 void
 Quantizer::unquantize(Segment *s,
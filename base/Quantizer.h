@@ -56,6 +56,16 @@ public:
      */
     void quantize(EventSelection *);
 
+    /**
+     * Quantize several Segments as one batch.  For a bar-local
+     * quantizer (see isBarLocal()) the quantized values for all the
+     * Segments are calculated in parallel into a side buffer, shared
+     * out between worker threads by segment and by bar, and then
+     * applied to each Segment in a single pass.  Other quantizers
+     * simply quantize each Segment in turn.
+     */
+    void quantize(const std::vector<Segment *> &segments) const;
+
     /**
      * Quantize a section of a Segment, and force the quantized
      * results into the formal absolute time and duration of
@@ -203,12 +213,62 @@ protected:
                                 Segment::iterator) const { }
 
     /**
-     * See note for quantizeSingle.
+     * See note for quantizeSingle.  For a bar-local quantizer the
+     * default implementation uses quantizeValues() rather than
+     * quantizeSingle(), calculating the results for the whole range
+     * (in parallel, if it is large) before applying any of them.
      */
     virtual void quantizeRange(Segment *,
                                Segment::iterator,
                                Segment::iterator) const;
 
+    enum QuantizeAction { LeaveEvent, SetEvent, EraseEvent };
+
+    /**
+     * Return true if the quantized values for an event depend only
+     * on its own source time and duration and on the start of the bar
+     * containing it.  A quantizer returning true must implement
+     * quantizeValues(), and can then be run by bar in parallel.
+     * The default is false.
+     */
+    virtual bool isBarLocal() const { return false; }
+
+    /**
+     * For bar-local quantizers: quantize the given source time and
+     * duration in place, and return what should be done to the event.
+     * This is called from worker threads, so it must not touch any
+     * Event, Segment or other shared state (including Profiler).
+     */
+    virtual QuantizeAction quantizeValues(bool /* isNote */,
+                                          timeT /* barStart */,
+                                          timeT & /* t */,
+                                          timeT & /* d */) const
+        { return LeaveEvent; }
+
+    /// An event awaiting bar-local quantization, and then its result.
+    struct BarLocalItem
+    {
+        Segment::iterator i;
+        bool isNote;
+        timeT barStart;
+        timeT t;
+        timeT d;
+        QuantizeAction action;
+    };
+    typedef std::vector<BarLocalItem> BarLocalItems;
+
+    class BarLocalTask;
+
+    void gatherBarLocalItems(Segment *,
+                             Segment::iterator from,
+                             Segment::iterator to,
+                             BarLocalItems &) const;
+    void computeBarLocalItems(BarLocalItems &) const;
+    void computeBarLocalRange(BarLocalItems &,
+                              size_t start, size_t end) const;
+    void applyBarLocalItems(Segment *, BarLocalItems &,
+                            size_t start, size_t end) const;
+
     std::string m_source;
     std::string m_target;
     mutable std::pair<timeT, timeT> m_normalizeRegion;
@@ -48,6 +48,8 @@ using std::string;
 
 static int g_runtimeSegmentId = 0;
 
+static DeferredEventLoader *g_deferredEventLoader = nullptr;
+
 Segment::Segment(SegmentType segmentType, timeT startTime) :
     EventContainer(),
     m_composition(nullptr),
@@ -76,6 +78,11 @@ Segment::Segment(SegmentType segmentType, timeT startTime) :
     m_notifyResizeLocked(false),
     m_memoStart(0),
     m_memoEndMarkerTime(nullptr),
+    m_eventTransactionDepth(0),
+    m_transactionStartTime(0),
+    m_transactionEndTime(0),
+    m_deferredState(NoDeferredEvents),
+    m_deferredEndTime(0),
     m_runtimeSegmentId(g_runtimeSegmentId++),
     m_snapGridSize(-1),
     m_viewFeatures(0),
@@ -122,6 +129,11 @@ Segment::Segment(const Segment &segment):
     m_notifyResizeLocked(false),  // To copy a segment while notifications
     m_memoStart(0),               // are locked doesn't sound as a good
     m_memoEndMarkerTime(nullptr),       // idea.
+    m_eventTransactionDepth(0),
+    m_transactionStartTime(0),
+    m_transactionEndTime(0),
+    m_deferredState(NoDeferredEvents),
+    m_deferredEndTime(0),
     m_runtimeSegmentId(g_runtimeSegmentId++),
     m_snapGridSize(-1),
     m_viewFeatures(0),
@@ -138,6 +150,12 @@ Segment::Segment(const Segment &segment):
          it != segment.end(); ++it) {
         insert(new Event(**it));
     }
+
+    // A copy is made to be changed, so it reads its events in at once
+    if (segment.hasDeferredEvents()) {
+        setDeferredEvents(segment.m_deferredEvents, segment.m_deferredEndTime);
+        loadDeferredEvents();
+    }
 }
 
 Segment*
@@ -189,6 +207,14 @@ Segment::~Segment()
     // delete content
     for (iterator it = begin(); it != end(); ++it) delete (*it);
 
+    // and anything erased during a transaction that never ended
+    for (size_t i = 0; i < m_transactionRemoved.size(); ++i) {
+        delete m_transactionRemoved[i];
+    }
+    for (size_t i = 0; i < m_transactionDiscarded.size(); ++i) {
+        delete m_transactionDiscarded[i];
+    }
+
     delete m_endMarkerTime;
 }
 
@@ -286,6 +312,10 @@ Segment::setTrack(TrackId id)
         m_trackId = id;
         return;
     }
+
+    if (m_deferredState == EventsDeferred && id != m_trackId) {
+        loadDeferredEvents();
+    }
     
     Composition *c = m_composition;
     if (c) c->weakDetachSegment(this); // sets m_composition to 0
@@ -362,6 +392,8 @@ Segment::setStartTime(timeT t)
 {
     //Profiler profiler("Segment::setStartTime()");
 
+    if (m_deferredState == EventsDeferred) loadDeferredEvents();
+
     typedef EventContainer base;
     int dt = t - m_startTime;
     if (dt == 0) return;
@@ -551,6 +583,12 @@ Segment::updateRefreshStatuses(timeT startTime, timeT endTime)
 {
     Profiler profiler("Segment::updateRefreshStatuses()");
 
+    // Once changed, the events can no longer be let go
+    if (m_deferredState == EventsLoaded) {
+        m_deferredState = NoDeferredEvents;
+        m_deferredEvents.clear();
+    }
+
     // For each observer, indicate that a refresh is needed for this time
     // span.
     for(size_t i = 0; i < m_refreshStatusArray.size(); ++i)
@@ -563,6 +601,8 @@ Segment::insert(Event *e)
 {
     Q_CHECK_PTR(e);
 
+    if (m_deferredState == EventsDeferred) loadDeferredEvents();
+
     // Event Start Time
     timeT t0 = e->getAbsoluteTime();
     // Event End Time
@@ -625,7 +665,7 @@ Segment::erase(iterator pos)
 
     EventContainer::erase(pos);
     notifyRemove(e);
-    delete e;
+    if (!isInEventTransaction()) delete e;
     updateRefreshStatuses(t0, t1);
 
     if (t0 == m_startTime && begin() != end()) {
@@ -644,6 +684,30 @@ Segment::erase(iterator pos)
 }
 
 
+void
+Segment::releaseEvents(std::vector<Event *> &events)
+{
+    if (m_deferredState == EventsDeferred) loadDeferredEvents();
+
+    if (begin() == end()) return;
+
+    events.insert(events.end(), begin(), end());
+    EventContainer::clear();
+
+    // The clef and key list only holds aliases
+    if (m_clefKeyList) m_clefKeyList->clear();
+
+    timeT oldEndTime = m_endTime;
+    m_endTime = m_startTime;
+
+    for (ObserverSet::const_iterator i = m_observers.begin();
+         i != m_observers.end(); ++i) {
+        (*i)->allEventsChanged(this);
+    }
+    notifyEndMarkerChange(true);
+    updateRefreshStatuses(m_startTime, oldEndTime);
+}
+
 void
 Segment::erase(iterator from, iterator to)
 {
@@ -651,8 +715,8 @@ Segment::erase(iterator from, iterator to)
     if (from != end()) startTime = (*from)->getAbsoluteTime();
     if (to != end()) endTime = (*to)->getAbsoluteTime() + (*to)->getGreaterDuration();
 
-    // Not very efficient, but without an observer event for
-    // multiple erase we can't do any better.
+    // Not very efficient outside an event transaction, which is the
+    // only way to give the observers a single notification.
 
     for (Segment::iterator i = from; i != to; ) {
 
@@ -664,7 +728,7 @@ Segment::erase(iterator from, iterator to)
 
         EventContainer::erase(i);
         notifyRemove(e);
-        delete e;
+        if (!isInEventTransaction()) delete e;
 
         i = j;
     }
@@ -719,8 +783,8 @@ Segment::findSingle(Event* e)
 Segment::iterator
 Segment::findTime(timeT t)
 {
-    Event dummy("dummy", t, 0, MIN_SUBORDERING);
-    return lower_bound(&dummy);
+    Event key(Event::SearchKey(), t, MIN_SUBORDERING);
+    return lower_bound(&key);
 }
 
 
@@ -1053,20 +1117,20 @@ Segment::normalizeRests(timeT startTime, timeT endTime)
 
 void Segment::getTimeSlice(timeT absoluteTime, iterator &start, iterator &end)
 {
-    Event dummy("dummy", absoluteTime, 0, MIN_SUBORDERING);
+    Event key(Event::SearchKey(), absoluteTime, MIN_SUBORDERING);
 
     // No, this won't work -- we need to include things that don't
     // compare equal because they have different suborderings, as long
     // as they have the same times
 
-//    std::pair<iterator, iterator> res = equal_range(&dummy);
+//    std::pair<iterator, iterator> res = equal_range(&key);
 
 //    start = res.first;
 //    end = res.second;
 
     // Got to do this instead:
 
-    start = end = lower_bound(&dummy);
+    start = end = lower_bound(&key);
 
     while (end != this->end() &&
            (*end)->getAbsoluteTime() == (*start)->getAbsoluteTime())
@@ -1076,9 +1140,9 @@ void Segment::getTimeSlice(timeT absoluteTime, iterator &start, iterator &end)
 void Segment::getTimeSlice(timeT absoluteTime, const_iterator &start, const_iterator &end)
     const
 {
-    Event dummy("dummy", absoluteTime, 0, MIN_SUBORDERING);
+    Event key(Event::SearchKey(), absoluteTime, MIN_SUBORDERING);
 
-    start = end = lower_bound(&dummy);
+    start = end = lower_bound(&key);
 
     while (end != this->end() &&
            (*end)->getAbsoluteTime() == (*start)->getAbsoluteTime())
@@ -1458,11 +1522,18 @@ checkInsertAsClefKey(Event *e) const
 }
 
 void
-Segment::notifyAdd(Event *e) const
+Segment::notifyAdd(Event *e)
 {
     Profiler profiler("Segment::notifyAdd()");
     checkInsertAsClefKey(e);
 
+    if (isInEventTransaction()) {
+        m_transactionAdded.push_back(e);
+        m_transactionAddedSet.insert(e);
+        noteTransactionRange(e);
+        return;
+    }
+
     for (ObserverSet::const_iterator i = m_observers.begin();
          i != m_observers.end(); ++i) {
         (*i)->eventAdded(this, e);
@@ -1471,7 +1542,7 @@ Segment::notifyAdd(Event *e) const
 
 
 void
-Segment::notifyRemove(Event *e) const
+Segment::notifyRemove(Event *e)
 {
     Profiler profiler("Segment::notifyRemove()");
 
@@ -1486,12 +1557,161 @@ Segment::notifyRemove(Event *e) const
         }
     }
 
+    if (isInEventTransaction()) {
+        std::set<Event *>::iterator added = m_transactionAddedSet.find(e);
+        if (added != m_transactionAddedSet.end()) {
+            m_transactionAddedSet.erase(added);
+            m_transactionDiscarded.push_back(e);
+        } else {
+            m_transactionRemoved.push_back(e);
+            noteTransactionRange(e);
+        }
+        return;
+    }
+
     for (ObserverSet::const_iterator i = m_observers.begin();
          i != m_observers.end(); ++i) {
         (*i)->eventRemoved(this, e);
     }
 }
 
+void
+Segment::noteTransactionRange(const Event *e)
+{
+    timeT t0 = e->getAbsoluteTime();
+    timeT t1 = t0 + e->getGreaterDuration();
+
+    if (m_transactionAdded.size() + m_transactionRemoved.size() == 1) {
+        m_transactionStartTime = t0;
+        m_transactionEndTime = t1;
+        return;
+    }
+
+    if (t0 < m_transactionStartTime) m_transactionStartTime = t0;
+    if (t1 > m_transactionEndTime) m_transactionEndTime = t1;
+}
+
+void
+Segment::beginEventTransaction()
+{
+    ++m_eventTransactionDepth;
+}
+
+void
+Segment::endEventTransaction()
+{
+    if (m_eventTransactionDepth == 0) return;
+    if (--m_eventTransactionDepth > 0) return;
+
+    Profiler profiler("Segment::endEventTransaction()");
+
+    // Take the lists first, in case an observer edits the segment
+    std::vector<Event *> added;
+    added.reserve(m_transactionAddedSet.size());
+    for (size_t i = 0; i < m_transactionAdded.size(); ++i) {
+        if (m_transactionAddedSet.find(m_transactionAdded[i]) !=
+            m_transactionAddedSet.end()) {
+            added.push_back(m_transactionAdded[i]);
+        }
+    }
+
+    std::vector<Event *> removed;
+    removed.swap(m_transactionRemoved);
+
+    std::vector<Event *> discarded;
+    discarded.swap(m_transactionDiscarded);
+
+    m_transactionAdded.clear();
+    m_transactionAddedSet.clear();
+
+    if (!added.empty() || !removed.empty()) {
+        for (ObserverSet::const_iterator i = m_observers.begin();
+             i != m_observers.end(); ++i) {
+            (*i)->eventsChanged(this,
+                                m_transactionStartTime, m_transactionEndTime,
+                                added, removed);
+        }
+    }
+
+    for (size_t i = 0; i < removed.size(); ++i) delete removed[i];
+    for (size_t i = 0; i < discarded.size(); ++i) delete discarded[i];
+}
+
+void
+Segment::setDeferredEventLoader(DeferredEventLoader *loader)
+{
+    g_deferredEventLoader = loader;
+}
+
+void
+Segment::setDeferredEvents(const QByteArray &events, timeT endTime)
+{
+    m_deferredEvents = events;
+    m_deferredEndTime = endTime;
+    m_deferredState = EventsDeferred;
+
+    if (endTime > m_endTime) {
+        m_endTime = endTime;
+        notifyEndMarkerChange(false);
+    }
+}
+
+bool
+Segment::loadDeferredEvents()
+{
+    if (m_deferredState != EventsDeferred) return true;
+
+    if (!g_deferredEventLoader) {
+        cerr << "WARNING: Segment::loadDeferredEvents(): no loader" << endl;
+        return false;
+    }
+
+    // The observers hear of all the events at once, and inserting
+    // them does not count as a change (see updateRefreshStatuses())
+    m_deferredState = EventsLoading;
+
+    bool ok;
+    {
+        EventTransaction transaction(*this);
+        ok = g_deferredEventLoader->loadEvents(this);
+    }
+
+    if (!ok) {
+        cerr << "WARNING: Segment::loadDeferredEvents(): failed to read events"
+             << endl;
+        resetToDeferred();
+        return false;
+    }
+
+    m_deferredState = EventsLoaded;
+    return true;
+}
+
+bool
+Segment::unloadDeferredEvents()
+{
+    if (m_deferredState != EventsLoaded) return false;
+
+    resetToDeferred();
+    return true;
+}
+
+void
+Segment::resetToDeferred()
+{
+    m_deferredState = EventsLoading;
+
+    {
+        EventTransaction transaction(*this);
+        erase(begin(), end());
+    }
+
+    m_deferredState = EventsDeferred;
+
+    m_endTime = m_deferredEndTime;
+    notifyEndMarkerChange(false);
+}
+
 
 void
 Segment::notifyAppearanceChange() const
@@ -1765,6 +1985,21 @@ allEventsChanged(const Segment *s)
     }
 }
 
+void
+SegmentObserver::
+eventsChanged(const Segment *s, timeT, timeT,
+              const std::vector<Event *> &added,
+              const std::vector<Event *> &removed)
+{
+    Profiler profiler("SegmentObserver::eventsChanged");
+    for (size_t i = 0; i < removed.size(); ++i) {
+        eventRemoved(s, removed[i]);
+    }
+    for (size_t i = 0; i < added.size(); ++i) {
+        eventAdded(s, added[i]);
+    }
+}
+
 // Find the next Event of "type".
 EventContainer::iterator
 EventContainer::findEventOfType(EventContainer::iterator i,
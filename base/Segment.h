@@ -20,6 +20,7 @@
 #include <set>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "Track.h"
 #include "Event.h"
@@ -28,6 +29,7 @@
 #include "RealTime.h"
 #include "MidiProgram.h"
 
+#include <QByteArray>
 #include <QColor>
 #include <QSharedPointer>
 
@@ -51,6 +53,7 @@ protected:
 };
 
 class SegmentObserver;
+class DeferredEventLoader;
 class Quantizer;
 class BasicQuantizer;
 class Composition;
@@ -412,6 +415,13 @@ public:
     /// Clear the segment.
     void clear() { erase(begin(), end()); }
 
+    /**
+     * Take all the events out of the segment without deleting them,
+     * appending them in order to the given vector.  The caller owns
+     * them afterwards.  Not for use within an event transaction.
+     */
+    void releaseEvents(std::vector<Event *> &events);
+
     /**
      * Looks up an Event and if it finds it, erases it.
      * @return true if the event was found and erased, false otherwise.
@@ -591,6 +601,68 @@ public:
      * Nested lock/unlock calls are not allowed currently.
      */ 
     void unlockResizeNotifications();    
+
+    /**
+     * Start a batch of edits.  Until the matching endEventTransaction(),
+     * insert() and erase() do not tell the observers about each event.
+     * Instead every observer gets a single eventsChanged() call at the
+     * end, listing everything added and removed.  Erased events are
+     * not deleted until then, so that the observers can still look at
+     * them.
+     *
+     * The segment itself, its clef and key list and its refresh
+     * statuses are kept up to date throughout; only the observers
+     * wait.  Transactions nest, and only the outermost one notifies.
+     */
+    void beginEventTransaction();
+    void endEventTransaction();
+
+    bool isInEventTransaction() const { return m_eventTransactionDepth > 0; }
+
+    /// Holds an event transaction open for the lifetime of the object
+    class EventTransaction
+    {
+    public:
+        EventTransaction(Segment &segment) : m_segment(segment)
+            { m_segment.beginEventTransaction(); }
+        ~EventTransaction() { m_segment.endEventTransaction(); }
+
+    private:
+        Segment &m_segment;
+    };
+
+    /**
+     * Give the segment its events in unparsed form, to be read in by
+     * the DeferredEventLoader the first time they are needed.  Until
+     * then the segment is an empty shell whose end time is endTime.
+     * Only for a newly read segment that has no events yet.
+     */
+    void setDeferredEvents(const QByteArray &events, timeT endTime);
+
+    /// Whether the segment is a shell whose events have not been read yet
+    bool hasDeferredEvents() const { return m_deferredState == EventsDeferred; }
+
+    /// The unparsed events, valid while hasDeferredEvents()
+    const QByteArray &getDeferredEvents() const { return m_deferredEvents; }
+
+    /**
+     * Read in the deferred events, if there are any.  insert(),
+     * setStartTime() and setTrack() do this themselves; anything else
+     * that reads the events of a segment that may be a shell must call
+     * it first.  Returns false if the events could not be read, in
+     * which case the segment stays a shell.
+     */
+    bool loadDeferredEvents();
+
+    /**
+     * Go back to being a shell, if the events were deferred and have
+     * not been changed since they were read in.  Returns true if the
+     * events were let go.
+     */
+    bool unloadDeferredEvents();
+
+    /// Set the loader used by loadDeferredEvents()
+    static void setDeferredEventLoader(DeferredEventLoader *loader);
     
     /**
      * YG: This one is only for debug
@@ -952,8 +1024,8 @@ private: // stuff to support SegmentObservers
     typedef std::list<SegmentObserver *> ObserverSet;
     ObserverSet m_observers;
 
-    void notifyAdd(Event *) const;
-    void notifyRemove(Event *) const;
+    void notifyAdd(Event *);
+    void notifyRemove(Event *);
     void notifyAppearanceChange() const;
     void notifyStartChanged(timeT);
     void notifyEndMarkerChange(bool shorten);
@@ -964,6 +1036,32 @@ private: // stuff to support SegmentObservers
     timeT m_memoStart;
     timeT *m_memoEndMarkerTime;
 
+    // Event transaction state, see beginEventTransaction()
+    int m_eventTransactionDepth;
+    timeT m_transactionStartTime;
+    timeT m_transactionEndTime;
+    std::vector<Event *> m_transactionAdded;
+    std::set<Event *> m_transactionAddedSet;
+    std::vector<Event *> m_transactionRemoved;
+    // Added and then erased again within the transaction, so the
+    // observers need never hear of them
+    std::vector<Event *> m_transactionDiscarded;
+
+    void noteTransactionRange(const Event *e);
+
+    // Deferred events, see setDeferredEvents()
+    enum DeferredState {
+        NoDeferredEvents,
+        EventsDeferred,
+        EventsLoading,
+        EventsLoaded    // still kept in m_deferredEvents until changed
+    };
+    DeferredState m_deferredState;
+    QByteArray m_deferredEvents;
+    timeT m_deferredEndTime;
+
+    void resetToDeferred();
+
 signals:
     void contentsChanged(timeT start, timeT end);
  public:
@@ -1035,6 +1133,19 @@ public:
     // both eventRemoved() and eventAdded() on every event.
     virtual void allEventsChanged(const Segment *);
 
+    /**
+     * Called at the end of a Segment event transaction, in lieu of
+     * calling eventAdded or eventRemoved for each event.  startTime
+     * and endTime span all of the events listed.  The removed events
+     * are no longer in the segment but are not deleted until this
+     * returns.  The default calls eventRemoved() on each removed event
+     * and then eventAdded() on each added one.
+     */
+    virtual void eventsChanged(const Segment *,
+                               timeT startTime, timeT endTime,
+                               const std::vector<Event *> &added,
+                               const std::vector<Event *> &removed);
+
     /**
      * Called after a change in the segment that will change the way its displays,
      * like a label change for instance
@@ -1062,6 +1173,23 @@ public:
 };
 
 
+/// Reads in the events of a Segment whose events were deferred.
+/**
+ * See Segment::setDeferredEvents().
+ */
+class DeferredEventLoader
+{
+public:
+    virtual ~DeferredEventLoader() {}
+
+    /**
+     * Insert the events held by segment->getDeferredEvents() into the
+     * segment.  Return false if they could not be read.
+     */
+    virtual bool loadEvents(Segment *segment) = 0;
+};
+
+
 class SegmentHelper
 {
 protected:
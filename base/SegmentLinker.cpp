@@ -221,15 +221,19 @@ SegmentLinker::linkedSegmentChanged(Segment *s, const timeT from,
         timeT segStartTime = linkedSegToUpdate->getStartTime();
         timeT segFrom = segStartTime + refFrom;
         timeT segTo = segStartTime + refTo;
-        Segment::iterator itrFrom = linkedSegToUpdate->findTime(segFrom);
-        Segment::iterator itrTo = linkedSegToUpdate->findTime(segTo);
-        lyricsChanged = eraseNonIgnored(linkedSegToUpdate,
-                                        itrFrom, itrTo, lyricsChanged);
-        
-        //now go through s from 'from' to 'to', inserting the equivalent
-        //event in linkedSegToUpdate
+
+        int semitones =
+                linkedSegToUpdate->getLinkTransposeParams().m_semitones -
+                                s->getLinkTransposeParams().m_semitones;
+        int steps = linkedSegToUpdate->getLinkTransposeParams().m_steps -
+                                    s->getLinkTransposeParams().m_steps;
+
+        //work out what the range in linkedSegToUpdate should contain: the
+        //equivalent of each event in s from 'from' to 'to'
+        std::vector<Event *> wanted;
+        Segment::const_iterator sourceTo = s->findTime(to);
         for(Segment::const_iterator itr = s->findTime(from);
-                                    itr != s->findTime(to); ++itr) {
+                                    itr != sourceTo; ++itr) {
             const Event *e = *itr;
         
             timeT eventT = (e->getAbsoluteTime() - sourceSegStartTime)
@@ -238,15 +242,19 @@ SegmentLinker::linkedSegmentChanged(Segment *s, const timeT from,
             timeT eventNotationT = (e->getNotationAbsoluteTime() - sourceSegStartTime)
                                    + segStartTime;
 
-            int semitones =
-                    linkedSegToUpdate->getLinkTransposeParams().m_semitones -
-                                    s->getLinkTransposeParams().m_semitones;
-            int steps = linkedSegToUpdate->getLinkTransposeParams().m_steps -
-                                        s->getLinkTransposeParams().m_steps;
-        
-            lyricsChanged = insertMappedEvent(linkedSegToUpdate, e, eventT,
-                                              eventNotationT, semitones, steps,
-                                              lyricsChanged);
+            Event *mapped = createMappedEvent(e, eventT, eventNotationT,
+                                              semitones, steps);
+            if (mapped) wanted.push_back(mapped);
+        }
+
+        //and then change only what differs from that, so that observers
+        //of linkedSegToUpdate hear about nothing but the real changes,
+        //and about all of them in a single eventsChanged() call
+        {
+            Segment::EventTransaction transaction(*linkedSegToUpdate);
+            lyricsChanged = applyMappedEvents(linkedSegToUpdate,
+                                              segFrom, segTo,
+                                              wanted, lyricsChanged);
         }
         
         // Fix verses count if lyrics have been modified
@@ -259,18 +267,21 @@ SegmentLinker::linkedSegmentChanged(Segment *s, const timeT from,
     }
 }
 
-bool
-SegmentLinker::insertMappedEvent(Segment *seg,
-                                 const Event *e, timeT t, timeT nt,
-                                 int semitones, int steps,
-                                 bool lyricsAlreadyInserted)
+/*static*/ Event *
+SegmentLinker::createMappedEvent(const Event *e, timeT t, timeT nt,
+                                 int semitones, int steps)
 {
-    bool lyricInserted = lyricsAlreadyInserted;
-
     bool ignore;
     if (e->get<Bool>(BaseProperties::LINKED_SEGMENT_IGNORE_UPDATE, ignore) 
         && ignore) {
-        return lyricInserted;
+        return nullptr;
+    }
+
+    //correct for temporal (and pitch shift??) here eventually...
+    if (semitones!=0 && e->isa(Rosegarden::Key::EventType)) {
+        Rosegarden::Key trKey = (Rosegarden::Key (*e)).transpose(semitones, 
+                                                                     steps);
+        return trKey.getAsEvent(t);
     }
 
     Event *refSegEvent = new Event(*e,
@@ -280,43 +291,102 @@ SegmentLinker::insertMappedEvent(Segment *seg,
                                    nt,
                                    e->getNotationDuration());
 
-    bool needsInsertion = true;
+    if (semitones!=0 && e->isa(Note::EventType)) {
+        long oldPitch = 0;
+        if (e->get<Int>(BaseProperties::PITCH, oldPitch)) {
+            long newPitch = oldPitch + semitones;
+            refSegEvent->set<Int>(BaseProperties::PITCH, newPitch);
+        }
+    }
 
-    //correct for temporal (and pitch shift??) here eventually...
-    if (semitones!=0) {
-        if (e->isa(Note::EventType)) {
-            long oldPitch = 0;
-            if (e->get<Int>(BaseProperties::PITCH, oldPitch)) {
-                long newPitch = oldPitch + semitones;
-                refSegEvent->set<Int>(BaseProperties::PITCH, newPitch);
+    return refSegEvent;
+}
+
+/*static*/ bool
+SegmentLinker::isLyric(const Event *e)
+{
+    if (!e->isa(Text::EventType)) return false;
+    std::string textType;
+    return e->get<String>(Text::TextTypePropertyName, textType)
+        && (textType == Text::Lyric);
+}
+
+bool
+SegmentLinker::insertMappedEvent(Segment *seg,
+                                 const Event *e, timeT t, timeT nt,
+                                 int semitones, int steps,
+                                 bool lyricsAlreadyInserted)
+{
+    Event *refSegEvent = createMappedEvent(e, t, nt, semitones, steps);
+    if (!refSegEvent) return lyricsAlreadyInserted;
+
+    seg->insert(refSegEvent);
+
+    return lyricsAlreadyInserted || isLyric(e);
+}
+
+bool
+SegmentLinker::applyMappedEvents(Segment *seg, timeT from, timeT to,
+                                 std::vector<Event *> &wanted,
+                                 bool lyricsAlreadyChanged)
+{
+    bool lyricChanged = lyricsAlreadyChanged;
+
+    //the wanted events are in time order, as they were mapped from
+    //another segment by a fixed offset, so we can match them against
+    //what's already in seg one time slice at a time
+    std::vector<bool> matched(wanted.size(), false);
+    size_t sliceStart = 0;
+
+    Segment::iterator itr = seg->findTime(from);
+    Segment::iterator itrTo = seg->findTime(to);
+
+    while (itr != seg->end() && itr != itrTo) {
+
+        Event *existing = *itr;
+
+        bool ignore = false;
+        existing->get<Bool>(BaseProperties::LINKED_SEGMENT_IGNORE_UPDATE,
+                            ignore);
+        if (ignore) {
+            ++itr;
+            continue;
+        }
+
+        timeT t = existing->getAbsoluteTime();
+        while (sliceStart < wanted.size() &&
+               wanted[sliceStart]->getAbsoluteTime() < t) {
+            ++sliceStart;
+        }
+
+        bool found = false;
+        for (size_t i = sliceStart;
+             i < wanted.size() && wanted[i]->getAbsoluteTime() == t; ++i) {
+            if (!matched[i] && wanted[i]->isIdenticalTo(*existing)) {
+                matched[i] = true;
+                found = true;
+                break;
             }
-        } else if (e->isa(Rosegarden::Key::EventType)) {
-            Rosegarden::Key trKey = (Rosegarden::Key (*e)).transpose(semitones, 
-                                                                         steps);
-            delete refSegEvent; 
-            refSegEvent = nullptr;
-            SegmentNotationHelper helper(*seg);
-            helper.insertKey(t,trKey);
-            needsInsertion = false;
         }
-    }
-    
-    if (needsInsertion) {
-
-        if (! lyricInserted) {
-            // Is the inserted event a lyric?
-            if (e->isa(Text::EventType)) {
-                std::string textType;
-                lyricInserted =
-                    e->get<String>(Text::TextTypePropertyName, textType)
-                    && (textType == Text::Lyric);
-                }
+
+        if (found) {
+            ++itr;
+        } else {
+            if (!lyricChanged) lyricChanged = isLyric(existing);
+            seg->erase(itr++);
         }
+    }
 
-        seg->insert(refSegEvent);
+    for (size_t i = 0; i < wanted.size(); ++i) {
+        if (matched[i]) {
+            delete wanted[i];
+        } else {
+            if (!lyricChanged) lyricChanged = isLyric(wanted[i]);
+            seg->insert(wanted[i]);
+        }
     }
 
-    return lyricInserted;
+    return lyricChanged;
 }
 
 bool
@@ -334,16 +404,8 @@ SegmentLinker::eraseNonIgnored(Segment *s, Segment::const_iterator itrFrom,
                                 ignore);
         if (!ignore) {
 
-            if (! lyricErased) {
-                // Is the erased event a lyric?
-                Event *e = *eraseItr;
-                if (e->isa(Text::EventType)) {
-                    std::string textType;
-                    lyricErased =
-                        e->get<String>(Text::TextTypePropertyName, textType)
-                        && (textType == Text::Lyric);
-                }
-            }
+            // Is the erased event a lyric?
+            if (! lyricErased) lyricErased = isLyric(*eraseItr);
 
             s->erase(eraseItr++);
         } else {
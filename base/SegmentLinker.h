@@ -20,6 +20,8 @@
 #include "Segment.h"
 #include <QObject>
 
+#include <vector>
+
 namespace Rosegarden 
 {
 
@@ -95,6 +97,28 @@ private:
                            int semitones, int steps,
                            bool lyricsAlreadyInserted);
 
+    /**
+     * Return a new copy of e moved to time t (notation time nt) and
+     * transposed, as it should appear in another linked segment, or
+     * nullptr if e is not to be copied to linked segments
+     */
+    static Event *createMappedEvent(const Event *e, timeT t, timeT nt,
+                                    int semitones, int steps);
+
+    /**
+     * Make the events in [from,to) of seg, other than those ignored
+     * for link purposes, match the wanted events (in time order).
+     * Events already present are left alone and only the differences
+     * are erased or inserted.  Takes ownership of the wanted events.
+     * Return true if lyricsAlreadyChanged is true or if a lyric has
+     * been erased or inserted
+     */
+    bool applyMappedEvents(Segment *seg, timeT from, timeT to,
+                           std::vector<Event *> &wanted,
+                           bool lyricsAlreadyChanged);
+
+    static bool isLyric(const Event *e);
+
     LinkedSegmentParamsList::iterator findParamsItrForSegment(Segment *s);
     static void handleImpliedCMajor(Segment *s);
 
@@ -1836,12 +1836,12 @@ SegmentNotationHelper::guessClef(iterator from, iterator to)
 bool
 SegmentNotationHelper::removeRests(timeT time, timeT &duration, bool testOnly)
 {
-    Event dummy("dummy", time, 0, MIN_SUBORDERING);
+    Event key(Event::SearchKey(), time, MIN_SUBORDERING);
     
     RG_DEBUG << "SegmentNotationHelper::removeRests(" << time
               << ", " << duration << ")";
 
-    iterator from = segment().lower_bound(&dummy);
+    iterator from = segment().lower_bound(&key);
 
     // ignore any number of zero-duration events at the start
     while (from != segment().end() &&
@@ -85,6 +85,8 @@ class LinearTimeScale
 // @author Tom Breton (Tehom)
 class TriggerExpansionContext
 {
+    friend class TriggerSegmentRec;
+
     typedef std::pair<timeT,timeT> TimeInterval;
     typedef std::vector<TimeInterval> TimeIntervalVector;
     
@@ -431,6 +433,78 @@ ExpandInto(Segment *target,
     return insertedSomething;
 }
 
+bool
+TriggerSegmentRec::
+getExpansionKey(Segment::iterator iTrigger,
+                Segment *containing,
+                ExpansionKey &key) const
+{
+    const Segment *source = getSegment();
+    if (!source || source->empty()) { return false; }
+
+    const Event *trigger = *iTrigger;
+    const timeT start = trigger->getAbsoluteTime();
+    const timeT duration =
+        SegmentPerformanceHelper(*containing).getSoundingDuration(iTrigger);
+    if (duration <= 0) { return false; }
+
+    const timeT trStart = source->getStartTime();
+    const timeT trEnd = source->getEndMarkerTime();
+
+    std::string adjustmentMode = BaseProperties::TRIGGER_SEGMENT_ADJUST_NONE;
+    trigger->get<String>(BaseProperties::TRIGGER_SEGMENT_ADJUST_TIMES,
+                         adjustmentMode);
+
+    // Squishing scales the start time along with everything else, so
+    // the result isn't simply offset by the trigger time.
+    if (adjustmentMode == BaseProperties::TRIGGER_SEGMENT_ADJUST_SQUISH &&
+        trEnd != trStart && duration != trEnd - trStart) {
+        return false;
+    }
+
+    // Performance time offset relative to the trigger time, as
+    // LinearTimeScale calculates it for an unsquished ornament
+    const timeT offset =
+        (adjustmentMode == BaseProperties::TRIGGER_SEGMENT_ADJUST_SYNC_END) ?
+        duration - trEnd : -trStart;
+
+    timeT lastEnd = trStart;
+    for (Segment::iterator i = source->begin();
+         i != source->getEndMarker(); ++i) {
+        const Event *e = *i;
+        if (e->has(BaseProperties::TRIGGER_SEGMENT_ID) ||
+            e->isa(Controller::EventType) ||
+            e->isa(PitchBend::EventType)) {
+            return false;
+        }
+        lastEnd = std::max(lastEnd, e->getAbsoluteTime() + e->getDuration());
+    }
+
+    // No event of the ornament sounds beyond this, relative to the
+    // trigger, so sounding intervals that reach past it are cut back
+    // to it.  Otherwise the intervals of ...ADJUST_NONE triggers,
+    // which run to the end of the containing segment, would make
+    // every key different.
+    const timeT limit = lastEnd - trStart + offset + 1;
+
+    TriggerExpansionContext::TimeIntervalVector intervals =
+        TriggerExpansionContext::getSoundingIntervals
+        (iTrigger, containing, LinearTimeScale::m_identity);
+
+    key.clear();
+    key.push_back(getId());
+    key.push_back(offset);
+    key.push_back(getTranspose(trigger));
+    key.push_back(getVelocityDiff(trigger));
+
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        key.push_back(std::min(intervals[i].first - start, limit));
+        key.push_back(std::min(intervals[i].second - start, limit));
+    }
+
+    return true;
+}
+
 /*** LinearTimeScale definitions ***/
 
 const LinearTimeScale
@@ -19,6 +19,7 @@
 #include <base/Segment.h>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace Rosegarden
 {
@@ -73,6 +74,20 @@ public:
                     ControllerContextParams *controllerContextParams) const;
     int getTranspose(const Event *trigger) const;
     int getVelocityDiff(const Event *trigger) const;
+
+    typedef std::vector<timeT> ExpansionKey;
+
+    // Describe in key everything about how iTrigger would be expanded
+    // by ExpandInto() except for its time.  Triggers with the same key
+    // expand to the same events, offset by the difference between the
+    // triggers' times, so one expansion can be copied for all of them.
+    // Returns false if that can't be done for this trigger, because
+    // the ornament is squished, contains controllers (which are made
+    // absolute using the surrounding context) or contains triggers
+    // itself.
+    bool getExpansionKey(Segment::iterator iTrigger,
+                         Segment *containing,
+                         ExpansionKey &key) const;
     
 protected:
     friend class Composition;
@@ -0,0 +1,93 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[BatchQuantizeCommand]"
+
+#include "BatchQuantizeCommand.h"
+
+#include "EventQuantizeCommand.h"
+#include "base/Profiler.h"
+#include "base/Quantizer.h"
+#include "base/Segment.h"
+
+
+namespace Rosegarden
+{
+
+BatchQuantizeCommand::BatchQuantizeCommand(QString name) :
+    MacroCommand(name),
+    m_executed(false)
+{
+}
+
+BatchQuantizeCommand::~BatchQuantizeCommand()
+{
+}
+
+void
+BatchQuantizeCommand::addCommand(EventQuantizeCommand *command)
+{
+    MacroCommand::addCommand(command);
+    m_quantizeCommands.push_back(command);
+}
+
+void
+BatchQuantizeCommand::execute()
+{
+    // Redo restores each segment by brute force
+    if (m_executed || m_quantizeCommands.empty()) {
+        MacroCommand::execute();
+        return;
+    }
+
+    m_executed = true;
+
+    Profiler profiler("BatchQuantizeCommand::execute", true);
+
+    // Each command saves its events for undo, and nothing more
+    std::vector<Segment *> segments;
+
+    for (size_t i = 0; i < m_quantizeCommands.size(); ++i) {
+        m_quantizeCommands[i]->setBatched(true);
+        m_quantizeCommands[i]->execute();
+        m_quantizeCommands[i]->setBatched(false);
+        segments.push_back(&m_quantizeCommands[i]->getSegment());
+    }
+
+    // The observers hear about each segment once, at the end
+    for (size_t i = 0; i < segments.size(); ++i) {
+        segments[i]->beginEventTransaction();
+    }
+
+    m_quantizeCommands[0]->getQuantizer()->quantize(segments);
+
+    for (size_t i = 0; i < m_quantizeCommands.size(); ++i) {
+
+        EventQuantizeCommand *command = m_quantizeCommands[i];
+        command->finishBatch();
+        segments[i]->endEventTransaction();
+
+        // As BasicCommand::execute() would have
+        segments[i]->updateRefreshStatuses(command->getStartTime(),
+                                           command->getRelayoutEndTime());
+        segments[i]->signalChanged(command->getStartTime(),
+                                   command->getRelayoutEndTime());
+    }
+}
+
+
+}
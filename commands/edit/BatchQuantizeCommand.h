@@ -0,0 +1,60 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_BATCHQUANTIZECOMMAND_H
+#define RG_BATCHQUANTIZECOMMAND_H
+
+#include "document/Command.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace Rosegarden
+{
+
+class EventQuantizeCommand;
+
+
+/**
+ * Quantizes whole segments, one EventQuantizeCommand for each, with a
+ * single call to Quantizer::quantize(const std::vector<Segment *> &)
+ * so that a bar-local quantizer can share the work out between
+ * threads by segment and by bar.  Each command keeps its own undo.
+ *
+ * The commands must all cover whole segments, with quantizers of the
+ * same settings; that of the first is used for them all.
+ */
+class BatchQuantizeCommand : public MacroCommand
+{
+public:
+    BatchQuantizeCommand(QString name);
+    ~BatchQuantizeCommand() override;
+
+    void addCommand(EventQuantizeCommand *command);
+
+    void execute() override;
+
+private:
+    std::vector<EventQuantizeCommand *> m_quantizeCommands;
+    bool m_executed;
+};
+
+
+}
+
+#endif
@@ -51,7 +51,9 @@ EventQuantizeCommand::EventQuantizeCommand(Segment &segment,
     BasicCommand(getGlobalName(quantizer), segment, startTime, endTime,
                  true),  // bruteForceRedo
     m_quantizer(quantizer),
-    m_selection(nullptr)
+    m_selection(nullptr),
+    m_batched(false),
+    m_batchEndTime(0)
 {
     // nothing else
 }
@@ -64,7 +66,9 @@ EventQuantizeCommand::EventQuantizeCommand(EventSelection &selection,
                  selection.getEndTime(),
                  true),  // bruteForceRedo
     m_quantizer(quantizer),
-    m_selection(&selection)
+    m_selection(&selection),
+    m_batched(false),
+    m_batchEndTime(0)
 {
     // nothing else
 }
@@ -78,7 +82,9 @@ EventQuantizeCommand::EventQuantizeCommand(Segment &segment,
                  segment, startTime, endTime,
                  true),  // bruteForceRedo
     m_selection(nullptr),
-    m_settingsGroup(settingsGroup)
+    m_settingsGroup(settingsGroup),
+    m_batched(false),
+    m_batchEndTime(0)
 {
     // nothing else -- m_quantizer set by makeQuantizer
 }
@@ -92,7 +98,9 @@ EventQuantizeCommand::EventQuantizeCommand(EventSelection &selection,
                  selection.getEndTime(),
                  true),  // bruteForceRedo
     m_selection(&selection),
-    m_settingsGroup(settingsGroup)
+    m_settingsGroup(settingsGroup),
+    m_batched(false),
+    m_batchEndTime(0)
 {
     // nothing else -- m_quantizer set by makeQuantizer
 }
@@ -124,6 +132,38 @@ EventQuantizeCommand::modifySegment()
     // Kick the event loop.
     qApp->processEvents();
 
+    Segment &segment = getSegment();
+
+    timeT endTime = segment.getEndTime();
+
+    // BatchQuantizeCommand quantizes all its segments at once, and
+    // then calls finishBatch()
+    if (m_batched) {
+        m_batchEndTime = endTime;
+        return;
+    }
+
+    if (m_selection) {
+        m_quantizer->quantize(m_selection);
+
+    } else {
+        m_quantizer->quantize(&segment,
+                              segment.findTime(getStartTime()),
+                              segment.findTime(getEndTime()));
+    }
+
+    tidySegment(endTime);
+}
+
+void
+EventQuantizeCommand::finishBatch()
+{
+    tidySegment(m_batchEndTime);
+}
+
+void
+EventQuantizeCommand::tidySegment(timeT endTime)
+{
     Segment &segment = getSegment();
     SegmentNotationHelper helper(segment);
 
@@ -142,17 +182,6 @@ EventQuantizeCommand::modifySegment()
         settings.endGroup();
     }
 
-    timeT endTime = segment.getEndTime();
-
-    if (m_selection) {
-        m_quantizer->quantize(m_selection);
-
-    } else {
-        m_quantizer->quantize(&segment,
-                              segment.findTime(getStartTime()),
-                              segment.findTime(getEndTime()));
-    }
-
     // Kick the event loop.
     qApp->processEvents();
 
@@ -78,6 +78,16 @@ public:
     void setProgressTotal(int total, int perCall) { m_progressTotal = total;
                                                     m_progressPerCall = perCall; };
 
+    Quantizer *getQuantizer() { return m_quantizer; }
+
+    /**
+     * For BatchQuantizeCommand: on first execution, save the events
+     * but leave them for the batch to quantize.  finishBatch() then
+     * does the rest, short of notifying.
+     */
+    void setBatched(bool batched) { m_batched = batched; }
+    void finishBatch();
+
 protected:
     void modifySegment() override;
 
@@ -90,6 +100,12 @@ private:
     int m_progressTotal;
     int m_progressPerCall;
 
+    bool m_batched;
+    timeT m_batchEndTime;
+
+    /// Make notes viable, rebeam etc. as the settings ask, after quantizing
+    void tidySegment(timeT endTime);
+
     /// Sets to m_quantizer as well as returning value
     Quantizer *makeQuantizer(QString, QuantizeScope);
 };
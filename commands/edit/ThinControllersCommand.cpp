@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[ThinControllersCommand]"
+
+#include "ThinControllersCommand.h"
+
+#include "base/Segment.h"
+#include "base/Selection.h"
+#include "misc/ConfigGroups.h"
+#include "misc/Debug.h"
+
+#include <QSettings>
+#include <QString>
+
+
+namespace Rosegarden
+{
+
+ThinControllersCommand::ThinControllersCommand(EventSelection &selection,
+                                               const ControllerThinner &thinner) :
+    BasicCommand(getGlobalName(),
+                 selection.getSegment(),
+                 selection.getStartTime(),
+                 selection.getEndTime(),
+                 true),
+    m_selection(&selection),
+    m_haveControl(false),
+    m_thinner(thinner)
+{
+}
+
+ThinControllersCommand::ThinControllersCommand(Segment &segment,
+                                               timeT start, timeT end,
+                                               const ControllerThinner &thinner) :
+    BasicCommand(getGlobalName(), segment, start, end, true),
+    m_selection(nullptr),
+    m_haveControl(false),
+    m_thinner(thinner)
+{
+}
+
+ThinControllersCommand::ThinControllersCommand(Segment &segment,
+                                               timeT start, timeT end,
+                                               const ControlParameter &control,
+                                               const ControllerThinner &thinner) :
+    BasicCommand(getGlobalName(), segment, start, end, true),
+    m_selection(nullptr),
+    m_haveControl(true),
+    m_control(control),
+    m_thinner(thinner)
+{
+}
+
+ControllerThinner
+ThinControllersCommand::getConfiguredThinner()
+{
+    QSettings settings;
+    settings.beginGroup(GeneralOptionsConfigGroup);
+    int tolerance = settings.value("controller_thin_tolerance", 0).toInt();
+    timeT interval = settings.value("controller_thin_interval", 0).toInt();
+    settings.endGroup();
+
+    return ControllerThinner(tolerance, interval);
+}
+
+void
+ThinControllersCommand::setConfiguredTolerance(int tolerance)
+{
+    QSettings settings;
+    settings.beginGroup(GeneralOptionsConfigGroup);
+    settings.setValue("controller_thin_tolerance", tolerance);
+    settings.endGroup();
+}
+
+bool
+ThinControllersCommand::isRecordingThinned()
+{
+    QSettings settings;
+    settings.beginGroup(GeneralOptionsConfigGroup);
+    bool thin = settings.value("thin_recorded_controllers", false).toBool();
+    settings.endGroup();
+
+    return thin;
+}
+
+void
+ThinControllersCommand::modifySegment()
+{
+    Segment &segment = getSegment();
+
+    std::vector<Event *> events;
+
+    if (m_selection) {
+        EventSelection::eventcontainer::iterator i;
+        for (i = m_selection->getSegmentEvents().begin();
+             i != m_selection->getSegmentEvents().end(); ++i) {
+            if (ControllerThinner::isThinnable(*i)) events.push_back(*i);
+        }
+    } else {
+        Segment::iterator end = segment.findTime(getEndTime());
+        for (Segment::iterator i = segment.findTime(getStartTime());
+             i != end; ++i) {
+            if (m_haveControl && !m_control.matches(*i)) continue;
+            if (ControllerThinner::isThinnable(*i)) events.push_back(*i);
+        }
+    }
+
+    std::vector<Event *> toErase = m_thinner.getRedundantEvents(events);
+
+    for (size_t i = 0; i < toErase.size(); ++i) {
+        segment.eraseSingle(toErase[i]);
+    }
+
+    const ControllerThinner::Report &report = m_thinner.getReport();
+
+    RG_DEBUG << "modifySegment(): removed" << report.removed << "of"
+             << report.examined << "events, max deviation"
+             << report.maxDeviation << "controller,"
+             << report.maxPitchBendDeviation << "pitch bend";
+}
+
+}
@@ -0,0 +1,89 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_THINCONTROLLERSCOMMAND_H
+#define RG_THINCONTROLLERSCOMMAND_H
+
+#include "document/BasicCommand.h"
+#include "base/ControllerThinner.h"
+#include "base/ControlParameter.h"
+#include <QString>
+#include <QCoreApplication>
+
+
+namespace Rosegarden
+{
+
+class EventSelection;
+class Segment;
+
+
+/// Erase the redundant events from dense controller and pitch bend data
+
+class ThinControllersCommand : public BasicCommand
+{
+    Q_DECLARE_TR_FUNCTIONS(Rosegarden::ThinControllersCommand)
+
+public:
+    /// Thin the controller events in a selection
+    ThinControllersCommand(EventSelection &selection,
+                           const ControllerThinner &thinner);
+
+    /**
+     * Thin every controller event in the segment from start to end.
+     * The events need not exist yet when the command is created, so
+     * this can follow the commands that insert them in a MacroCommand.
+     */
+    ThinControllersCommand(Segment &segment, timeT start, timeT end,
+                           const ControllerThinner &thinner);
+
+    /// As above, but only the events of the given controller
+    ThinControllersCommand(Segment &segment, timeT start, timeT end,
+                           const ControlParameter &control,
+                           const ControllerThinner &thinner);
+
+    static QString getGlobalName() { return tr("&Thin Controller Events"); }
+
+    /**
+     * The thinner set up in the general options: the last tolerance
+     * used from the Controllers menu, and the minimum interval.
+     */
+    static ControllerThinner getConfiguredThinner();
+    static void setConfiguredTolerance(int tolerance);
+
+    /// Whether recorded MIDI should be thinned when recording stops
+    static bool isRecordingThinned();
+
+    /// What was removed on the first execute
+    const ControllerThinner::Report &getReport() const
+        { return m_thinner.getReport(); }
+
+protected:
+    void modifySegment() override;
+
+private:
+    EventSelection *m_selection;// only used on 1st execute (cf bruteForceRedo)
+    bool m_haveControl;
+    ControlParameter m_control;
+    ControllerThinner m_thinner;
+};
+
+
+
+}
+
+#endif
@@ -59,6 +59,8 @@ BasicCommand::BasicCommand(const QString &name,
     m_redoEvents(redoEvents)
 {
     if (m_endTime == m_startTime) { ++m_endTime; }
+
+    segment.loadDeferredEvents();
 }
 
 
@@ -72,6 +74,10 @@ BasicCommand::~BasicCommand()
 timeT
 BasicCommand::calculateStartTime(timeT given, Segment &segment)
 {
+    // This is the first look at the events, so make sure there are
+    // some if the segment was read lazily
+    segment.loadDeferredEvents();
+
     timeT actual = given;
     Segment::iterator i = segment.findTime(given);
 
@@ -120,10 +126,15 @@ BasicCommand::execute()
 {
     beginExecute();
 
-    if (!m_doBruteForceRedo) {
-        modifySegment();
-    } else {
-        copyFrom(m_redoEvents);
+    {
+        // Observers hear about the whole edit at once when this ends
+        Segment::EventTransaction transaction(m_segment);
+
+        if (!m_doBruteForceRedo) {
+            modifySegment();
+        } else {
+            copyFrom(m_redoEvents);
+        }
     }
 
     m_segment.updateRefreshStatuses(getStartTime(), getRelayoutEndTime());
@@ -143,10 +154,13 @@ BasicCommand::unexecute()
         m_doBruteForceRedo = true;
     }
 
-    // This can take a very long time.  This is because we are adding
-    // events to a Segment that has someone to notify of changes.
-    // Every single call to Segment::insert() fires off notifications.
-    copyFrom(&m_savedEvents);
+    // Restoring a large range means many inserts and erases.  Within
+    // a transaction the Segment's observers are notified once at the
+    // end rather than for every single event.
+    {
+        Segment::EventTransaction transaction(m_segment);
+        copyFrom(&m_savedEvents);
+    }
 
     m_segment.updateRefreshStatuses(getStartTime(), getRelayoutEndTime());
     m_segment.signalChanged(getStartTime(), getRelayoutEndTime());
@@ -38,6 +38,10 @@ class CommandArgumentQuerier; // forward declaration useful for some subclasses
  * single Rosegarden Segment, by brute force.  When a subclass
  * of BasicCommand executes, it stores a copy of the events that are
  * modified by the command, ready to be restored verbatim on undo.
+ *
+ * modifySegment() and undo both run inside a Segment event
+ * transaction, so the Segment's observers get one eventsChanged()
+ * call for the whole edit instead of one call per event.
  */
 
 class BasicCommand : public NamedCommand
@@ -0,0 +1,236 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[LazySegmentLoader]"
+
+#include "LazySegmentLoader.h"
+
+#include "RoseXmlHandler.h"
+#include "RosegardenDocument.h"
+#include "base/Composition.h"
+#include "misc/ConfigGroups.h"
+#include "misc/Debug.h"
+
+#include <QSettings>
+#include <QXmlInputSource>
+#include <QXmlSimpleReader>
+
+#include <set>
+
+namespace Rosegarden
+{
+
+LazySegmentLoader *
+LazySegmentLoader::getInstance()
+{
+    static LazySegmentLoader instance;
+    return &instance;
+}
+
+bool
+LazySegmentLoader::isEnabled()
+{
+    QSettings settings;
+    settings.beginGroup(GeneralOptionsConfigGroup);
+    bool enabled = settings.value("lazy_archived_segments", false).toBool();
+    settings.endGroup();
+    return enabled;
+}
+
+// Return the value of the named attribute in an element's opening
+// tag, or an empty string.  Attribute values never contain a quote,
+// as XmlExportable::encode() escapes them.
+static QString
+getAttribute(const QString &tag, const QString &name)
+{
+    QString key = QString(" %1=\"").arg(name);
+    int start = tag.indexOf(key);
+    if (start < 0) return QString();
+    start += key.length();
+    int end = tag.indexOf('"', start);
+    if (end < 0) return QString();
+    return tag.mid(start, end - start);
+}
+
+void
+LazySegmentLoader::deferArchivedSegments(QString &fileContents,
+                                         std::vector<QByteArray> &events)
+{
+    std::set<int> archivedTracks;
+
+    int pos = 0;
+    while ((pos = fileContents.indexOf("<track ", pos)) >= 0) {
+        int tagEnd = fileContents.indexOf('>', pos);
+        if (tagEnd < 0) break;
+        QString tag = fileContents.mid(pos, tagEnd - pos);
+        if (getAttribute(tag, "archived") == "true") {
+            archivedTracks.insert(getAttribute(tag, "id").toInt());
+        }
+        pos = tagEnd;
+    }
+
+    if (archivedTracks.empty()) return;
+
+    QString result;
+    int copied = 0;
+
+    pos = 0;
+    while ((pos = fileContents.indexOf("<segment ", pos)) >= 0) {
+
+        int tagEnd = fileContents.indexOf('>', pos);
+        if (tagEnd < 0) break;
+        int segmentEnd = fileContents.indexOf("</segment>", tagEnd);
+        if (segmentEnd < 0) break;
+
+        QString tag = fileContents.mid(pos, tagEnd - pos);
+        pos = tagEnd;
+
+        if (tag.endsWith('/') ||
+            !archivedTracks.count(getAttribute(tag, "track").toInt()) ||
+            getAttribute(tag, "eventsend").isEmpty() ||
+            !getAttribute(tag, "type").isEmpty() ||
+            !getAttribute(tag, "triggerid").isEmpty() ||
+            !getAttribute(tag, "linkerid").isEmpty()) continue;
+
+        // The event rulers follow the events, and stay with the shell
+        int eventsEnd = fileContents.indexOf("<gui>", tagEnd);
+        if (eventsEnd < 0 || eventsEnd > segmentEnd) eventsEnd = segmentEnd;
+
+        if (result.isEmpty()) result.reserve(fileContents.length());
+
+        result += fileContents.mid(copied, tagEnd - copied);
+        result += QString(" deferred=\"%1\">").arg(events.size());
+
+        events.push_back(qCompress
+            (fileContents.mid(tagEnd + 1, eventsEnd - tagEnd - 1).toUtf8()));
+
+        copied = eventsEnd;
+        pos = segmentEnd;
+    }
+
+    if (events.empty()) return;
+
+    result += fileContents.mid(copied);
+    fileContents = result;
+
+    RG_DEBUG << "deferArchivedSegments(): deferred" << events.size()
+             << "segments on" << archivedTracks.size() << "archived tracks";
+}
+
+bool
+LazySegmentLoader::loadEvents(Segment *segment)
+{
+    QString xml = "<segment>" +
+        QString::fromUtf8(qUncompress(segment->getDeferredEvents())) +
+        "</segment>";
+
+    // The handler touches nothing but the segment in this mode, so
+    // needs no document
+    RoseXmlHandler handler(nullptr, 0, nullptr, false);
+    handler.setDeferredSegment(segment);
+
+    QXmlInputSource source;
+    source.setData(xml);
+    QXmlSimpleReader reader;
+    reader.setContentHandler(&handler);
+    reader.setErrorHandler(&handler);
+
+    if (!reader.parse(source)) {
+        RG_WARNING << "loadEvents():" << handler.errorString();
+        return false;
+    }
+
+    // The events may trigger other segments.  Within loadSegments()
+    // the references are updated once the whole batch is in.
+    Composition *composition = segment->getComposition();
+    if (composition && !m_inBatch) {
+        composition->updateTriggerSegmentReferences();
+    }
+
+    return true;
+}
+
+void
+LazySegmentLoader::loadSegments(const std::vector<Segment *> &segments)
+{
+    LazySegmentLoader *loader = getInstance();
+    const bool outerBatch = !loader->m_inBatch;
+    loader->m_inBatch = true;
+
+    std::set<Composition *> compositions;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (!segments[i]->hasDeferredEvents()) continue;
+        if (!segments[i]->loadDeferredEvents()) continue;
+        Composition *composition = segments[i]->getComposition();
+        if (composition) compositions.insert(composition);
+    }
+
+    if (!outerBatch) return;
+
+    loader->m_inBatch = false;
+
+    for (std::set<Composition *>::iterator i = compositions.begin();
+         i != compositions.end(); ++i) {
+        (*i)->updateTriggerSegmentReferences();
+    }
+}
+
+// Loading can move a segment within the composition, so gather the
+// segments first
+static std::vector<Segment *>
+getSegments(Composition &composition, TrackId track)
+{
+    std::vector<Segment *> segments;
+    for (Composition::iterator i = composition.begin();
+         i != composition.end(); ++i) {
+        if (track == NO_TRACK || (*i)->getTrack() == track) {
+            segments.push_back(*i);
+        }
+    }
+    return segments;
+}
+
+void
+LazySegmentLoader::loadTrack(Composition &composition, TrackId track)
+{
+    loadSegments(getSegments(composition, track));
+}
+
+void
+LazySegmentLoader::loadAll(Composition &composition)
+{
+    loadSegments(getSegments(composition, NO_TRACK));
+}
+
+int
+LazySegmentLoader::unloadTrack(RosegardenDocument *doc, TrackId track)
+{
+    std::vector<Segment *> segments =
+        getSegments(doc->getComposition(), track);
+
+    int count = 0;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (doc->isBeingEdited(segments[i])) continue;
+        if (segments[i]->unloadDeferredEvents()) ++count;
+    }
+
+    return count;
+}
+
+}
@@ -0,0 +1,96 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_LAZYSEGMENTLOADER_H
+#define RG_LAZYSEGMENTLOADER_H
+
+#include "base/Segment.h"
+#include "base/Track.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <vector>
+
+namespace Rosegarden
+{
+
+class Composition;
+class RosegardenDocument;
+
+/**
+ * Reads the events of segments on archived tracks only when they are
+ * first needed.  Archived tracks are not played, so until one of
+ * their segments is selected, opened in an editor, changed, copied,
+ * exported or moved to another track, it can stay an empty shell
+ * holding its events as compressed XML.
+ *
+ * Before the file is parsed, deferArchivedSegments() cuts the events
+ * out of each such segment element.  The segments are then created as
+ * shells by RoseXmlHandler, and read in by loadEvents() through
+ * Segment::loadDeferredEvents().  A shell is saved by writing its XML
+ * back out as it was read.
+ *
+ * Only plain segments saved with an "eventsend" attribute are
+ * deferred, as the shell needs its end time.  Linked and triggered
+ * segments are always read in full.
+ */
+class LazySegmentLoader : public DeferredEventLoader
+{
+public:
+    static LazySegmentLoader *getInstance();
+
+    /// Whether the user has chosen to read archived segments lazily
+    static bool isEnabled();
+
+    /**
+     * Take the events of each segment on an archived track out of
+     * fileContents, appending them to events and marking the segment
+     * element with a "deferred" attribute giving their index.
+     */
+    static void deferArchivedSegments(QString &fileContents,
+                                      std::vector<QByteArray> &events);
+
+    bool loadEvents(Segment *segment) override;
+
+    /// Read in any deferred events of the given segments
+    static void loadSegments(const std::vector<Segment *> &segments);
+
+    /// Read in any deferred events of the segments on a track
+    static void loadTrack(Composition &composition, TrackId track);
+
+    /// Read in every deferred event in the composition
+    static void loadAll(Composition &composition);
+
+    /**
+     * Let go of the events of the segments on a track that were
+     * deferred and have not been changed since, unless an editor has
+     * them open.  Returns the number of segments that became shells.
+     */
+    static int unloadTrack(RosegardenDocument *doc, TrackId track);
+
+private:
+    LazySegmentLoader() : m_inBatch(false) { }
+
+    /// Set while loadSegments() is reading, to defer the update of
+    /// trigger segment references until the end of the batch
+    bool m_inBatch;
+};
+
+}
+
+#endif
@@ -0,0 +1,290 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[ParallelSegmentParser]"
+
+#include "ParallelSegmentParser.h"
+
+#include "RoseXmlHandler.h"
+#include "base/BaseProperties.h"
+#include "base/Composition.h"
+#include "base/Event.h"
+#include "base/Segment.h"
+#include "misc/ConfigGroups.h"
+#include "misc/Debug.h"
+
+#include <QRunnable>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QXmlInputSource>
+#include <QXmlSimpleReader>
+
+#include <algorithm>
+#include <map>
+
+namespace Rosegarden
+{
+
+// Below this many characters of events in all, starting the threads
+// costs more than it saves.
+static const int minParallelLength = 256 * 1024;
+
+static int threadCount = 0;
+
+ParallelSegmentParser::ParallelSegmentParser()
+{
+}
+
+ParallelSegmentParser::~ParallelSegmentParser()
+{
+    for (size_t i = 0; i < m_bodies.size(); ++i) {
+        delete m_bodies[i].parsed;
+    }
+}
+
+bool
+ParallelSegmentParser::isEnabled()
+{
+    QSettings settings;
+    settings.beginGroup(GeneralOptionsConfigGroup);
+    bool enabled = settings.value("parallel_segment_parsing", true).toBool();
+    settings.endGroup();
+    return enabled;
+}
+
+void
+ParallelSegmentParser::setThreadCount(int threads)
+{
+    threadCount = threads;
+}
+
+int
+ParallelSegmentParser::getThreadCount()
+{
+    if (threadCount > 0) return threadCount;
+    return std::max(QThread::idealThreadCount(), 1);
+}
+
+void
+ParallelSegmentParser::cutSegments(QString &fileContents)
+{
+    if (getThreadCount() < 2) return;
+
+    // Where the events of each segment start and end
+    std::vector<std::pair<int, int> > ranges;
+    int totalLength = 0;
+
+    int pos = 0;
+    while ((pos = fileContents.indexOf("<segment ", pos)) >= 0) {
+
+        int tagEnd = fileContents.indexOf('>', pos);
+        if (tagEnd < 0) break;
+        int segmentEnd = fileContents.indexOf("</segment>", tagEnd);
+        if (segmentEnd < 0) break;
+
+        QString tag = fileContents.mid(pos, tagEnd - pos);
+        pos = tagEnd;
+
+        if (tag.endsWith('/') ||
+            tag.contains(" type=\"") ||
+            tag.contains(" triggerid=\"") ||
+            tag.contains(" linkerid=\"") ||
+            tag.contains(" deferred=\"")) continue;
+
+        // The event rulers follow the events, and stay with the shell
+        int eventsEnd = fileContents.indexOf("<gui>", tagEnd);
+        if (eventsEnd < 0 || eventsEnd > segmentEnd) eventsEnd = segmentEnd;
+
+        ranges.push_back(std::pair<int, int>(tagEnd + 1, eventsEnd));
+        totalLength += eventsEnd - tagEnd - 1;
+
+        pos = segmentEnd;
+    }
+
+    if (ranges.size() < 2 || totalLength < minParallelLength) return;
+
+    QString result;
+    result.reserve(fileContents.length() - totalLength);
+
+    m_bodies.resize(ranges.size());
+
+    int copied = 0;
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+
+        int eventsStart = ranges[i].first;
+        int eventsEnd = ranges[i].second;
+
+        // Up to the closing '>' of the opening tag
+        result += fileContents.mid(copied, eventsStart - 1 - copied);
+        result += QString(" parsed=\"%1\">").arg(i);
+
+        m_bodies[i].xml = "<segment>" +
+            fileContents.mid(eventsStart, eventsEnd - eventsStart) +
+            "</segment>";
+
+        copied = eventsEnd;
+    }
+
+    result += fileContents.mid(copied);
+    fileContents = result;
+
+    RG_DEBUG << "cutSegments(): cut the events of" << m_bodies.size()
+             << "segments," << totalLength << "characters";
+}
+
+void
+ParallelSegmentParser::setShell(unsigned int index, Segment *segment,
+                                const timeT *endMarker)
+{
+    if (index >= m_bodies.size()) return;
+
+    Body &body = m_bodies[index];
+    body.shell = segment;
+    body.hasEndMarker = (endMarker != nullptr);
+    if (endMarker) body.endMarker = *endMarker;
+}
+
+class ParallelSegmentParser::ParseTask : public QRunnable
+{
+public:
+    ParseTask(Body &body) : m_body(body) { }
+
+    void run() override { parseBody(m_body); }
+
+private:
+    Body &m_body;
+};
+
+void
+ParallelSegmentParser::parseBody(Body &body)
+{
+    // As for LazySegmentLoader, the handler touches nothing but the
+    // segment in this mode, so needs no document
+    RoseXmlHandler handler(nullptr, 0, nullptr, false);
+    handler.setDeferredSegment(body.parsed);
+
+    QXmlInputSource source;
+    source.setData(body.xml);
+    QXmlSimpleReader reader;
+    reader.setContentHandler(&handler);
+    reader.setErrorHandler(&handler);
+
+    body.ok = reader.parse(source);
+    if (!body.ok) body.error = handler.errorString();
+
+    body.xml.clear();
+}
+
+bool
+ParallelSegmentParser::isLonger(const Body *b1, const Body *b2)
+{
+    return b1->xml.length() > b2->xml.length();
+}
+
+bool
+ParallelSegmentParser::parse(QString &errMsg)
+{
+    if (m_bodies.empty()) return true;
+
+    std::vector<Body *> bodies;
+
+    for (size_t i = 0; i < m_bodies.size(); ++i) {
+        Body &body = m_bodies[i];
+        if (!body.shell) {
+            errMsg = "Found segment events with no segment";
+            return false;
+        }
+        // Made here, as Segment's constructor is not thread safe
+        body.parsed = new Segment(Segment::Internal,
+                                  body.shell->getStartTime());
+        bodies.push_back(&body);
+    }
+
+    // Longest first, so that no thread is left with a long one at the
+    // end while the others wait
+    std::sort(bodies.begin(), bodies.end(), isLonger);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(getThreadCount());
+
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        pool.start(new ParseTask(*bodies[i]));
+    }
+
+    pool.waitForDone();
+
+    // Move the events into the shells in file order, on this thread,
+    // as the shells are in the composition
+    for (size_t i = 0; i < m_bodies.size(); ++i) {
+
+        Body &body = m_bodies[i];
+
+        if (!body.ok) {
+            errMsg = body.error;
+            return false;
+        }
+
+        Segment *shell = body.shell;
+
+        // Moved rather than copied, as a copy would lose the
+        // non-persistent properties
+        std::vector<Event *> events;
+        body.parsed->releaseEvents(events);
+        delete body.parsed;
+        body.parsed = nullptr;
+
+        // Beamed groups take their ids from the shell, as they would
+        // have from RoseXmlHandler
+        std::map<long, long> groupIdMap;
+
+        for (size_t j = 0; j < events.size(); ++j) {
+
+            Event *e = events[j];
+
+            if (e->has(BaseProperties::BEAMED_GROUP_ID)) {
+                long parsedId = e->get<Int>(BaseProperties::BEAMED_GROUP_ID);
+                if (groupIdMap.find(parsedId) == groupIdMap.end()) {
+                    groupIdMap[parsedId] = shell->getNextId();
+                }
+                if (groupIdMap[parsedId] != parsedId) {
+                    e->set<Int>(BaseProperties::BEAMED_GROUP_ID,
+                                groupIdMap[parsedId]);
+                }
+            }
+
+            shell->insert(e);
+        }
+
+        // Held back until now, as an end marker past the end of an
+        // empty segment fills it with rests
+        if (body.hasEndMarker) {
+            RoseXmlHandler::setSegmentEndMarker(shell, body.endMarker);
+        }
+    }
+
+    // The events may trigger other segments
+    Composition *composition = m_bodies[0].shell->getComposition();
+    if (composition) composition->updateTriggerSegmentReferences();
+
+    m_bodies.clear();
+
+    return true;
+}
+
+}
@@ -0,0 +1,111 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_PARALLELSEGMENTPARSER_H
+#define RG_PARALLELSEGMENTPARSER_H
+
+#include "base/TimeT.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace Rosegarden
+{
+
+class Segment;
+
+/**
+ * Reads the events of the segments in a document on several threads.
+ *
+ * Most of a large file is segment events, and the events of one
+ * segment do not depend on those of any other.  Before the file is
+ * parsed, cutSegments() takes the events out of each plain segment
+ * element, leaving a shell with a "parsed" attribute giving the index
+ * of its events.  RoseXmlHandler reads everything else as usual,
+ * creating the shells and passing them to setShell().  Then parse()
+ * reads the events of all the segments at once, each into a segment
+ * of its own outside the composition, and moves them into the shells
+ * in file order on the calling thread.
+ *
+ * As with LazySegmentLoader, linked and triggered segments are always
+ * read in full, as are segments already deferred by it.
+ */
+class ParallelSegmentParser
+{
+public:
+    ParallelSegmentParser();
+    ~ParallelSegmentParser();
+
+    /// Whether the user allows segments to be read in parallel
+    static bool isEnabled();
+
+    /**
+     * Use at most the given number of threads, for benchmarking.  0,
+     * the default, means one for each core.
+     */
+    static void setThreadCount(int threads);
+
+    /**
+     * Take the events of each plain segment element out of
+     * fileContents, marking the element with a "parsed" attribute.
+     * Does nothing if the file is too small to be worth it.
+     */
+    void cutSegments(QString &fileContents);
+
+    /**
+     * The segment created for the element with the given "parsed"
+     * index, and its end marker if any, to be set once it has its
+     * events.
+     */
+    void setShell(unsigned int index, Segment *segment,
+                  const timeT *endMarker);
+
+    /**
+     * Read the events cut out earlier into their segments.  Returns
+     * false, with an error message, if any could not be read.
+     */
+    bool parse(QString &errMsg);
+
+private:
+    class ParseTask;
+
+    struct Body
+    {
+        Body() :
+            shell(nullptr), hasEndMarker(false), endMarker(0),
+            parsed(nullptr), ok(false) { }
+
+        QString xml;
+        Segment *shell;
+        bool hasEndMarker;
+        timeT endMarker;
+        Segment *parsed;
+        bool ok;
+        QString error;
+    };
+
+    static int getThreadCount();
+    static void parseBody(Body &body);
+    static bool isLonger(const Body *b1, const Body *b2);
+
+    std::vector<Body> m_bodies;
+};
+
+}
+
+#endif
@@ -52,7 +52,9 @@
 #include "gui/widgets/StartupLogo.h"
 #include "gui/studio/AudioPlugin.h"
 #include "gui/studio/AudioPluginManager.h"
+#include "ParallelSegmentParser.h"
 #include "RosegardenDocument.h"
+#include "SnapshotFile.h"
 #include "sound/AudioFileManager.h"
 #include "XmlStorableEvent.h"
 #include "XmlSubHandler.h"
@@ -246,7 +248,11 @@ RoseXmlHandler::RoseXmlHandler(RosegardenDocument *doc,
     m_skipAllAudio(false),
     m_hasActiveAudio(false),
     m_oldSolo(false),
-    m_progressDialog(progressDialog)
+    m_progressDialog(progressDialog),
+    m_deferredEvents(nullptr),
+    m_deferredSegment(nullptr),
+    m_snapshot(nullptr),
+    m_parallelParser(nullptr)
 {}
 
 RoseXmlHandler::~RoseXmlHandler()
@@ -281,6 +287,9 @@ RoseXmlHandler::getAudioPluginManager()
 bool
 RoseXmlHandler::startDocument()
 {
+    // Only events are read into an existing segment
+    if (m_deferredSegment) return true;
+
     if (m_progressDialog) {
         m_progressDialog->setLabelText(tr("Reading file..."));
         m_progressDialog->setRange(0, 100);
@@ -885,6 +894,14 @@ RoseXmlHandler::startElement(const QString& namespaceURI,
 
     } else if (lcName == "segment") {
 
+        if (m_deferredSegment) {
+            m_section = InSegment;
+            m_currentSegment = m_deferredSegment;
+            m_currentTime = m_deferredSegment->getStartTime();
+            m_groupIdMap.clear();
+            return true;
+        }
+
         if (m_section != NoSection) {
             m_errorString = "Found Segment in another section";
             return false;
@@ -1059,6 +1076,33 @@ RoseXmlHandler::startElement(const QString& namespaceURI,
             m_segmentEndMarkerTime = new timeT(endMarkerStr.toInt());
         }
 
+        QString deferredStr = atts.value("deferred");
+        if (!deferredStr.isEmpty() && m_deferredEvents) {
+            size_t index = deferredStr.toUInt();
+            if (index < m_deferredEvents->size()) {
+                m_currentSegment->setDeferredEvents
+                    ((*m_deferredEvents)[index], atts.value("eventsend").toInt());
+            }
+        }
+
+        QString parsedStr = atts.value("parsed");
+        if (!parsedStr.isEmpty() && m_parallelParser) {
+            // The events come later, and the end marker with them
+            m_parallelParser->setShell(parsedStr.toUInt(), m_currentSegment,
+                                       m_segmentEndMarkerTime);
+            delete m_segmentEndMarkerTime;
+            m_segmentEndMarkerTime = nullptr;
+        }
+
+        QString packedStr = atts.value("packed");
+        if (!packedStr.isEmpty()) {
+            if (!m_snapshot ||
+                !m_snapshot->readSegment(packedStr.toInt(), m_currentSegment)) {
+                m_errorString = "Could not read packed segment events";
+                return false;
+            }
+        }
+
         m_groupIdMap.clear();
 
     } else if (lcName == "gui") {
@@ -2360,17 +2404,7 @@ RoseXmlHandler::endElement(const QString& namespaceURI,
     } else if (lcName == "segment") {
 
         if (m_currentSegment && m_segmentEndMarkerTime) {
-            m_currentSegment->setEndMarkerTime(*m_segmentEndMarkerTime);
-
-            // If the segment is zero or negative duration
-            if (m_currentSegment->getEndMarkerTime() <= 
-                    m_currentSegment->getStartTime()) {
-                // Make it stick out so the user can take care of it.
-                m_currentSegment->setEndMarkerTime(
-                    m_currentSegment->getStartTime() + 
-                        Note(Note::Shortest).getDuration());
-            }
-
+            setSegmentEndMarker(m_currentSegment, *m_segmentEndMarkerTime);
             delete m_segmentEndMarkerTime;
             m_segmentEndMarkerTime = nullptr;
         }
@@ -2482,9 +2516,24 @@ RoseXmlHandler::fatalError(const QXmlParseException& exception)
     return QXmlDefaultHandler::fatalError( exception );
 }
 
+void
+RoseXmlHandler::setSegmentEndMarker(Segment *segment, timeT endMarker)
+{
+    segment->setEndMarkerTime(endMarker);
+
+    // If the segment is zero or negative duration
+    if (segment->getEndMarkerTime() <= segment->getStartTime()) {
+        // Make it stick out so the user can take care of it.
+        segment->setEndMarkerTime(segment->getStartTime() +
+                                  Note(Note::Shortest).getDuration());
+    }
+}
+
 bool
 RoseXmlHandler::endDocument()
 {
+    if (m_deferredSegment) return true;
+
     if (m_foundTempo == false) {
         getComposition().setCompositionDefaultTempo
         (Composition::getTempoForQpm(120.0));
@@ -22,6 +22,7 @@
 #include "base/MidiProgram.h"
 #include "base/Event.h"
 
+#include <QByteArray>
 #include <QString>
 #include <QXmlDefaultHandler>
 #include <QtCore/QSharedPointer>
@@ -32,6 +33,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 
 class QXmlParseException;
@@ -46,6 +48,8 @@ class XmlSubHandler;
 class Studio;
 class Segment;
 class SegmentLinker;
+class SnapshotReader;
+class ParallelSegmentParser;
 class RosegardenDocument;
 class Instrument;
 class Device;
@@ -112,6 +116,38 @@ public:
     bool hasActiveAudio() const { return m_hasActiveAudio; }
     std::set<QString> &pluginsNotFound() { return m_pluginsNotFound; }
 
+    /**
+     * The segment events taken out of the file by
+     * LazySegmentLoader::deferArchivedSegments(), indexed by the
+     * "deferred" attribute of the segments they belong to.
+     */
+    void setDeferredEvents(const std::vector<QByteArray> *events)
+        { m_deferredEvents = events; }
+
+    /**
+     * Read nothing but events, into the given segment, from a document
+     * of the form <segment>...</segment>.  Used by LazySegmentLoader.
+     */
+    void setDeferredSegment(Segment *segment)
+        { m_deferredSegment = segment; }
+
+    /**
+     * The snapshot being read, from which segments with a "packed"
+     * attribute take their events.
+     */
+    void setSnapshot(const SnapshotReader *snapshot)
+        { m_snapshot = snapshot; }
+
+    /**
+     * The parser holding the events cut out of segments with a
+     * "parsed" attribute, to which their segments are handed.
+     */
+    void setParallelParser(ParallelSegmentParser *parser)
+        { m_parallelParser = parser; }
+
+    /// Set the end marker of a segment read from a file
+    static void setSegmentEndMarker(Segment *segment, timeT endMarker);
+
     bool error(const QXmlParseException& exception) override;
     bool fatalError(const QXmlParseException& exception) override;
 
@@ -196,6 +232,11 @@ protected:
     bool m_oldSolo;
 
     QPointer<QProgressDialog> m_progressDialog;
+
+    const std::vector<QByteArray> *m_deferredEvents;
+    Segment *m_deferredSegment;
+    const SnapshotReader *m_snapshot;
+    ParallelSegmentParser *m_parallelParser;
 };
 
 
@@ -22,8 +22,11 @@
 #include "RosegardenDocument.h"
 
 #include "CommandHistory.h"
+#include "LazySegmentLoader.h"
+#include "ParallelSegmentParser.h"
 #include "RoseXmlHandler.h"
 #include "GzipFile.h"
+#include "SnapshotFile.h"
 
 #include "base/AudioDevice.h"
 #include "base/AudioPluginInstance.h"
@@ -47,6 +50,7 @@
 #include "base/Track.h"
 #include "base/XmlExportable.h"
 #include "commands/edit/EventQuantizeCommand.h"
+#include "commands/edit/ThinControllersCommand.h"
 #include "commands/notation/NormalizeRestsCommand.h"
 #include "commands/segment/AddTracksCommand.h"
 #include "commands/segment/SegmentInsertCommand.h"
@@ -131,10 +135,13 @@ RosegardenDocument::RosegardenDocument(
     m_autoSavePeriod(0),
     m_beingDestroyed(false),
     m_clearCommandHistory(clearCommandHistory),
-    m_soundEnabled(enableSound)
+    m_soundEnabled(enableSound),
+    m_snapshotWriter(nullptr)
 {
     checkSequencerTimer();
 
+    Segment::setDeferredEventLoader(LazySegmentLoader::getInstance());
+
     connect(CommandHistory::getInstance(), SIGNAL(commandExecuted()),
             this, SLOT(slotDocumentModified()));
 
@@ -208,6 +215,14 @@ void RosegardenDocument::deleteEditViews()
     qDeleteAll(views);
 }
 
+bool RosegardenDocument::isBeingEdited(const Segment *segment) const
+{
+    for (int i = 0; i < m_editViewList.size(); ++i) {
+        if (m_editViewList[i]->isEditing(segment)) return true;
+    }
+    return false;
+}
+
 void RosegardenDocument::setAbsFilePath(const QString &filename)
 {
     m_absFilePath = filename;
@@ -523,6 +538,8 @@ bool RosegardenDocument::openDocument(const QString &filename,
                                       bool squelchProgressDialog,
                                       bool enableLock)
 {
+    Profiler profiler("RosegardenDocument::openDocument");
+
     RG_DEBUG << "openDocument(" << filename << ")";
 
     if (filename.isEmpty())
@@ -594,21 +611,31 @@ bool RosegardenDocument::openDocument(const QString &filename,
     // Load.
 
     QString fileContents;
-
-    // Unzip
-    bool okay = GzipFile::readFromFile(filename, fileContents);
-    
     QString errMsg;
     bool cancelled = false;
+    bool okay = false;
 
-    if (!okay) {
-        errMsg = tr("Could not open Rosegarden file");
+    // Snapshots are recognised by content, as autosaves keep the
+    // usual name
+    SnapshotReader snapshot;
+    bool isSnapshot = SnapshotReader::isSnapshot(filename);
+
+    if (isSnapshot) {
+        okay = snapshot.open(filename, errMsg);
+        if (okay) fileContents = snapshot.getXml();
     } else {
+        // Unzip
+        okay = GzipFile::readFromFile(filename, fileContents);
+        if (!okay) errMsg = tr("Could not open Rosegarden file");
+    }
+
+    if (okay) {
         // Parse the XML
         okay = xmlParse(fileContents,
                         errMsg,
                         permanent,
-                        cancelled);
+                        cancelled,
+                        isSnapshot ? &snapshot : nullptr);
     }
 
     if (!okay) {
@@ -1179,8 +1206,17 @@ bool RosegardenDocument::saveDocument(const QString& filename,
 {
     QFileInfo fileInfo(filename);
 
+    // Decided here, as the temporary file below has no .rgs extension
+    bool snapshot = SnapshotWriter::isSnapshotFilename(filename);
+    if (autosave && !snapshot) {
+        QSettings settings;
+        settings.beginGroup(GeneralOptionsConfigGroup);
+        snapshot = settings.value("autosave_snapshot", false).toBool();
+        settings.endGroup();
+    }
+
     if (!fileInfo.exists()) { // safe to write directly
-        return saveDocumentActual(filename, errMsg, autosave);
+        return saveDocumentActual(filename, errMsg, autosave, snapshot);
     }
 
     if (fileInfo.exists()  &&  !fileInfo.isWritable()) {
@@ -1212,7 +1248,7 @@ bool RosegardenDocument::saveDocument(const QString& filename,
         return false;
     }
 
-    bool success = saveDocumentActual(tempFileName, errMsg, autosave);
+    bool success = saveDocumentActual(tempFileName, errMsg, autosave, snapshot);
 
     if (!success) {
         // errMsg should be already set
@@ -1235,12 +1271,17 @@ bool RosegardenDocument::saveDocument(const QString& filename,
 
 bool RosegardenDocument::saveDocumentActual(const QString& filename,
                                           QString& errMsg,
-                                          bool autosave)
+                                          bool autosave,
+                                          bool snapshot)
 {
     //Profiler profiler("RosegardenDocument::saveDocumentActual");
 
     RG_DEBUG << "RosegardenDocument::saveDocumentActual(" << filename << ")";
 
+    // saveSegment() packs the events into this rather than writing XML
+    SnapshotWriter writer;
+    m_snapshotWriter = snapshot ? &writer : nullptr;
+
     QString outText;
     QTextStream outStream(&outText, QIODevice::WriteOnly);
 //    outStream.setEncoding(QTextStream::UnicodeUTF8); qt3
@@ -1362,10 +1403,16 @@ bool RosegardenDocument::saveDocumentActual(const QString& filename,
     //
     outStream << "</rosegarden-data>\n";
 
-    bool okay = GzipFile::writeToFile(filename, outText);
-    if (!okay) {
-        errMsg = tr("Error while writing on '%1'").arg(filename);
-        return false;
+    m_snapshotWriter = nullptr;
+
+    if (snapshot) {
+        if (!writer.write(filename, outText, errMsg)) return false;
+    } else {
+        bool okay = GzipFile::writeToFile(filename, outText);
+        if (!okay) {
+            errMsg = tr("Error while writing on '%1'").arg(filename);
+            return false;
+        }
     }
 
     RG_DEBUG << "RosegardenDocument::saveDocument() finished";
@@ -1518,9 +1565,27 @@ void RosegardenDocument::saveSegment(QTextStream& outStream, Segment *segment,
             << "\"/>\n";
         }
 
+    } else if (segment->hasDeferredEvents()) {
+
+        // Never read in, so write the events back out as they were read
+        outStream << "\" eventsend=\"" << segment->getEndTime() << "\">";
+        outStream << QString::fromUtf8(qUncompress(segment->getDeferredEvents()));
+
+        saveEventRulers(outStream, segment);
+
+    } else if (m_snapshotWriter) {
+
+        // The events go into the snapshot's own tables
+        outStream << "\" eventsend=\"" << segment->getEndTime()
+                  << "\" packed=\"" << m_snapshotWriter->addSegment(segment)
+                  << "\">\n";
+
+        saveEventRulers(outStream, segment);
+
     } else // Internal type
     {
-        outStream << "\">\n";
+        // The end time lets LazySegmentLoader defer the events
+        outStream << "\" eventsend=\"" << segment->getEndTime() << "\">\n";
 
         bool inChord = false;
         timeT chordStart = 0, chordDuration = 0;
@@ -1572,31 +1637,36 @@ void RosegardenDocument::saveSegment(QTextStream& outStream, Segment *segment,
             outStream << "</chord>\n";
         }
 
-        // Add EventRulers to segment - we call them controllers because of
-        // a historical mistake in naming them.  My bad.  RWB.
-        //
-        Segment::EventRulerList list = segment->getEventRulerList();
+        saveEventRulers(outStream, segment);
+    }
 
-        if (list.size()) {
-            outStream << "<gui>\n"; // gui elements
-            Segment::EventRulerListConstIterator it;
-            for (it = list.begin(); it != list.end(); ++it) {
-                outStream << "  <controller type=\"" << strtoqstr((*it)->m_type);
 
-                if ((*it)->m_type == Controller::EventType) {
-                    outStream << "\" value =\"" << (*it)->m_controllerValue;
-                }
+    outStream << QString("</%1>\n").arg(segment->getXmlElementName()); //-------------------------
 
-                outStream << "\"/>\n";
-            }
-            outStream << "</gui>\n";
-        }
+}
 
-    }
+void RosegardenDocument::saveEventRulers(QTextStream &outStream,
+                                         Segment *segment)
+{
+    // Add EventRulers to segment - we call them controllers because of
+    // a historical mistake in naming them.  My bad.  RWB.
+    //
+    Segment::EventRulerList list = segment->getEventRulerList();
 
+    if (list.size()) {
+        outStream << "<gui>\n"; // gui elements
+        Segment::EventRulerListConstIterator it;
+        for (it = list.begin(); it != list.end(); ++it) {
+            outStream << "  <controller type=\"" << strtoqstr((*it)->m_type);
 
-    outStream << QString("</%1>\n").arg(segment->getXmlElementName()); //-------------------------
+            if ((*it)->m_type == Controller::EventType) {
+                outStream << "\" value =\"" << (*it)->m_controllerValue;
+            }
 
+            outStream << "\"/>\n";
+        }
+        outStream << "</gui>\n";
+    }
 }
 
 bool RosegardenDocument::saveAs(const QString &newName, QString &errMsg)
@@ -1653,12 +1723,25 @@ bool RosegardenDocument::isSoundEnabled() const
 bool
 RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
                            bool permanent,
-                           bool &cancelled)
+                           bool &cancelled,
+                           const SnapshotReader *snapshot)
 {
-    //Profiler profiler("RosegardenDocument::xmlParse");
+    Profiler profiler("RosegardenDocument::xmlParse");
 
     cancelled = false;
 
+    // A snapshot's segments are already cheap to read in full
+    std::vector<QByteArray> deferredEvents;
+    if (!snapshot && LazySegmentLoader::isEnabled()) {
+        LazySegmentLoader::deferArchivedSegments(fileContents, deferredEvents);
+    }
+
+    // What is left of the segments can be read on several threads
+    ParallelSegmentParser parallelParser;
+    if (!snapshot && ParallelSegmentParser::isEnabled()) {
+        parallelParser.cutSegments(fileContents);
+    }
+
     unsigned int elementCount = 0;
     for (int i = 0; i < fileContents.length() - 1; ++i) {
         if (fileContents[i] == '<' && fileContents[i+1] != '/') {
@@ -1669,6 +1752,9 @@ RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
     if (permanent && m_soundEnabled) RosegardenSequencer::getInstance()->removeAllDevices();
 
     RoseXmlHandler handler(this, elementCount, m_progressDialog, permanent);
+    handler.setDeferredEvents(&deferredEvents);
+    handler.setSnapshot(snapshot);
+    handler.setParallelParser(&parallelParser);
 
     QXmlInputSource source;
     source.setData(fileContents);
@@ -1678,6 +1764,11 @@ RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
 
     bool ok = reader.parse(source);
 
+    QString segmentsError;
+    if (ok && !(m_progressDialog && m_progressDialog->wasCanceled())) {
+        ok = parallelParser.parse(segmentsError);
+    }
+
     if (m_progressDialog  &&  m_progressDialog->wasCanceled()) {
         QMessageBox::information(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), tr("File load cancelled"));
         cancelled = true;
@@ -1695,7 +1786,8 @@ RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
             return true;
         } else {
 #endif
-            errMsg = handler.errorString();
+            if (segmentsError.isEmpty()) errMsg = handler.errorString();
+            else errMsg = segmentsError;
 #if 0
         }
 #endif
@@ -2417,6 +2509,12 @@ RosegardenDocument::stopRecordingMidi()
     }
     m_noteOnEvents.clear();
 
+    // Dense controller data from a fader or wheel is thinned as part
+    // of the same undoable insertion, if the user has asked for that.
+    const bool thinControllers = ThinControllersCommand::isRecordingThinned();
+    const ControllerThinner thinner =
+        ThinControllersCommand::getConfiguredThinner();
+
     while (!m_recordMIDISegments.empty()) {
 
         Segment *s = m_recordMIDISegments.begin()->second;
@@ -2441,6 +2539,14 @@ RosegardenDocument::stopRecordingMidi()
                              NotationOptionsConfigGroup,
                              EventQuantizeCommand::QUANTIZE_NOTATION_ONLY));
 
+        if (thinControllers) {
+            command->addCommand(new ThinControllersCommand
+                                (*s,
+                                 s->getStartTime(),
+                                 s->getEndTime(),
+                                 thinner));
+        }
+
         command->addCommand(new NormalizeRestsCommand
                             (*s,
                              c.getBarStartForTime(s->getStartTime()),
@@ -53,6 +53,8 @@ class MappedEventList;
 class Event;
 class EditViewBase;
 class AudioPluginManager;
+class SnapshotReader;
+class SnapshotWriter;
 
 
 static const int MERGE_AT_END           = (1 << 0);
@@ -141,6 +143,11 @@ public:
      */
     void deleteEditViews();
 
+    /**
+     * Whether any Edit View has the segment open
+     */
+    bool isBeingEdited(const Segment *segment) const;
+
     /// Set the modified flag but do not notify observers.
     /**
      * This also clears m_autoSaved.
@@ -204,6 +211,9 @@ public:
      * saves the document under filename and format.
      *
      * errMsg will be set to a user-readable error message if save fails
+     *
+     * A filename ending in .rgs is saved as a binary snapshot, as is
+     * an autosave when the user has chosen fast autosaves.
      */ 
     bool saveDocument(const QString &filename, QString& errMsg,
                       bool autosave = false);
@@ -581,7 +591,8 @@ private:
      */
     bool xmlParse(QString fileContents, QString &errMsg,
                   bool permanent,
-                  bool &cancelled);
+                  bool &cancelled,
+                  const SnapshotReader *snapshot = nullptr);
 
     /**
      * Set the "auto saved" status of the document
@@ -605,10 +616,11 @@ private:
      * save of the file to the given filename; saveDocument() wraps
      * this, saving to a temporary file and then renaming to the
      * required file, so as not to lose the original if a failure
-     * occurs during overwriting.
+     * occurs during overwriting.  With snapshot set, the file is
+     * written as a SnapshotWriter snapshot rather than gzipped XML.
      */
     bool saveDocumentActual(const QString &filename, QString& errMsg,
-                            bool autosave = false);
+                            bool autosave = false, bool snapshot = false);
 
     /**
      * Save one segment to the given text stream
@@ -617,6 +629,11 @@ private:
                      long totalNbOfEvents, long &count,
                      QString extraAttributes = QString::null);
 
+    /**
+     * Save the segment's event rulers, within a segment element
+     */
+    void saveEventRulers(QTextStream&, Segment*);
+
     /// Identifies a specific event within a specific segment.
     /**
      * A struct formed by a Segment pointer and an iterator into the same
@@ -805,6 +822,9 @@ private:
     bool m_release;
 
     QPointer<QProgressDialog> m_progressDialog;
+
+    /// Collects the events while a snapshot is being saved
+    SnapshotWriter *m_snapshotWriter;
 };
 
 
@@ -0,0 +1,511 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[SnapshotFile]"
+
+#include "SnapshotFile.h"
+
+#include "base/BaseProperties.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/RealTime.h"
+#include "base/Segment.h"
+#include "misc/Debug.h"
+
+#include <QCoreApplication>
+
+#include <string.h>
+
+namespace Rosegarden
+{
+
+static const char SnapshotMagic[8] = { 'R', 'G', 'S', 'N', 'A', 'P', 'S', 'H' };
+
+bool
+SnapshotWriter::isSnapshotFilename(const QString &filename)
+{
+    return filename.endsWith(".rgs", Qt::CaseInsensitive);
+}
+
+quint32
+SnapshotWriter::addString(const std::string &s)
+{
+    StringMap::iterator i = m_stringMap.find(s);
+    if (i != m_stringMap.end()) return i->second;
+
+    quint32 index = quint32(m_strings.size());
+    m_strings.push_back(s);
+    m_stringMap[s] = index;
+    return index;
+}
+
+quint32
+SnapshotWriter::addName(const PropertyName &name)
+{
+    NameMap::iterator i = m_nameMap.find(name.getValue());
+    if (i != m_nameMap.end()) return i->second;
+
+    quint32 index = quint32(m_names.size());
+    m_names.push_back(name.getName());
+    m_nameMap[name.getValue()] = index;
+    return index;
+}
+
+void
+SnapshotWriter::addProperties(const Event *e,
+                              const std::vector<PropertyName> &names,
+                              bool persistent,
+                              std::vector<SnapshotProperty> &properties)
+{
+    for (size_t i = 0; i < names.size(); ++i) {
+
+        const PropertyName &name = names[i];
+
+        // View-local properties are not saved, as in toXmlString()
+        if (!persistent &&
+            name.getName().find("::") != std::string::npos) continue;
+
+        SnapshotProperty property;
+        memset(&property, 0, sizeof(property));
+        property.name = addName(name);
+        property.persistent = persistent ? 1 : 0;
+
+        PropertyType type = e->getPropertyType(name);
+        property.type = quint8(type);
+
+        switch (type) {
+        case Int:
+            property.value = e->get<Int>(name);
+            break;
+        case Bool:
+            property.value = e->get<Bool>(name) ? 1 : 0;
+            break;
+        case String:
+            property.value = addString(e->get<String>(name));
+            break;
+        case RealTimeT: {
+            RealTime t = e->get<RealTimeT>(name);
+            property.value = (qint64(t.sec) << 32) | quint32(t.nsec);
+            break;
+        }
+        }
+
+        properties.push_back(property);
+    }
+}
+
+int
+SnapshotWriter::addSegment(const Segment *segment)
+{
+    m_segments.push_back(PackedSegment());
+    PackedSegment &packed = m_segments.back();
+    packed.events.reserve(segment->size());
+
+    for (Segment::const_iterator i = segment->begin();
+         i != segment->end(); ++i) {
+
+        const Event *e = *i;
+
+        SnapshotEvent event;
+        memset(&event, 0, sizeof(event));
+        event.absoluteTime = e->getAbsoluteTime();
+        event.type = addString(e->getType());
+        event.subOrdering = e->getSubOrdering();
+
+        // Zero length notes are saved as in Event::toXmlString()
+        timeT duration = e->getDuration();
+        if (e->isa(Note::EventType) &&
+            duration < 1 &&
+            !e->has(BaseProperties::IS_GRACE_NOTE)) {
+            duration = 1;
+        }
+        event.duration = duration;
+
+        event.firstProperty = quint32(packed.properties.size());
+        addProperties(e, e->getPersistentPropertyNames(), true,
+                      packed.properties);
+        addProperties(e, e->getNonPersistentPropertyNames(), false,
+                      packed.properties);
+        event.propertyCount =
+            quint32(packed.properties.size()) - event.firstProperty;
+
+        packed.events.push_back(event);
+    }
+
+    return int(m_segments.size()) - 1;
+}
+
+static bool
+writeData(QFile &file, const void *data, quint64 length)
+{
+    if (length == 0) return true;
+    return file.write(static_cast<const char *>(data), length) ==
+        qint64(length);
+}
+
+static std::vector<SnapshotString>
+layOutStrings(const std::vector<std::string> &strings, quint64 &offset)
+{
+    std::vector<SnapshotString> index(strings.size());
+    for (size_t i = 0; i < strings.size(); ++i) {
+        index[i].offset = offset;
+        index[i].length = strings[i].length();
+        offset += strings[i].length();
+    }
+    return index;
+}
+
+bool
+SnapshotWriter::write(const QString &filename, const QString &xml,
+                      QString &errMsg)
+{
+    QByteArray xmlData = xml.toUtf8();
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+    header.version = SnapshotVersion;
+    header.byteOrder = SnapshotByteOrder;
+    header.stringCount = quint32(m_strings.size());
+    header.nameCount = quint32(m_names.size());
+    header.segmentCount = quint32(m_segments.size());
+
+    // The fixed size records come first, so they all stay 8-byte
+    // aligned, then the strings and the XML
+
+    quint64 offset = sizeof(header);
+
+    header.stringsOffset = offset;
+    offset += sizeof(SnapshotString) * header.stringCount;
+    header.namesOffset = offset;
+    offset += sizeof(SnapshotString) * header.nameCount;
+    header.segmentsOffset = offset;
+    offset += sizeof(SnapshotSegment) * header.segmentCount;
+
+    std::vector<SnapshotSegment> segments(m_segments.size());
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+        segments[i].eventCount = quint32(m_segments[i].events.size());
+        segments[i].propertyCount = quint32(m_segments[i].properties.size());
+        segments[i].eventsOffset = offset;
+        offset += sizeof(SnapshotEvent) * segments[i].eventCount;
+        segments[i].propertiesOffset = offset;
+        offset += sizeof(SnapshotProperty) * segments[i].propertyCount;
+    }
+
+    std::vector<SnapshotString> strings = layOutStrings(m_strings, offset);
+    std::vector<SnapshotString> names = layOutStrings(m_names, offset);
+
+    header.xmlOffset = offset;
+    header.xmlLength = xmlData.size();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotWriter", "Could not open '%1' for writing")
+            .arg(filename);
+        return false;
+    }
+
+    bool ok = writeData(file, &header, sizeof(header));
+
+    if (!strings.empty()) {
+        ok = ok && writeData(file, &strings[0],
+                             sizeof(SnapshotString) * strings.size());
+    }
+    if (!names.empty()) {
+        ok = ok && writeData(file, &names[0],
+                             sizeof(SnapshotString) * names.size());
+    }
+    if (!segments.empty()) {
+        ok = ok && writeData(file, &segments[0],
+                             sizeof(SnapshotSegment) * segments.size());
+    }
+
+    for (size_t i = 0; ok && i < m_segments.size(); ++i) {
+        const PackedSegment &packed = m_segments[i];
+        if (!packed.events.empty()) {
+            ok = ok && writeData(file, &packed.events[0],
+                                 sizeof(SnapshotEvent) * packed.events.size());
+        }
+        if (!packed.properties.empty()) {
+            ok = ok && writeData(file, &packed.properties[0],
+                                 sizeof(SnapshotProperty) *
+                                 packed.properties.size());
+        }
+    }
+
+    for (size_t i = 0; ok && i < m_strings.size(); ++i) {
+        ok = writeData(file, m_strings[i].data(), m_strings[i].length());
+    }
+    for (size_t i = 0; ok && i < m_names.size(); ++i) {
+        ok = writeData(file, m_names[i].data(), m_names[i].length());
+    }
+
+    ok = ok && writeData(file, xmlData.constData(), xmlData.size());
+
+    file.close();
+
+    if (!ok) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotWriter", "Error while writing on '%1'")
+            .arg(filename);
+        return false;
+    }
+
+    return true;
+}
+
+
+SnapshotReader::SnapshotReader() :
+    m_data(nullptr),
+    m_size(0),
+    m_header(nullptr)
+{
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    // The mapping goes with the file
+    m_file.close();
+}
+
+bool
+SnapshotReader::isSnapshot(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    char magic[sizeof(SnapshotMagic)];
+    if (file.read(magic, sizeof(magic)) != qint64(sizeof(magic))) {
+        return false;
+    }
+
+    return memcmp(magic, SnapshotMagic, sizeof(magic)) == 0;
+}
+
+bool
+SnapshotReader::isInFile(quint64 offset, quint64 count, size_t size) const
+{
+    return offset <= m_size && count <= (m_size - offset) / size;
+}
+
+bool
+SnapshotReader::readStrings(quint64 offset, quint32 count,
+                            std::vector<std::string> &strings)
+{
+    if (!isInFile(offset, count, sizeof(SnapshotString))) return false;
+
+    const SnapshotString *index =
+        reinterpret_cast<const SnapshotString *>(m_data + offset);
+
+    strings.reserve(count);
+
+    for (quint32 i = 0; i < count; ++i) {
+        if (!isInFile(index[i].offset, index[i].length, 1)) return false;
+        strings.push_back(std::string
+            (reinterpret_cast<const char *>(m_data + index[i].offset),
+             size_t(index[i].length)));
+    }
+
+    return true;
+}
+
+bool
+SnapshotReader::open(const QString &filename, QString &errMsg)
+{
+    m_file.setFileName(filename);
+
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotReader", "Could not open snapshot '%1'")
+            .arg(filename);
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+
+    if (!m_data) {
+        RG_DEBUG << "open(): could not map" << filename << ", reading it";
+        m_buffer = m_file.readAll();
+        m_data = reinterpret_cast<const uchar *>(m_buffer.constData());
+        m_size = m_buffer.size();
+    }
+
+    const SnapshotHeader *header =
+        reinterpret_cast<const SnapshotHeader *>(m_data);
+
+    if (m_size < sizeof(SnapshotHeader) ||
+        memcmp(header->magic, SnapshotMagic, sizeof(header->magic)) != 0) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotReader", "Not a Rosegarden snapshot");
+        return false;
+    }
+
+    if (header->byteOrder != SnapshotByteOrder) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotReader",
+             "Snapshot was saved on a machine of different byte order");
+        return false;
+    }
+
+    if (header->version != SnapshotVersion) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotReader", "Unsupported snapshot version %1")
+            .arg(header->version);
+        return false;
+    }
+
+    if (!isInFile(header->xmlOffset, header->xmlLength, 1) ||
+        !isInFile(header->segmentsOffset, header->segmentCount,
+                  sizeof(SnapshotSegment)) ||
+        !readStrings(header->stringsOffset, header->stringCount, m_strings)) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotReader", "Snapshot is truncated or corrupt");
+        return false;
+    }
+
+    std::vector<std::string> names;
+    if (!readStrings(header->namesOffset, header->nameCount, names)) {
+        errMsg = QCoreApplication::translate
+            ("Rosegarden::SnapshotReader", "Snapshot is truncated or corrupt");
+        return false;
+    }
+
+    // Intern each name once, rather than once per property
+    m_names.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        m_names.push_back(PropertyName(names[i]));
+    }
+
+    m_header = header;
+    return true;
+}
+
+QString
+SnapshotReader::getXml() const
+{
+    if (!m_header) return QString();
+
+    return QString::fromUtf8
+        (reinterpret_cast<const char *>(m_data + m_header->xmlOffset),
+         int(m_header->xmlLength));
+}
+
+bool
+SnapshotReader::readSegment(int index, Segment *segment) const
+{
+    if (!m_header || index < 0 || quint32(index) >= m_header->segmentCount) {
+        return false;
+    }
+
+    const SnapshotSegment &packed =
+        reinterpret_cast<const SnapshotSegment *>
+        (m_data + m_header->segmentsOffset)[index];
+
+    if (!isInFile(packed.eventsOffset, packed.eventCount,
+                  sizeof(SnapshotEvent)) ||
+        !isInFile(packed.propertiesOffset, packed.propertyCount,
+                  sizeof(SnapshotProperty))) {
+        return false;
+    }
+
+    const SnapshotEvent *events =
+        reinterpret_cast<const SnapshotEvent *>(m_data + packed.eventsOffset);
+    const SnapshotProperty *properties =
+        reinterpret_cast<const SnapshotProperty *>
+        (m_data + packed.propertiesOffset);
+
+    // As in RoseXmlHandler, beamed groups get new ids from the segment
+    std::map<long, long> groupIdMap;
+
+    for (quint32 i = 0; i < packed.eventCount; ++i) {
+
+        const SnapshotEvent &packedEvent = events[i];
+
+        if (packedEvent.type >= m_strings.size() ||
+            packedEvent.firstProperty > packed.propertyCount ||
+            packedEvent.propertyCount >
+                packed.propertyCount - packedEvent.firstProperty) {
+            return false;
+        }
+
+        Event *e = new Event(m_strings[packedEvent.type],
+                             packedEvent.absoluteTime,
+                             packedEvent.duration,
+                             short(packedEvent.subOrdering));
+
+        for (quint32 j = 0; j < packedEvent.propertyCount; ++j) {
+
+            const SnapshotProperty &property =
+                properties[packedEvent.firstProperty + j];
+
+            bool ok = (property.name < m_names.size());
+
+            if (ok) {
+                const PropertyName &name = m_names[property.name];
+                bool persistent = (property.persistent != 0);
+
+                switch (property.type) {
+                case Int:
+                    e->set<Int>(name, long(property.value), persistent);
+                    break;
+                case Bool:
+                    e->set<Bool>(name, property.value != 0, persistent);
+                    break;
+                case String:
+                    ok = (property.value >= 0 &&
+                          quint64(property.value) < m_strings.size());
+                    if (ok) {
+                        e->set<String>(name, m_strings[property.value],
+                                       persistent);
+                    }
+                    break;
+                case RealTimeT:
+                    e->set<RealTimeT>
+                        (name,
+                         RealTime(int(property.value >> 32),
+                                  int(qint32(property.value & 0xffffffff))),
+                         persistent);
+                    break;
+                default:
+                    ok = false;
+                    break;
+                }
+            }
+
+            if (!ok) {
+                delete e;
+                return false;
+            }
+        }
+
+        if (e->has(BaseProperties::BEAMED_GROUP_ID)) {
+            long storedId = e->get<Int>(BaseProperties::BEAMED_GROUP_ID);
+            if (groupIdMap.find(storedId) == groupIdMap.end()) {
+                groupIdMap[storedId] = segment->getNextId();
+            }
+            e->set<Int>(BaseProperties::BEAMED_GROUP_ID, groupIdMap[storedId]);
+        }
+
+        segment->insert(e);
+    }
+
+    return true;
+}
+
+}
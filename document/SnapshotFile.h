@@ -0,0 +1,196 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_SNAPSHOTFILE_H
+#define RG_SNAPSHOTFILE_H
+
+#include "base/PropertyName.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Rosegarden
+{
+
+class Event;
+class Segment;
+
+/*
+ * A snapshot is a binary alternative to the gzipped XML of a .rg
+ * file, for fast saving and loading.  Everything but the events of
+ * the segments is kept as the usual XML, uncompressed.  The events
+ * are packed into fixed size records which a reader can use in place,
+ * from a memory-mapped file, with no parsing of text at all.
+ *
+ * The file starts with a SnapshotHeader, and the rest is found
+ * through the offsets in it.  Event types and string values are
+ * stored once each in a string table, and property names once each in
+ * a name table, so they can be interned as they are read.  Each
+ * segment element in the XML has a "packed" attribute giving the
+ * index of its SnapshotSegment.
+ *
+ * Numbers are in the byte order of the machine that wrote the file;
+ * a reader on a machine of the other order refuses it.  Any change
+ * to this layout needs a new SnapshotVersion.
+ */
+
+struct SnapshotHeader
+{
+    char magic[8];              // "RGSNAPSH"
+    quint32 version;
+    quint32 byteOrder;          // SnapshotByteOrder as written
+    quint64 xmlOffset;          // UTF-8
+    quint64 xmlLength;
+    quint64 stringsOffset;      // SnapshotString[stringCount]
+    quint64 namesOffset;        // SnapshotString[nameCount]
+    quint64 segmentsOffset;     // SnapshotSegment[segmentCount]
+    quint32 stringCount;
+    quint32 nameCount;
+    quint32 segmentCount;
+    quint32 reserved;
+};
+
+struct SnapshotString
+{
+    quint64 offset;             // UTF-8, not terminated
+    quint64 length;
+};
+
+struct SnapshotSegment
+{
+    quint64 eventsOffset;       // SnapshotEvent[eventCount]
+    quint64 propertiesOffset;   // SnapshotProperty[propertyCount]
+    quint32 eventCount;
+    quint32 propertyCount;
+};
+
+struct SnapshotEvent
+{
+    qint64 absoluteTime;
+    qint64 duration;
+    quint32 type;               // index into the string table
+    qint32 subOrdering;
+    quint32 firstProperty;      // within the segment's properties
+    quint32 propertyCount;
+};
+
+struct SnapshotProperty
+{
+    // Int and Bool as they are, String as an index into the string
+    // table, RealTimeT as seconds in the high 32 bits and nanoseconds
+    // in the low
+    qint64 value;
+    quint32 name;               // index into the name table
+    quint8 type;                // PropertyType
+    quint8 persistent;
+    quint16 reserved;
+};
+
+static const quint32 SnapshotVersion = 1;
+static const quint32 SnapshotByteOrder = 0x01020304;
+
+/**
+ * Collects the events of segments as they are saved, then writes the
+ * snapshot.  See RosegardenDocument::saveDocument().
+ */
+class SnapshotWriter
+{
+public:
+    /// Whether the file name is that of a snapshot (.rgs)
+    static bool isSnapshotFilename(const QString &filename);
+
+    /**
+     * Pack the events of the segment, returning the index to give
+     * its element as the "packed" attribute.  Events are saved as
+     * Event::toXmlString() would save them.
+     */
+    int addSegment(const Segment *segment);
+
+    /// Write the snapshot, with the given XML for everything else
+    bool write(const QString &filename, const QString &xml,
+               QString &errMsg);
+
+private:
+    quint32 addString(const std::string &s);
+    quint32 addName(const PropertyName &name);
+    void addProperties(const Event *e,
+                       const std::vector<PropertyName> &names,
+                       bool persistent,
+                       std::vector<SnapshotProperty> &properties);
+
+    typedef std::map<std::string, quint32> StringMap;
+    StringMap m_stringMap;
+    std::vector<std::string> m_strings;
+
+    typedef std::map<int, quint32> NameMap;  // by PropertyName value
+    NameMap m_nameMap;
+    std::vector<std::string> m_names;
+
+    struct PackedSegment
+    {
+        std::vector<SnapshotEvent> events;
+        std::vector<SnapshotProperty> properties;
+    };
+    std::vector<PackedSegment> m_segments;
+};
+
+/**
+ * Reads a snapshot, mapping the file into memory.  The XML is handed
+ * to RoseXmlHandler as usual, which calls readSegment() for each
+ * segment element with a "packed" attribute.
+ */
+class SnapshotReader
+{
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    /// Whether the file starts like a snapshot, whatever its name
+    static bool isSnapshot(const QString &filename);
+
+    bool open(const QString &filename, QString &errMsg);
+
+    /// The XML for everything but the events
+    QString getXml() const;
+
+    /// Insert the events packed at the given index into the segment
+    bool readSegment(int index, Segment *segment) const;
+
+private:
+    bool isInFile(quint64 offset, quint64 count, size_t size) const;
+    bool readStrings(quint64 offset, quint32 count,
+                     std::vector<std::string> &strings);
+
+    QFile m_file;
+    const uchar *m_data;
+    quint64 m_size;
+    QByteArray m_buffer;        // if the file could not be mapped
+
+    const SnapshotHeader *m_header;
+    std::vector<std::string> m_strings;
+    std::vector<PropertyName> m_names;
+};
+
+}
+
+#endif
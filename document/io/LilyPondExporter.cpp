@@ -42,6 +42,7 @@
 #include "base/Exception.h"
 #include "base/Instrument.h"
 #include "base/NotationTypes.h"
+#include "base/Profiler.h"
 #include "base/PropertyName.h"
 #include "base/Segment.h"
 #include "base/SegmentNotationHelper.h"
@@ -671,6 +672,8 @@ struct MarkerComp {
 bool
 LilyPondExporter::write()
 {
+    Profiler profiler("LilyPondExporter::write");
+
     m_warningMessage = "";
     QString tmpName = strtoqstr(m_fileName);
 
@@ -28,6 +28,7 @@
 
 #include "misc/ConfigGroups.h"
 #include "misc/Debug.h"
+#include "base/Profiler.h"
 #include "base/StaffExportTypes.h"
 
 #include "rosegarden-version.h"
@@ -490,6 +491,8 @@ MusicXmlExporter::writeScorePart(timeT compositionEndTime, std::ostream &str)
 bool
 MusicXmlExporter::write()
 {
+    Profiler profiler("MusicXmlExporter::write");
+
     std::ofstream str(m_fileName.c_str(), std::ios::out);
     if (!str) {
         RG_WARNING << "write(): Can't write file" << m_fileName;
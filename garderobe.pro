@@ -132,6 +132,7 @@ HEADERS += \
     base/Equation.h \
     base/Device.h \
     base/ControlParameter.h \
+    base/ControllerThinner.h \
     base/Controllable.h \
     base/Configuration.h \
     base/CompositionTimeSliceAdapter.h \
@@ -169,8 +170,10 @@ HEADERS += \
     commands/edit/MoveAcrossSegmentsCommand.h \
     commands/edit/ModifyMarkerCommand.h \
     commands/edit/InvertCommand.h \
+    commands/edit/ThinControllersCommand.h \
     commands/edit/InsertTriggerNoteCommand.h \
     commands/edit/EventUnquantizeCommand.h \
+    commands/edit/BatchQuantizeCommand.h \
     commands/edit/EventQuantizeCommand.h \
     commands/edit/EventInsertionCommand.h \
     commands/edit/EventEditCommand.h \
@@ -254,8 +257,11 @@ HEADERS += \
     document/XmlSubHandler.h \
     document/XmlStorableEvent.h \
     document/RoseXmlHandler.h \
+    document/LazySegmentLoader.h \
+    document/ParallelSegmentParser.h \
     document/RosegardenDocument.h \
     document/GzipFile.h \
+    document/SnapshotFile.h \
     document/CommandRegistry.h \
     document/CommandHistory.h \
     document/Command.h \
@@ -396,6 +402,7 @@ HEADERS += \
     gui/editors/notation/NotePixmapPainter.h \
     gui/editors/notation/NotePixmapFactory.h \
     gui/editors/notation/NoteItem.h \
+    gui/editors/notation/NoteGlyphCache.h \
     gui/editors/notation/NoteFontViewer.h \
     gui/editors/notation/NoteFontMap.h \
     gui/editors/notation/NoteFontFactory.h \
@@ -549,6 +556,7 @@ HEADERS += \
     sound/SF2PatchExtractor.h \
     sound/SequencerDataBlock.h \
     sound/Scavenger.h \
+    sound/LocateCache.h \
     sound/SampleWindow.h \
     sound/RunnablePluginInstance.h \
     sound/RingBuffer.h \
@@ -839,6 +847,7 @@ SOURCES += \
     base/Equation.cpp \
     base/Device.cpp \
     base/ControlParameter.cpp \
+    base/ControllerThinner.cpp \
     base/Configuration.cpp \
     base/CompositionTimeSliceAdapter.cpp \
     base/Composition.cpp \
@@ -874,8 +883,10 @@ SOURCES += \
     commands/edit/MoveAcrossSegmentsCommand.cpp \
     commands/edit/ModifyMarkerCommand.cpp \
     commands/edit/InvertCommand.cpp \
+    commands/edit/ThinControllersCommand.cpp \
     commands/edit/InsertTriggerNoteCommand.cpp \
     commands/edit/EventUnquantizeCommand.cpp \
+    commands/edit/BatchQuantizeCommand.cpp \
     commands/edit/EventQuantizeCommand.cpp \
     commands/edit/EventInsertionCommand.cpp \
     commands/edit/EventEditCommand.cpp \
@@ -959,9 +970,12 @@ SOURCES += \
     document/XmlSubHandler.cpp \
     document/XmlStorableEvent.cpp \
     document/RoseXmlHandler.cpp \
+    document/LazySegmentLoader.cpp \
+    document/ParallelSegmentParser.cpp \
     document/RosegardenDocument.cpp \
     document/DocumentGet.cpp \
     document/GzipFile.cpp \
+    document/SnapshotFile.cpp \
     document/CommandRegistry.cpp \
     document/CommandHistory.cpp \
     document/Command.cpp \
@@ -1099,6 +1113,7 @@ SOURCES += \
     gui/editors/notation/NotePixmapParameters.cpp \
     gui/editors/notation/NotePixmapFactory.cpp \
     gui/editors/notation/NoteItem.cpp \
+    gui/editors/notation/NoteGlyphCache.cpp \
     gui/editors/notation/NoteFontViewer.cpp \
     gui/editors/notation/NoteFontMap.cpp \
     gui/editors/notation/NoteFontFactory.cpp \
@@ -1243,6 +1258,8 @@ SOURCES += \
     sound/SoundDriver.cpp \
     sound/SF2PatchExtractor.cpp \
     sound/SequencerDataBlock.cpp \
+    sound/Scavenger.cpp \
+    sound/LocateCache.cpp \
     sound/RunnablePluginInstance.cpp \
     sound/RIFFAudioFile.cpp \
     sound/Resampler.cpp \
@@ -1485,3 +1502,14 @@ SOURCES += \
 FORMS += gui/dialogs/RosegardenTransportUi.ui \
     gui/studio/DeviceManagerDialogUi.ui
     
+
+# "qmake CONFIG+=benchmarks" builds rosegarden-benchmarks instead: the
+# application plus the headless --benchmark modes, which the shipping
+# build leaves out.
+#
+benchmarks {
+    TARGET = rosegarden-benchmarks
+    DEFINES += RG_BENCHMARKS
+    HEADERS += gui/application/Benchmarks.h
+    SOURCES += gui/application/Benchmarks.cpp
+}
@@ -0,0 +1,1311 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+    See the AUTHORS file for more details.
+ 
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[Benchmarks]"
+
+#include "Benchmarks.h"
+
+#include "misc/Debug.h"
+#include "document/RosegardenDocument.h"
+#include "document/GzipFile.h"
+#include "document/LazySegmentLoader.h"
+#include "document/ParallelSegmentParser.h"
+#include "document/io/LilyPondExporter.h"
+#include "gui/general/ResourceFinder.h"
+#include "gui/editors/notation/NotationScene.h"
+#include "gui/editors/notation/NoteGlyphCache.h"
+#include "gui/editors/notation/NoteItem.h"
+#include "gui/editors/notation/NotePixmapFactory.h"
+#include "gui/editors/notation/NotePixmapParameters.h"
+#include "gui/editors/notation/StaffLayout.h"
+#include "gui/seqmanager/SequenceManager.h"
+#include "base/Composition.h"
+#include "base/NotationTypes.h"
+#include "base/Profiler.h"
+#include "base/RealTime.h"
+#include "base/Segment.h"
+#include "base/Selection.h"
+#include "sound/MappedBufMetaIterator.h"
+#include "sound/MappedEvent.h"
+#include "sound/MappedInserterBase.h"
+#include "sound/MidiFile.h"
+#include "sound/MidiProcess.h"
+#include "sound/Resampler.h"
+#include "sound/SequencerDataBlock.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGraphicsItem>
+#include <QImage>
+#include <QList>
+#include <QPainter>
+#include <QRunnable>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+namespace Rosegarden
+{
+
+
+void
+Benchmarks::printUsage()
+{
+    std::cerr << "       rosegarden-benchmarks --benchmark [--scale N] [--json out.json] [file.rg...]\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-snapshot file.rg...\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-load file.rg...\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-playback file.rg...\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-meters\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-midi-in\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-glyphs [file.rg...]\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-segment\n";
+    std::cerr << "       rosegarden-benchmarks --benchmark-resampler\n";
+}
+
+static void usage()
+{
+    std::cerr << "Usage:\n";
+    Benchmarks::printUsage();
+    exit(2);
+}
+
+// Open a document as convert() does, timing it
+static RosegardenDocument *
+openTimed(const QString &file, qint64 &milliseconds)
+{
+    RosegardenDocument *doc = new RosegardenDocument(
+            nullptr,  // parent
+            nullptr,  // audioPluginManager
+            true,  // skipAutoload
+            true,  // clearCommandHistory
+            false);  // m_useSequencer
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = doc->openDocument(
+            file,
+            false,  // permanent
+            true,  // squelchProgressDialog
+            false);  // enableLock
+
+    milliseconds = timer.elapsed();
+
+    if (!ok) {
+        std::cerr << "Error opening file: " << file << "\n";
+        exit(1);
+    }
+
+    return doc;
+}
+
+static void saveOrExit(RosegardenDocument *doc, const QString &file)
+{
+    QString errMsg;
+    if (!doc->saveDocument(file, errMsg)) {
+        std::cerr << "Error saving file: " << file << ": " << errMsg << "\n";
+        exit(1);
+    }
+}
+
+// Compare the time taken to open each file as XML and as a snapshot,
+// and check that the snapshot loses nothing by saving both as XML.
+static void benchmarkSnapshot(const QStringList &args)
+{
+    if (args.size() < 3) usage();
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        std::cerr << "Error creating temporary directory\n";
+        exit(1);
+    }
+
+    const QString snapshotFile = tempDir.path() + "/benchmark.rgs";
+    const QString fromXmlFile = tempDir.path() + "/fromxml.rg";
+    const QString fromSnapshotFile = tempDir.path() + "/fromsnapshot.rg";
+
+    bool allMatch = true;
+
+    for (int i = 2; i < args.size(); ++i) {
+
+        const QString &inFile = args[i];
+
+        qint64 xmlTime = 0;
+        RosegardenDocument *xmlDoc = openTimed(inFile, xmlTime);
+
+        QElapsedTimer timer;
+        timer.start();
+        saveOrExit(xmlDoc, snapshotFile);
+        qint64 saveTime = timer.elapsed();
+
+        qint64 snapshotTime = 0;
+        RosegardenDocument *snapshotDoc =
+            openTimed(snapshotFile, snapshotTime);
+
+        saveOrExit(xmlDoc, fromXmlFile);
+        saveOrExit(snapshotDoc, fromSnapshotFile);
+
+        QString fromXml, fromSnapshot;
+        bool match = GzipFile::readFromFile(fromXmlFile, fromXml) &&
+                     GzipFile::readFromFile(fromSnapshotFile, fromSnapshot) &&
+                     fromXml == fromSnapshot;
+        if (!match) allMatch = false;
+
+        std::cout << inFile << ":\n"
+                  << "  open XML:        " << xmlTime << " ms, "
+                  << QFileInfo(inFile).size() << " bytes\n"
+                  << "  save snapshot:   " << saveTime << " ms\n"
+                  << "  open snapshot:   " << snapshotTime << " ms, "
+                  << QFileInfo(snapshotFile).size() << " bytes\n"
+                  << "  round trip:      "
+                  << (match ? "identical" : "DIFFERS") << "\n";
+
+        delete snapshotDoc;
+        delete xmlDoc;
+    }
+
+    exit(allMatch ? 0 : 1);
+}
+
+// Time opening each file with its segments read on 1, 2, 4, 8 and 16
+// threads, up to the number of cores, and check that each reads the
+// same as one thread does.
+static void benchmarkLoad(const QStringList &args)
+{
+    if (args.size() < 3) usage();
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        std::cerr << "Error creating temporary directory\n";
+        exit(1);
+    }
+
+    const QString baseFile = tempDir.path() + "/base.rg";
+    const QString threadedFile = tempDir.path() + "/threaded.rg";
+
+    const int cores = QThread::idealThreadCount();
+    bool allMatch = true;
+
+    for (int i = 2; i < args.size(); ++i) {
+
+        const QString &inFile = args[i];
+        std::cout << inFile << ":\n";
+
+        qint64 baseTime = 0;
+        ParallelSegmentParser::setThreadCount(1);
+        RosegardenDocument *baseDoc = openTimed(inFile, baseTime);
+        saveOrExit(baseDoc, baseFile);
+        delete baseDoc;
+
+        QString base;
+        GzipFile::readFromFile(baseFile, base);
+
+        std::cout << "   1 thread:  " << baseTime << " ms\n";
+
+        for (int threads = 2; threads <= 16 && threads <= cores;
+             threads *= 2) {
+
+            qint64 time = 0;
+            ParallelSegmentParser::setThreadCount(threads);
+            RosegardenDocument *doc = openTimed(inFile, time);
+            saveOrExit(doc, threadedFile);
+            delete doc;
+
+            QString threaded;
+            bool match = GzipFile::readFromFile(threadedFile, threaded) &&
+                         threaded == base;
+            if (!match) allMatch = false;
+
+            std::cout << "  " << (threads < 10 ? " " : "") << threads
+                      << " threads: " << time << " ms, speedup "
+                      << (time > 0 ? double(baseTime) / double(time) : 0.0)
+                      << (match ? "" : ", DIFFERS from 1 thread") << "\n";
+        }
+    }
+
+    ParallelSegmentParser::setThreadCount(0);
+
+    exit(allMatch ? 0 : 1);
+}
+
+// Discards the events fetched by the benchmarks, counting them and
+// the ones that come before the one inserted last in the same slice.
+class CountingInserter : public MappedInserterBase
+{
+public:
+    CountingInserter() : m_count(0), m_outOfOrder(0) { }
+
+    void startSlice() { m_last = RealTime::zeroTime; }
+
+    void insertCopy(const MappedEvent &evt) override {
+        if (evt.getEventTime() < m_last) ++m_outOfOrder;
+        m_last = evt.getEventTime();
+        ++m_count;
+    }
+
+    long getCount() const { return m_count; }
+    long getOutOfOrder() const { return m_outOfOrder; }
+
+private:
+    long m_count;
+    long m_outOfOrder;
+    RealTime m_last;
+};
+
+// Make the composition scale times as long by appending scale - 1
+// copies of each MIDI segment after the end marker, so that the
+// pipelines can be timed on a project larger than any example.
+static void scaleComposition(RosegardenDocument *doc, int scale)
+{
+    Composition &composition = doc->getComposition();
+
+    const timeT start = composition.getStartMarker();
+    const timeT length = composition.getEndMarker() - start;
+
+    std::vector<Segment *> originals;
+    for (Composition::iterator i = composition.begin();
+         i != composition.end(); ++i) {
+        if ((*i)->getType() == Segment::Internal) originals.push_back(*i);
+    }
+
+    composition.setEndMarker(start + length * scale);
+
+    for (int copy = 1; copy < scale; ++copy) {
+        for (size_t i = 0; i < originals.size(); ++i) {
+            Segment *segment = originals[i]->clone(false);
+            segment->setStartTime
+                (originals[i]->getStartTime() + length * copy);
+            composition.addSegment(segment);
+        }
+    }
+}
+
+// Open the file, scale it up, and time each of the main pipelines on
+// it: opening and parsing, filling the segment mappers, fetching the
+// events as playback does, MIDI and LilyPond export, and notation
+// layout.  Returns the timings as a JSON object.
+static QString benchmarkPipelines(const QString &file, int scale,
+                                  const QString &tempPath)
+{
+    qint64 openTime = 0;
+    RosegardenDocument *doc = openTimed(file, openTime);
+    if (scale > 1) scaleComposition(doc, scale);
+
+    Composition &composition = doc->getComposition();
+
+    std::vector<Segment *> segments;
+    long events = 0;
+    for (Composition::iterator i = composition.begin();
+         i != composition.end(); ++i) {
+        if ((*i)->getType() != Segment::Internal) continue;
+        segments.push_back(*i);
+        events += long((*i)->size());
+    }
+
+    QElapsedTimer timer;
+
+    timer.start();
+    SequenceManager *sequenceManager = new SequenceManager();
+    sequenceManager->setDocument(doc);
+    sequenceManager->resetCompositionMapper();
+    const qint64 mapperTime = timer.elapsed();
+
+    // Fetch in 100ms slices, as the sequencer does while playing
+    timer.start();
+    MappedBufMetaIterator *metaIterator =
+        sequenceManager->makeTempMetaiterator();
+    const RealTime start =
+        composition.getElapsedRealTime(composition.getStartMarker());
+    const RealTime end =
+        composition.getElapsedRealTime(composition.getEndMarker());
+    const RealTime slice(0, 100000000);
+    CountingInserter inserter;
+    metaIterator->jumpToTime(start);
+    for (RealTime t = start; t < end; t = t + slice) {
+        metaIterator->fetchEvents(inserter, t, t + slice);
+    }
+    delete metaIterator;
+    const qint64 playbackTime = timer.elapsed();
+
+    delete sequenceManager;
+
+    // As the exporters do in the GUI
+    LazySegmentLoader::loadAll(doc->getComposition());
+
+    timer.start();
+    MidiFile midiFile;
+    bool ok = midiFile.convertToMidi(doc, tempPath + "/benchmark.mid");
+    const qint64 midiTime = timer.elapsed();
+    if (!ok) {
+        std::cerr << "Error exporting MIDI: " << file << "\n";
+        exit(1);
+    }
+
+    timer.start();
+    LilyPondExporter lilyPondExporter
+        (doc, SegmentSelection(),
+         std::string((tempPath + "/benchmark.ly").toLocal8Bit().constData()));
+    ok = lilyPondExporter.write();
+    const qint64 lilyPondTime = timer.elapsed();
+    if (!ok) {
+        std::cerr << "Error exporting LilyPond: " << file << "\n";
+        exit(1);
+    }
+
+    // As NotationWidget::setSegments() does.  Page mode has a fixed
+    // page width, so the scene can be laid out without a widget.
+    timer.start();
+    for (size_t i = 0; i < segments.size(); ++i) {
+        segments[i]->enforceBeginWithClefAndKey();
+    }
+    NotationScene *scene = new NotationScene();
+    scene->suspendLayoutUpdates();
+    scene->setStaffs(doc, segments);
+    scene->setPageMode(StaffLayout::MultiPageMode);
+    scene->resumeLayoutUpdates();
+    const qint64 layoutTime = timer.elapsed();
+    delete scene;
+
+    delete doc;
+
+    std::cout << file << " x" << scale << ": " << events << " events, "
+              << inserter.getCount() << " played\n"
+              << "  open:            " << openTime << " ms\n"
+              << "  fill mappers:    " << mapperTime << " ms\n"
+              << "  playback:        " << playbackTime << " ms\n"
+              << "  MIDI export:     " << midiTime << " ms\n"
+              << "  LilyPond export: " << lilyPondTime << " ms\n"
+              << "  notation layout: " << layoutTime << " ms\n";
+
+    QString name = QFileInfo(file).fileName();
+    name.replace("\\", "\\\\").replace("\"", "\\\"");
+
+    return QString("    { \"file\": \"%1\", \"scale\": %2, \"events\": %3, "
+                   "\"open_ms\": %4, \"mapper_ms\": %5, "
+                   "\"playback_ms\": %6, \"midi_export_ms\": %7, "
+                   "\"lilypond_export_ms\": %8, \"layout_ms\": %9 }")
+        .arg(name).arg(scale).arg(events)
+        .arg(openTime).arg(mapperTime).arg(playbackTime)
+        .arg(midiTime).arg(lilyPondTime).arg(layoutTime);
+}
+
+// The example files, unbundled from the resources where need be so
+// that they can be opened as files.
+static QStringList exampleFiles()
+{
+    QStringList files;
+
+    const QStringList examples =
+        ResourceFinder().getResourceFiles("examples", "rg");
+    for (int i = 0; i < examples.size(); ++i) {
+        QString example = examples[i];
+        if (example.startsWith(":")) {
+            QString name = QFileInfo(example).fileName();
+            ResourceFinder().unbundleResource("examples", name);
+            example = ResourceFinder().getResourcePath("examples", name);
+            if (example.startsWith(":")) continue;
+        }
+        files << example;
+    }
+    files.sort();
+
+    return files;
+}
+
+// Time the main pipelines on each file given, or on each example if
+// none is, both as it is and scaled up, and write the timings and the
+// peak RSS as JSON.  Unlike the profiling points, this does not need a
+// build with timing enabled.
+static void benchmark(const QStringList &args)
+{
+    int scale = 8;
+    QString jsonFile;
+    QStringList files;
+
+    for (int i = 2; i < args.size(); ++i) {
+        if (args[i] == "--scale" && i + 1 < args.size()) {
+            scale = args[++i].toInt();
+            if (scale < 1) usage();
+        } else if (args[i] == "--json" && i + 1 < args.size()) {
+            jsonFile = args[++i];
+        } else if (args[i].startsWith("-")) {
+            usage();
+        } else {
+            files << args[i];
+        }
+    }
+
+    if (files.empty()) files = exampleFiles();
+
+    if (files.empty()) {
+        std::cerr << "No files to benchmark\n";
+        exit(1);
+    }
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        std::cerr << "Error creating temporary directory\n";
+        exit(1);
+    }
+
+    QStringList runs;
+    for (int i = 0; i < files.size(); ++i) {
+        runs << benchmarkPipelines(files[i], 1, tempDir.path());
+        if (scale > 1) {
+            runs << benchmarkPipelines(files[i], scale, tempDir.path());
+        }
+    }
+
+    const long peakRSS = Profiles::getPeakRSS();
+    std::cout << "peak RSS: " << peakRSS << " KB\n";
+
+    const QString json = QString("{\n  \"peak_rss_kb\": %1,\n"
+                                 "  \"runs\": [\n%2\n  ]\n}\n")
+        .arg(peakRSS).arg(runs.join(",\n"));
+
+    if (jsonFile != "") {
+        QFile out(jsonFile);
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Text) ||
+            out.write(json.toUtf8()) < 0) {
+            std::cerr << "Error writing file: " << jsonFile << "\n";
+            exit(1);
+        }
+    }
+
+    exit(0);
+}
+
+// Segments playing at once in benchmarkPlayback(), about as many as
+// a large project has
+static const int playbackSegments = 200;
+
+// Fetch all of doc's events through a fresh set of mappers in slices
+// of the given length, as the sequencer does while playing, and return
+// the time taken in nanoseconds.
+static qint64 fetchInSlices(RosegardenDocument *doc, const RealTime &slice,
+                            CountingInserter &inserter, long &slices)
+{
+    Composition &composition = doc->getComposition();
+
+    SequenceManager sequenceManager;
+    sequenceManager.setDocument(doc);
+    sequenceManager.resetCompositionMapper();
+
+    MappedBufMetaIterator *metaIterator =
+        sequenceManager.makeTempMetaiterator();
+
+    const RealTime start =
+        composition.getElapsedRealTime(composition.getStartMarker());
+    const RealTime end =
+        composition.getElapsedRealTime(composition.getEndMarker());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    slices = 0;
+    metaIterator->jumpToTime(start);
+    for (RealTime t = start; t < end; t = t + slice) {
+        inserter.startSlice();
+        metaIterator->fetchEvents(inserter, t, t + slice);
+        ++slices;
+    }
+
+    const qint64 time = timer.nsecsElapsed();
+
+    delete metaIterator;
+
+    return time;
+}
+
+// Time fetching each file's events in playback-sized slices, with
+// copies of its MIDI segments stacked so that at least
+// playbackSegments play at once, and check that slicing neither loses
+// nor repeats events.
+static void benchmarkPlayback(const QStringList &args)
+{
+    if (args.size() < 3) usage();
+
+    bool allMatch = true;
+
+    for (int i = 2; i < args.size(); ++i) {
+
+        const QString &inFile = args[i];
+
+        qint64 openTime = 0;
+        RosegardenDocument *doc = openTimed(inFile, openTime);
+        Composition &composition = doc->getComposition();
+
+        std::vector<Segment *> originals;
+        for (Composition::iterator s = composition.begin();
+             s != composition.end(); ++s) {
+            if ((*s)->getType() == Segment::Internal) originals.push_back(*s);
+        }
+        if (originals.empty()) {
+            std::cout << inFile << ": no MIDI segments\n";
+            delete doc;
+            continue;
+        }
+
+        for (size_t copy = originals.size();
+             copy < size_t(playbackSegments); copy += originals.size()) {
+            for (size_t s = 0; s < originals.size(); ++s) {
+                composition.addSegment(originals[s]->clone(false));
+            }
+        }
+
+        std::cout << inFile << ": " << composition.getNbSegments()
+                  << " segments\n";
+
+        // One slice for the whole composition gives the events to
+        // expect
+        CountingInserter whole;
+        long slices = 0;
+        fetchInSlices(doc, RealTime(100000, 0), whole, slices);
+
+        static const int sliceLengthsMs[] = { 10, 100, 1000 };
+        for (size_t l = 0;
+             l < sizeof(sliceLengthsMs) / sizeof(sliceLengthsMs[0]); ++l) {
+
+            CountingInserter inserter;
+            const qint64 time = fetchInSlices
+                (doc, RealTime(0, sliceLengthsMs[l] * 1000000),
+                 inserter, slices);
+
+            const bool match = (inserter.getCount() == whole.getCount());
+            if (!match) allMatch = false;
+
+            std::cout << "  " << sliceLengthsMs[l] << " ms slices: "
+                      << slices << " slices, "
+                      << (slices > 0 ? time / slices / 1000 : 0)
+                      << " us per slice, " << inserter.getCount()
+                      << " events, " << inserter.getOutOfOrder()
+                      << " out of order"
+                      << (match ? "" : ", DIFFERS from one slice") << "\n";
+        }
+
+        delete doc;
+    }
+
+    exit(allMatch ? 0 : 1);
+}
+
+// Instruments metered by benchmarkMeters(), about as many as a large
+// studio has
+static const int meterInstruments = 128;
+static const InstrumentId meterInstrumentBase = 1000;
+
+// Sets the meters as fast as it can until told to stop, as the
+// sequencer would, with readings whose values are all the same so that
+// a torn one can be seen.
+class MeterWriter : public QRunnable
+{
+public:
+    MeterWriter(std::atomic<bool> &stop) :
+        m_stop(stop), m_count(0) { }
+
+    void run() override {
+        SequencerDataBlock *sdb = SequencerDataBlock::getInstance();
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            LevelInfo info;
+            info.level = info.levelRight = m_count % 128;
+            info.rms = info.rmsRight = m_count % 128;
+            sdb->setInstrumentLevel
+                (meterInstrumentBase + m_count % meterInstruments, info);
+            ++m_count;
+        }
+    }
+
+    long getCount() const { return m_count; }
+
+private:
+    std::atomic<bool> &m_stop;
+    long m_count;
+};
+
+// Time setting and reading the meters, alone and with the reader and
+// writer on different threads, and check that no reading is torn.
+static void benchmarkMeters()
+{
+    SequencerDataBlock *sdb = SequencerDataBlock::getInstance();
+    sdb->clearTemporaries();
+
+    const long sets = 10000000;
+    const int rounds = 100000;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (long i = 0; i < sets; ++i) {
+        LevelInfo info;
+        info.level = info.levelRight = i % 128;
+        info.rms = info.rmsRight = i % 128;
+        sdb->setInstrumentLevel(meterInstrumentBase + i % meterInstruments,
+                                info);
+    }
+
+    qint64 setTime = timer.nsecsElapsed();
+
+    // Every meter is changed, so every one is read
+    timer.restart();
+
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < meterInstruments; ++i) {
+            LevelInfo info;
+            info.level = round;
+            sdb->setInstrumentLevel(meterInstrumentBase + i, info);
+        }
+        for (int i = 0; i < meterInstruments; ++i) {
+            LevelInfo info;
+            sdb->getInstrumentLevelForMixer(meterInstrumentBase + i, info);
+        }
+    }
+
+    qint64 pollAllTime = timer.nsecsElapsed();
+
+    // A few meters are changed, and only those are read
+    timer.restart();
+
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            LevelInfo info;
+            info.level = round;
+            sdb->setInstrumentLevel(meterInstrumentBase + i, info);
+        }
+        std::set<InstrumentId> changed;
+        sdb->getChangedInstruments(SequencerDataBlock::MixerMeters, changed);
+        for (std::set<InstrumentId>::const_iterator i = changed.begin();
+             i != changed.end(); ++i) {
+            LevelInfo info;
+            sdb->getInstrumentLevelForMixer(*i, info);
+        }
+    }
+
+    qint64 pollChangedTime = timer.nsecsElapsed();
+
+    // The reader and writer at once, for a second
+    std::atomic<bool> stop(false);
+    MeterWriter *writer = new MeterWriter(stop);
+    writer->setAutoDelete(false);
+
+    QThreadPool pool;
+    pool.start(writer);
+
+    long reads = 0;
+    long torn = 0;
+
+    timer.restart();
+
+    while (timer.elapsed() < 1000) {
+        for (int i = 0; i < meterInstruments; ++i) {
+            LevelInfo info;
+            if (!sdb->getInstrumentLevelForMixer
+                (meterInstrumentBase + i, info)) continue;
+            ++reads;
+            if (info.levelRight != info.level ||
+                info.rms != info.level ||
+                info.rmsRight != info.level) ++torn;
+        }
+    }
+
+    stop.store(true);
+    pool.waitForDone();
+    long writes = writer->getCount();
+    delete writer;
+
+    sdb->clearTemporaries();
+
+    std::cout << "Metering " << meterInstruments << " instruments:\n"
+              << "  set:                       "
+              << double(setTime) / sets << " ns per meter\n"
+              << "  set and poll all:          "
+              << double(pollAllTime) / rounds / 1000.0 << " us per poll\n"
+              << "  set 4 and poll changed:    "
+              << double(pollChangedTime) / rounds / 1000.0 << " us per poll\n"
+              << "  writer and reader at once: "
+              << writes << " sets, " << reads << " changed readings, "
+              << torn << " torn\n";
+
+    exit(torn ? 1 : 0);
+}
+
+// Sends MIDI IN controller messages to MidiThread's callback, as
+// RtMidi would, numbering them in their data bytes.  With an interval,
+// it sends one every interval nanoseconds; without, as fast as it can.
+class MidiInFlooder : public QRunnable
+{
+public:
+    MidiInFlooder(int count, qint64 interval) :
+        m_count(count), m_interval(interval), m_callbackTime(0) { }
+
+    void run() override {
+        std::vector<unsigned char> message(3);
+        message[0] = 0xB0;
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 callbackTime = 0;
+
+        for (int i = 0; i < m_count; ++i) {
+            while (timer.nsecsElapsed() < i * m_interval) {
+                QThread::yieldCurrentThread();
+            }
+            message[1] = (i >> 7) & 0x7f;
+            message[2] = i & 0x7f;
+            const qint64 before = timer.nsecsElapsed();
+            MidiThread::midiInCallback(0, &message, nullptr);
+            callbackTime += timer.nsecsElapsed() - before;
+        }
+
+        m_callbackTime = callbackTime;
+    }
+
+    qint64 getCallbackTime() const { return m_callbackTime; }
+
+private:
+    int m_count;
+    qint64 m_interval;
+    qint64 m_callbackTime;
+};
+
+// Send count messages through the MIDI IN queue, polling it every
+// millisecond as the driver does, and check that every message comes
+// out, in order, or is counted as dropped.  If paced, none may be
+// dropped.
+static bool floodMidiIn(const char *name, int count, qint64 interval)
+{
+    MidiThread::setElapsedTime(0);
+    const int droppedBefore = MidiThread::getDroppedMidiIn();
+
+    MidiInFlooder *flooder = new MidiInFlooder(count, interval);
+    flooder->setAutoDelete(false);
+
+    QThreadPool pool;
+    QElapsedTimer timer;
+    timer.start();
+    pool.start(flooder);
+
+    long received = 0;
+    int last = -1;
+    bool inOrder = true;
+    RealTime lastTime = RealTime::zeroTime;
+    bool done = false;
+
+    while (!done) {
+        // Once the flooder has finished, one more poll empties the queue
+        done = pool.waitForDone(1);
+        MappedEventList events = MidiThread::getReturnComposition();
+        for (MappedEventListIterator i = events.begin();
+             i != events.end(); ++i) {
+            const int number = (*i)->getData1() * 128 + (*i)->getData2();
+            if ((*i)->getEventTime() < lastTime) inOrder = false;
+            if (interval > 0 && number != (last + 1) % 16384) inOrder = false;
+            last = number;
+            lastTime = (*i)->getEventTime();
+            ++received;
+        }
+    }
+
+    const qint64 time = timer.nsecsElapsed();
+    const int dropped = MidiThread::getDroppedMidiIn() - droppedBefore;
+    const bool ok = inOrder && received + dropped == count &&
+                    (interval == 0 || dropped == 0);
+
+    std::cout << name << ": " << count << " messages in "
+              << time / 1000000 << " ms, "
+              << flooder->getCallbackTime() / count << " ns per callback, "
+              << received << " received, " << dropped << " dropped, "
+              << (ok ? "correct" : "WRONG") << "\n";
+
+    delete flooder;
+
+    return ok;
+}
+
+// Feed MIDI IN at 10,000 messages a second, then as fast as possible.
+static void benchmarkMidiIn()
+{
+    bool ok = floodMidiIn("10k/s", 10000, 100000);
+    ok = floodMidiIn("flood", 1000000, 0) && ok;
+
+    exit(ok ? 0 : 1);
+}
+
+// Times each score is repainted by benchmarkGlyphs(), as when scrolling
+static const int glyphRepaints = 10;
+
+// Lay out each file given, or each example if none is, as the notation
+// editor would, and gather the parameters of every note it renders.
+static std::vector<NotePixmapParameters>
+scoreNotes(const QStringList &args)
+{
+    QStringList files;
+    for (int i = 2; i < args.size(); ++i) {
+        if (args[i].startsWith("-")) usage();
+        files << args[i];
+    }
+    if (files.empty()) files = exampleFiles();
+
+    std::vector<NotePixmapParameters> notes;
+
+    for (int f = 0; f < files.size(); ++f) {
+
+        qint64 openTime = 0;
+        RosegardenDocument *doc = openTimed(files[f], openTime);
+        Composition &composition = doc->getComposition();
+        LazySegmentLoader::loadAll(composition);
+
+        std::vector<Segment *> segments;
+        for (Composition::iterator i = composition.begin();
+             i != composition.end(); ++i) {
+            if ((*i)->getType() != Segment::Internal) continue;
+            (*i)->enforceBeginWithClefAndKey();
+            segments.push_back(*i);
+        }
+
+        // As in benchmarkPipelines()
+        NotationScene *scene = new NotationScene();
+        scene->suspendLayoutUpdates();
+        scene->setStaffs(doc, segments);
+        scene->setPageMode(StaffLayout::MultiPageMode);
+        scene->resumeLayoutUpdates();
+
+        const size_t before = notes.size();
+        const QList<QGraphicsItem *> items = scene->items();
+        for (int i = 0; i < items.size(); ++i) {
+            const NoteItem *item = dynamic_cast<const NoteItem *>(items[i]);
+            if (item) notes.push_back(item->getParameters());
+        }
+
+        std::cout << files[f] << ": " << notes.size() - before
+                  << " notes\n";
+
+        delete scene;
+        delete doc;
+    }
+
+    return notes;
+}
+
+// Paint the notes of the example scores, with the stems, flags,
+// accidentals, dots and leger lines the layout gave them, first drawing
+// every note and then blitting them from the glyph cache, and check
+// that both paint the same.
+static void benchmarkGlyphs(const QStringList &args)
+{
+    const std::vector<NotePixmapParameters> notes = scoreNotes(args);
+    const int glyphNotes = int(notes.size());
+
+    if (glyphNotes == 0) {
+        std::cerr << "No notes to paint\n";
+        exit(1);
+    }
+
+    NotePixmapFactory factory;
+
+    std::vector<NoteItemDimensions> dimensions(glyphNotes);
+    std::vector<QByteArray> keys(glyphNotes);
+
+    for (int i = 0; i < glyphNotes; ++i) {
+        factory.getNoteDimensions(notes[i], dimensions[i]);
+    }
+
+    QImage drawn(1000, 1000, QImage::Format_ARGB32_Premultiplied);
+    QImage blitted(1000, 1000, QImage::Format_ARGB32_Premultiplied);
+
+    // Each repaint puts the notes on a 40 by 25 grid, drawing the
+    // last page of them into the image for comparison
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int pass = 0; pass < glyphRepaints; ++pass) {
+        drawn.fill(Qt::transparent);
+        QPainter painter(&drawn);
+        for (int i = 0; i < glyphNotes; ++i) {
+            painter.save();
+            painter.translate((i % 40) * 25 + 10, (i / 40 % 25) * 40 + 20);
+            factory.drawNoteForItem(notes[i], dimensions[i],
+                                    NoteItem::DrawNormal, &painter);
+            painter.restore();
+        }
+    }
+
+    qint64 drawTime = timer.nsecsElapsed();
+
+    NoteGlyphCache *cache = NoteGlyphCache::getInstance();
+    cache->clear();
+
+    qint64 firstBlitTime = 0;
+    timer.restart();
+
+    for (int pass = 0; pass < glyphRepaints; ++pass) {
+        blitted.fill(Qt::transparent);
+        QPainter painter(&blitted);
+        for (int i = 0; i < glyphNotes; ++i) {
+            if (keys[i].isEmpty()) keys[i] = factory.getNoteGlyphKey(notes[i]);
+            painter.save();
+            painter.translate((i % 40) * 25 + 10, (i / 40 % 25) * 40 + 20);
+            factory.drawNoteGlyph(notes[i], dimensions[i], keys[i], &painter);
+            painter.restore();
+        }
+        if (pass == 0) firstBlitTime = timer.nsecsElapsed();
+    }
+
+    qint64 blitTime = timer.nsecsElapsed();
+
+    const int hits = cache->getHits();
+    const int misses = cache->getMisses();
+
+    // Allow for the glyph having been drawn onto a transparent pixmap
+    // and then composed, rather than drawn straight onto the page
+    long differing = 0;
+    for (int y = 0; y < drawn.height(); ++y) {
+        const QRgb *a = reinterpret_cast<const QRgb *>(drawn.constScanLine(y));
+        const QRgb *b = reinterpret_cast<const QRgb *>(blitted.constScanLine(y));
+        for (int x = 0; x < drawn.width(); ++x) {
+            if (abs(qAlpha(a[x]) - qAlpha(b[x])) > 2 ||
+                abs(qRed(a[x]) - qRed(b[x])) > 2 ||
+                abs(qGreen(a[x]) - qGreen(b[x])) > 2 ||
+                abs(qBlue(a[x]) - qBlue(b[x])) > 2) ++differing;
+        }
+    }
+
+    const double paints = double(glyphNotes) * glyphRepaints;
+
+    std::cout << "Painting " << glyphNotes << " notes "
+              << glyphRepaints << " times:\n"
+              << "  draw every note:    "
+              << drawTime / paints / 1000.0 << " us per note\n"
+              << "  blit from cache:    "
+              << blitTime / paints / 1000.0 << " us per note, first paint "
+              << firstBlitTime / double(glyphNotes) / 1000.0
+              << " us per note\n"
+              << "  cache:              " << misses << " glyphs rendered, "
+              << hits << " hits, hit rate "
+              << (hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0)
+              << "%\n"
+              << "  compared with draw: " << differing
+              << " pixels differ\n";
+
+    cache->clear();
+
+    exit(differing ? 1 : 0);
+}
+
+// Events in the segment built by benchmarkSegment()
+static const int segmentEvents = 1000000;
+
+// Time inserting notes at random times into a segment, finding times
+// in it, and scanning it in order, and check that the order and every
+// findTime() result are right.
+static void benchmarkSegment()
+{
+    std::vector<timeT> times(segmentEvents);
+    unsigned int r = 1;
+    for (int i = 0; i < segmentEvents; ++i) {
+        r = r * 1103515245 + 12345;
+        times[i] = timeT(r >> 4) % (timeT(segmentEvents) * 240);
+    }
+
+    Segment *segment = new Segment();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < segmentEvents; ++i) {
+        segment->insert(new Event(Note::EventType, times[i], 240));
+    }
+    const qint64 insertTime = timer.nsecsElapsed();
+
+    bool ok = (int(segment->size()) == segmentEvents);
+
+    // Ordering only reads the absolute time and sub-ordering
+    timer.start();
+    timeT previous = segment->getStartTime();
+    for (Segment::iterator i = segment->begin(); i != segment->end(); ++i) {
+        if ((*i)->getAbsoluteTime() < previous) ok = false;
+        previous = (*i)->getAbsoluteTime();
+    }
+    const qint64 scanTime = timer.nsecsElapsed();
+
+    // Durations are only in the event data
+    timer.start();
+    timeT total = 0;
+    for (Segment::iterator i = segment->begin(); i != segment->end(); ++i) {
+        total += (*i)->getDuration();
+    }
+    const qint64 dataScanTime = timer.nsecsElapsed();
+    if (total != timeT(segmentEvents) * 240) ok = false;
+
+    std::sort(times.begin(), times.end());
+
+    timer.start();
+    for (int i = 0; i < segmentEvents; ++i) {
+        r = r * 1103515245 + 12345;
+        const timeT t = timeT(r >> 4) % (timeT(segmentEvents) * 240);
+        Segment::iterator found = segment->findTime(t);
+        const std::vector<timeT>::iterator expected =
+            std::lower_bound(times.begin(), times.end(), t);
+        if (expected == times.end() ?
+                found != segment->end() :
+                found == segment->end() ||
+                (*found)->getAbsoluteTime() != *expected) {
+            ok = false;
+        }
+    }
+    const qint64 findTime = timer.nsecsElapsed();
+
+    delete segment;
+
+    std::cout << segmentEvents << " events:\n"
+              << "  insert:            " << insertTime / segmentEvents
+              << " ns per event\n"
+              << "  scan times:        " << scanTime / segmentEvents
+              << " ns per event\n"
+              << "  scan durations:    " << dataScanTime / segmentEvents
+              << " ns per event\n"
+              << "  findTime + check:  " << findTime / segmentEvents
+              << " ns per call\n"
+              << "  order and lookups: " << (ok ? "correct" : "WRONG") << "\n";
+
+    exit(ok ? 0 : 1);
+}
+
+// Least-squares fit of a sine of the given frequency (and any DC) to
+// samples [from, to) of signal, returning the ratio in dB of the
+// fitted sine's power to that of what is left over.
+static double sineToResidualDb(const std::vector<float> &signal,
+                               double frequency, double rate,
+                               size_t from, size_t to)
+{
+    double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0;
+    double x1 = 0, s1 = 0, c1 = 0;
+    const double n = double(to - from);
+
+    for (size_t i = from; i < to; ++i) {
+        const double w = 2.0 * M_PI * frequency * double(i) / rate;
+        const double s = sin(w), c = cos(w), x = signal[i];
+        ss += s * s; cc += c * c; sc += s * c;
+        xs += x * s; xc += x * c;
+        x1 += x; s1 += s; c1 += c;
+    }
+
+    // Remove the mean first, then solve the 2x2 normal equations
+    ss -= s1 * s1 / n; cc -= c1 * c1 / n; sc -= s1 * c1 / n;
+    xs -= x1 * s1 / n; xc -= x1 * c1 / n;
+
+    const double det = ss * cc - sc * sc;
+    const double a = (xs * cc - xc * sc) / det;
+    const double b = (xc * ss - xs * sc) / det;
+    const double mean = (x1 - a * s1 - b * c1) / n;
+
+    double fitted = 0, residual = 0;
+    for (size_t i = from; i < to; ++i) {
+        const double w = 2.0 * M_PI * frequency * double(i) / rate;
+        const double y = a * sin(w) + b * cos(w);
+        const double e = double(signal[i]) - y - mean;
+        fitted += y * y;
+        residual += e * e;
+    }
+
+    if (residual <= 0) return 200.0;
+    return 10.0 * log10(fitted / residual);
+}
+
+// Resample a whole signal in blocks, as PlayableAudioFile does
+static std::vector<float> resampleAll(Resampler::Quality quality,
+                                      const std::vector<float> &in,
+                                      float ratio)
+{
+    const int block = 1024;
+    Resampler resampler(quality, 1, block);
+
+    std::vector<float> out;
+    std::vector<float> buffer;
+
+    for (size_t i = 0; i < in.size(); i += block) {
+        const int count = int(std::min(in.size() - i, size_t(block)));
+        const bool final = (i + block >= in.size());
+        buffer.resize(resampler.getOutputSize(count, ratio, final));
+        const float *inp = &in[i];
+        float *outp = &buffer[0];
+        const int got = resampler.resample(&inp, &outp, count, ratio, final);
+        out.insert(out.end(), buffer.begin(), buffer.begin() + got);
+    }
+
+    return out;
+}
+
+// Measure each resampler quality converting between the common rates:
+// how faithfully it reproduces sines within the band, how well it
+// rejects sines that would alias when downsampling, and how fast it
+// runs.  Fails if Best is not clean to 90dB within the band, or if
+// any quality loses frames at the end of the signal.
+static void benchmarkResampler()
+{
+    static const Resampler::Quality qualities[] = {
+        Resampler::Best, Resampler::FastestTolerable, Resampler::Fastest
+    };
+    static const char *const qualityNames[] = {
+        "Best", "FastestTolerable", "Fastest"
+    };
+    static const int rates[][2] = {
+        { 44100, 48000 }, { 48000, 44100 }, { 44100, 96000 },
+        { 96000, 44100 }, { 44100, 44117 }
+    };
+    const int rateCount = sizeof(rates) / sizeof(rates[0]);
+
+    const double seconds = 2.0;
+    bool ok = true;
+
+    for (int q = 0; q < 3; ++q) {
+
+        std::cout << qualityNames[q] << ":\n";
+
+        for (int r = 0; r < rateCount; ++r) {
+
+            const double inRate = rates[r][0];
+            const double outRate = rates[r][1];
+            const float ratio = float(outRate / inRate);
+            const double nyquist = std::min(inRate, outRate) / 2.0;
+
+            // The resampler converts exactly to outRate if the ratio is
+            // a simple fraction, and otherwise to the ratio as rounded
+            // to a float, which drifts by enough to show at 16 bits
+            const double roundedOutRate = inRate * double(ratio);
+            const size_t frames = size_t(inRate * seconds);
+
+            // Sines at 1kHz and at 80% of the lower Nyquist frequency,
+            // compared with ideal sines at the output rate, skipping
+            // the ends where the filter is filling and emptying
+            double db[2];
+            const double frequencies[] = { 1000.0, nyquist * 0.8 };
+            size_t outFrames = 0;
+
+            for (int f = 0; f < 2; ++f) {
+                std::vector<float> in(frames);
+                for (size_t i = 0; i < frames; ++i) {
+                    in[i] = 0.5f * float(sin(2.0 * M_PI * frequencies[f] *
+                                             double(i) / inRate));
+                }
+                std::vector<float> out = resampleAll(qualities[q], in, ratio);
+                outFrames = out.size();
+                const size_t margin = out.size() / 10;
+                db[f] = std::max
+                    (sineToResidualDb(out, frequencies[f], outRate,
+                                      margin, out.size() - margin),
+                     sineToResidualDb(out, frequencies[f], roundedOutRate,
+                                      margin, out.size() - margin));
+            }
+
+            // When downsampling, a sine between the output and input
+            // Nyquist frequencies should come out as near silence
+            double rejectionDb = 0.0;
+            if (outRate < inRate) {
+                const double frequency = (nyquist + inRate / 2.0) / 2.0;
+                std::vector<float> in(frames);
+                for (size_t i = 0; i < frames; ++i) {
+                    in[i] = 0.5f * float(sin(2.0 * M_PI * frequency *
+                                             double(i) / inRate));
+                }
+                std::vector<float> out = resampleAll(qualities[q], in, ratio);
+                const size_t margin = out.size() / 10;
+                double power = 0.0;
+                for (size_t i = margin; i < out.size() - margin; ++i) {
+                    power += double(out[i]) * double(out[i]);
+                }
+                power /= double(out.size() - 2 * margin);
+                rejectionDb = (power > 0 ? 10.0 * log10(0.125 / power) : 200.0);
+            }
+
+            // Throughput, for ten seconds of stereo noise
+            const int block = 1024;
+            const int channels = 2;
+            std::vector<float> noise(block * channels);
+            unsigned int seed = 1;
+            for (size_t i = 0; i < noise.size(); ++i) {
+                seed = seed * 1103515245 + 12345;
+                noise[i] = float(int(seed >> 16) % 2001 - 1000) / 1000.f;
+            }
+            std::vector<float> output((int(block * ratio) + 64) * channels);
+            const float *inputs[] = { &noise[0], &noise[block] };
+            float *outputs[] = { &output[0], &output[output.size() / 2] };
+
+            Resampler resampler(qualities[q], channels, block);
+            const int blocks = int(inRate * 10.0) / block;
+
+            QElapsedTimer timer;
+            timer.start();
+            for (int b = 0; b < blocks; ++b) {
+                resampler.resample(inputs, outputs, block, ratio);
+            }
+            const qint64 nsecs = std::max(timer.nsecsElapsed(), qint64(1));
+            const double realtime = 10.0e9 / double(nsecs);
+
+            std::cout << "  " << rates[r][0] << " -> " << rates[r][1]
+                      << ": sine to error " << db[0] << " dB at 1kHz, "
+                      << db[1] << " dB at " << int(frequencies[1]) << "Hz";
+            if (outRate < inRate) {
+                std::cout << ", alias rejection " << rejectionDb << " dB";
+            }
+            std::cout << ", " << realtime << "x realtime stereo\n";
+
+            // The final block must flush the tail held back by the filter
+            const double expectedFrames = double(frames) * double(ratio);
+            if (fabs(double(outFrames) - expectedFrames) > 1.0) {
+                std::cout << "    wrote " << outFrames << " frames, expected "
+                          << expectedFrames << "\n";
+                ok = false;
+            }
+
+            if (qualities[q] == Resampler::Best &&
+                (db[0] < 90.0 || db[1] < 90.0)) ok = false;
+        }
+    }
+
+    exit(ok ? 0 : 1);
+}
+
+bool
+Benchmarks::isBenchmarkOption(const QString &option)
+{
+    return option == "--benchmark" || option.startsWith("--benchmark-");
+}
+
+void
+Benchmarks::run(const QString &option, const QStringList &args)
+{
+    if (option == "--benchmark") benchmark(args);
+    else if (option == "--benchmark-snapshot") benchmarkSnapshot(args);
+    else if (option == "--benchmark-load") benchmarkLoad(args);
+    else if (option == "--benchmark-playback") benchmarkPlayback(args);
+    else if (option == "--benchmark-meters") benchmarkMeters();
+    else if (option == "--benchmark-midi-in") benchmarkMidiIn();
+    else if (option == "--benchmark-glyphs") benchmarkGlyphs(args);
+    else if (option == "--benchmark-segment") benchmarkSegment();
+    else if (option == "--benchmark-resampler") benchmarkResampler();
+    else usage();
+}
+
+
+}
@@ -0,0 +1,50 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+    See the AUTHORS file for more details.
+ 
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_BENCHMARKS_H
+#define RG_BENCHMARKS_H
+
+#include <QString>
+#include <QStringList>
+
+namespace Rosegarden
+{
+
+
+/**
+ * The headless --benchmark modes, which time the main pipelines and
+ * check their results without opening a window.  They are only built
+ * into the rosegarden-benchmarks binary, made by running qmake with
+ * CONFIG+=benchmarks, and not into the application that ships.
+ *
+ * Each mode exits when done, with status 0 if its checks passed.
+ */
+class Benchmarks
+{
+public:
+    /// Whether option names one of the modes
+    static bool isBenchmarkOption(const QString &option);
+
+    /// Run the mode named by option, with the whole command line
+    static void run(const QString &option, const QStringList &args);
+
+    /// Print the modes' command lines to stderr, for usage()
+    static void printUsage();
+};
+
+
+}
+
+#endif
@@ -43,6 +43,7 @@
 #include "commands/segment/AudioSegmentInsertCommand.h"
 #include "commands/segment/SegmentSingleRepeatToCopyCommand.h"
 #include "document/CommandHistory.h"
+#include "document/LazySegmentLoader.h"
 #include "document/RosegardenDocument.h"
 #include "RosegardenApplication.h"
 #include "gui/configuration/GeneralConfigurationPage.h"
@@ -406,6 +407,8 @@ void RosegardenMainViewWidget::slotEditSegmentsNotation(std::vector<Segment *> s
 NotationView *
 RosegardenMainViewWidget::createNotationView(std::vector<Segment *> segmentsToEdit)
 {
+    LazySegmentLoader::loadSegments(segmentsToEdit);
+
     NotationView *notationView =
         new NotationView(getDocument(), segmentsToEdit, this);
 
@@ -558,6 +561,8 @@ void RosegardenMainViewWidget::slotEditSegmentsPitchTracker(std::vector<Segment
 PitchTrackerView *
 RosegardenMainViewWidget::createPitchTrackerView(std::vector<Segment *> segmentsToEdit)
 {
+    LazySegmentLoader::loadSegments(segmentsToEdit);
+
     PitchTrackerView *pitchTrackerView =
         new PitchTrackerView(getDocument(), segmentsToEdit, this);
 
@@ -757,6 +762,8 @@ void RosegardenMainViewWidget::slotEditSegmentsPercussionMatrix(std::vector<Segm
 MatrixView *
 RosegardenMainViewWidget::createMatrixView(std::vector<Segment *> segmentsToEdit, bool drumMode)
 {
+    LazySegmentLoader::loadSegments(segmentsToEdit);
+
     MatrixView *matrixView = new MatrixView(getDocument(),
                                                   segmentsToEdit,
                                                   drumMode,
@@ -1219,6 +1226,12 @@ RosegardenMainViewWidget::updateMeters()
         i->second = unknownState;
     }
 
+    // Only the instruments whose meters have been set need be read
+    std::set<InstrumentId> changed;
+    SequencerDataBlock::getInstance()->getChangedInstruments
+        (SequencerDataBlock::TrackMeters, changed);
+    if (changed.empty()) return;
+
     for (Composition::trackcontainer::iterator i =
              getDocument()->getComposition().getTracks().begin();
          i != getDocument()->getComposition().getTracks().end(); ++i) {
@@ -1227,6 +1240,7 @@ RosegardenMainViewWidget::updateMeters()
         if (!track) continue;
 
         InstrumentId instrumentId = track->getInstrument();
+        if (!changed.count(instrumentId)) continue;
 
         if (states[instrumentId] == unknownState) {
             bool isNew =
@@ -2053,6 +2067,8 @@ RosegardenMainViewWidget::initChordNameRuler()
 EventView *
 RosegardenMainViewWidget::createEventView(std::vector<Segment *> segmentsToEdit)
 {
+    LazySegmentLoader::loadSegments(segmentsToEdit);
+
     EventView *eventView = new EventView(getDocument(),
                                          segmentsToEdit,
                                          this);
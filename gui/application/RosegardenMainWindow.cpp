@@ -43,6 +43,7 @@
 #include "base/Selection.h"
 #include "base/Studio.h"
 #include "base/Track.h"
+#include "commands/edit/BatchQuantizeCommand.h"
 #include "commands/edit/CopyCommand.h"
 #include "commands/edit/CutCommand.h"
 #include "commands/edit/EventQuantizeCommand.h"
@@ -91,6 +92,7 @@
 #include "document/io/MusicXMLLoader.h"
 #include "document/io/LilyPondExporter.h"
 #include "document/CommandHistory.h"
+#include "document/LazySegmentLoader.h"
 #include "document/io/RG21Loader.h"
 #include "document/io/MupExporter.h"
 #include "document/io/MusicXmlExporter.h"
@@ -1372,7 +1374,7 @@ RosegardenMainWindow::createDocument(
 
         if (extension == "mid"  ||  extension == "midi")
             importType = ImportMIDI;
-        else if (extension == "rg"  ||  extension == "rgt")
+        else if (extension == "rg"  ||  extension == "rgt"  ||  extension == "rgs")
             importType = ImportRG4;
         else if (extension == "rgd")
             importType = ImportRGD;
@@ -1831,8 +1833,8 @@ RosegardenMainWindow::openFileDialogAt(QString target)
 
     // Launch the Open File dialog.
     QString fname = FileDialog::getOpenFileName(this, tr("Open File"), directory,
-                    tr("All supported files") + " (*.rg *.RG *.rgt *.RGT *.rgp *.RGP *.mid *.MID *.midi *.MIDI)" + ";;" +
-                    tr("Rosegarden files") + " (*.rg *.RG *.rgp *.RGP *.rgt *.RGT)" + ";;" +
+                    tr("All supported files") + " (*.rg *.RG *.rgs *.RGS *.rgt *.RGT *.rgp *.RGP *.mid *.MID *.midi *.MIDI)" + ";;" +
+                    tr("Rosegarden files") + " (*.rg *.RG *.rgs *.RGS *.rgp *.RGP *.rgt *.RGT)" + ";;" +
                     tr("MIDI files") + " (*.mid *.MID *.midi *.MIDI)" + ";;" +
                     tr("All files") + " (*)", nullptr, nullptr);
 
@@ -2100,8 +2102,15 @@ RosegardenMainWindow::slotFileSaveAs(bool asTemplate)
     QString fileExtension(asTemplate ? " (*.rgt *.RGT)" : " (*.rg *.RG)");
     QString dialogMessage(asTemplate ? tr("Save as template...") : tr("Save as..."));
 
+    // Snapshots save and load faster, but are not compressed and
+    // can only be read on machines of the same byte order
+    QString snapshotType;
+    if (!asTemplate)
+        snapshotType = tr("Rosegarden snapshots") + " (*.rgs *.RGS)" + ";;";
+
     QString newName = getValidWriteFileName
                       (fileType + fileExtension + ";;" +
+                       snapshotType +
                        tr("All files") + " (*)",
                        dialogMessage);
     if (newName.isEmpty())
@@ -2359,7 +2368,8 @@ RosegardenMainWindow::slotQuantizeSelection()
 
     SegmentSelection selection = m_view->getSelection();
 
-    MacroCommand *command = new MacroCommand
+    // Quantized together, so that the work can be shared out
+    BatchQuantizeCommand *command = new BatchQuantizeCommand
                              (EventQuantizeCommand::getGlobalName());
 
     for (SegmentSelection::iterator i = selection.begin();
@@ -2382,7 +2392,8 @@ RosegardenMainWindow::slotRepeatQuantizeSelection()
 
     SegmentSelection selection = m_view->getSelection();
 
-    MacroCommand *command = new MacroCommand
+    // Quantized together, so that the work can be shared out
+    BatchQuantizeCommand *command = new BatchQuantizeCommand
                              (EventQuantizeCommand::getGlobalName());
 
     for (SegmentSelection::iterator i = selection.begin();
@@ -5031,6 +5042,8 @@ RosegardenMainWindow::slotExportMIDI()
 void
 RosegardenMainWindow::exportMIDIFile(QString file)
 {
+    LazySegmentLoader::loadAll(m_doc->getComposition());
+
     // Progress Dialog
     QProgressDialog progressDialog(
             tr("Exporting MIDI file..."),  // labelText
@@ -5077,6 +5090,8 @@ RosegardenMainWindow::slotExportCsound()
 void
 RosegardenMainWindow::exportCsoundFile(QString file)
 {
+    LazySegmentLoader::loadAll(m_doc->getComposition());
+
     // Progress Dialog
     // ??? The Csound export process is so fast, this never has a
     //     chance to appear.  Even with a huge composition.  I'm
@@ -5129,6 +5144,8 @@ RosegardenMainWindow::slotExportMup()
 void
 RosegardenMainWindow::exportMupFile(QString file)
 {
+    LazySegmentLoader::loadAll(m_doc->getComposition());
+
     // Progress Dialog
     QProgressDialog progressDialog(
             tr("Exporting Mup file..."),  // labelText
@@ -5245,6 +5262,8 @@ RosegardenMainWindow::exportLilyPondFile(QString file, bool forPreview)
     if (dialog.exec() != QDialog::Accepted)
         return false;
 
+    LazySegmentLoader::loadAll(m_doc->getComposition());
+
     // Progress Dialog
     QProgressDialog progressDialog(
             tr("Exporting LilyPond file..."),  // labelText
@@ -5305,6 +5324,8 @@ RosegardenMainWindow::exportMusicXmlFile(QString file)
     if (dialog.exec() != QDialog::Accepted)
         return;
 
+    LazySegmentLoader::loadAll(m_doc->getComposition());
+
     // Progress Dialog
     // Note: Label text will be set later in the process.
     QProgressDialog progressDialog(
@@ -7946,7 +7967,7 @@ RosegardenMainWindow::slotImportStudio()
     QString directory = settings.value("import_studio", ResourceFinder().getResourceDir("library")).toString();
 
     const QString file = FileDialog::getOpenFileName(this, tr("Import Studio from File"), directory,
-                    tr("All supported files") + " (*.rg *.RG *.rgt *.RGT *.rgp *.RGP)" + ";;" +
+                    tr("All supported files") + " (*.rg *.RG *.rgs *.RGS *.rgt *.RGT *.rgp *.RGP)" + ";;" +
                     tr("All files") + " (*)", nullptr, nullptr);
 
     if (file.isEmpty())
@@ -20,11 +20,15 @@
 #include "misc/Debug.h"
 #include "gui/application/RosegardenMainWindow.h"
 #include "document/RosegardenDocument.h"
+#include "document/LazySegmentLoader.h"
 #include "gui/widgets/StartupLogo.h"
 #include "gui/general/ResourceFinder.h"
 #include "gui/general/IconLoader.h"
 #include "gui/general/ThornStyle.h"
 #include "gui/application/RosegardenApplication.h"
+#ifdef RG_BENCHMARKS
+#include "gui/application/Benchmarks.h"
+#endif
 #include "base/RealTime.h"
 
 #include "sound/MidiFile.h"
@@ -333,6 +337,9 @@ static void usage()
     std::cerr << "Rosegarden: A sequencer and musical notation editor\n";
     std::cerr << "Usage: rosegarden [--nosplash] [--nosound] [file.rg]\n";
     std::cerr << "       rosegarden --convert source.rg dest.mid\n";
+#ifdef RG_BENCHMARKS
+    Benchmarks::printUsage();
+#endif
     std::cerr << "       rosegarden --version\n";
     exit(2);
 }
@@ -363,6 +370,9 @@ static void convert(const QStringList &args)
         exit(1);
     }
 
+    // Archived tracks may have been left as shells
+    LazySegmentLoader::loadAll(doc.getComposition());
+
     MidiFile midiFile;
     ok = midiFile.convertToMidi(&doc, outFile);
     if (!ok) {
@@ -495,6 +505,10 @@ int main(int argc, char *argv[])
             if (args[i] == "--nosplash") nosplash = true;
             else if (args[i] == "--nosound") nosound = true;
             else if (args[i] == "--convert") convert(args);
+#ifdef RG_BENCHMARKS
+            else if (Benchmarks::isBenchmarkOption(args[i]))
+                Benchmarks::run(args[i], args);
+#endif
             else usage();
         } else {
             ++nonOptArgs;
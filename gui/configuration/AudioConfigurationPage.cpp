@@ -18,6 +18,7 @@
 
 #include "AudioConfigurationPage.h"
 
+#include "sound/AudioCache.h"
 #include "sound/Midi.h"
 #include "sound/SoundDriver.h"
 #include "misc/ConfigGroups.h"
@@ -109,6 +110,18 @@ AudioConfigurationPage::AudioConfigurationPage(
     layout->addWidget(m_audioRecFormat, row, 1, row- row+1, 2);
     ++row;
 
+    layout->addWidget(new QLabel(tr("Memory for short audio files (MB)"),
+                                 frame), row, 0);
+    m_audioCacheBudget = new QSpinBox(frame);
+    m_audioCacheBudget->setMinimum(0);
+    m_audioCacheBudget->setMaximum(4096);
+    m_audioCacheBudget->setValue(settings.value("audio_cache_budget",
+                                 AudioCache::DefaultBudgetMB).toInt());
+    m_audioCacheBudget->setToolTip(tr("How much decoded audio to keep for short audio files that are not playing, so that they need not be read again."));
+    connect(m_audioCacheBudget, SIGNAL(valueChanged(int)), this, SLOT(slotModified()));
+    layout->addWidget(m_audioCacheBudget, row, 1, 1, 2);
+    ++row;
+
     settings.endGroup();
 
 #endif
@@ -226,6 +239,11 @@ AudioConfigurationPage::apply()
     settings.setValue("connect_default_jack_outputs", m_connectDefaultAudioOutputs->isChecked());
     settings.setValue("connect_default_jack_inputs", m_connectDefaultAudioInputs->isChecked());
     settings.setValue("autostartjack", m_autoStartJackServer->isChecked());
+    settings.setValue("audio_cache_budget", m_audioCacheBudget->value());
+
+    // In megabytes
+    AudioCache::getInstance()->setBudget
+        (size_t(m_audioCacheBudget->value()) * 1024 * 1024);
 #endif
 
     settings.endGroup();
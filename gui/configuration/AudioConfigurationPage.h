@@ -88,6 +88,7 @@ protected:
     QCheckBox    *m_autoStartJackServer;
 
     QComboBox    *m_audioRecFormat;
+    QSpinBox     *m_audioCacheBudget;
 
 #endif // HAVE_LIBJACK
 
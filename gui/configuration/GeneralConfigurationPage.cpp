@@ -199,6 +199,69 @@ GeneralConfigurationPage::GeneralConfigurationPage(QWidget *parent) :
 
     ++row;
 
+    // Thin recorded controllers
+    label = new QLabel(tr("Thin recorded controllers"), frame);
+    tipText = tr(
+            "<qt><p>If checked, controller and pitch bend events that do "
+            "not change the value are removed when recording stops.  With a "
+            "tolerance or minimum interval set, small or closely spaced "
+            "changes are removed as well.</p></qt>");
+    label->setToolTip(tipText);
+    layout->addWidget(label, row, 0);
+
+    m_thinRecordedControllers = new QCheckBox(frame);
+    m_thinRecordedControllers->setToolTip(tipText);
+    m_thinRecordedControllers->setChecked(
+            settings.value("thin_recorded_controllers", false).toBool());
+    connect(m_thinRecordedControllers, &QCheckBox::stateChanged,
+            this, &GeneralConfigurationPage::slotModified);
+    layout->addWidget(m_thinRecordedControllers, row, 1, 1, 2);
+
+    ++row;
+
+    // Controller thinning interval
+    label = new QLabel(tr("Controller thinning interval"), frame);
+    tipText = tr(
+            "<qt><p>The minimum time between controller or pitch bend "
+            "events kept when thinning recorded controllers or generating "
+            "pitch bend sequences.  960 ticks make a quarter note.</p></qt>");
+    label->setToolTip(tipText);
+    layout->addWidget(label, row, 0);
+
+    m_controllerThinInterval = new QSpinBox(frame);
+    m_controllerThinInterval->setToolTip(tipText);
+    m_controllerThinInterval->setMinimum(0);
+    m_controllerThinInterval->setMaximum(960);
+    m_controllerThinInterval->setSuffix(tr(" ticks"));
+    m_controllerThinInterval->setSpecialValueText(tr("Off"));
+    m_controllerThinInterval->setValue(
+            settings.value("controller_thin_interval", 0).toInt());
+    connect(m_controllerThinInterval, SIGNAL(valueChanged(int)),
+            this, SLOT(slotModified()));
+    layout->addWidget(m_controllerThinInterval, row, 1, 1, 2);
+
+    ++row;
+
+    // Read archived segments lazily
+    label = new QLabel(tr("Read archived segments when needed"), frame);
+    tipText = tr(
+            "<qt><p>If checked, the events of segments on archived tracks "
+            "are not read until a segment is opened, changed or exported, "
+            "which makes large files quicker to open.  Takes effect the "
+            "next time a file is opened.</p></qt>");
+    label->setToolTip(tipText);
+    layout->addWidget(label, row, 0);
+
+    m_lazyArchivedSegments = new QCheckBox(frame);
+    m_lazyArchivedSegments->setToolTip(tipText);
+    m_lazyArchivedSegments->setChecked(
+            settings.value("lazy_archived_segments", false).toBool());
+    connect(m_lazyArchivedSegments, &QCheckBox::stateChanged,
+            this, &GeneralConfigurationPage::slotModified);
+    layout->addWidget(m_lazyArchivedSegments, row, 1, 1, 2);
+
+    ++row;
+
     settings.endGroup();
 
 #ifdef HAVE_LIBJACK
@@ -463,6 +526,12 @@ void GeneralConfigurationPage::apply()
     settings.setValue("usetrackname", m_useTrackName->isChecked());
     settings.setValue("enableEditingDuringPlayback",
             m_enableEditingDuringPlayback->isChecked());
+    settings.setValue("thin_recorded_controllers",
+            m_thinRecordedControllers->isChecked());
+    settings.setValue("controller_thin_interval",
+            m_controllerThinInterval->value());
+    settings.setValue("lazy_archived_segments",
+            m_lazyArchivedSegments->isChecked());
 
     settings.endGroup();
 
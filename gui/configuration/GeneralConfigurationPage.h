@@ -105,6 +105,9 @@ private:
     QCheckBox *m_appendSuffixes;
     QCheckBox *m_useTrackName;
     QCheckBox *m_enableEditingDuringPlayback;
+    QCheckBox *m_thinRecordedControllers;
+    QSpinBox *m_controllerThinInterval;
+    QCheckBox *m_lazyArchivedSegments;
     QCheckBox *m_useJackTransport;
 
     // Presentation tab
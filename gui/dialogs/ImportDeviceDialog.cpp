@@ -361,7 +361,7 @@ ImportDeviceDialog::importFromRG(QString fileName)
         MidiDevice *device = dynamic_cast<MidiDevice*>(*it);
 
         if (device) {
-            std::vector<MidiBank> banks = device->getBanks();
+            const BankList &banks = device->getBanks();
 
             // DMM - check for controllers too, because some users have
             // created .rgd files that contain only controllers
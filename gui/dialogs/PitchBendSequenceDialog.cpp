@@ -18,11 +18,13 @@
 
 #include "PitchBendSequenceDialog.h"
 #include "base/ControlParameter.h"
+#include "base/ControllerThinner.h"
 #include "base/MidiTypes.h"
 #include "base/RealTime.h"
 #include "base/Selection.h"
 #include "commands/edit/EventInsertionCommand.h"
 #include "commands/edit/EraseCommand.h"
+#include "commands/edit/ThinControllersCommand.h"
 #include "document/CommandHistory.h"
 #include "document/Command.h"
 #include "misc/ConfigGroups.h"
@@ -44,7 +46,9 @@
 #include <QDesktopServices>
 #include <QtGlobal>
 
+#include <algorithm>
 #include <cmath>
+#include <set>
 
 namespace Rosegarden
 {
@@ -782,12 +786,14 @@ PitchBendSequenceDialog::accept()
 
     // In Replace and OnlyAdd modes, add the requested controller events.
     if (getReplaceMode() != OnlyErase) {
+        std::vector<Event *> events;
         if ((getRampMode() == Linear) &&
             (getStepSizeCalculation() == StepSizeByCount)) {
-            addLinearCountedEvents(macro);
+            addLinearCountedEvents(events);
         } else {
-            addStepwiseEvents(macro);
+            addStepwiseEvents(events);
         }
+        insertEvents(macro, events);
     }
 
     CommandHistory::getInstance()->addCommand(macro);
@@ -821,7 +827,7 @@ PitchBendSequenceDialog::numVibratoCycles()
 }
 
 void
-PitchBendSequenceDialog::addLinearCountedEvents(MacroCommand *macro)
+PitchBendSequenceDialog::addLinearCountedEvents(std::vector<Event *> &events)
 {
     static const float pi = acos(0.0) * 2.0;
     
@@ -856,7 +862,7 @@ PitchBendSequenceDialog::addLinearCountedEvents(MacroCommand *macro)
     /* Always put an event at the start of the sequence.  */
     Event *event = m_control.newEvent(m_startTime, startValue);
     
-    macro->addCommand(new EventInsertionCommand (*m_segment, event));
+    events.push_back(event);
 
     for ( int i = 1 ; i < steps ; i++) {
         const timeT elapsedTime = (timeT) i * sequenceDuration/(timeT) steps;
@@ -880,7 +886,7 @@ PitchBendSequenceDialog::addLinearCountedEvents(MacroCommand *macro)
         value = value + int(amplitudeRatio * amplitude);
         value = m_control.clamp(value);
         Event *event = m_control.newEvent(eventTime, value);
-        macro->addCommand(new EventInsertionCommand (*m_segment, event));
+        events.push_back(event);
 
         /* Keep going if we are adding vibrato events, because those
            are inserted even after the ramp. */
@@ -892,7 +898,7 @@ PitchBendSequenceDialog::addLinearCountedEvents(MacroCommand *macro)
 }
 
 void
-PitchBendSequenceDialog::addStepwiseEvents(MacroCommand *macro)
+PitchBendSequenceDialog::addStepwiseEvents(std::vector<Event *> &events)
 {
     static const float pi = acos(0.0) * 2.0;
     // Needed when rampMode is logarithmic. 
@@ -946,7 +952,7 @@ PitchBendSequenceDialog::addStepwiseEvents(MacroCommand *macro)
     /* Always put an event at the start of the sequence.  */
     Event *event = m_control.newEvent(m_startTime, startValue);
     
-    macro->addCommand(new EventInsertionCommand (*m_segment, event));
+    events.push_back(event);
 
     // Remember the most recent value so we can avoid inserting it
     // twice.
@@ -1043,7 +1049,7 @@ PitchBendSequenceDialog::addStepwiseEvents(MacroCommand *macro)
 
             Event *event = m_control.newEvent(eventTime, value);
 
-            macro->addCommand(new EventInsertionCommand (*m_segment, event));
+            events.push_back(event);
             if (eventTime >= rampEndTime) { break; }
         }
     }
@@ -1053,8 +1059,40 @@ PitchBendSequenceDialog::addStepwiseEvents(MacroCommand *macro)
            are only writing into the time interval we were given.  */
         Event *finalEvent =
             m_control.newEvent(m_endTime - 1, endValue);
-        macro->addCommand(new EventInsertionCommand (*m_segment,
-                                                     finalEvent));
+        events.push_back(finalEvent);
+    }
+}
+
+// Comparison for sorting the generated events into time order
+static bool
+earlierEvent(const Event *a, const Event *b)
+{
+    return a->getAbsoluteTime() < b->getAbsoluteTime();
+}
+
+void
+PitchBendSequenceDialog::insertEvents(MacroCommand *macro,
+                                      std::vector<Event *> &events)
+{
+    // The steps already skip repeated values, so only thin them
+    // further if a tolerance or interval has been set.  Only the
+    // events made here are thinned, never ones already in the segment.
+    ControllerThinner thinner =
+        ThinControllersCommand::getConfiguredThinner();
+    std::vector<Event *> redundant;
+    if (thinner.isLossy()) {
+        std::stable_sort(events.begin(), events.end(), earlierEvent);
+        redundant = thinner.getRedundantEvents(events);
+    }
+    std::set<Event *> dropped(redundant.begin(), redundant.end());
+
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (dropped.find(events[i]) != dropped.end()) {
+            delete events[i];
+        } else {
+            macro->addCommand(new EventInsertionCommand (*m_segment,
+                                                         events[i]));
+        }
     }
 }
 
@@ -22,6 +22,8 @@
 
 #include "base/Event.h"
 
+#include <vector>
+
 class QComboBox;
 class QDoubleSpinBox;
 class QGroupBox;
@@ -121,10 +123,13 @@ protected:
     void savePreset(int preset);
     void restorePreset(int preset);
     
-    /** Methods filling the macrocommand with commands **/
+    /** Methods making the events and filling the macrocommand **/
 
-    void addLinearCountedEvents(MacroCommand *macro);
-    void addStepwiseEvents(MacroCommand *macro);
+    void addLinearCountedEvents(std::vector<Event *> &events);
+    void addStepwiseEvents(std::vector<Event *> &events);
+    // Thin the events made above as configured, and add commands to
+    // insert the rest.  Deletes the events that are not inserted.
+    void insertEvents(MacroCommand *macro, std::vector<Event *> &events);
 
     /**** Data members ****/
     
@@ -44,15 +44,23 @@ MatrixElement::MatrixElement(MatrixScene *scene, Event *event,
     m_scene(scene),
     m_drum(drum),
     m_current(true),
+    m_selected(false),
     m_item(nullptr),
-    m_pitchOffset(pitchOffset)
+    m_width(0),
+    m_velocity(0),
+    m_pitchOffset(pitchOffset),
+    m_x(0),
+    m_y(0),
+    m_itemWidth(0),
+    m_tied(false)
 {
     reconfigure();
 }
 
 MatrixElement::~MatrixElement()
 {
-    delete m_item;
+    hideItem();
+    m_scene->elementChanged();
 }
 
 void
@@ -105,78 +113,133 @@ MatrixElement::reconfigure(timeT time, timeT duration, int pitch, int velocity)
 
     // if the note has TIED_FORWARD or TIED_BACK properties, draw it with a
     // different fill pattern
-    bool tiedNote = (event()->has(BaseProperties::TIED_FORWARD) ||
-                     event()->has(BaseProperties::TIED_BACKWARD));
-    Qt::BrushStyle brushPattern = (tiedNote ? Qt::Dense2Pattern : Qt::SolidPattern);
+    m_tied = (event()->has(BaseProperties::TIED_FORWARD) ||
+              event()->has(BaseProperties::TIED_BACKWARD));
 
-    QColor colour;
     if (event()->has(BaseProperties::TRIGGER_SEGMENT_ID)) {
         //!!! Using gray for trigger events and events from other, non-active
         // segments won't work.  This should be handled some other way, with a
         // color outside the range of possible velocity choices, which probably
         // leaves some kind of curious light blue or something
-        colour = Qt::cyan;
+        m_colour = Qt::cyan;
     } else {
-        colour = DefaultVelocityColour::getInstance()->getColour(velocity);
+        m_colour = DefaultVelocityColour::getInstance()->getColour(velocity);
     }
-    colour.setAlpha(160);
+    m_colour.setAlpha(160);
 
+    m_itemWidth = m_width;
+    if (!m_drum && m_itemWidth < 1) {
+        x0 = std::max(0.0, x1 - 1);
+        m_itemWidth = 1;
+    }
+
+    setLayoutX(x0);
+    m_x = x0;
+
+    // set the Y position taking m_pitchOffset into account, subtracting the
+    // opposite of whatever the originating segment transpose was
+
+//    std::cout << "TRANSPOSITION TEST: event pitch: "
+//              << (pitch ) << " m_pitchOffset: " << m_pitchOffset
+//              << std::endl;
+
+    m_y = (127 - pitch - m_pitchOffset) * (resolution + 1);
+
+    if (m_item) {
+        updateItem();
+    } else if (m_scene->isInItemArea(getSceneRect())) {
+        showItem();
+    }
+
+    m_scene->elementChanged();
+}
+
+void
+MatrixElement::updateItem()
+{
+    if (!m_item) return;
+
+    int resolution = m_scene->getYResolution();
     double fres(resolution);
 
     if (m_drum) {
         fres = resolution + 1;
-        QGraphicsPolygonItem *item = dynamic_cast<QGraphicsPolygonItem *>(m_item);
-        if (!item) {
-            delete m_item;
-            item = new QGraphicsPolygonItem;
-            m_item = item;
-            m_scene->addItem(m_item);
-        }
         QPolygonF polygon;
         polygon << QPointF(0, 0)
                 << QPointF(fres/2, fres/2)
                 << QPointF(0, fres)
                 << QPointF(-fres/2, fres/2)
                 << QPointF(0, 0);
-        item->setPolygon(polygon);
-        item->setPen
-            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementBorder), 0));
-        item->setBrush(QBrush(colour, brushPattern));
+        static_cast<QGraphicsPolygonItem *>(m_item)->setPolygon(polygon);
     } else {
-        QGraphicsRectItem *item = dynamic_cast<QGraphicsRectItem *>(m_item);
-        if (!item) {
-            delete m_item;
-            item = new QGraphicsRectItem;
-            m_item = item;
-            m_scene->addItem(m_item);
-        }
-        float width = m_width;
-        if (width < 1) {
-            x0 = std::max(0.0, x1 - 1);
-            width = 1;
-        }
-        QRectF rect(0, 0, width, fres + 1);
-        item->setRect(rect);
-        item->setPen
-            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementBorder), 0));
-        item->setBrush(QBrush(colour, brushPattern));
+        QRectF rect(0, 0, m_itemWidth, fres + 1);
+        static_cast<QGraphicsRectItem *>(m_item)->setRect(rect);
     }
 
-    setLayoutX(x0);
+    if (m_current) {
+        m_item->setBrush(QBrush(m_colour,
+                                m_tied ? Qt::Dense2Pattern : Qt::SolidPattern));
+    } else {
+        m_item->setBrush(getColour());
+    }
+    m_item->setZValue(m_current ? 1 : 0);
+
+    if (m_selected) {
+        QPen pen(GUIPalette::getColour(GUIPalette::SelectedElement), 2,
+                 Qt::SolidLine, Qt::SquareCap, Qt::MiterJoin);
+        pen.setCosmetic(!m_drum);
+        m_item->setPen(pen);
+    } else if (m_current) {
+        m_item->setPen
+            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementBorder), 0));
+    } else {
+        m_item->setPen
+            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementLightBorder), 0));
+    }
 
     m_item->setData(MatrixElementData, QVariant::fromValue((void *)this));
 
-    // set the Y position taking m_pitchOffset into account, subtracting the
-    // opposite of whatever the originating segment transpose was
+    m_item->setPos(m_x, m_y);
 
-//    std::cout << "TRANSPOSITION TEST: event pitch: "
-//              << (pitch ) << " m_pitchOffset: " << m_pitchOffset
-//              << std::endl;
+    // set a tooltip explaining why this event is drawn in a different pattern
+    m_item->setToolTip(m_tied ?
+                       QObject::tr("This event is tied to another event.") :
+                       QString());
+}
 
-    m_item->setPos(x0, (127 - pitch - m_pitchOffset) * (resolution + 1));
+QRectF
+MatrixElement::getSceneRect() const
+{
+    double height = m_scene->getYResolution() + 1;
 
-    // set a tooltip explaining why this event is drawn in a different pattern
-    if (tiedNote) m_item->setToolTip(QObject::tr("This event is tied to another event."));
+    if (m_drum) {
+        return QRectF(m_x - height/2, m_y, height, height);
+    } else {
+        return QRectF(m_x, m_y, m_itemWidth, height);
+    }
+}
+
+QColor
+MatrixElement::getColour() const
+{
+    if (m_current) return m_colour;
+    return QColor(200, 200, 200);
+}
+
+void
+MatrixElement::showItem()
+{
+    if (m_item) return;
+    m_item = m_scene->acquireItem(this, m_drum);
+    updateItem();
+}
+
+void
+MatrixElement::hideItem()
+{
+    if (!m_item) return;
+    m_scene->releaseItem(this, m_item);
+    m_item = nullptr;
 }
 
 bool
@@ -188,56 +251,17 @@ MatrixElement::isNote() const
 void
 MatrixElement::setSelected(bool selected)
 {
-    QAbstractGraphicsShapeItem *item =
-        dynamic_cast<QAbstractGraphicsShapeItem *>(m_item);
-    if (!item) return;
-
-    if (selected) {
-        QPen pen(GUIPalette::getColour(GUIPalette::SelectedElement), 2,
-                 Qt::SolidLine, Qt::SquareCap, Qt::MiterJoin);
-        pen.setCosmetic(!m_drum);
-        item->setPen(pen);
-    } else {
-        item->setPen
-            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementBorder), 0));
-    }
+    m_selected = selected;
+    updateItem();
 }
 
 void
 MatrixElement::setCurrent(bool current)
 {
     if (m_current == current) return;
-
-    QAbstractGraphicsShapeItem *item =
-        dynamic_cast<QAbstractGraphicsShapeItem *>(m_item);
-    if (!item) return;
-
-    QColor colour;
-    
-    if (!current) {
-        colour = QColor(200, 200, 200);
-    } else {
-        if (event()->has(BaseProperties::TRIGGER_SEGMENT_ID)) {
-            colour = Qt::gray;
-        } else {
-            long velocity = 100;
-            event()->get<Int>(BaseProperties::VELOCITY, velocity);
-            colour = DefaultVelocityColour::getInstance()->getColour(velocity);
-        }
-    }
-
-    item->setBrush(colour);
-    item->setZValue(current ? 1 : 0);
-
-    if (current) {
-        item->setPen
-            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementBorder), 0));
-    } else {
-        item->setPen
-            (QPen(GUIPalette::getColour(GUIPalette::MatrixElementLightBorder), 0));
-    }
-
     m_current = current;
+    updateItem();
+    m_scene->elementChanged();
 }
 
 MatrixElement *
@@ -20,8 +20,11 @@
 
 #include "base/ViewElement.h"
 
-class QColor;
+#include <QColor>
+#include <QRectF>
+
 class QGraphicsItem;
+class QAbstractGraphicsShapeItem;
 
 namespace Rosegarden
 {
@@ -70,14 +73,40 @@ public:
 
     static MatrixElement *getMatrixElement(QGraphicsItem *);
 
+    /// The area this element covers, in scene coordinates
+    QRectF getSceneRect() const;
+
+    /// The colour this element is filled with
+    QColor getColour() const;
+
+    /**
+     * Elements only have a graphics item while they are in or near the
+     * view.  These are called by the scene as the view moves, to take
+     * an item from its pool or give it back.
+     */
+    bool hasItem() const { return m_item != nullptr; }
+    void showItem();
+    void hideItem();
+
 protected:
+    /// Bring our item, if we have one, up to date with our layout
+    void updateItem();
+
     MatrixScene *m_scene;
     bool m_drum;
     bool m_current;
-    QGraphicsItem *m_item;
+    bool m_selected;
+    QAbstractGraphicsShapeItem *m_item;
     double m_width;
     double m_velocity;
 
+    // Layout of the item, kept so it can be recreated at any time
+    double m_x;
+    double m_y;
+    double m_itemWidth;
+    QColor m_colour;
+    bool m_tied;
+
     /** Events don't know anything about what segment owns them, so neither do
      * MatrixElements.  In order to handle transposing segments properly, we
      * have to adjust the pitch relative to the segment transpose, and this can
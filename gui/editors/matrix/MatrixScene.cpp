@@ -40,11 +40,15 @@
 #include "gui/studio/StudioControl.h"
 
 #include <QGraphicsSceneMouseEvent>
-#include <QGraphicsLineItem>
+#include <QGraphicsRectItem>
+#include <QGraphicsPolygonItem>
+#include <QPainter>
 #include <QSettings>
 #include <QPointF>
 #include <QRectF>
 
+#include <algorithm>
+
 //#define DEBUG_MOUSE
 
 namespace Rosegarden
@@ -61,7 +65,8 @@ MatrixScene::MatrixScene() :
     m_snapGrid(nullptr),
     m_resolution(8),
     m_selection(nullptr),
-    m_currentSegmentIndex(0)
+    m_currentSegmentIndex(0),
+    m_overviewValid(false)
 {
     connect(CommandHistory::getInstance(), SIGNAL(commandExecuted()),
             this, SLOT(slotCommandExecuted()));
@@ -79,6 +84,13 @@ MatrixScene::~MatrixScene()
     for (unsigned int i = 0; i < m_viewSegments.size(); ++i) {
         delete m_viewSegments[i];
     }
+    // The elements have now given all their items back to the pools
+    for (unsigned int i = 0; i < m_rectItemPool.size(); ++i) {
+        delete m_rectItemPool[i];
+    }
+    for (unsigned int i = 0; i < m_polygonItemPool.size(); ++i) {
+        delete m_polygonItemPool[i];
+    }
     delete m_snapGrid;
     delete m_referenceScale;
     delete m_scale;
@@ -263,47 +275,19 @@ MatrixScene::recreateLines()
         }
     }
 
-    // Pen Width?
-    double pw = 0;
-
     double startPos = m_scale->getXForTime(start);
     double endPos = m_scale->getXForTime(end);
 
-    // Draw horizontal lines
-    int i = 0; 	   	 
-    while (i < 127) { 	 
-         int y = (i + 1) * (m_resolution + 1); 	 
-         QGraphicsLineItem *line; 	 
-         if (i < (int)m_horizontals.size()) { 	 
-             line = m_horizontals[i]; 	 
-         } else { 	 
-             line = new QGraphicsLineItem; 	 
-             line->setZValue(-9); 	 
-             line->setPen(QPen(GUIPalette::getColour 	 
-                               (GUIPalette::MatrixHorizontalLine), pw)); 	 
-             addItem(line); 	 
-             m_horizontals.push_back(line); 	 
-         } 	 
-         line->setLine(startPos, y, endPos, y); 	 
-         line->show(); 	 
-         ++i; 	 
-     } 	 
-
-
-     // Hide the other lines, if there are any.  Just a double check.
-     while (i < (int)m_horizontals.size()) { 	 
-         m_horizontals[i]->hide(); 	 
-         ++i; 	 
-    }
-
     setSceneRect(QRectF(startPos, 0, endPos - startPos, 128 * (m_resolution + 1)));
 
     Composition *c = &m_document->getComposition();
 
     int firstbar = c->getBarNumber(start), lastbar = c->getBarNumber(end);
 
-    // Draw Vertical Lines
-    i = 0;
+    m_barLines.clear();
+    m_beatLines.clear();
+
+    // Find the vertical lines
     for (int bar = firstbar; bar <= lastbar; ++bar) {
 
         std::pair<timeT, timeT> range = c->getBarRange(bar);
@@ -342,38 +326,17 @@ MatrixScene::recreateLines()
                 break;
             }
 
-            QGraphicsLineItem *line;
-
-            if (i < (int)m_verticals.size()) {
-                line = m_verticals[i];
-            } else {
-                line = new QGraphicsLineItem;
-                addItem(line);
-                m_verticals.push_back(line);
-            }
-
+            // index 0 is the bar line
             if (index == 0) {
-              // index 0 is the bar line
-                line->setPen(QPen(GUIPalette::getColour(GUIPalette::MatrixBarLine), pw));
+                m_barLines.push_back(x);
             } else {
-                line->setPen(QPen(GUIPalette::getColour(GUIPalette::BeatLine), pw));
+                m_beatLines.push_back(x);
             }
 
-            line->setZValue(index > 0 ? -10 : -8);
-            line->setLine(x, 0, x, 128 * (m_resolution + 1));
-            
-            line->show();
             x += dx;
-            ++i;
         }
     }
 
-    // Hide the other lines. We are not using them right now.
-    while (i < (int)m_verticals.size()) {
-        m_verticals[i]->hide();
-        ++i;
-    }
-
     recreatePitchHighlights();
     
     // Force update so all vertical lines are drawn correctly
@@ -389,7 +352,8 @@ MatrixScene::recreatePitchHighlights()
     timeT k0 = segment->getClippedStartTime();
     timeT k1 = segment->getClippedStartTime();
 
-    int i = 0;
+    m_tonicHighlights.clear();
+    m_pitchHighlights.clear();
 
     while (k0 < segment->getEndMarkerTime()) {
 
@@ -439,42 +403,213 @@ MatrixScene::recreatePitchHighlights()
             int pitch = hsteps[j];
             while (pitch < 128) {
 
-                QGraphicsRectItem *rect;
-
-                if (i < (int)m_highlights.size()) {
-                    rect = m_highlights[i];
-                } else {
-                    rect = new QGraphicsRectItem;
-                    rect->setZValue(-11);
-                    rect->setPen(Qt::NoPen);
-                    addItem(rect);
-                    m_highlights.push_back(rect);
-                }
+                QRectF rect(x0, (127 - pitch) * (m_resolution + 1),
+                            x1 - x0, m_resolution + 1);
 
                 if (j == 0) {
-                    rect->setBrush(GUIPalette::getColour
-                                   (GUIPalette::MatrixTonicHighlight));
+                    m_tonicHighlights.push_back(rect);
                 } else {
-                    rect->setBrush(GUIPalette::getColour
-                                   (GUIPalette::MatrixPitchHighlight));
+                    m_pitchHighlights.push_back(rect);
                 }
 
-//                rect->setRect(0.5, 0.5, x1 - x0, m_resolution + 1);
-                rect->setRect(0, 0, x1 - x0, m_resolution + 1);
-                rect->setPos(x0, (127 - pitch) * (m_resolution + 1));
-                rect->show();
-
                 pitch += 12;
-
-                ++i;
             }
         }
 
         k0 = k1;
     }
-    while (i < (int)m_highlights.size()) {
-        m_highlights[i]->hide();
-        ++i;
+
+    update();
+}
+
+void
+MatrixScene::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsScene::drawBackground(painter, rect);
+
+    painter->save();
+
+    for (size_t i = 0; i < m_tonicHighlights.size(); ++i) {
+        if (!m_tonicHighlights[i].intersects(rect)) continue;
+        painter->fillRect(m_tonicHighlights[i], GUIPalette::getColour
+                          (GUIPalette::MatrixTonicHighlight));
+    }
+    for (size_t i = 0; i < m_pitchHighlights.size(); ++i) {
+        if (!m_pitchHighlights[i].intersects(rect)) continue;
+        painter->fillRect(m_pitchHighlights[i], GUIPalette::getColour
+                          (GUIPalette::MatrixPitchHighlight));
+    }
+
+    double rowHeight = m_resolution + 1;
+    double left = std::max(rect.left(), sceneRect().left());
+    double right = std::min(rect.right(), sceneRect().right());
+    double top = std::max(rect.top(), 0.0);
+    double bottom = std::min(rect.bottom(), 128 * rowHeight);
+
+    // Beat lines below horizontal lines below bar lines
+
+    painter->setPen(QPen(GUIPalette::getColour(GUIPalette::BeatLine), 0));
+    for (std::vector<double>::const_iterator i =
+             std::lower_bound(m_beatLines.begin(), m_beatLines.end(), left);
+         i != m_beatLines.end() && *i <= right; ++i) {
+        painter->drawLine(QPointF(*i, top), QPointF(*i, bottom));
+    }
+
+    painter->setPen(QPen(GUIPalette::getColour
+                         (GUIPalette::MatrixHorizontalLine), 0));
+    for (int i = std::max(0, int(top / rowHeight) - 1); i < 127; ++i) {
+        double y = (i + 1) * rowHeight;
+        if (y < top) continue;
+        if (y > bottom) break;
+        painter->drawLine(QPointF(left, y), QPointF(right, y));
+    }
+
+    painter->setPen(QPen(GUIPalette::getColour(GUIPalette::MatrixBarLine), 0));
+    for (std::vector<double>::const_iterator i =
+             std::lower_bound(m_barLines.begin(), m_barLines.end(), left);
+         i != m_barLines.end() && *i <= right; ++i) {
+        painter->drawLine(QPointF(*i, top), QPointF(*i, bottom));
+    }
+
+    painter->restore();
+
+    // Notes outside the item area have no items, so a view showing
+    // any of that (the panner, or the matrix view itself before it
+    // has told us where it is) needs them drawn here
+    if (!m_itemArea.contains(rect)) drawOverview(painter, rect);
+}
+
+void
+MatrixScene::drawOverview(QPainter *painter, const QRectF &rect)
+{
+    QTransform transform = painter->worldTransform();
+
+    if (!m_overviewValid ||
+        transform != m_overviewTransform || rect != m_overviewRect) {
+
+        QRect deviceRect = transform.mapRect(rect).toAlignedRect();
+
+        m_overview = QPixmap(deviceRect.size());
+        m_overview.fill(Qt::transparent);
+
+        QPainter paint(&m_overview);
+        paint.translate(-deviceRect.topLeft());
+        paint.setWorldTransform(transform, true);
+
+        std::vector<MatrixElement *> elements;
+        findElements(rect, elements);
+        for (size_t i = 0; i < elements.size(); ++i) {
+            paint.fillRect(elements[i]->getSceneRect(),
+                           elements[i]->getColour());
+        }
+        paint.end();
+
+        m_overviewTransform = transform;
+        m_overviewRect = rect;
+        m_overviewValid = true;
+    }
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+    painter->drawPixmap(transform.mapRect(rect).toAlignedRect().topLeft(),
+                        m_overview);
+    painter->restore();
+}
+
+void
+MatrixScene::findElements(const QRectF &rect,
+                          std::vector<MatrixElement *> &elements) const
+{
+    if (!m_scale) return;
+
+    timeT t0 = m_scale->getTimeForX(rect.left());
+    timeT t1 = m_scale->getTimeForX(rect.right());
+
+    for (size_t i = 0; i < m_viewSegments.size(); ++i) {
+
+        ViewElementList *vel = m_viewSegments[i]->getViewElementList();
+
+        // Start early enough to catch the longest note that could
+        // still be sounding at t0
+        ViewElementList::iterator j =
+            vel->findTime(t0 - m_viewSegments[i]->getLongestDuration());
+
+        for ( ; j != vel->end(); ++j) {
+            if ((*j)->getViewAbsoluteTime() > t1) break;
+            MatrixElement *element = static_cast<MatrixElement *>(*j);
+            if (rect.intersects(element->getSceneRect())) {
+                elements.push_back(element);
+            }
+        }
+    }
+}
+
+void
+MatrixScene::slotViewportChanged(QRectF viewportScene)
+{
+    // Keep items for half a view either side, so that small scrolls
+    // don't need any new ones
+    double dx = viewportScene.width() / 2;
+    double dy = viewportScene.height() / 2;
+    m_itemArea = viewportScene.adjusted(-dx, -dy, dx, dy);
+
+    updateItems();
+}
+
+void
+MatrixScene::updateItems()
+{
+    std::vector<MatrixElement *> leaving;
+    for (std::set<MatrixElement *>::iterator i = m_shownElements.begin();
+         i != m_shownElements.end(); ++i) {
+        if (!m_itemArea.intersects((*i)->getSceneRect())) {
+            leaving.push_back(*i);
+        }
+    }
+    for (size_t i = 0; i < leaving.size(); ++i) {
+        leaving[i]->hideItem();
+    }
+
+    std::vector<MatrixElement *> arriving;
+    findElements(m_itemArea, arriving);
+    for (size_t i = 0; i < arriving.size(); ++i) {
+        arriving[i]->showItem();
+    }
+}
+
+QAbstractGraphicsShapeItem *
+MatrixScene::acquireItem(MatrixElement *element, bool drum)
+{
+    std::vector<QAbstractGraphicsShapeItem *> &pool =
+        (drum ? m_polygonItemPool : m_rectItemPool);
+
+    QAbstractGraphicsShapeItem *item = nullptr;
+
+    if (pool.empty()) {
+        if (drum) item = new QGraphicsPolygonItem;
+        else item = new QGraphicsRectItem;
+    } else {
+        item = pool.back();
+        pool.pop_back();
+    }
+
+    addItem(item);
+    m_shownElements.insert(element);
+
+    return item;
+}
+
+void
+MatrixScene::releaseItem(MatrixElement *element,
+                         QAbstractGraphicsShapeItem *item)
+{
+    m_shownElements.erase(element);
+    removeItem(item);
+
+    if (dynamic_cast<QGraphicsPolygonItem *>(item)) {
+        m_polygonItemPool.push_back(item);
+    } else {
+        m_rectItemPool.push_back(item);
     }
 }
 
@@ -19,11 +19,15 @@
 #define RG_MATRIXSCENE_H
 
 #include <QGraphicsScene>
+#include <QPixmap>
+#include <QTransform>
 
 #include "base/Composition.h"
 #include "gui/general/SelectionManager.h"
 
-class QGraphicsLineItem;
+#include <set>
+
+class QAbstractGraphicsShapeItem;
 
 namespace Rosegarden
 {
@@ -42,10 +46,14 @@ class ZoomableRulerScale;
 class SnapGrid;
 
 /**
- * Specialised graphics scene for matrix elements.  The note blocks and
- * horizontal and vertical grid lines are all represented by graphics items
- * owned by this scene.  This scene also owns the MatrixViewSegment classes
- * which track segment contents in view objects.
+ * Specialised graphics scene for matrix elements.  The note blocks are
+ * represented by graphics items owned by this scene, but only for notes
+ * in or near the part of the scene shown in the matrix view: items are
+ * handed out from a pool as the view scrolls, and given back when they
+ * leave it.  The grid lines and key highlights are drawn directly in
+ * drawBackground(), as are any notes without items in views that show
+ * more of the scene (such as the panner).  This scene also owns the
+ * MatrixViewSegment classes which track segment contents in view objects.
  *
  * The scene works with MatrixViewSegment, MatrixViewElement, MatrixPainter,
  * and MatrixMover to support the new "concert pitch matrix" concept.  All
@@ -126,6 +134,23 @@ public:
     // SegmentObserver method forwarded from MatrixViewSegment
     void segmentEndMarkerTimeChanged(const Segment *s, bool shorten);
 
+    /**
+     * Is any of this rect (in scene coordinates) in the area within
+     * which notes have graphics items?
+     */
+    bool isInItemArea(const QRectF &rect) const {
+        return m_itemArea.intersects(rect);
+    }
+
+    /// Take an item from the pool to show the given element
+    QAbstractGraphicsShapeItem *acquireItem(MatrixElement *, bool drum);
+
+    /// Remove the given element's item from the scene, back to the pool
+    void releaseItem(MatrixElement *, QAbstractGraphicsShapeItem *);
+
+    /// Called by elements when their layout or colour changes
+    void elementChanged() { m_overviewValid = false; }
+
 signals:
     void mousePressed(const MatrixMouseEvent *e);
     void mouseMoved(const MatrixMouseEvent *e);
@@ -160,6 +185,12 @@ signals:
 public slots:
     void slotRulerSelectionChanged(EventSelection *s);
 
+    /**
+     * The matrix view has scrolled or zoomed.  Create items for the
+     * notes now in or near it, and release those that have moved away.
+     */
+    void slotViewportChanged(QRectF viewportScene);
+
 protected slots:
     void slotCommandExecuted();
 
@@ -169,6 +200,8 @@ protected:
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *) override;
     void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *) override;
 
+    void drawBackground(QPainter *, const QRectF &) override;
+
     void segmentRemoved(const Composition *, Segment *) override; // CompositionObserver
     void timeSignatureChanged(const Composition *) override; // CompositionObserver
 
@@ -191,15 +224,34 @@ private:
 
     int m_currentSegmentIndex;
 
-    // These are the background items -- the grid lines and the shadings
-    // used to highlight the first, third and fifth in the current key
-    std::vector<QGraphicsLineItem *> m_horizontals;
-    std::vector<QGraphicsLineItem *> m_verticals;
-    std::vector<QGraphicsRectItem *> m_highlights;
+    // The background, drawn by drawBackground() -- the x coordinates of
+    // the vertical grid lines, and the shadings used to highlight the
+    // first, third and fifth in the current key.  The horizontal lines
+    // are simply one per pitch across the scene rect.
+    std::vector<double> m_barLines;
+    std::vector<double> m_beatLines;
+    std::vector<QRectF> m_tonicHighlights;
+    std::vector<QRectF> m_pitchHighlights;
+
+    // Notes within this area (the view plus a margin) have items
+    QRectF m_itemArea;
+    std::set<MatrixElement *> m_shownElements;
+    std::vector<QAbstractGraphicsShapeItem *> m_rectItemPool; // I own these
+    std::vector<QAbstractGraphicsShapeItem *> m_polygonItemPool; // and these
+
+    // Cached drawing of all notes, for views showing beyond m_itemArea
+    QPixmap m_overview;
+    QTransform m_overviewTransform;
+    QRectF m_overviewRect;
+    bool m_overviewValid;
 
     void setupMouseEvent(QGraphicsSceneMouseEvent *, MatrixMouseEvent &) const;
     void recreateLines();
     void recreatePitchHighlights();
+    void updateItems();
+    void findElements(const QRectF &rect,
+                      std::vector<MatrixElement *> &elements) const;
+    void drawOverview(QPainter *, const QRectF &rect);
     void updateCurrentSegment();
     void setSelectionElementStatus(EventSelection *, bool set);
     void previewSelection(EventSelection *, EventSelection *oldSelection);
@@ -52,6 +52,7 @@
 #include "commands/edit/PasteEventsCommand.h"
 #include "commands/edit/SelectionPropertyCommand.h"
 #include "commands/edit/SetTriggerCommand.h"
+#include "commands/edit/ThinControllersCommand.h"
 
 #include "commands/edit/InvertCommand.h"
 #include "commands/edit/MoveCommand.h"
@@ -416,6 +417,7 @@ MatrixView::setupActions()
     createAction("copy_controllers",  SLOT(slotEditCopyControllers()));
     createAction("cut_controllers",   SLOT(slotEditCutControllers()));
     createAction("set_controllers",   SLOT(slotSetControllers()));
+    createAction("thin_controllers",  SLOT(slotThinControllers()));
     createAction("place_controllers", SLOT(slotPlaceControllers()));
 
     createAction("show_chords_ruler", SLOT(slotToggleChordsRuler()));
@@ -1073,6 +1075,50 @@ MatrixView::slotSetControllers()
                       &ParameterPattern::VelocityPatterns);
 }
 
+void
+MatrixView::slotThinControllers()
+{
+    ControlRulerWidget *cr = m_matrixWidget->getControlsWidget();
+    EventSelection *selection = cr->getSelection();
+    if (!selection) return;
+
+    ControllerThinner configured =
+        ThinControllersCommand::getConfiguredThinner();
+
+    bool ok = false;
+    int min = 0;
+    int max = 127;
+    int step = 1;
+    int tolerance = QInputDialog::getInt(
+            this,
+            tr("Thin Controller Events"),
+            tr("Remove changes no larger than: "),
+            configured.getTolerance(),
+            min,
+            max,
+            step,
+            &ok);
+
+    if (!ok) return;
+
+    ThinControllersCommand::setConfiguredTolerance(tolerance);
+
+    ThinControllersCommand *command =
+        new ThinControllersCommand(*selection,
+                                   ControllerThinner(tolerance,
+                                                     configured.getMinInterval()));
+    CommandHistory::getInstance()->addCommand(command);
+
+    const ControllerThinner::Report &report = command->getReport();
+    statusBar()->showMessage
+        (tr("Removed %1 of %2 controller events, changing controller values by up to %3 and pitch bend by up to %4")
+         .arg(report.removed)
+         .arg(report.examined)
+         .arg(report.maxDeviation)
+         .arg(report.maxPitchBendDeviation),
+         10000);
+}
+
 void
 MatrixView::slotPlaceControllers()
 {
@@ -119,6 +119,7 @@ protected slots:
     void slotEditCutControllers();
     void slotEditCopyControllers();
     void slotSetControllers();
+    void slotThinControllers();
     void slotPlaceControllers();
     
     void slotTriggerSegment();
@@ -39,7 +39,8 @@ MatrixViewSegment::MatrixViewSegment(MatrixScene *scene,
     ViewSegment(*segment),
     m_scene(scene),
     m_drum(drum),
-    m_refreshStatusId(segment->getNewRefreshStatusId())
+    m_refreshStatusId(segment->getNewRefreshStatusId()),
+    m_longestDuration(0)
 {
 }
 
@@ -91,6 +92,10 @@ MatrixViewSegment::makeViewElement(Event* e)
 
     //RG_DEBUG << "  I am segment \"" << getSegment().getLabel() << "\"";
 
+    if (e->getDuration() > m_longestDuration) {
+        m_longestDuration = e->getDuration();
+    }
+
     return new MatrixElement(m_scene, e, m_drum, pitchOffset);
 }
 
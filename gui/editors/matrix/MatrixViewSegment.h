@@ -43,6 +43,12 @@ public:
 
     void updateElements(timeT from, timeT to);
 
+    /**
+     * The longest duration of any element made for this segment, so
+     * that we know how far back to look for notes overlapping a time.
+     */
+    timeT getLongestDuration() const { return m_longestDuration; }
+
 protected:
 //!!!    const MidiKeyMapping *getKeyMapping() const;
 
@@ -68,6 +74,7 @@ protected:
     MatrixScene *m_scene;
     bool m_drum;
     unsigned int m_refreshStatusId;
+    timeT m_longestDuration;
 };
 
 }
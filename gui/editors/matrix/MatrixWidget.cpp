@@ -417,6 +417,12 @@ MatrixWidget::setSegments(RosegardenDocument *document,
 
     m_view->setScene(m_scene);
 
+    // The scene only makes note items for the area around the view.
+    // Queued, as the view reports changes from within its paint.
+    connect(m_view, &Panned::viewportChanged,
+            m_scene, &MatrixScene::slotViewportChanged,
+            Qt::QueuedConnection);
+
     m_toolBox->setScene(m_scene);
 
     m_panner->setScene(m_scene);
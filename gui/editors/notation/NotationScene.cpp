@@ -31,6 +31,7 @@
 #include "NotationWidget.h"
 #include "NotationMouseEvent.h"
 #include "NoteFontFactory.h"
+#include "NoteGlyphCache.h"
 #include "gui/widgets/Panned.h"
 
 #include "misc/Debug.h"
@@ -165,6 +166,7 @@ void
 NotationScene::setFontName(QString name)
 {
     if (name == getFontName()) return;
+    NoteGlyphCache::getInstance()->clear();
     setNotePixmapFactories(name, getFontSize());
     if (!m_updatesSuspended) {
         positionStaffs();
@@ -182,6 +184,7 @@ void
 NotationScene::setFontSize(int size)
 {
     if (size == getFontSize()) return;
+    NoteGlyphCache::getInstance()->clear();
     setNotePixmapFactories(getFontName(), size);
     if (!m_updatesSuspended) {
         positionStaffs();
@@ -437,7 +437,7 @@ NotationVLayout::scanViewSegment(ViewSegment &staffBase, timeT, timeT, bool)
 void
 NotationVLayout::finishLayout(timeT, timeT, bool)
 {
-    Profiler profiler("NotationHLayout::finishLayout");
+    Profiler profiler("NotationVLayout::finishLayout");
 
     for (SlurListMap::iterator mi = m_slurs.begin();
          mi != m_slurs.end(); ++mi) {
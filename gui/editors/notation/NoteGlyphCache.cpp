@@ -0,0 +1,79 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[NoteGlyphCache]"
+
+#include "NoteGlyphCache.h"
+
+#include "misc/Debug.h"
+
+namespace Rosegarden
+{
+
+// 16MB of 32-bit pixmaps is room for tens of thousands of typical
+// note glyphs, which covers every distinct note in most scores.
+static const int DefaultBudget = 16 * 1024;
+
+NoteGlyphCache *
+NoteGlyphCache::getInstance()
+{
+    static NoteGlyphCache instance;
+    return &instance;
+}
+
+NoteGlyphCache::NoteGlyphCache() :
+    m_glyphs(DefaultBudget),
+    m_hits(0),
+    m_misses(0)
+{
+}
+
+bool
+NoteGlyphCache::find(const QByteArray &key, QPixmap &glyph)
+{
+    QPixmap *cached = m_glyphs.object(key);
+    if (!cached) {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    glyph = *cached;
+    return true;
+}
+
+void
+NoteGlyphCache::insert(const QByteArray &key, const QPixmap &glyph)
+{
+    int cost = (glyph.width() * glyph.height() * 4) / 1024 + 1;
+
+    // QCache deletes the object itself if it is too large to keep
+    m_glyphs.insert(key, new QPixmap(glyph), cost);
+}
+
+void
+NoteGlyphCache::clear()
+{
+    RG_DEBUG << "clear(): dropping" << m_glyphs.count() << "glyphs after"
+             << m_hits << "hits and" << m_misses << "misses";
+
+    m_glyphs.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
+
+}
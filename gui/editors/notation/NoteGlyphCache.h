@@ -0,0 +1,84 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_NOTEGLYPHCACHE_H
+#define RG_NOTEGLYPHCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QPixmap>
+
+namespace Rosegarden
+{
+
+/**
+ * A process-wide cache of fully rendered note glyphs (head, stem,
+ * flags, accidental, dots, marks and so on), shared by every
+ * NotePixmapFactory.  NoteItem paints by blitting from here instead
+ * of redrawing the note with a QPainter on every repaint.
+ *
+ * Entries are keyed by NotePixmapFactory::getNoteGlyphKey(), which
+ * covers the note parameters together with the font, size, style and
+ * selected/shaded state.  The total size of the cached pixmaps is
+ * bounded, and the least recently used glyphs are dropped first.
+ *
+ * This class is not thread safe; it must only be used from the GUI
+ * thread.
+ */
+class NoteGlyphCache
+{
+public:
+    static NoteGlyphCache *getInstance();
+
+    /**
+     * Return the glyph for the given key in glyph, or false if it is
+     * not in the cache.
+     */
+    bool find(const QByteArray &key, QPixmap &glyph);
+
+    /**
+     * Add a glyph to the cache.  Glyphs larger than the whole budget
+     * are not kept.
+     */
+    void insert(const QByteArray &key, const QPixmap &glyph);
+
+    /**
+     * Discard all glyphs.  Called when the notation font or size
+     * changes, as none of the existing glyphs will be asked for again.
+     */
+    void clear();
+
+    /// Memory budget in kilobytes
+    int getBudget() const { return m_glyphs.maxCost(); }
+    void setBudget(int kilobytes) { m_glyphs.setMaxCost(kilobytes); }
+
+    int getHits() const { return m_hits; }
+    int getMisses() const { return m_misses; }
+
+protected:
+    NoteGlyphCache();
+
+    /// Cost of each glyph is its approximate size in kilobytes
+    QCache<QByteArray, QPixmap> m_glyphs;
+
+    int m_hits;
+    int m_misses;
+};
+
+}
+
+#endif
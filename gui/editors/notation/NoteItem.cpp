@@ -98,7 +98,21 @@ NoteItem::paint(QPainter *painter,
     m_factory->setNoteStyle(m_style);
     m_factory->setSelected(m_selected);
     m_factory->setShaded(m_shaded);
-    m_factory->drawNoteForItem(m_parameters, m_dimensions, mode, painter);
+
+    // At normal and reduced scales the note looks the same whether it
+    // is drawn or blitted, so share rendered glyphs between items.
+    // Magnified notes are still drawn, so as to stay sharp.
+    if (mode == DrawNormal || mode == DrawSmall) {
+        if (m_glyphKey.isEmpty()) {
+            m_glyphKey = m_factory->getNoteGlyphKey(m_parameters);
+        }
+        if (mode == DrawSmall) {
+            painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+        }
+        m_factory->drawNoteGlyph(m_parameters, m_dimensions, m_glyphKey, painter);
+    } else {
+        m_factory->drawNoteForItem(m_parameters, m_dimensions, mode, painter);
+    }
     painter->restore();
 }
 
@@ -18,6 +18,7 @@
 #ifndef RG_NOTEITEM_H
 #define RG_NOTEITEM_H
 
+#include <QByteArray>
 #include <QGraphicsItem>
 #include <QSharedPointer>
 
@@ -52,6 +53,8 @@ public:
     QPointF offset() const;
     QPixmap makePixmap() const;
 
+    const NotePixmapParameters &getParameters() const { return m_parameters; }
+
     void paint(QPainter *painter,
                const QStyleOptionGraphicsItem *option,
                QWidget *widget) override;
@@ -73,6 +76,7 @@ protected:
     mutable bool m_haveDimensions;
     mutable QPoint m_offset;
     mutable QSize m_size;
+    mutable QByteArray m_glyphKey;
     
     void getDimensions() const;
 };
@@ -44,6 +44,7 @@
 #include "NoteCharacterNames.h"
 #include "NoteFontFactory.h"
 #include "NoteFont.h"
+#include "NoteGlyphCache.h"
 #include "NotePixmapParameters.h"
 #include "NotePixmapPainter.h"
 #include "NoteStyleFactory.h"
@@ -54,6 +55,7 @@
 #include <QMessageBox>
 #include <QBitmap>
 #include <QColor>
+#include <QDataStream>
 #include <QFile>
 #include <QFont>
 #include <QFontMetrics>
@@ -349,6 +351,83 @@ NotePixmapFactory::drawNoteForItem(const NotePixmapParameters &params,
     drawNoteAux(params, painter, 0, 0);
 }
 
+QByteArray
+NotePixmapFactory::getNoteGlyphKey(const NotePixmapParameters &params) const
+{
+    // Everything that can change what drawNoteAux() produces: the
+    // parameters, the font and style, and our own colour state
+
+    QByteArray key;
+    QDataStream s(&key, QIODevice::WriteOnly);
+
+    s << m_font->getName() << m_font->getSize()
+      << m_graceFont->getSize() << m_haveGrace
+      << m_style->getName() << m_selected << m_shaded;
+
+    s << params.m_noteType << params.m_dots
+      << QByteArray(params.m_accidental.c_str())
+      << params.m_cautionary << params.m_shifted << params.m_dotShifted
+      << params.m_accidentalShift << params.m_accidentalExtra
+      << params.m_drawFlag << params.m_drawStem << params.m_stemGoesUp
+      << params.m_stemLength << params.m_legerLines << params.m_slashes
+      << params.m_selected << params.m_highlighted << params.m_quantized
+      << int(params.m_trigger) << params.m_onLine
+      << params.m_safeVertDistance << params.m_restOutsideStave;
+
+    s << params.m_beamed << params.m_nextBeamCount
+      << params.m_thisPartialBeams << params.m_nextPartialBeams
+      << params.m_width << params.m_gradient;
+
+    s << params.m_tupletCount << params.m_tuplingLineY
+      << params.m_tuplingLineWidth << params.m_tuplingLineGradient
+      << params.m_tuplingLineFollowsBeam;
+
+    s << params.m_tied << params.m_tieLength
+      << params.m_tiePositionExplicit << params.m_tieAbove
+      << params.m_inRange << params.m_memberOfParallel;
+
+    s << quint32(params.m_marks.size());
+    for (size_t i = 0; i < params.m_marks.size(); ++i) {
+        s << QByteArray(params.m_marks[i].c_str());
+    }
+
+    s << params.m_forceColor;
+    if (params.m_forceColor) s << params.m_forcedColor.rgba();
+
+    return key;
+}
+
+void
+NotePixmapFactory::drawNoteGlyph(const NotePixmapParameters &params,
+                                 const NoteItemDimensions &dimensions,
+                                 const QByteArray &key,
+                                 QPainter *painter)
+{
+    NoteGlyphCache *cache = NoteGlyphCache::getInstance();
+
+    QPoint origin(-dimensions.left,
+                  -dimensions.above - dimensions.noteBodyHeight / 2);
+
+    QPixmap glyph;
+    if (!cache->find(key, glyph)) {
+
+        Profiler profiler("NotePixmapFactory::drawNoteGlyph: render");
+
+        glyph = QPixmap(dimensions.noteBodyWidth + dimensions.left + dimensions.right,
+                        dimensions.noteBodyHeight + dimensions.above + dimensions.below);
+        glyph.fill(Qt::transparent);
+
+        QPainter glyphPainter(&glyph);
+        m_nd = dimensions;
+        drawNoteAux(params, &glyphPainter, -origin.x(), -origin.y());
+        glyphPainter.end();
+
+        cache->insert(key, glyph);
+    }
+
+    painter->drawPixmap(origin, glyph);
+}
+
 QGraphicsPixmapItem *
 NotePixmapFactory::makeNotePixmapItem(const NotePixmapParameters &params)
 {
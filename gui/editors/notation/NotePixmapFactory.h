@@ -28,6 +28,7 @@
 #include <map>
 #include <string>
 
+#include <QByteArray>
 #include <QFont>
 #include <QFontMetrics>
 #include <QPixmap>
@@ -136,6 +137,23 @@ public:
                          NoteItem::DrawMode mode,
                          QPainter *painter);
 
+    /**
+     * Return a key identifying the note glyph that would be drawn for
+     * the given parameters with the current font, style and
+     * selected/shaded state, for use with NoteGlyphCache.
+     */
+    QByteArray getNoteGlyphKey(const NotePixmapParameters &parameters) const;
+
+    /**
+     * Draw a note at the item origin by blitting its glyph from the
+     * shared NoteGlyphCache, rendering it into the cache first if it
+     * is not already there.
+     */
+    void drawNoteGlyph(const NotePixmapParameters &parameters,
+                       const NoteItemDimensions &dimensions,
+                       const QByteArray &key,
+                       QPainter *painter);
+
     /** Make a clef pixmap from Clef &clef.  The optional colourType parameter
      * is used to pass a ColourType through makeClef() into drawCharacter() for
      * certain special situations requiring external control of the glyph colour
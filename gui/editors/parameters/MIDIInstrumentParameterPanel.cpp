@@ -55,7 +55,7 @@
 #include <QString>
 #include <QWidget>
 
-#include <algorithm>  // std::sort(), std::remove_if()
+#include <algorithm>  // std::sort()
 #include <string>
 #include <iostream>
 #include <cmath>
@@ -530,13 +530,18 @@ MIDIInstrumentParameterPanel::updateBankComboBox()
     }
 
     int currentBank = -1;
-    BankList banks;
+
+    // The banks to show.  Without variations these are the Device's
+    // own list, which is not copied.
+    BankList variationBanks;
+    const BankList *banksToShow = &variationBanks;
 
     RG_DEBUG << "updateBankComboBox(): Variation type is " << md->getVariationType();
 
     if (md->getVariationType() == MidiDevice::NoVariations) {
 
-        banks = md->getBanks(getSelectedInstrument()->isPercussion());
+        banksToShow = &md->getBanks(getSelectedInstrument()->isPercussion());
+        const BankList &banks = *banksToShow;
 
         // If there are banks to display, show the bank widgets.
         // Why not showBank(banks.size()>1)?  Because that would hide the
@@ -580,20 +585,20 @@ MIDIInstrumentParameterPanel::updateBankComboBox()
 
         if (useMSB) {
             for (unsigned int i = 0; i < bytes.size(); ++i) {
-                BankList bl = md->getBanksByMSB
+                const BankList &bl = md->getBanksByMSB
                               (getSelectedInstrument()->isPercussion(), bytes[i]);
                 RG_DEBUG << "updateBankComboBox(): Have " << bl.size() << " variations for MSB " << bytes[i];
 
                 if (bl.size() == 0)
                     continue;
                 if (getSelectedInstrument()->getMSB() == bytes[i]) {
-                    currentBank = banks.size();
+                    currentBank = variationBanks.size();
                 }
-                banks.push_back(bl[0]);
+                variationBanks.push_back(bl[0]);
             }
         } else {
             for (unsigned int i = 0; i < bytes.size(); ++i) {
-                BankList bl = md->getBanksByLSB
+                const BankList &bl = md->getBanksByLSB
                               (getSelectedInstrument()->isPercussion(), bytes[i]);
 
                 RG_DEBUG << "updateBankComboBox(): Have " << bl.size() << " variations for LSB " << bytes[i];
@@ -601,13 +606,15 @@ MIDIInstrumentParameterPanel::updateBankComboBox()
                 if (bl.size() == 0)
                     continue;
                 if (getSelectedInstrument()->getLSB() == bytes[i]) {
-                    currentBank = banks.size();
+                    currentBank = variationBanks.size();
                 }
-                banks.push_back(bl[0]);
+                variationBanks.push_back(bl[0]);
             }
         }
     }
 
+    const BankList &banks = *banksToShow;
+
     // Populate the combobox with bank names.
 
     // If we need to repopulate m_bankComboBox
@@ -656,6 +663,23 @@ MIDIInstrumentParameterPanel::hasNoName(const MidiProgram &p)
     return (p.getName() == "");
 }
 
+bool
+MIDIInstrumentParameterPanel::namedProgramsMatch(const ProgramList &programs,
+                                                 const ProgramList &named)
+{
+    unsigned j = 0;
+
+    for (unsigned i = 0; i < programs.size(); ++i) {
+        if (hasNoName(programs[i]))
+            continue;
+        if (j == named.size()  ||  !programs[i].partialCompareWithName(named[j]))
+            return false;
+        ++j;
+    }
+
+    return (j == named.size());
+}
+
 void
 MIDIInstrumentParameterPanel::updateProgramComboBox()
 {
@@ -675,13 +699,29 @@ MIDIInstrumentParameterPanel::updateProgramComboBox()
 
     MidiBank bank = getSelectedInstrument()->getProgram().getBank();
 
-    ProgramList programs =
+    const ProgramList &allPrograms =
             md->getPrograms0thVariation(getSelectedInstrument()->isPercussion(), bank);
 
-    // Remove the programs that have no name.
-    programs.erase(std::remove_if(programs.begin(), programs.end(),
-                                  MIDIInstrumentParameterPanel::hasNoName),
-                   programs.end());
+    // If the programs have changed, we need to repopulate the combobox.
+    if (!namedProgramsMatch(allPrograms, m_programs))
+    {
+        // Update the cache, leaving out the programs that have no name.
+        m_programs.clear();
+        for (unsigned i = 0; i < allPrograms.size(); ++i) {
+            if (!hasNoName(allPrograms[i]))
+                m_programs.push_back(allPrograms[i]);
+        }
+
+        // Copy from m_programs to m_programComboBox.
+        m_programComboBox->clear();
+        for (unsigned i = 0; i < m_programs.size(); ++i) {
+            m_programComboBox->addItem(QObject::tr("%1. %2")
+                                       .arg(m_programs[i].getProgram() + 1)
+                                       .arg(QObject::tr(m_programs[i].getName().c_str())));
+        }
+    }
+
+    const ProgramList &programs = m_programs;
 
     // If we've got programs, show the Program widgets.
     // Why not "show = (programs.size()>1)"?  Because that would hide the
@@ -704,21 +744,6 @@ MIDIInstrumentParameterPanel::updateProgramComboBox()
         }
     }
 
-    // If the programs have changed, we need to repopulate the combobox.
-    if (!partialCompareWithName(programs, m_programs))
-    {
-        // Update the cache.
-        m_programs = programs;
-
-        // Copy from m_programs to m_programComboBox.
-        m_programComboBox->clear();
-        for (unsigned i = 0; i < m_programs.size(); ++i) {
-            m_programComboBox->addItem(QObject::tr("%1. %2")
-                                       .arg(m_programs[i].getProgram() + 1)
-                                       .arg(QObject::tr(m_programs[i].getName().c_str())));
-        }
-    }
-
     m_programComboBox->setEnabled(getSelectedInstrument()->sendsProgramChange());
 
 #if 0
@@ -1063,7 +1088,7 @@ MIDIInstrumentParameterPanel::slotSelectBank(int index)
         if (md->getVariationType() == MidiDevice::NoVariations) {
 
             // ...go with the first program
-            ProgramList programList = md->getPrograms(bank);
+            const ProgramList &programList = md->getPrograms(bank);
             if (!programList.empty()) {
                 // Switch to the first program in this bank.
                 getSelectedInstrument()->setProgram(programList.front());
@@ -1080,19 +1105,17 @@ MIDIInstrumentParameterPanel::slotSelectBank(int index)
             // the bank they just selected.
 
             // Get the variation bank list for this bank
-            BankList bankList;
-            if (md->getVariationType() == MidiDevice::VariationFromMSB) {
-                bankList = md->getBanksByLSB(
-                        getSelectedInstrument()->isPercussion(), bank.getLSB());
-            } else {
-                bankList = md->getBanksByMSB(
+            const BankList &bankList =
+                    (md->getVariationType() == MidiDevice::VariationFromMSB) ?
+                    md->getBanksByLSB(
+                        getSelectedInstrument()->isPercussion(), bank.getLSB()) :
+                    md->getBanksByMSB(
                         getSelectedInstrument()->isPercussion(), bank.getMSB());
-            }
             if (!bankList.empty()) {
                 // Pick the first bank
                 MidiBank firstBank = bankList.front();
                 // Get the program list
-                ProgramList programList = md->getPrograms(firstBank);
+                const ProgramList &programList = md->getPrograms(firstBank);
                 if (!programList.empty()) {
                     // Pick the first program
                     getSelectedInstrument()->setProgram(programList.front());
@@ -1211,7 +1234,7 @@ MIDIInstrumentParameterPanel::slotSelectProgram(int index)
     if (md->getVariationType() == MidiDevice::VariationFromMSB) {
         MidiBank bank = getSelectedInstrument()->getProgram().getBank();
         // Get the list of MSB variations.
-        BankList bankList = md->getBanksByLSB(
+        const BankList &bankList = md->getBanksByLSB(
                 getSelectedInstrument()->isPercussion(), bank.getLSB());
         if (!bankList.empty()) {
             // Pick the first MSB variation
@@ -1221,7 +1244,7 @@ MIDIInstrumentParameterPanel::slotSelectProgram(int index)
     if (md->getVariationType() == MidiDevice::VariationFromLSB) {
         MidiBank bank = getSelectedInstrument()->getProgram().getBank();
         // Get the list of LSB variations.
-        BankList bankList = md->getBanksByMSB(
+        const BankList &bankList = md->getBanksByMSB(
                 getSelectedInstrument()->isPercussion(), bank.getMSB());
         if (!bankList.empty()) {
             // Pick the first LSB variation
@@ -141,6 +141,9 @@ private:
     /// From the selected instrument.
     void updateProgramComboBox();
     static bool hasNoName(const MidiProgram &p);
+    /// Whether named holds just the programs with names, in order.
+    static bool namedProgramsMatch(const ProgramList &programs,
+                                   const ProgramList &named);
 
     // Variation
     QLabel *m_variationLabel;
@@ -43,6 +43,7 @@
 #include "gui/dialogs/PitchPickerDialog.h"
 #include "sound/PluginIdentifier.h"
 #include "gui/general/PresetHandlerDialog.h"
+#include "document/LazySegmentLoader.h"
 #include "document/RosegardenDocument.h"
 #include "gui/application/RosegardenMainWindow.h"
 #include "gui/application/RosegardenMainViewWidget.h"
@@ -603,6 +604,14 @@ TrackParameterBox::slotArchiveChanged(bool checked)
     track->setArchived(checked);
     m_doc->slotDocumentModified();
 
+    // Archived tracks are not played, so their segments can go back to
+    // being shells if they were read lazily.  Other tracks need all of
+    // their events.
+    if (checked)
+        LazySegmentLoader::unloadTrack(m_doc, track->getId());
+    else
+        LazySegmentLoader::loadTrack(m_doc->getComposition(), track->getId());
+
     // Notify observers
     // This will trigger a call to updateWidgets2().
     Composition &comp = m_doc->getComposition();
@@ -706,6 +706,22 @@ void CompositionModelImpl::allEventsChanged(const Segment *s)
     emit needUpdate(rect);
 }
 
+void CompositionModelImpl::eventsChanged(const Segment *s, timeT, timeT,
+                                         const std::vector<Event *> &,
+                                         const std::vector<Event *> &)
+{
+    // Called at the end of a command's edit, once for all the events.
+
+    if (m_recording)
+        return;
+
+    deleteCachedPreview(s);
+
+    QRect rect;
+    getSegmentQRect(*s, rect);
+    emit needUpdate(rect);
+}
+
 void CompositionModelImpl::appearanceChanged(const Segment *s)
 {
     // Called by Segment::setLabel() and Segment::setColourIndex().
@@ -1195,6 +1211,10 @@ void CompositionModelImpl::setSelected(Segment *segment, bool selected)
     // Update m_selectedSegments
 
     if (selected) {
+        // A selected segment is about to be worked on, so it needs its
+        // events if they were deferred
+        segment->loadDeferredEvents();
+
         if (!isSelected(segment))
             m_selectedSegments.insert(segment);
     } else {
@@ -1209,6 +1229,12 @@ void CompositionModelImpl::setSelected(Segment *segment, bool selected)
 void CompositionModelImpl::selectSegments(const SegmentSelection &segments)
 {
     m_selectedSegments = segments;
+
+    for (SegmentSelection::iterator i = m_selectedSegments.begin();
+         i != m_selectedSegments.end(); ++i) {
+        (*i)->loadDeferredEvents();
+    }
+
     emit needUpdate();
 }
 
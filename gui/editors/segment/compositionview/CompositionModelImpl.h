@@ -384,6 +384,9 @@ private:
     void eventAdded(const Segment *, Event *) override;
     void eventRemoved(const Segment *, Event *) override;
     void allEventsChanged(const Segment *) override;
+    void eventsChanged(const Segment *, timeT, timeT,
+                       const std::vector<Event *> &,
+                       const std::vector<Event *> &) override;
     void appearanceChanged(const Segment *) override;
     void endMarkerTimeChanged(const Segment *, bool shorten) override;
     void segmentDeleted(const Segment *) override
@@ -37,6 +37,8 @@
 #include <QTabWidget>
 #include <QToolBar>
 
+#include <algorithm>
+
 namespace Rosegarden
 {
 
@@ -80,6 +82,13 @@ EditViewBase::~EditViewBase()
     slotSaveOptions();
 }
 
+bool
+EditViewBase::isEditing(const Segment *segment) const
+{
+    return std::find(m_segments.begin(), m_segments.end(), segment) !=
+        m_segments.end();
+}
+
 Clipboard *EditViewBase::getClipboard()
 {
     return Clipboard::mainClipboard();
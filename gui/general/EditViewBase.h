@@ -53,6 +53,9 @@ public:
     const RosegardenDocument *getDocument() const { return m_doc; }
     RosegardenDocument *getDocument() { return m_doc; }
 
+    /// Whether the segment is one of those being edited
+    bool isEditing(const Segment *segment) const;
+
     Clipboard *getClipboard();
 
     /**
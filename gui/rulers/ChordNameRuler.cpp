@@ -51,6 +51,8 @@
 #include <QToolTip>
 #include <QWidget>
 
+#include <algorithm>
+
 
 namespace Rosegarden
 {
@@ -209,8 +211,32 @@ ChordNameRuler::minimumSizeHint() const
     return res;
 }
 
+bool
+ChordNameRuler::hasKeyChange(timeT from, timeT to)
+{
+    for (Segment::iterator i = m_chordSegment->findTime(from);
+            i != m_chordSegment->findTime(to); ++i) {
+        if ((*i)->isa(Text::EventType) &&
+                (*i)->has(Text::TextTypePropertyName) &&
+                (*i)->get<String>(Text::TextTypePropertyName) == Text::KeyName)
+            return true;
+    }
+
+    for (SegmentRefreshMap::iterator si = m_segments.begin();
+            si != m_segments.end(); ++si) {
+        Segment *segment = si->first;
+        for (Segment::iterator i = segment->findTime(from);
+                i != segment->findTime(to); ++i) {
+            if ((*i)->isa(Key::EventType))
+                return true;
+        }
+    }
+
+    return false;
+}
+
 void
-ChordNameRuler::recalculate(timeT from, timeT to)
+ChordNameRuler::recalculate()
 {
     if (!m_ready)
         return ;
@@ -220,7 +246,7 @@ ChordNameRuler::recalculate(timeT from, timeT to)
 
     bool regetSegments = false;
 
-    enum RecalcLevel { RecalcNone, RecalcVisible, RecalcWhole };
+    enum RecalcLevel { RecalcNone, RecalcRange, RecalcWhole };
     RecalcLevel level = RecalcNone;
 
     if (m_segments.empty()) {
@@ -315,27 +341,23 @@ ChordNameRuler::recalculate(timeT from, timeT to)
     }
 
     // We now have the overall area affected by these changes, across
-    // all segments.  If it's entirely within our displayed area, just
-    // recalculate the displayed area; if it overlaps, calculate the
-    // union of the two areas; if it's entirely without, calculate
-    // nothing.
+    // all segments.  The chord labels are cached in m_chordSegment, one
+    // per time slice, so only the slices within that area need to be
+    // relabelled -- whether or not they are currently visible.
+
+    timeT from = overallStatus.from();
+    timeT to = overallStatus.to();
 
     if (level == RecalcNone) {
-        if (from == to) {
-            RG_DEBUG << "recalculate(): from==to, recalculating all";
+        if (m_chordSegment->empty()) {
+            RG_DEBUG << "recalculate(): no labels yet, recalculating whole";
             level = RecalcWhole;
-        } else if (overallStatus.from() == overallStatus.to()) {
+        } else if (from == to) {
             RG_DEBUG << "recalculate(): overallStatus.from==overallStatus.to, ignoring";
             level = RecalcNone;
-        } else if (overallStatus.from() >= from && overallStatus.to() <= to) {
-            RG_DEBUG << "recalculate(): change is " << overallStatus.from() << "->" << overallStatus.to() << ", I show " << from << "->" << to << ", recalculating visible area";
-            level = RecalcVisible;
-        } else if (overallStatus.from() >= to || overallStatus.to() <= from) {
-            RG_DEBUG << "recalculate(): change is " << overallStatus.from() << "->" << overallStatus.to() << ", I show " << from << "->" << to << ", ignoring";
-            level = RecalcNone;
         } else {
-            RG_DEBUG << "recalculate(): change is " << overallStatus.from() << "->" << overallStatus.to() << ", I show " << from << "->" << to << ", recalculating whole";
-            level = RecalcWhole;
+            RG_DEBUG << "recalculate(): change is " << from << "->" << to << ", recalculating range";
+            level = RecalcRange;
         }
     }
 
@@ -370,7 +392,34 @@ ChordNameRuler::recalculate(timeT from, timeT to)
         }
     */
 
-    if (level == RecalcWhole) {
+    if (level == RecalcRange) {
+
+        // The notes making up the chord labelled just before the
+        // change may have been quantized into it from within the
+        // changed area, so widen the area back to that slice.
+        Segment::iterator i = m_chordSegment->findTime(from);
+        if (i != m_chordSegment->begin()) {
+            --i;
+            if ((*i)->getAbsoluteTime() >= 0)
+                from = (*i)->getAbsoluteTime();
+        }
+
+        // A key change (added or removed) alters the names of all the
+        // chords after it, so in that case relabel to the end.
+        if (hasKeyChange(from, to)) {
+            RG_DEBUG << "recalculate(): key change in range, recalculating from " << from << " to end";
+            to = m_composition->getDuration();
+            m_chordSegment->erase(m_chordSegment->findTime(from),
+                                  m_chordSegment->end());
+        } else {
+            m_chordSegment->erase(m_chordSegment->findTime(from),
+                                  m_chordSegment->findTime(to));
+        }
+
+        if (from >= to)
+            return ;
+
+    } else {
 
         m_chordSegment->clear();
 
@@ -386,11 +435,6 @@ ChordNameRuler::recalculate(timeT from, timeT to)
 
         from = 0;
         to = 0;
-
-    } else {
-        Segment::iterator i = m_chordSegment->findTime(from);
-        Segment::iterator j = m_chordSegment->findTime(to);
-        m_chordSegment->erase(i, j);
     }
 
     SegmentSelection selection;
@@ -399,9 +443,16 @@ ChordNameRuler::recalculate(timeT from, timeT to)
         selection.insert(si->first);
     }
 
+    // Later key changes are held in m_chordSegment as KeyName text,
+    // not as keys, so take the key in force at the start from the
+    // segment itself.
+    timeT keyTime = std::max(from, m_currentSegment->getStartTime());
+    ::Rosegarden::Key key = m_currentSegment->getKeyAtTime(keyTime);
+
     CompositionTimeSliceAdapter adapter(m_composition, &selection, from, to);
     AnalysisHelper helper;
-    helper.labelChords(adapter, *m_chordSegment, m_composition->getNotationQuantizer());
+    helper.labelChords(adapter, *m_chordSegment,
+                       m_composition->getNotationQuantizer(), key);
 }
 
 void
@@ -434,7 +485,7 @@ ChordNameRuler::paintEvent(QPaintEvent* e)
     timeT to = m_rulerScale->getTimeForX
                (clipRect.x() + clipRect.width() - m_currentXOffset + 50);
 
-    recalculate(from, to);
+    recalculate();
 
     if (!m_chordSegment)
         return ;
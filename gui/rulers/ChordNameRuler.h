@@ -98,8 +98,16 @@ protected:
     void paintEvent(QPaintEvent *) override;
 
 private:
-    void recalculate(timeT from = 0,
-                     timeT to = 0);
+    /**
+     * Bring the cached chord labels in m_chordSegment up to date.
+     * Only the time slices within the range changed since the last
+     * call (as reported by the segments' refresh statuses) are
+     * relabelled, unless the set of segments itself has changed.
+     */
+    void recalculate();
+
+    /// Whether a key change was, or now is, present in [from, to).
+    bool hasKeyChange(timeT from, timeT to);
 
     int    m_height;
     int    m_currentXOffset;
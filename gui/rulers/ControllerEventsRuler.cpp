@@ -54,10 +54,18 @@
 #include <QWidget>
 #include <QPainter>
 
+#include <algorithm>
+#include <set>
+
 
 namespace Rosegarden
 {
 
+// Show individual items only while the values in view are at least
+// this many pixels apart on average.
+static const int MinItemSpacing = 4;
+
+
 
 ControllerEventsRuler::ControllerEventsRuler(ViewSegment *segment,
         RulerScale* rulerScale,
@@ -69,7 +77,8 @@ ControllerEventsRuler::ControllerEventsRuler(ViewSegment *segment,
         m_lastDrawnRect(QRectF(0,0,0,0)),
         m_moddingSegment(false),
         m_rubberBand(new QLineF(0,0,0,0)),
-        m_rubberBandVisible(false)
+        m_rubberBandVisible(false),
+        m_itemsShown(false)
 {
     // Make a copy of the ControlParameter if we have one
     //
@@ -141,21 +150,175 @@ ControllerEventsRuler::init()
         return;
 
     clear();
+    m_values.clear();
     
     // Reset range information for this controller type
     setMaxItemValue(m_controller->getMax());
     setMinItemValue(m_controller->getMin());
 
+    // Segment order is time order, so these all go on the end
     for (Segment::iterator it = m_segment->begin();
             it != m_segment->end(); ++it) {
-        if (isOnThisRuler(*it)) {
-            addControlItem2(*it);
-        }
+        if (isOnThisRuler(*it)) addValue(*it);
     }
+
+    updateVisibleItems();
     
     update();
 }
 
+void
+ControllerEventsRuler::slotSetPannedRect(QRectF pr)
+{
+    ControlRuler::slotSetPannedRect(pr);
+    updateVisibleItems();
+}
+
+void
+ControllerEventsRuler::addValue(Event *event)
+{
+    ControllerValue value;
+    value.time = event->getAbsoluteTime();
+    value.value = 0;
+    ControllerEventAdapter(event).getValue(value.value);
+    value.event = event;
+
+    // After any others at the same time, as the segment would have it.
+    // Usually this is the end.
+    if (m_values.empty() || !(value < m_values.back())) {
+        m_values.push_back(value);
+    } else {
+        m_values.insert(std::upper_bound(m_values.begin(), m_values.end(),
+                                         value),
+                        value);
+    }
+}
+
+void
+ControllerEventsRuler::removeValue(Event *event)
+{
+    ControllerValue value;
+    value.time = event->getAbsoluteTime();
+
+    std::pair<ControllerValueList::iterator, ControllerValueList::iterator>
+        range = std::equal_range(m_values.begin(), m_values.end(), value);
+
+    for (ControllerValueList::iterator i = range.first;
+         i != range.second; ++i) {
+        if (i->event == event) {
+            m_values.erase(i);
+            return;
+        }
+    }
+}
+
+bool
+ControllerEventsRuler::getItemRange(ControllerValueList::iterator &first,
+                                    ControllerValueList::iterator &last)
+{
+    first = last = m_values.end();
+
+    if (!m_segment || width() <= 0 || m_pannedRect.width() <= 0) return false;
+
+    ControllerValue from, to;
+    from.time = m_rulerScale->getTimeForX(m_pannedRect.left() / m_xScale);
+    to.time = m_rulerScale->getTimeForX(m_pannedRect.right() / m_xScale);
+
+    first = std::lower_bound(m_values.begin(), m_values.end(), from);
+    last = std::upper_bound(first, m_values.end(), to);
+    if (first != m_values.begin()) --first;
+
+    return true;
+}
+
+bool
+ControllerEventsRuler::isDense(ControllerValueList::iterator first,
+                               ControllerValueList::iterator last)
+{
+    return (last - first) * MinItemSpacing > width();
+}
+
+void
+ControllerEventsRuler::updateVisibleItems()
+{
+    if (!m_segment || !m_controller) return;
+
+    ControllerValueList::iterator first, last;
+    m_itemsShown = getItemRange(first, last) && !isDense(first, last);
+
+    timeT from = 0, to = -1;
+    if (m_itemsShown && first != last) {
+        from = first->time;
+        to = (last-1)->time;
+    }
+
+    // Drop the items we no longer want, noting the ones we keep
+    std::set<Event *> kept;
+
+    ControlItemMap::iterator it = m_controlItemMap.begin();
+    while (it != m_controlItemMap.end()) {
+        ControlItemMap::iterator next = it;
+        ++next;
+        Event *event = it->second->getEvent();
+        if (!event || it->second->isSelected()) {
+            if (event) kept.insert(event);
+        } else if (event->getAbsoluteTime() >= from &&
+                   event->getAbsoluteTime() <= to) {
+            kept.insert(event);
+        } else {
+            eraseControlItem(it);
+        }
+        it = next;
+    }
+
+    if (!m_itemsShown) return;
+
+    for (ControllerValueList::iterator i = first; i != last; ++i) {
+        if (kept.find(i->event) == kept.end()) addControlItem2(i->event);
+    }
+}
+
+void
+ControllerEventsRuler::drawEnvelope(QPainter &painter)
+{
+    ControllerValueList::iterator first, last;
+    getItemRange(first, last);
+
+    int lastX = mapXToWidget
+        (m_rulerScale->getXForTime(m_segment->getStartTime()) * m_xScale);
+    int lastY = mapYToWidget(valueToY(m_controller->getDefault()));
+
+    // The value before the view only sets the level we start from
+    if (first != last && first->time <
+        m_rulerScale->getTimeForX(m_pannedRect.left() / m_xScale)) {
+        lastY = mapYToWidget(valueToY(first->value));
+        ++first;
+    }
+
+    ControllerValueList::iterator i = first;
+    while (i != last) {
+        int x = mapXToWidget(m_rulerScale->getXForTime(i->time) * m_xScale);
+        painter.drawLine(lastX, lastY, x, lastY);
+
+        // Everything in this pixel column becomes one vertical line
+        // covering the level coming in and all the values within it
+        int minY = lastY, maxY = lastY;
+        while (i != last &&
+               mapXToWidget(m_rulerScale->getXForTime(i->time) * m_xScale) == x) {
+            lastY = mapYToWidget(valueToY(i->value));
+            if (lastY < minY) minY = lastY;
+            if (lastY > maxY) maxY = lastY;
+            ++i;
+        }
+        painter.drawLine(x, minY, x, maxY);
+        lastX = x;
+    }
+
+    painter.drawLine(lastX, lastY,
+            mapXToWidget(m_rulerScale->getXForTime(m_segment->getEndTime())*m_xScale),
+            lastY);
+}
+
 void ControllerEventsRuler::paintEvent(QPaintEvent *event)
 {
     ControlRuler::paintEvent(event);
@@ -186,36 +349,40 @@ void ControllerEventsRuler::paintEvent(QPaintEvent *event)
 
     QString str;
     
-    ControlItemMap::iterator mapIt;
-    float lastX, lastY;
-    lastX = m_rulerScale->getXForTime(m_segment->getStartTime())*m_xScale;
-
-    if (m_nextItemLeft != m_controlItemMap.end()) {
-        EventControlItem *item = static_cast<EventControlItem*> (m_nextItemLeft->second);
-        lastY = item->y();
-    } else {
-        lastY = valueToY(m_controller->getDefault());
-    }
-    
-    mapIt = m_firstVisibleItem;
-    while (mapIt != m_controlItemMap.end()) {
-        EventControlItem *item = static_cast<EventControlItem*> (mapIt->second);
-        painter.drawLine(mapXToWidget(lastX),mapYToWidget(lastY),
-                mapXToWidget(item->xStart()),mapYToWidget(lastY));
-        painter.drawLine(mapXToWidget(item->xStart()),mapYToWidget(lastY),
-                mapXToWidget(item->xStart()),mapYToWidget(item->y()));
-        lastX = item->xStart();
-        lastY = item->y();
-        if (mapIt == m_lastVisibleItem) {
-            mapIt = m_controlItemMap.end();
+    if (m_itemsShown) {
+        ControlItemMap::iterator mapIt;
+        float lastX, lastY;
+        lastX = m_rulerScale->getXForTime(m_segment->getStartTime())*m_xScale;
+
+        if (m_nextItemLeft != m_controlItemMap.end()) {
+            EventControlItem *item = static_cast<EventControlItem*> (m_nextItemLeft->second);
+            lastY = item->y();
         } else {
-            ++mapIt;
+            lastY = valueToY(m_controller->getDefault());
         }
-    }
     
-    painter.drawLine(mapXToWidget(lastX),mapYToWidget(lastY),
-            mapXToWidget(m_rulerScale->getXForTime(m_segment->getEndTime())*m_xScale),
-            mapYToWidget(lastY));
+        mapIt = m_firstVisibleItem;
+        while (mapIt != m_controlItemMap.end()) {
+            EventControlItem *item = static_cast<EventControlItem*> (mapIt->second);
+            painter.drawLine(mapXToWidget(lastX),mapYToWidget(lastY),
+                    mapXToWidget(item->xStart()),mapYToWidget(lastY));
+            painter.drawLine(mapXToWidget(item->xStart()),mapYToWidget(lastY),
+                    mapXToWidget(item->xStart()),mapYToWidget(item->y()));
+            lastX = item->xStart();
+            lastY = item->y();
+            if (mapIt == m_lastVisibleItem) {
+                mapIt = m_controlItemMap.end();
+            } else {
+                ++mapIt;
+            }
+        }
+    
+        painter.drawLine(mapXToWidget(lastX),mapYToWidget(lastY),
+                mapXToWidget(m_rulerScale->getXForTime(m_segment->getEndTime())*m_xScale),
+                mapYToWidget(lastY));
+    } else {
+        drawEnvelope(painter);
+    }
     
     // Use a fast vector list to record selected items that are currently visible so that they
     // can be drawn last - can't use m_selectedItems as this covers all selected, visible or not
@@ -309,7 +476,23 @@ void ControllerEventsRuler::eventAdded(const Segment*, Event *event)
     //  add a ControlItem to display it
     // Note that ControlPainter will (01/08/09) add events directly
     //  these should not be replicated by this observer mechanism
-    if (isOnThisRuler(event) && !m_moddingSegment) addControlItem2(event);
+    if (!isOnThisRuler(event)) return;
+
+    addValue(event);
+    if (m_moddingSegment) return;
+
+    ControllerValueList::iterator first, last;
+    if (!getItemRange(first, last) || first == last) return;
+
+    timeT t = event->getAbsoluteTime();
+    if (t < first->time || t > (last-1)->time) return;
+
+    if (m_itemsShown && !isDense(first, last)) {
+        addControlItem2(event);
+    } else if (m_itemsShown) {
+        updateVisibleItems();
+    }
+    update();
 }
 
 void ControllerEventsRuler::eventRemoved(const Segment*, Event *event)
@@ -320,10 +503,43 @@ void ControllerEventsRuler::eventRemoved(const Segment*, Event *event)
     // Old code did this ... not sure why
     //    clearSelectedItems();
     //
-    if (isOnThisRuler(event) && !m_moddingSegment) {
-        eraseControlItem(event);
-        update();
+    if (!isOnThisRuler(event)) return;
+
+    removeValue(event);
+    if (m_moddingSegment) return;
+
+    eraseControlItem(event);
+
+    // We may now be sparse enough to show items again
+    if (!m_itemsShown) updateVisibleItems();
+    update();
+}
+
+void ControllerEventsRuler::eventsChanged(const Segment *, timeT, timeT,
+                                          const std::vector<Event *> &added,
+                                          const std::vector<Event *> &removed)
+{
+    // Segment observer notification of a whole command's changes.
+    // Update the values for every event, then the items just once.
+    bool changed = false;
+
+    for (size_t i = 0; i < removed.size(); ++i) {
+        if (!isOnThisRuler(removed[i])) continue;
+        removeValue(removed[i]);
+        if (!m_moddingSegment) eraseControlItem(removed[i]);
+        changed = true;
     }
+
+    for (size_t i = 0; i < added.size(); ++i) {
+        if (!isOnThisRuler(added[i])) continue;
+        addValue(added[i]);
+        changed = true;
+    }
+
+    if (!changed || m_moddingSegment) return;
+
+    updateVisibleItems();
+    update();
 }
 
 void ControllerEventsRuler::segmentDeleted(const Segment *)
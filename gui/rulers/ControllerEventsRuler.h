@@ -23,8 +23,11 @@
 #include "base/Segment.h"
 #include <QString>
 
+#include <vector>
+
 class QWidget;
 class QMouseEvent;
+class QPainter;
 
 
 namespace Rosegarden
@@ -65,6 +68,9 @@ public:
     // SegmentObserver interface
     void eventAdded(const Segment *, Event *) override;
     void eventRemoved(const Segment *, Event *) override;
+    void eventsChanged(const Segment *, timeT, timeT,
+                       const std::vector<Event *> &added,
+                       const std::vector<Event *> &removed) override;
     void segmentDeleted(const Segment *) override;
 
     virtual ControlItem* addControlItem2(float, float);
@@ -97,11 +103,55 @@ public:
 
 public slots:
     void slotSetTool(const QString&) override;
+    void slotSetPannedRect(QRectF) override;
 
 protected:
     virtual void init();
     virtual bool isOnThisRuler(Event *);
 
+    /**
+     * One entry for each event on this ruler, kept in time order.
+     * This is what we draw from: ControlItems are only made for the
+     * events in view, and only when they are far enough apart to be
+     * edited individually.
+     */
+    struct ControllerValue {
+        timeT time;
+        long value;
+        Event *event;
+        bool operator<(const ControllerValue &v) const { return time < v.time; }
+    };
+    typedef std::vector<ControllerValue> ControllerValueList;
+
+    void addValue(Event *);
+    void removeValue(Event *);
+
+    /**
+     * Find the values that items should be shown for: those in view,
+     * plus the one before that sets the level at the left edge.
+     * Returns false if there is no view yet.
+     */
+    bool getItemRange(ControllerValueList::iterator &first,
+                      ControllerValueList::iterator &last);
+
+    /// Too many values in [first, last) to show as separate items?
+    bool isDense(ControllerValueList::iterator first,
+                 ControllerValueList::iterator last);
+
+    /**
+     * Create items for the values in range if we are zoomed in far
+     * enough, and delete those no longer needed.  Selected items, and
+     * those not yet written to the segment, are always kept.
+     */
+    void updateVisibleItems();
+
+    /**
+     * Draw the values in view as a step line with one vertical min/max
+     * line per pixel column, for when there are too many to show as
+     * separate items.
+     */
+    void drawEnvelope(QPainter &painter);
+
     //--------------- Data members ---------------------------------
     int  m_defaultItemWidth;
 
@@ -110,6 +160,9 @@ protected:
     bool m_moddingSegment;
     QLineF *m_rubberBand;
     bool m_rubberBandVisible;
+
+    ControllerValueList m_values;
+    bool m_itemsShown;
 };
 
 
@@ -70,6 +70,9 @@ public:
 // Used to update the ruler when notes are moved around or deleted
     void eventAdded(const Segment *, Event *) override { update(); }
     void eventRemoved(const Segment *, Event *) override { update(); }
+    void eventsChanged(const Segment *, timeT, timeT,
+                       const std::vector<Event *> &,
+                       const std::vector<Event *> &) override { update(); }
 
     void segmentDeleted(const Segment *) override;
 
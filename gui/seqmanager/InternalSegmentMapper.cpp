@@ -38,6 +38,8 @@
 
 #include <limits>
 #include <algorithm>
+#include <map>
+#include <vector>
 
 // #define DEBUG_INTERNAL_SEGMENT_MAPPER 1
 
@@ -57,6 +59,32 @@ InternalSegmentMapper::
     if(m_triggeredEvents) { delete m_triggeredEvents; }
 }
 
+namespace
+{
+    // One expansion of a trigger, kept so that other triggers with
+    // the same TriggerSegmentRec::ExpansionKey can copy it rather than
+    // expanding the ornament again.
+    struct TriggerExpansion
+    {
+        // Time of the trigger that was expanded
+        timeT time;
+        std::vector<Event *> events;
+    };
+
+    class TriggerExpansionCache :
+        public std::map<TriggerSegmentRec::ExpansionKey, TriggerExpansion>
+    {
+    public:
+        ~TriggerExpansionCache() {
+            for (iterator i = begin(); i != end(); ++i) {
+                for (size_t j = 0; j < i->second.events.size(); ++j) {
+                    delete i->second.events[j];
+                }
+            }
+        }
+    };
+}
+
 RealTime
 InternalSegmentMapper::
 toRealTime(Composition &comp, timeT t)
@@ -68,6 +96,8 @@ toRealTime(Composition &comp, timeT t)
 
 void InternalSegmentMapper::fillBuffer()
 {
+    Profiler profiler("InternalSegmentMapper::fillBuffer");
+
     Composition &comp = m_doc->getComposition();
     Track* track = comp.getTrackById(m_segment->getTrack());
 #ifdef DEBUG_INTERNAL_SEGMENT_MAPPER
@@ -104,6 +134,12 @@ void InternalSegmentMapper::fillBuffer()
     m_controllerCache.clear();
     m_noteOffs = NoteoffContainer();
 
+    // Expansions of the triggers found so far, by key.  Ornaments are
+    // often triggered many times over with the same note and timing
+    // adjustment, and copying an expansion is much cheaper than
+    // working it out again.
+    TriggerExpansionCache expansionCache;
+
     for (int repeatNo = 0; repeatNo <= repeatCount; ++repeatNo) {
 
         // For triggered segments.  We write their notes into
@@ -162,6 +198,14 @@ void InternalSegmentMapper::fillBuffer()
                 long triggerId = -1;
                 (**k)->get<Int>(BaseProperties::TRIGGER_SEGMENT_ID, triggerId);
 
+                if (triggerId >= 0 && repeatNo > 0) {
+                    // Triggers were all expanded the first time thru,
+                    // and m_triggeredEvents holds their events in
+                    // base time, ready to be played again.
+                    ++j;
+                    continue;
+                }
+
                 if (triggerId >= 0) {
 
                     TriggerSegmentRec *rec =
@@ -177,25 +221,54 @@ void InternalSegmentMapper::fillBuffer()
 
                     // Add triggered events into m_triggeredEvents.
                     // This invalidates `implied'.
-                    bool insertedSomething = rec &&
-                        rec->ExpandInto(m_triggeredEvents,
-                                        j, m_segment, &params);
+                    bool insertedSomething = false;
+                    TriggerSegmentRec::ExpansionKey key;
+
+                    if (!rec) {
+                        // Nothing to expand
+                    } else if (!rec->getExpansionKey(j, m_segment, key)) {
+                        insertedSomething =
+                            rec->ExpandInto(m_triggeredEvents,
+                                            j, m_segment, &params);
+                    } else {
+                        TriggerExpansionCache::iterator cached =
+                            expansionCache.find(key);
+
+                        if (cached == expansionCache.end()) {
+                            // Expand into a scratch segment so that we
+                            // can tell which events came from this
+                            // trigger.
+                            Segment expansion;
+                            rec->ExpandInto(&expansion, j, m_segment,
+                                            &params);
+
+                            TriggerExpansion &entry = expansionCache[key];
+                            entry.time = refTime;
+                            for (Segment::iterator i = expansion.begin();
+                                 i != expansion.end(); ++i) {
+                                entry.events.push_back(new Event(**i));
+                            }
+                            cached = expansionCache.find(key);
+                        }
+
+                        const TriggerExpansion &entry = cached->second;
+                        const timeT offset = refTime - entry.time;
+
+                        for (size_t i = 0; i < entry.events.size(); ++i) {
+                            const Event *e = entry.events[i];
+                            m_triggeredEvents->insert
+                                (new Event(*e, e->getAbsoluteTime() + offset,
+                                           e->getDuration()));
+                        }
+
+                        insertedSomething = !entry.events.empty();
+                    }
+
                     if (insertedSomething) {
                         // Re-find `implied'
                         implied =
                             Segment::iterator
                             (m_triggeredEvents->findTime(refTime));
-
-                        // Recalculate how much buffer space to
-                        // reserve.  !!! Probably should calculate the
-                        // extra from m_triggeredEvents rather than
-                        // rec->getSegment()
-                        int spaceNeeded =
-                            addSize(calculateSize(), rec->getSegment());
-                        // Reserve more space if we will need it.
-                        if (spaceNeeded > capacity()) {
-                            reserve(spaceNeeded);
-                        }
                     }
                         
                     // whatever happens, we don't want to write this one
@@ -391,7 +464,29 @@ int
 InternalSegmentMapper::calculateSize()
 {
     if (!m_segment) { return 0; }
-    return addSize(0, m_segment);
+
+    int size = addSize(0, m_segment);
+
+    // Make room for the events of any ornaments too, so that the
+    // buffer is sized once before filling rather than grown each time
+    // a trigger is expanded.
+    Composition &comp = m_doc->getComposition();
+
+    for (Segment::iterator i = m_segment->begin();
+         m_segment->isBeforeEndMarker(i); ++i) {
+
+        long triggerId = -1;
+        if (!(*i)->get<Int>(BaseProperties::TRIGGER_SEGMENT_ID, triggerId)) {
+            continue;
+        }
+
+        TriggerSegmentRec *rec = comp.getTriggerSegmentRec(triggerId);
+        if (rec && rec->getSegment()) {
+            size = addSize(size, rec->getSegment());
+        }
+    }
+
+    return size;
 }
 
 // Make the channel ready to be played on.  
@@ -27,6 +27,7 @@
 #include "misc/Strings.h"  // for qStrToBool()
 #include "misc/ConfigGroups.h"
 #include "base/Composition.h"
+#include "base/Marker.h"
 #include "base/Device.h"
 #include "base/Exception.h"
 #include "base/Instrument.h"
@@ -174,6 +175,15 @@ SequenceManager::play()
     // Make sure RosegardenSequencer has the right Instrument objects.
     preparePlayback();
 
+    // Let the sequencer prepare audio at the markers for relocation
+    std::vector<RealTime> markerTimes;
+    Composition::markercontainer &markers = comp.getMarkers();
+    for (Composition::markerconstiterator i = markers.begin();
+         i != markers.end(); ++i) {
+        markerTimes.push_back(comp.getElapsedRealTime((*i)->getTime()));
+    }
+    RosegardenSequencer::getInstance()->setMarkers(markerTimes);
+
     // Remember the last playback position so that we can return on stop.
     m_lastTransportStartPosition = comp.getPosition();
 
@@ -599,7 +599,7 @@ BankEditorDialog::populateDeviceItem(QTreeWidgetItem* deviceItem, MidiDevice* mi
 
     QString itemName = strtoqstr(midiDevice->getName());
 
-    BankList banks = midiDevice->getBanks();
+    const BankList &banks = midiDevice->getBanks();
     // add banks for this device
     for (size_t i = 0; i < banks.size(); ++i) {
         RG_DEBUG << "BankEditorDialog::populateDeviceItem - adding "
@@ -632,7 +632,7 @@ BankEditorDialog::updateDeviceItem(MidiDeviceTreeWidgetItem* deviceItem)
 
     QString itemName = strtoqstr(midiDevice->getName());
 
-    BankList banks = midiDevice->getBanks();
+    const BankList &banks = midiDevice->getBanks();
     KeyMappingList keymaps = midiDevice->getKeyMappings();
 
     // add missing banks for this device
@@ -621,7 +621,16 @@ MidiMixerWindow::slotControlChange(Instrument *instrument, int cc)
 void
 MidiMixerWindow::updateMeters()
 {
+    // Only the instruments whose meters have been set need be read
+    std::set<InstrumentId> changed;
+    SequencerDataBlock::getInstance()->getChangedInstruments
+        (SequencerDataBlock::MixerMeters, changed);
+    if (changed.empty())
+        return;
+
     for (size_t i = 0; i != m_faders.size(); ++i) {
+        if (!changed.count(m_faders[i]->m_id))
+            continue;
         LevelInfo info;
         if (!SequencerDataBlock::getInstance()->
             getInstrumentLevelForMixer(m_faders[i]->m_id, info)) {
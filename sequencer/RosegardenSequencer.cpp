@@ -33,10 +33,12 @@
 #include "sound/ControlBlock.h"
 #include "sound/SoundDriver.h"
 #include "sound/SoundDriverFactory.h"
+#include "sound/LocateCache.h"
 #include "sound/MappedInstrument.h"
 #include "sound/MappedEventInserter.h"
 #include "base/Profiler.h"
 #include "sound/PluginFactory.h"
+#include "sound/Scavenger.h"
 #include "base/Instrument.h"
 #include "base/InstrumentStaticSignals.h"
 #include "gui/studio/StudioControl.h"
@@ -59,7 +61,11 @@ RosegardenSequencer::m_instanceMutex;
 
 //#define LOCKED QMutexLocker rgseq_locker(&m_mutex); SEQUENCER_DEBUG << "Locked in " << __PRETTY_FUNCTION__ << " at " << __LINE__
 
-#define LOCKED QMutexLocker rgseq_locker(&m_mutex)
+// Code running under the lock may use plugin instances, audio queues
+// and ring buffers that the driver hands to its Scavengers, so it
+// holds this thread's ScavengerReader too.
+#define LOCKED QMutexLocker rgseq_locker(&m_mutex); \
+    ScavengerReader::Scope rgseq_reader
 
 RosegardenSequencer::RosegardenSequencer() :
     m_driver(nullptr),
@@ -152,11 +158,13 @@ void
 RosegardenSequencer::lock()
 {
     m_mutex.lock();
+    ScavengerReader::enterThread();
 }
 
 void
 RosegardenSequencer::unlock()
 {
+    ScavengerReader::leaveThread();
     m_mutex.unlock();
 }
 
@@ -207,6 +215,8 @@ RosegardenSequencer::play(const RealTime &time)
 
     SequencerDataBlock::getInstance()->setPositionPointer(m_songPosition);
 
+    LocateCache::getInstance()->addRecentPosition(m_songPosition);
+
     if (m_transportStatus != RECORDING &&
         m_transportStatus != STARTING_TO_RECORD) {
         m_transportStatus = STARTING_TO_PLAY;
@@ -405,6 +415,8 @@ RosegardenSequencer::jumpTo(const RealTime &pos)
 
     SequencerDataBlock::getInstance()->setPositionPointer(m_songPosition);
 
+    LocateCache::getInstance()->addRecentPosition(m_songPosition);
+
     m_driver->resetPlayback(oldPosition, m_songPosition);
 
     if (m_driver->isPlaying()) {
@@ -440,6 +452,15 @@ RosegardenSequencer::setLoop(const RealTime &loopStart,
     m_loopEnd = loopEnd;
 
     m_driver->setLoop(loopStart, loopEnd);
+
+    LocateCache::getInstance()->setLoopStart
+        (loopStart != loopEnd ? loopStart : RealTime::zeroTime);
+}
+
+void
+RosegardenSequencer::setMarkers(const std::vector<RealTime> &markers)
+{
+    LocateCache::getInstance()->setMarkers(markers);
 }
 
 
@@ -87,6 +87,13 @@ public:
 
     /// Set the sequencer to a given time.
     void jumpTo(const RealTime &rt);
+
+    /// Tell the sequencer where the composition markers are.
+    /**
+     * Audio at the markers is kept ready in memory so that playback
+     * can start there without waiting for the disk.
+     */
+    void setMarkers(const std::vector<RealTime> &markers);
  
     /// Return the Sound system status (audio/MIDI)
     unsigned int getSoundDriverStatus(const QString &guiVersion);
@@ -18,105 +18,259 @@
 #include "AudioCache.h"
 #include "misc/Debug.h"
 
+#include <string.h>
+#include <climits>
+
 //#define DEBUG_AUDIO_CACHE 1
 
 namespace Rosegarden
 {
 
-AudioCache::~AudioCache()
+// Enough to keep a few hundred typical drum and effect samples
+// decoded across plays and edits.
+static const size_t DefaultBudget = size_t(AudioCache::DefaultBudgetMB) * 1024 * 1024;
+
+AudioCache *
+AudioCache::getInstance()
 {
-    clear();
+    static AudioCache instance;
+    return &instance;
 }
 
-bool
-AudioCache::has(void *index)
+AudioCache::AudioCache() :
+    m_memoryUsed(0),
+    m_budget(DefaultBudget),
+    m_hits(0),
+    m_misses(0)
 {
-    return m_cache.find(index) != m_cache.end();
+    pthread_mutex_t initialisingMutex = PTHREAD_MUTEX_INITIALIZER;
+    memcpy(&m_lock, &initialisingMutex, sizeof(pthread_mutex_t));
+}
+
+AudioCache::~AudioCache()
+{
+    clear();
+    pthread_mutex_destroy(&m_lock);
 }
 
 float **
-AudioCache::getData(void *index, size_t &channels, size_t &frames)
+AudioCache::acquireData(void *index, int sampleRate, int channels,
+                        size_t &frames)
 {
-    if (m_cache.find(index) == m_cache.end())
+    pthread_mutex_lock(&m_lock);
+
+    std::map<CacheKey, CacheRec *>::iterator i =
+        m_index.find(CacheKey(index, sampleRate, channels));
+
+    if (i == m_index.end()) {
+        ++m_misses;
+        pthread_mutex_unlock(&m_lock);
         return nullptr;
-    CacheRec *rec = m_cache[index];
-    channels = rec->channels;
+    }
+
+    CacheRec *rec = i->second;
+    ++rec->refCount;
+    ++m_hits;
+
+    // move to the most recently used end
+    m_recs.splice(m_recs.end(), m_recs, rec->position);
+
+#ifdef DEBUG_AUDIO_CACHE
+    RG_DEBUG << "acquireData(" << index << "," << sampleRate << ","
+             << channels << ") [to" << rec->refCount << "]";
+#endif
+
     frames = rec->nframes;
-    return rec->data;
+    float **data = rec->data;
+
+    pthread_mutex_unlock(&m_lock);
+    return data;
 }
 
-void
-AudioCache::addData(void *index, size_t channels, size_t nframes, float **data)
+float **
+AudioCache::addData(void *index, int sampleRate, int channels,
+                    size_t nframes, float **data)
 {
 #ifdef DEBUG_AUDIO_CACHE
-    RG_DEBUG << "AudioCache::addData(" << index << ")";
+    RG_DEBUG << "addData(" << index << "," << sampleRate << ","
+             << channels << ")";
 #endif
 
-    if (m_cache.find(index) != m_cache.end()) {
-        RG_WARNING << "WARNING: AudioCache::addData(" << index << ", "
-        << channels << ", " << nframes
-        << ": already cached";
-        return ;
+    CacheKey key(index, sampleRate, channels);
+
+    pthread_mutex_lock(&m_lock);
+
+    std::map<CacheKey, CacheRec *>::iterator i = m_index.find(key);
+
+    if (i != m_index.end()) {
+        // Someone else decoded the same thing first: use theirs
+        CacheRec *rec = i->second;
+        ++rec->refCount;
+        float **existing = rec->data;
+        pthread_mutex_unlock(&m_lock);
+        for (int ch = 0; ch < channels; ++ch) delete[] data[ch];
+        delete[] data;
+        return existing;
     }
 
-    m_cache[index] = new CacheRec(data, channels, nframes);
+    CacheRec *rec = new CacheRec(key, data, channels, nframes);
+    rec->position = m_recs.insert(m_recs.end(), rec);
+    m_index[key] = rec;
+    m_dataIndex[data] = rec;
+    m_memoryUsed += rec->getBytes();
+
+    evict();
+
+    pthread_mutex_unlock(&m_lock);
+    return data;
 }
 
 void
-AudioCache::incrementReference(void *index)
+AudioCache::releaseData(float **data)
 {
-    if (m_cache.find(index) == m_cache.end()) {
-        RG_WARNING << "WARNING: AudioCache::incrementReference(" << index
-        << "): not found";
-        return ;
+    pthread_mutex_lock(&m_lock);
+
+    std::map<float **, CacheRec *>::iterator i = m_dataIndex.find(data);
+
+    if (i == m_dataIndex.end()) {
+        RG_WARNING << "WARNING: releaseData(" << data << "): not found";
+        pthread_mutex_unlock(&m_lock);
+        return;
     }
-    ++m_cache[index]->refCount;
+
+    CacheRec *rec = i->second;
+    if (rec->refCount > 0) --rec->refCount;
 
 #ifdef DEBUG_AUDIO_CACHE
-    RG_DEBUG << "AudioCache::incrementReference(" << index << ") [to " << (m_cache[index]->refCount) << "]";
+    RG_DEBUG << "releaseData(" << rec->key.index << ") [to"
+             << rec->refCount << "]";
 #endif
+
+    if (rec->refCount == 0) {
+        if (rec->forgotten) {
+            deleteRec(rec);
+        } else {
+            evict();
+        }
+    }
+
+    pthread_mutex_unlock(&m_lock);
 }
 
 void
-AudioCache::decrementReference(void *index)
+AudioCache::forgetIndex(void *index)
 {
-    std::map<void *, CacheRec *>::iterator i = m_cache.find(index);
+    pthread_mutex_lock(&m_lock);
 
-    if (i == m_cache.end()) {
-        RG_WARNING << "WARNING: AudioCache::decrementReference(" << index
-        << "): not found";
-        return ;
+    // The index is ordered by index first, so its entries are together
+    std::map<CacheKey, CacheRec *>::iterator i =
+        m_index.lower_bound(CacheKey(index, INT_MIN, INT_MIN));
+
+    while (i != m_index.end() && i->first.index == index) {
+        CacheRec *rec = i->second;
+        m_index.erase(i++);
+        if (rec->refCount == 0) {
+            deleteRec(rec);
+        } else {
+            rec->forgotten = true;
+        }
     }
-    if (i->second->refCount <= 1) {
-        delete i->second;
-        m_cache.erase(i);
-#ifdef DEBUG_AUDIO_CACHE
-        RG_DEBUG << "AudioCache::decrementReference(" << index << ") [deleting]";
-#endif
 
-    } else {
-        --i->second->refCount;
+    pthread_mutex_unlock(&m_lock);
+}
+
+size_t
+AudioCache::getBudget() const
+{
+    pthread_mutex_lock(&m_lock);
+    size_t budget = m_budget;
+    pthread_mutex_unlock(&m_lock);
+    return budget;
+}
+
+size_t
+AudioCache::getMemoryUsed() const
+{
+    pthread_mutex_lock(&m_lock);
+    size_t used = m_memoryUsed;
+    pthread_mutex_unlock(&m_lock);
+    return used;
+}
+
+int
+AudioCache::getHits() const
+{
+    pthread_mutex_lock(&m_lock);
+    int hits = m_hits;
+    pthread_mutex_unlock(&m_lock);
+    return hits;
+}
+
+int
+AudioCache::getMisses() const
+{
+    pthread_mutex_lock(&m_lock);
+    int misses = m_misses;
+    pthread_mutex_unlock(&m_lock);
+    return misses;
+}
+
+void
+AudioCache::setBudget(size_t bytes)
+{
+    pthread_mutex_lock(&m_lock);
+    m_budget = bytes;
+    evict();
+    pthread_mutex_unlock(&m_lock);
+}
+
+void
+AudioCache::evict()
+{
+    RecList::iterator i = m_recs.begin();
+
+    while (m_memoryUsed > m_budget && i != m_recs.end()) {
+        if ((*i)->refCount > 0) {
+            ++i;
+            continue;
+        }
 #ifdef DEBUG_AUDIO_CACHE
-        RG_DEBUG << "AudioCache::decrementReference(" << index << ") [to " << (m_cache[index]->refCount) << "]";
+        RG_DEBUG << "evict(): discarding" << (*i)->key.index
+                 << "to free" << (*i)->getBytes() << "bytes";
 #endif
-
+        CacheRec *rec = *i++;
+        if (!rec->forgotten) m_index.erase(rec->key);
+        deleteRec(rec);
     }
 }
 
+void
+AudioCache::deleteRec(CacheRec *rec)
+{
+    m_memoryUsed -= rec->getBytes();
+    m_recs.erase(rec->position);
+    m_dataIndex.erase(rec->data);
+    delete rec;
+}
+
 void
 AudioCache::clear()
 {
 #ifdef DEBUG_AUDIO_CACHE
-    RG_DEBUG << "AudioCache::clear()";
+    RG_DEBUG << "clear(): after" << m_hits << "hits and" << m_misses
+             << "misses";
 #endif
 
-    for (std::map<void *, CacheRec *>::iterator i = m_cache.begin();
-            i != m_cache.end(); ++i) {
-        if (i->second->refCount > 0) {
-            RG_WARNING << "WARNING: AudioCache::clear: deleting cached data with refCount " << i->second->refCount;
+    for (RecList::iterator i = m_recs.begin(); i != m_recs.end(); ++i) {
+        if ((*i)->refCount > 0) {
+            RG_WARNING << "WARNING: AudioCache::clear: deleting cached data with refCount " << (*i)->refCount;
         }
+        delete *i;
     }
-    m_cache.clear();
+    m_recs.clear();
+    m_index.clear();
+    m_dataIndex.clear();
+    m_memoryUsed = 0;
 }
 
 AudioCache::CacheRec::~CacheRec()
@@ -127,5 +281,3 @@ AudioCache::CacheRec::~CacheRec()
 }
 
 }
-
-
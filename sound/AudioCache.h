@@ -16,76 +16,145 @@
 #ifndef RG_AUDIO_CACHE_H
 #define RG_AUDIO_CACHE_H
 
+#include <pthread.h>
 #include <map>
+#include <list>
 #include <stddef.h>
 
 namespace Rosegarden
 {
 
 /**
- * A simple cache for smallish bits of audio data, indexed by some
- * opaque pointer type.  (The PlayableAudioFile uses this with an
- * AudioFile* index type, for example.)  With reference counting.
+ * A process-wide cache of decoded audio, indexed by some opaque
+ * pointer type together with the sample rate and channel count the
+ * audio was decoded to.  (The PlayableAudioFile uses this with an
+ * AudioFile* index type, for example, so that the same file played
+ * at two different rates or channel counts has two entries.)
+ *
+ * Entries are reference counted.  An entry whose reference count
+ * drops to zero is not deleted straight away, but kept in case it is
+ * wanted again, until the total size of the cache exceeds its memory
+ * budget.  Unreferenced entries are then discarded, least recently
+ * used first.  Referenced entries are never discarded, so the budget
+ * may be exceeded while they are in use.
+ *
+ * All calls are thread safe, but they take a lock and should not be
+ * made from the audio thread: hold on to the data pointer returned
+ * by acquireData() or addData() instead.  Lookups are logarithmic in
+ * the number of entries and the LRU update is constant time.
+ *
+ * The budget comes from the audio_cache_budget setting, in megabytes.
  */
 
 class AudioCache
 {
 public:
-    AudioCache() { }
-    virtual ~AudioCache();
+    static AudioCache *getInstance();
 
     /**
-     * Look some audio data up in the cache and report whether it
-     * exists.
+     * Look some audio data up in the cache for the given index,
+     * sample rate and channel count.  If it exists, increment its
+     * reference count and return one pointer per channel to samples,
+     * with the frame count in frames.  Return 0 if the data is not in
+     * cache.  Ownership of the returned data remains with the cache
+     * object, and it stays valid until releaseData is called.
      */
-    bool has(void *index);
+    float **acquireData(void *index, int sampleRate, int channels,
+                        size_t &frames);
 
     /**
-     * Look some audio data up in the cache and return it if it
-     * exists, returning the number of channels in channels, the frame
-     * count in frames, and one pointer per channel to samples in the
-     * return value.  Return 0 if the data is not in cache.  Does not
-     * affect the reference count.  Ownership of the returned data
-     * remains with the cache object.  You should not call this unless
-     * you have already called incrementReference (or addData) to
-     * register your interest.
+     * Add a piece of data to the cache with a reference count of 1.
+     * Ownership of the data is passed to the cache, which will
+     * delete it with delete[] when done.  Returns the data.
      */
-    float **getData(void *index, size_t &channels, size_t &frames);
+    float **addData(void *index, int sampleRate, int channels,
+                    size_t nframes, float **data);
 
     /**
-     * Add a piece of data to the cache, and increment the reference
-     * count for that data (to 1).  Ownership of the data is passed
-     * to the cache, which will delete it with delete[] when done.
+     * Decrement the reference count for a piece of data previously
+     * returned by acquireData or addData.  When it reaches zero the
+     * data may be discarded at any time.
      */
-    void addData(void *index, size_t channels, size_t nframes, float **data);
+    void releaseData(float **data);
 
     /**
-     * Increment the reference count for a given piece of data.
+     * Discard all unreferenced data for the given index, and make
+     * sure any data still referenced is discarded as soon as it is
+     * released.  Call this before deleting the object the index
+     * refers to, so that a later object at the same address cannot
+     * find stale data.
      */
-    void incrementReference(void *index);
+    void forgetIndex(void *index);
 
-    /**
-     * Decrement the reference count for a given piece of data,
-     * and delete the data from the cache if the reference count has
-     * reached zero.
-     */
-    void decrementReference(void *index);
+    /// Memory budget in bytes
+    size_t getBudget() const;
+    void setBudget(size_t bytes);
+
+    size_t getMemoryUsed() const;
+
+    int getHits() const;
+    int getMisses() const;
+
+    /// Default budget, in megabytes
+    static const int DefaultBudgetMB = 128;
 
 protected:
+    AudioCache();
+    virtual ~AudioCache();
+
     void clear();
 
+    struct CacheKey {
+        CacheKey(void *i, int r, int c) :
+            index(i), sampleRate(r), channels(c) { }
+        bool operator<(const CacheKey &k) const {
+            if (index != k.index) return index < k.index;
+            if (sampleRate != k.sampleRate) return sampleRate < k.sampleRate;
+            return channels < k.channels;
+        }
+        void *index;
+        int sampleRate;
+        int channels;
+    };
+
     struct CacheRec {
-        CacheRec() : data(nullptr), channels(0), nframes(0), refCount(0) { }
-        CacheRec(float **d, size_t c, size_t n) :
-            data(d), channels(c), nframes(n), refCount(1) { }
+        CacheRec(const CacheKey &k, float **d, size_t c, size_t n) :
+            key(k), data(d), channels(c), nframes(n), refCount(1),
+            forgotten(false) { }
         ~CacheRec();
+        size_t getBytes() const { return channels * nframes * sizeof(float); }
+        CacheKey key;
         float **data;
         size_t channels;
         size_t nframes;
         int refCount;
+        bool forgotten; // no longer in m_index
+        std::list<CacheRec *>::iterator position; // in m_recs
     };
 
-    std::map<void *, CacheRec *> m_cache;
+    typedef std::list<CacheRec *> RecList;
+
+    void deleteRec(CacheRec *rec);
+
+    /// Discard unreferenced entries until we are within budget.
+    /// Call with m_lock held.
+    void evict();
+
+    /// All entries, least recently used first
+    RecList m_recs;
+
+    std::map<CacheKey, CacheRec *> m_index;
+
+    /// Every entry, including forgotten ones, by its data pointer
+    std::map<float **, CacheRec *> m_dataIndex;
+
+    size_t m_memoryUsed;
+    size_t m_budget;
+
+    int m_hits;
+    int m_misses;
+
+    mutable pthread_mutex_t m_lock;
 };
 
 }
@@ -23,13 +23,16 @@
 #include "base/Profiler.h"
 #include "base/AudioLevel.h"
 #include "AudioPlayQueue.h"
+#include "LocateCache.h"
 #include "PluginFactory.h"
+#include "SequencerDataBlock.h"
 
 #include "misc/Strings.h"
 #include <sys/time.h>
 #include <pthread.h>
 
 #include <cmath>
+#include <algorithm>
 
 #ifdef __FreeBSD__
 #include <stdlib.h>
@@ -823,9 +826,11 @@ AudioBussMixer::threadRun()
 {
     while (!m_exiting) {
 
+        m_scavengerReader.enter();
         if (m_driver->areClocksRunning()) {
             kick(false);
         }
+        m_scavengerReader.leave();
 
         RealTime t = m_driver->getAudioMixBufferLength();
         t = t / 2;
@@ -1795,6 +1800,8 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
 
             std::cerr << "AudioInstrumentMixer::processBlock(" << id << "): file " << file->getAudioFile()->getFilename() << " has " << frames << " frames available, says isBuffered " << file->isBuffered() << std::endl;
 
+            if (file->isBuffered()) file->countUnderrun();
+
             if (!m_driver->getLowLatencyMode()) {
 
                 // Not a serious problem, just block on this
@@ -2057,9 +2064,11 @@ AudioInstrumentMixer::threadRun()
 {
     while (!m_exiting) {
 
+        m_scavengerReader.enter();
         if (m_driver->areClocksRunning()) {
             kick(false);
         }
+        m_scavengerReader.leave();
 
         RealTime t = m_driver->getAudioMixBufferLength();
         t = t / 2;
@@ -2081,20 +2090,77 @@ AudioInstrumentMixer::threadRun()
 
 
 
+// Number of disk threads the AudioFileReader spreads its reads over
+static const int ReadWorkerCount = 4;
+
+// Files with buffers fuller than this are left until the next pass,
+// so that they are refilled in fewer, larger reads.  The reader
+// sleeps for half a buffer length when idle, so this still leaves a
+// quarter of a buffer in hand.
+static const float RefillThreshold = 0.75f;
+
+// Most locate cache heads to build in one idle pass of the reader, so
+// as to stay responsive to playback
+static const int LocateHeadsPerPass = 2;
+
 AudioFileReader::AudioFileReader(SoundDriver *driver,
                                  unsigned int sampleRate) :
-        AudioThread("AudioFileReader", driver, sampleRate)
+        AudioThread("AudioFileReader", driver, sampleRate),
+        m_nextRequest(0),
+        m_requestsOutstanding(0),
+        m_criticalOutstanding(0),
+        m_someFilled(false),
+        m_batchActive(false)
 {
-    // nothing else here
+    pthread_mutex_t initialisingMutex = PTHREAD_MUTEX_INITIALIZER;
+    memcpy(&m_queueLock, &initialisingMutex, sizeof(pthread_mutex_t));
+
+    pthread_cond_t initialisingCondition = PTHREAD_COND_INITIALIZER;
+    memcpy(&m_requestCondition, &initialisingCondition, sizeof(pthread_cond_t));
+    memcpy(&m_doneCondition, &initialisingCondition, sizeof(pthread_cond_t));
+
+    for (int i = 0; i < ReadWorkerCount; ++i) {
+        m_workers.push_back(new AudioFileReadWorker(driver, sampleRate, this));
+    }
 }
 
 AudioFileReader::~AudioFileReader()
-{}
+{
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        delete m_workers[i];
+    }
+
+    pthread_cond_destroy(&m_requestCondition);
+    pthread_cond_destroy(&m_doneCondition);
+    pthread_mutex_destroy(&m_queueLock);
+}
+
+void
+AudioFileReader::run()
+{
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i]->run();
+    }
+
+    AudioThread::run();
+}
+
+void
+AudioFileReader::terminate()
+{
+    // Stop scheduling before taking the workers away
+    AudioThread::terminate();
+
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i]->terminate();
+    }
+}
 
 void
 AudioFileReader::fillBuffers(const RealTime &currentTime)
 {
     getLock();
+    beginBatch();
 
     // Tell every audio file the play start time.
 
@@ -2118,16 +2184,30 @@ AudioFileReader::fillBuffers(const RealTime &currentTime)
         (*fi)->clearBuffers();
     }
 
+    ReadRequestList requests;
+
     int allocated = 0;
     for (AudioPlayQueue::FileSet::const_iterator fi = files.begin();
             fi != files.end(); ++fi) {
-        (*fi)->fillBuffers(currentTime);
         if ((*fi)->getEndTime() >= currentTime) {
+            ReadRequest request;
+            request.file = *fi;
+            request.deadline = std::max(currentTime, (*fi)->getStartTime());
+            request.fill = true;
+            request.fillTime = currentTime;
+            requests.push_back(request);
             if (++allocated == poolSize)
                 break;
-        } // else the file's ring buffers will have been returned
+        } else {
+            // no reading to do: this just returns the file's ring buffers
+            (*fi)->fillBuffers(currentTime);
+        }
     }
 
+    // The transport is not running yet, so every file is needed
+    // before we return
+    performRequests(requests, RealTime::beforeMaxTime);
+
     releaseLock();
 }
 
@@ -2137,11 +2217,11 @@ AudioFileReader::kick(bool wantLock)
     if (wantLock)
         getLock();
 
+    beginBatch();
+
     RealTime now = m_driver->getSequencerTime();
     const AudioPlayQueue *queue = m_driver->getAudioQueue();
 
-    bool someFilled = false;
-
     // Tell files that are playing or will be playing in the next few
     // seconds to update.
 
@@ -2150,30 +2230,202 @@ AudioFileReader::kick(bool wantLock)
     queue->getPlayingFiles
     (now, RealTime(3, 0) + m_driver->getAudioReadBufferLength(), playing);
 
+    ReadRequestList requests;
+
     for (AudioPlayQueue::FileSet::iterator fi = playing.begin();
             fi != playing.end(); ++fi) {
 
-        if (!(*fi)->isBuffered()) {
+        PlayableAudioFile *file = *fi;
+
+#ifdef DEBUG_READER
+        std::cerr << "AudioFileReader::kick: " << file->getAudioFile()->getShortFilename() << ": buffer " << int(file->getBufferFillLevel() * 100) << "% full, " << file->getUnderrunCount() << " underruns" << std::endl;
+#endif
+
+        int underruns = file->takeNewUnderruns();
+        if (underruns > 0) {
+            std::cerr << "WARNING: AudioFileReader::kick: "
+                      << file->getAudioFile()->getShortFilename() << ": "
+                      << underruns << " new underruns ("
+                      << file->getUnderrunCount() << " in all), buffer "
+                      << int(file->getBufferFillLevel() * 100) << "% full"
+                      << std::endl;
+        }
+
+        ReadRequest request;
+        request.file = file;
+
+        if (!file->isBuffered()) {
             // fillBuffers has not been called on this file.  This
             // happens when a file is unmuted during playback.  The
             // results are unpredictable because we can no longer
             // synchronise with the correct JACK callback slice at
             // this point, but this is better than allowing the file
             // to update from its start as would otherwise happen.
-            (*fi)->fillBuffers(now);
-            someFilled = true;
+            request.deadline = std::max(now, file->getStartTime());
+            request.fill = true;
+            request.fillTime = now;
         } else {
-            if ((*fi)->updateBuffers())
-                someFilled = true;
+            if (file->isFullyBuffered() ||
+                file->getBufferFillLevel() > RefillThreshold) {
+                continue;
+            }
+            request.deadline = file->getBufferDeadline(now);
+            request.fill = false;
         }
+
+        requests.push_back(request);
     }
 
+    // Wait only for the files that would run dry before our next
+    // pass; the rest are topped up in the background.
+    RealTime criticalTime = now + m_driver->getAudioReadBufferLength() / 2;
+
+    bool someFilled = performRequests(requests, criticalTime);
+
     if (wantLock)
         releaseLock();
 
     return someFilled;
 }
 
+void
+AudioFileReader::beginBatch()
+{
+    pthread_mutex_lock(&m_queueLock);
+    pthread_cleanup_push(staticQueueCleanup, this);
+
+    // Drop the requests no worker has taken yet, as the new batch
+    // will ask again for any file that still needs them, and wait for
+    // the reads already under way.
+
+    if (m_nextRequest < m_requests.size()) {
+        m_requestsOutstanding -= m_requests.size() - m_nextRequest;
+        m_nextRequest = m_requests.size();
+    }
+
+    while (m_requestsOutstanding > 0) {
+        pthread_cond_wait(&m_doneCondition, &m_queueLock);
+    }
+
+    endBatch();
+
+    m_batchReader.enter();
+    m_batchActive = true;
+
+    pthread_cleanup_pop(1);
+}
+
+void
+AudioFileReader::endBatch()
+{
+    m_requests.clear();
+    m_nextRequest = 0;
+
+    if (m_batchActive) {
+        m_batchReader.leave();
+        m_batchActive = false;
+    }
+}
+
+bool
+AudioFileReader::performRequests(ReadRequestList &requests,
+                                 const RealTime &criticalTime)
+{
+    bool someFilled = false;
+
+    if (requests.empty() || m_workers.empty() || !m_workers[0]->running()) {
+        std::sort(requests.begin(), requests.end());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            PlayableAudioFile *file = requests[i].file;
+            if (requests[i].fill ? file->fillBuffers(requests[i].fillTime) :
+                                   file->updateBuffers()) {
+                someFilled = true;
+            }
+        }
+        pthread_mutex_lock(&m_queueLock);
+        endBatch();
+        pthread_mutex_unlock(&m_queueLock);
+        return someFilled;
+    }
+
+    std::sort(requests.begin(), requests.end());
+
+    pthread_mutex_lock(&m_queueLock);
+    pthread_cleanup_push(staticQueueCleanup, this);
+
+    m_requests = requests;
+    m_nextRequest = 0;
+    m_requestsOutstanding = m_requests.size();
+    m_criticalOutstanding = 0;
+    m_someFilled = false;
+
+    // Sorted by deadline, so the critical requests come first
+    for (size_t i = 0; i < m_requests.size(); ++i) {
+        m_requests[i].critical = (m_requests[i].deadline < criticalTime);
+        if (m_requests[i].critical) ++m_criticalOutstanding;
+    }
+
+    pthread_cond_broadcast(&m_requestCondition);
+
+    while (m_criticalOutstanding > 0) {
+        pthread_cond_wait(&m_doneCondition, &m_queueLock);
+    }
+
+    someFilled = m_someFilled;
+
+    pthread_cleanup_pop(1);
+
+    return someFilled;
+}
+
+void
+AudioFileReader::takeRequest(ReadRequest &request)
+{
+    pthread_mutex_lock(&m_queueLock);
+    pthread_cleanup_push(staticQueueCleanup, this);
+
+    while (m_nextRequest >= m_requests.size()) {
+        pthread_cond_wait(&m_requestCondition, &m_queueLock);
+    }
+
+    request = m_requests[m_nextRequest++];
+
+    pthread_cleanup_pop(1);
+}
+
+void
+AudioFileReader::requestDone(bool filled, bool critical)
+{
+    pthread_mutex_lock(&m_queueLock);
+
+    if (filled) m_someFilled = true;
+
+    bool wake = false;
+
+    if (critical && --m_criticalOutstanding == 0) {
+        wake = true;
+    }
+
+    if (--m_requestsOutstanding == 0) {
+        endBatch();
+        wake = true;
+    }
+
+    if (wake) {
+        pthread_cond_signal(&m_doneCondition);
+    }
+
+    pthread_mutex_unlock(&m_queueLock);
+}
+
+void
+AudioFileReader::staticQueueCleanup(void *arg)
+{
+    // Release the queue lock if we are cancelled while waiting on it
+    AudioFileReader *inst = static_cast<AudioFileReader *>(arg);
+    pthread_mutex_unlock(&inst->m_queueLock);
+}
+
 void
 AudioFileReader::threadRun()
 {
@@ -2185,9 +2437,17 @@ AudioFileReader::threadRun()
 
         bool someFilled = false;
 
+        m_scavengerReader.enter();
         if (m_driver->areClocksRunning()) {
             someFilled = kick(false);
         }
+        if (!someFilled) {
+            // Spend idle time getting ready for the next relocation
+            LocateCache::getInstance()->update
+                (m_driver->getAudioQueue()->getAllScheduledFiles(),
+                 LocateHeadsPerPass);
+        }
+        m_scavengerReader.leave();
 
         if (someFilled) {
 
@@ -2216,6 +2476,41 @@ AudioFileReader::threadRun()
 }
 
 
+AudioFileReadWorker::AudioFileReadWorker(SoundDriver *driver,
+                                         unsigned int sampleRate,
+                                         AudioFileReader *reader) :
+        AudioThread("AudioFileReadWorker", driver, sampleRate),
+        m_reader(reader)
+{
+    // nothing else here
+}
+
+AudioFileReadWorker::~AudioFileReadWorker()
+{}
+
+void
+AudioFileReadWorker::threadRun()
+{
+    // Requests are handed out under the reader's queue lock; our own
+    // lock is held throughout but nothing else waits on it.
+
+    while (!m_exiting) {
+
+        AudioFileReader::ReadRequest request;
+        m_reader->takeRequest(request);
+
+        bool filled;
+        if (request.fill) {
+            filled = request.file->fillBuffers(request.fillTime, m_buffers);
+        } else {
+            filled = request.file->updateBuffers(m_buffers);
+        }
+
+        m_reader->requestDone(filled, request.critical);
+    }
+}
+
+
 
 AudioFileWriter::AudioFileWriter(SoundDriver *driver,
                                  unsigned int sampleRate) :
@@ -2327,9 +2622,18 @@ AudioFileWriter::write(InstrumentId id,
 {
     if (!m_files[id].first)
         return ; // no file
-    if (m_files[id].second->buffer(samples, channel, sampleCount) < sampleCount) {
+
+    RecordableAudioFile *raf = m_files[id].second;
+
+    if (raf->buffer(samples, channel, sampleCount) < sampleCount) {
         m_driver->reportFailure(MappedEvent::FailureDiscOverrun);
     }
+
+    // Wake the disk thread as soon as there's a block to write,
+    // rather than leaving it until its next timeout
+    if (channel == 0 && raf->haveBlockToWrite()) {
+        signal();
+    }
 }
 
 bool
@@ -2428,6 +2732,18 @@ AudioFileWriter::kick(bool wantLock)
 #endif
 
             raf->write();
+
+            RealTime writeTime = raf->getLastWriteTime();
+            RealTime worstWriteTime = raf->getWorstWriteTime();
+
+            RecordDiskInfo info;
+            info.bufferFill = int(raf->getLastBufferFill() * 100 + 0.5);
+            info.writeTime = writeTime.sec * 1000000 + writeTime.usec();
+            info.worstWriteTime =
+                worstWriteTime.sec * 1000000 + worstWriteTime.usec();
+            info.overruns = raf->getOverruns();
+            SequencerDataBlock::getInstance()->
+                setInstrumentRecordDiskInfo(id, info);
         }
     }
 
@@ -2440,8 +2756,12 @@ AudioFileWriter::threadRun()
 {
     while (!m_exiting) {
 
+        m_scavengerReader.enter();
         kick(false);
+        m_scavengerReader.leave();
 
+        // write() signals us when a file has a block ready, so this
+        // timeout is only a fallback
         RealTime t = m_driver->getAudioWriteBufferLength();
         t = t / 2;
         if (t < RealTime(0, 10000000))
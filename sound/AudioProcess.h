@@ -22,7 +22,9 @@
 #include "RingBuffer.h"
 #include "RunnablePluginInstance.h"
 #include "AudioPlayQueue.h"
+#include "PlayableAudioFile.h"
 #include "RecordableAudioFile.h"
+#include "Scavenger.h"
 
 namespace Rosegarden
 {
@@ -39,11 +41,11 @@ public:
     virtual ~AudioThread();
 
     // This is to be called by the owning class after construction.
-    void run();
+    virtual void run();
 
     // This is to be called by the owning class to cause the thread to
     // exit and clean up, before destruction.
-    void terminate();
+    virtual void terminate();
 
     bool running() const { return m_running; }
 
@@ -67,6 +69,10 @@ protected:
     bool              m_running;
     volatile bool     m_exiting;
 
+    // Brackets each pass of threadRun(), so that objects claimed by
+    // the driver's scavengers are not freed while we are using them.
+    ScavengerReader   m_scavengerReader;
+
 private:
     static void *staticThreadRun(void *arg);
     static void  staticThreadCleanup(void *arg);
@@ -330,6 +336,26 @@ protected:
 };
 
 
+class AudioFileReadWorker;
+
+/**
+ * Keeps the ring buffers of the playing audio files topped up from
+ * disk.  The reader thread itself only schedules the work: on each
+ * pass it collects the files that need refilling, orders them by the
+ * time at which each would run out of data, and hands them to a small
+ * pool of AudioFileReadWorker threads.  It waits only for the files
+ * that would run dry before its next pass, leaving the workers to top
+ * up the rest in the background.  A slow read on one file therefore
+ * holds up only the worker doing it, and the most urgent files are
+ * always read first.
+ *
+ * Files whose underrun count has grown since the last pass are
+ * reported on stderr with their buffer fill level.
+ *
+ * Files whose buffers are still mostly full are left until more
+ * space is free, so that each refill is a single larger sequential
+ * read rather than many small ones.
+ */
 class AudioFileReader : public AudioThread
 {
 public:
@@ -338,6 +364,9 @@ public:
 
     ~AudioFileReader() override;
 
+    void run() override;
+    void terminate() override;
+
     bool kick(bool wantLock = true);
 
     /**
@@ -346,8 +375,88 @@ public:
      */
     void fillBuffers(const RealTime &currentTime);
 
+protected:
+    friend class AudioFileReadWorker;
+
+    void threadRun() override;
+
+    struct ReadRequest
+    {
+        PlayableAudioFile *file;
+        RealTime deadline;
+        bool fill; // fillBuffers from fillTime rather than updateBuffers
+        RealTime fillTime;
+        bool critical; // performRequests() waits for this one
+
+        bool operator<(const ReadRequest &r) const {
+            return deadline < r.deadline;
+        }
+    };
+
+    typedef std::vector<ReadRequest> ReadRequestList;
+
+    /**
+     * Drop the requests left over from the last batch, wait for any
+     * the workers are still reading, then enter m_batchReader.  Call
+     * before looking at the audio queue, so that every file a request
+     * names is covered until the workers have finished with it.
+     */
+    void beginBatch();
+
+    /**
+     * Run the given requests on the workers, most urgent first, and
+     * return once those with a deadline before criticalTime have
+     * completed.  The others carry on in the background, and
+     * m_batchReader is left once they are done.  Returns true if any
+     * file was read by the time of returning.
+     */
+    bool performRequests(ReadRequestList &requests,
+                         const RealTime &criticalTime);
+
+    /// End a batch that has nothing left to do.  Call with m_queueLock held.
+    void endBatch();
+
+    // Called from the workers
+    void takeRequest(ReadRequest &request);
+    void requestDone(bool filled, bool critical);
+    static void staticQueueCleanup(void *arg);
+
+    std::vector<AudioFileReadWorker *> m_workers;
+
+    ReadRequestList   m_requests;
+    size_t            m_nextRequest;
+    size_t            m_requestsOutstanding;
+    size_t            m_criticalOutstanding;
+    bool              m_someFilled;
+
+    ScavengerReader   m_batchReader;
+    bool              m_batchActive;
+
+    pthread_mutex_t   m_queueLock;
+    pthread_cond_t    m_requestCondition;
+    pthread_cond_t    m_doneCondition;
+};
+
+
+/**
+ * One of the AudioFileReader's disk threads.  Each worker has its own
+ * read and decode buffers, so workers can read different files at
+ * the same time.
+ */
+class AudioFileReadWorker : public AudioThread
+{
+public:
+    AudioFileReadWorker(SoundDriver *driver,
+                        unsigned int sampleRate,
+                        AudioFileReader *reader);
+
+    ~AudioFileReadWorker() override;
+
 protected:
     void threadRun() override;
+
+    AudioFileReader *m_reader;
+    PlayableAudioFile::ReadBuffers m_buffers;
 };
 
 
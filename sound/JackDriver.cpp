@@ -18,6 +18,7 @@
 #include "JackDriver.h"
 #include "AlsaDriver.h"
 #include "MappedStudio.h"
+#include "AudioCache.h"
 #include "AudioProcess.h"
 #include "base/Profiler.h"
 #include "base/AudioLevel.h"
@@ -30,6 +31,8 @@
 #include <QSettings>
 #include <QtGlobal>
 
+#include <cmath>
+
 #ifdef HAVE_ALSA
 #ifdef HAVE_LIBJACK
 
@@ -46,6 +49,15 @@ static unsigned long framesThisPlay = 0;
 static RealTime startTime;
 #endif
 
+// The RMS of a block of frames as a long fader value, for the meters
+static int
+rmsToFader(float sumOfSquares, size_t frames)
+{
+    if (frames == 0) return 0;
+    return AudioLevel::multiplier_to_fader
+        (sqrtf(sumOfSquares / frames), 127, AudioLevel::LongFader);
+}
+
 JackDriver::JackDriver(AlsaDriver *alsaDriver) :
         m_client(nullptr),
         m_bufferSize(0),
@@ -218,7 +230,12 @@ JackDriver::initialise(bool reinitialise)
     QSettings settings;
     settings.beginGroup(SequencerOptionsConfigGroup);
     bool autoStartJack = settings.value("autostartjack", true).toBool();
+    int audioCacheBudget = settings.value("audio_cache_budget",
+                                          AudioCache::DefaultBudgetMB).toInt();
     settings.endGroup();
+
+    // In megabytes
+    AudioCache::getInstance()->setBudget(size_t(audioCacheBudget) * 1024 * 1024);
     // default is to auto start JACK; use JackNullOption
     jack_options_t jackOptions = JackNullOption;
     if (!autoStartJack) jackOptions = JackNoStartServer;
@@ -782,10 +799,13 @@ int
 JackDriver::jackProcessStatic(jack_nframes_t nframes, void *arg)
 {
     JackDriver *inst = static_cast<JackDriver*>(arg);
-    if (inst)
-        return inst->jackProcess(nframes);
-    else
+    if (!inst)
         return 0;
+
+    inst->m_scavengerReader.enter();
+    int rv = inst->jackProcess(nframes);
+    inst->m_scavengerReader.leave();
+    return rv;
 }
 
 int
@@ -1035,6 +1055,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
 
         sample_t *submaster[2] = { nullptr, nullptr };
         sample_t peak[2] = { 0.0, 0.0 };
+        float sumOfSquares[2] = { 0.0, 0.0 };
 
         if ((int)m_outputSubmasters.size() > buss * 2 + 1) {
             submaster[0] =
@@ -1067,6 +1088,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
                     sample_t sample = submaster[ch][i];
                     if (sample > peak[ch])
                         peak[ch] = sample;
+                    sumOfSquares[ch] += sample * sample;
                     master[ch][i] += sample;
                 }
             }
@@ -1077,6 +1099,8 @@ JackDriver::jackProcess(jack_nframes_t nframes)
                 peak[0], 127, AudioLevel::LongFader);
         info.levelRight = AudioLevel::multiplier_to_fader(
                 peak[1], 127, AudioLevel::LongFader);
+        info.rms = rmsToFader(sumOfSquares[0], nframes);
+        info.rmsRight = rmsToFader(sumOfSquares[1], nframes);
 
         SequencerDataBlock::getInstance()->setSubmasterLevel(buss, info);
 
@@ -1108,6 +1132,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
 
         sample_t *instrument[2] = { nullptr, nullptr };
         sample_t peak[2] = { 0.0, 0.0 };
+        float sumOfSquares[2] = { 0.0, 0.0 };
 
         if (int(m_outputInstruments.size()) > i * 2 + 1) {
             instrument[0] =
@@ -1183,6 +1208,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
                     sample_t sample = instrument[ch][f];
                     if (sample > peak[ch])
                         peak[ch] = sample;
+                    sumOfSquares[ch] += sample * sample;
                     if (directToMaster)
                         master[ch][f] += sample;
                 }
@@ -1203,6 +1229,8 @@ JackDriver::jackProcess(jack_nframes_t nframes)
                 peak[0], 127, AudioLevel::LongFader);
         info.levelRight = AudioLevel::multiplier_to_fader(
                 peak[1], 127, AudioLevel::LongFader);
+        info.rms = rmsToFader(sumOfSquares[0], nframes);
+        info.rmsRight = rmsToFader(sumOfSquares[1], nframes);
 
         SequencerDataBlock::getInstance()->setInstrumentLevel(id, info);
     }
@@ -1223,12 +1251,14 @@ JackDriver::jackProcess(jack_nframes_t nframes)
     // Get master fader levels.  There's no pan on the master.
     float gain = AudioLevel::dB_to_multiplier(m_masterLevel);
     float masterPeak[2] = { 0.0, 0.0 };
+    float masterSumOfSquares[2] = { 0.0, 0.0 };
 
     for (int ch = 0; ch < 2; ++ch) {
         for (size_t i = 0; i < nframes; ++i) {
             sample_t sample = master[ch][i] * gain;
             if (sample > masterPeak[ch])
                 masterPeak[ch] = sample;
+            masterSumOfSquares[ch] += sample * sample;
             master[ch][i] = sample;
         }
     }
@@ -1238,6 +1268,8 @@ JackDriver::jackProcess(jack_nframes_t nframes)
             masterPeak[0], 127, AudioLevel::LongFader);
     info.levelRight = AudioLevel::multiplier_to_fader(
             masterPeak[1], 127, AudioLevel::LongFader);
+    info.rms = rmsToFader(masterSumOfSquares[0], nframes);
+    info.rmsRight = rmsToFader(masterSumOfSquares[1], nframes);
 
     SequencerDataBlock::getInstance()->setMasterLevel(info);
 
@@ -1349,6 +1381,7 @@ JackDriver::jackProcessRecord(InstrumentId id,
 
     bool wroteSomething = false;
     sample_t peakLeft = 0.0, peakRight = 0.0;
+    float sumOfSquaresLeft = 0.0, sumOfSquaresRight = 0.0;
 
 #ifdef DEBUG_JACK_PROCESS
     RG_DEBUG << "jackProcessRecord(" << id << "): clocksRunning " << clocksRunning;
@@ -1424,6 +1457,7 @@ JackDriver::jackProcessRecord(InstrumentId id,
                 sample_t sample = inputBufferLeft[i] * gain;
                 if (sample > peakLeft)
                     peakLeft = sample;
+                sumOfSquaresLeft += sample * sample;
                 m_tempOutBuffer[i] = sample;
             }
 
@@ -1448,6 +1482,7 @@ JackDriver::jackProcessRecord(InstrumentId id,
                     sample_t sample = inputBufferRight[i] * gain;
                     if (sample > peakRight)
                         peakRight = sample;
+                    sumOfSquaresRight += sample * sample;
                     m_tempOutBuffer[i] = sample;
                 }
                 if (m_outputMonitors.size() > 1) {
@@ -1487,6 +1522,7 @@ JackDriver::jackProcessRecord(InstrumentId id,
                 sample_t sample = inputBufferLeft[i] * gain;
                 if (sample > peakLeft)
                     peakLeft = sample;
+                sumOfSquaresLeft += sample * sample;
                 if (buf)
                     buf[i] = sample;
             }
@@ -1503,6 +1539,7 @@ JackDriver::jackProcessRecord(InstrumentId id,
                     sample_t sample = inputBufferRight[i] * gain;
                     if (sample > peakRight)
                         peakRight = sample;
+                    sumOfSquaresRight += sample * sample;
                     if (buf)
                         buf[i] = sample;
                 }
@@ -1510,14 +1547,18 @@ JackDriver::jackProcessRecord(InstrumentId id,
         }
     }
 
-    if (channels < 2)
+    if (channels < 2) {
         peakRight = peakLeft;
+        sumOfSquaresRight = sumOfSquaresLeft;
+    }
 
     LevelInfo info;
     info.level = AudioLevel::multiplier_to_fader
             (peakLeft, 127, AudioLevel::LongFader);
     info.levelRight = AudioLevel::multiplier_to_fader
             (peakRight, 127, AudioLevel::LongFader);
+    info.rms = rmsToFader(sumOfSquaresLeft, nframes);
+    info.rmsRight = rmsToFader(sumOfSquaresRight, nframes);
     SequencerDataBlock::getInstance()->setInstrumentRecordLevel(id, info);
 
     if (wroteSomething) {
@@ -25,6 +25,7 @@
 #include "base/Instrument.h"
 #include "base/RealTime.h"
 #include "ExternalTransport.h"
+#include "Scavenger.h"
 #include <QStringList>
 
 namespace Rosegarden
@@ -281,6 +282,9 @@ protected:
     time_t                       m_kickedOutAt;
     size_t                       m_framesProcessed;
 
+    // Brackets each jackProcess() call for the driver's scavengers
+    ScavengerReader              m_scavengerReader;
+
     // initialise() has completed successfully, and there are no other issues
     bool                         m_ok;
 };
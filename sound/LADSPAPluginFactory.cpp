@@ -29,6 +29,7 @@
 #include "LADSPAPluginInstance.h"
 #include "MappedStudio.h"
 #include "PluginIdentifier.h"
+#include "base/Profiler.h"
 
 //#include <lrdf.h>
 
@@ -617,6 +618,10 @@ LADSPAPluginFactory::getLRDFPath(QString &baseUri)
 void
 LADSPAPluginFactory::discoverPlugins()
 {
+    // Shown as they finish, to give a breakdown of the time this adds
+    // to startup.
+    Profiler profiler("LADSPAPluginFactory::discoverPlugins", true);
+
     RG_DEBUG << "discoverPlugins() begin...";
 
     std::vector<QString> pathList = getPluginPath();
@@ -652,7 +657,16 @@ LADSPAPluginFactory::discoverPlugins()
         generateTaxonomy(baseUri + "Plugin", "");
     }*/
 
-    generateFallbackCategories();
+    {
+        Profiler categoryProfiler
+            ("LADSPAPluginFactory::discoverPlugins: categories", true);
+        generateFallbackCategories();
+    }
+
+    Profiler libraryProfiler
+        ("LADSPAPluginFactory::discoverPlugins: libraries", true);
+
+    int libraryCount = 0;
 
     for (std::vector<QString>::iterator i = pathList.begin();
             i != pathList.end(); ++i) {
@@ -661,9 +675,15 @@ LADSPAPluginFactory::discoverPlugins()
 
         for (unsigned int j = 0; j < pluginDir.count(); ++j) {
             discoverPlugin(QString("%1/%2").arg(*i).arg(pluginDir[j]));
+            ++libraryCount;
         }
     }
 
+    libraryProfiler.end();
+
+    RG_DEBUG << "discoverPlugins():" << libraryCount << "libraries,"
+             << m_identifiers.size() << "plugins";
+
     // Cleanup after the RDF library
     //
     //lrdf_cleanup();
@@ -0,0 +1,445 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[LocateCache]"
+
+#include "LocateCache.h"
+#include "AudioFile.h"
+#include "PlayableAudioFile.h"
+#include "misc/Debug.h"
+
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+
+//#define DEBUG_LOCATE_CACHE 1
+
+namespace Rosegarden
+{
+
+// How much audio to keep from each locate point.  This only has to
+// cover the time taken for the disk thread to catch up after a
+// relocation.
+static const RealTime HeadLength(0, 500000000);
+
+// How many of the most recent playback start positions to cache for
+static const size_t RecentPositionCount = 4;
+
+static const size_t DefaultBudget = 64 * 1024 * 1024;
+
+LocateCache *
+LocateCache::getInstance()
+{
+    static LocateCache instance;
+    return &instance;
+}
+
+LocateCache::LocateCache() :
+    m_memoryUsed(0),
+    m_budget(DefaultBudget),
+    m_building(false),
+    m_buildingFileId(0),
+    m_forgetCount(0)
+{
+    pthread_mutex_t initialisingMutex = PTHREAD_MUTEX_INITIALIZER;
+    memcpy(&m_lock, &initialisingMutex, sizeof(pthread_mutex_t));
+
+    pthread_cond_t initialisingCondition = PTHREAD_COND_INITIALIZER;
+    memcpy(&m_buildDone, &initialisingCondition, sizeof(pthread_cond_t));
+}
+
+LocateCache::~LocateCache()
+{
+    clear();
+    pthread_cond_destroy(&m_buildDone);
+    pthread_mutex_destroy(&m_lock);
+}
+
+size_t
+LocateCache::getBudget() const
+{
+    pthread_mutex_lock(&m_lock);
+    size_t budget = m_budget;
+    pthread_mutex_unlock(&m_lock);
+    return budget;
+}
+
+void
+LocateCache::setBudget(size_t bytes)
+{
+    pthread_mutex_lock(&m_lock);
+    m_budget = bytes;
+    pthread_mutex_unlock(&m_lock);
+}
+
+size_t
+LocateCache::getMemoryUsed() const
+{
+    pthread_mutex_lock(&m_lock);
+    size_t used = m_memoryUsed;
+    pthread_mutex_unlock(&m_lock);
+    return used;
+}
+
+void
+LocateCache::setLoopStart(const RealTime &loopStart)
+{
+    pthread_mutex_lock(&m_lock);
+    m_loopStart = loopStart;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void
+LocateCache::setMarkers(const std::vector<RealTime> &markers)
+{
+    pthread_mutex_lock(&m_lock);
+    m_markers = markers;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void
+LocateCache::addRecentPosition(const RealTime &position)
+{
+    pthread_mutex_lock(&m_lock);
+
+    std::vector<RealTime>::iterator i =
+        std::find(m_recentPositions.begin(), m_recentPositions.end(), position);
+    if (i != m_recentPositions.end()) {
+        m_recentPositions.erase(i);
+    }
+
+    m_recentPositions.insert(m_recentPositions.begin(), position);
+    if (m_recentPositions.size() > RecentPositionCount) {
+        m_recentPositions.resize(RecentPositionCount);
+    }
+
+    pthread_mutex_unlock(&m_lock);
+}
+
+std::vector<RealTime>
+LocateCache::getLocatePoints()
+{
+    // In order of priority, for when the budget is tight
+
+    std::vector<RealTime> points;
+
+    pthread_mutex_lock(&m_lock);
+
+    if (m_loopStart != RealTime::zeroTime) {
+        points.push_back(m_loopStart);
+    }
+    points.insert(points.end(),
+                  m_recentPositions.begin(), m_recentPositions.end());
+    points.insert(points.end(), m_markers.begin(), m_markers.end());
+
+    pthread_mutex_unlock(&m_lock);
+
+    return points;
+}
+
+void
+LocateCache::update(const AudioPlayQueue::FileSet &files, int maxHeads)
+{
+    std::vector<RealTime> points = getLocatePoints();
+
+    std::vector<Head> missing;
+    std::vector<AudioFile *> missingFiles;
+
+    pthread_mutex_lock(&m_lock);
+
+    // The AudioFiles are owned by the driver, which calls forgetFile()
+    // before deleting one.  Any that is forgotten after this point is
+    // not read from.
+    unsigned int forgetCount = m_forgetCount;
+
+    for (HeadList::iterator i = m_heads.begin(); i != m_heads.end(); ++i) {
+        (*i)->wanted = false;
+    }
+
+    for (size_t p = 0; p < points.size(); ++p) {
+
+        const RealTime &point = points[p];
+
+        for (AudioPlayQueue::FileSet::const_iterator fi = files.begin();
+             fi != files.end(); ++fi) {
+
+            PlayableAudioFile *file = *fi;
+
+            // small files are already held in memory in full
+            if (file->isSmallFile()) continue;
+
+            if (file->getStartTime() >= point + HeadLength ||
+                file->getEndTime() <= point) continue;
+
+            RealTime position = file->getStartIndex();
+            if (point > file->getStartTime()) {
+                position = position + point - file->getStartTime();
+            }
+
+            AudioFile *audioFile = file->getAudioFile();
+            AudioFileId fileId = audioFile->getId();
+            int channels = file->getTargetChannels();
+            int sampleRate = file->getTargetSampleRate();
+
+            bool found = false;
+
+            for (HeadList::iterator i = m_heads.begin();
+                 i != m_heads.end(); ++i) {
+                if ((*i)->matches(fileId, position, channels, sampleRate)) {
+                    (*i)->wanted = true;
+                    found = true;
+                    break;
+                }
+            }
+
+            for (size_t i = 0; !found && i < missing.size(); ++i) {
+                found = missing[i].matches
+                    (fileId, position, channels, sampleRate);
+            }
+
+            if (found) continue;
+
+            Head head;
+            head.fileId = fileId;
+            head.position = position;
+            head.channels = channels;
+            head.sampleRate = sampleRate;
+            head.wanted = true;
+            missing.push_back(head);
+            missingFiles.push_back(audioFile);
+        }
+    }
+
+    for (HeadList::iterator i = m_heads.begin(); i != m_heads.end(); ) {
+        if ((*i)->wanted) {
+            ++i;
+        } else {
+            deleteHead(*i);
+            i = m_heads.erase(i);
+        }
+    }
+
+    // Build the most important of the missing heads, outside the lock
+    // as this means reading from disk.  Mark the file as being built
+    // from first, so that forgetFile() waits for us before the file
+    // can be deleted.
+
+    int built = 0;
+
+    for (size_t i = 0; i < missing.size() && built < maxHeads; ++i) {
+
+        if (m_forgetCount != forgetCount) break;
+
+        size_t bytes = RealTime::realTime2Frame(HeadLength, missing[i].sampleRate)
+            * missing[i].channels * sizeof(float);
+        if (m_memoryUsed + bytes > m_budget) break;
+
+        m_building = true;
+        m_buildingFileId = missing[i].fileId;
+
+        pthread_mutex_unlock(&m_lock);
+
+        Head *head = new Head(missing[i]);
+        bool ok = buildHead(head, missingFiles[i]);
+
+        pthread_mutex_lock(&m_lock);
+
+        m_building = false;
+        pthread_cond_broadcast(&m_buildDone);
+
+        // The file may have been forgotten while we were reading it
+        if (!ok || m_forgetCount != forgetCount) {
+            for (size_t ch = 0; ch < head->data.size(); ++ch) {
+                delete[] head->data[ch];
+            }
+            delete head;
+            continue;
+        }
+
+        m_heads.push_back(head);
+        m_memoryUsed += head->frames * head->channels * sizeof(float);
+
+        ++built;
+    }
+
+#ifdef DEBUG_LOCATE_CACHE
+    if (built > 0) {
+        RG_DEBUG << "update(): built" << built << "of" << missing.size()
+                 << "missing heads for" << points.size() << "locate points,"
+                 << m_memoryUsed << "bytes used";
+    }
+#endif
+
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool
+LocateCache::buildHead(Head *head, AudioFile *audioFile)
+{
+    std::ifstream stream(audioFile->getFilename().toLocal8Bit(),
+                         std::ios::in | std::ios::binary);
+    if (!stream) return false;
+
+    if (!audioFile->scanTo(&stream, head->position)) return false;
+
+    size_t frames = RealTime::realTime2Frame(HeadLength, head->sampleRate);
+
+    size_t fileFrames = frames;
+    if (head->sampleRate != int(audioFile->getSampleRate())) {
+        fileFrames = size_t(float(frames) * float(audioFile->getSampleRate()) /
+                            float(head->sampleRate));
+    }
+
+    size_t bytesPerFrame = audioFile->getBytesPerFrame();
+    std::vector<char> raw(fileFrames * bytesPerFrame);
+
+    size_t obtained =
+        audioFile->getSampleFrames(&stream, &raw[0], fileFrames);
+    if (obtained == 0) return false;
+
+    if (obtained < fileFrames) {
+        frames = size_t(float(obtained) * float(head->sampleRate) /
+                        float(audioFile->getSampleRate()));
+        if (frames == 0) return false;
+    }
+
+    for (int ch = 0; ch < head->channels; ++ch) {
+        head->data.push_back(new float[frames]);
+    }
+    head->frames = frames;
+
+    if (!audioFile->decode((const unsigned char *)&raw[0],
+                           obtained * bytesPerFrame,
+                           head->sampleRate,
+                           head->channels,
+                           frames,
+                           head->data,
+                           false)) {
+        for (size_t ch = 0; ch < head->data.size(); ++ch) {
+            delete[] head->data[ch];
+        }
+        head->data.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void
+LocateCache::deleteHead(Head *head)
+{
+    m_memoryUsed -= head->frames * head->channels * sizeof(float);
+
+    for (size_t ch = 0; ch < head->data.size(); ++ch) {
+        delete[] head->data[ch];
+    }
+
+    delete head;
+}
+
+size_t
+LocateCache::read(AudioFileId fileId, const RealTime &position,
+                  int channels, int sampleRate,
+                  RingBuffer<float> **targets, size_t maxFrames,
+                  size_t fadeFrames)
+{
+    size_t written = 0;
+
+    pthread_mutex_lock(&m_lock);
+
+    for (HeadList::iterator i = m_heads.begin(); i != m_heads.end(); ++i) {
+
+        Head *head = *i;
+
+        if (head->fileId != fileId ||
+            head->channels != channels ||
+            head->sampleRate != sampleRate ||
+            position < head->position) continue;
+
+        size_t offset = RealTime::realTime2Frame
+            (position - head->position, sampleRate);
+        if (offset >= head->frames) continue;
+
+        size_t n = std::min(head->frames - offset, maxFrames);
+        size_t fade = std::min(fadeFrames, n);
+
+        std::vector<float> faded(fade);
+
+        for (int ch = 0; ch < channels; ++ch) {
+            if (!targets[ch]) continue;
+            const float *source = head->data[ch] + offset;
+            for (size_t j = 0; j < fade; ++j) {
+                faded[j] = source[j] * float(j + 1) / float(fade);
+            }
+            if (fade > 0) targets[ch]->write(&faded[0], fade);
+            targets[ch]->write(source + fade, n - fade);
+        }
+
+        written = n;
+        break;
+    }
+
+    pthread_mutex_unlock(&m_lock);
+
+#ifdef DEBUG_LOCATE_CACHE
+    RG_DEBUG << "read(" << position << "): wrote" << written << "frames";
+#endif
+
+    return written;
+}
+
+void
+LocateCache::forgetFile(AudioFileId fileId)
+{
+    pthread_mutex_lock(&m_lock);
+
+    ++m_forgetCount;
+
+    while (m_building && m_buildingFileId == fileId) {
+        pthread_cond_wait(&m_buildDone, &m_lock);
+    }
+
+    for (HeadList::iterator i = m_heads.begin(); i != m_heads.end(); ) {
+        if ((*i)->fileId == fileId) {
+            deleteHead(*i);
+            i = m_heads.erase(i);
+        } else {
+            ++i;
+        }
+    }
+
+    pthread_mutex_unlock(&m_lock);
+}
+
+void
+LocateCache::clear()
+{
+    pthread_mutex_lock(&m_lock);
+
+    ++m_forgetCount;
+
+    while (m_building) {
+        pthread_cond_wait(&m_buildDone, &m_lock);
+    }
+
+    for (HeadList::iterator i = m_heads.begin(); i != m_heads.end(); ++i) {
+        deleteHead(*i);
+    }
+    m_heads.clear();
+
+    pthread_mutex_unlock(&m_lock);
+}
+
+}
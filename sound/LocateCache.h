@@ -0,0 +1,149 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_LOCATECACHE_H
+#define RG_LOCATECACHE_H
+
+#include "base/RealTime.h"
+#include "AudioFile.h"
+#include "AudioPlayQueue.h"
+#include "RingBuffer.h"
+
+#include <pthread.h>
+#include <vector>
+#include <list>
+#include <stddef.h>
+
+namespace Rosegarden
+{
+
+/**
+ * Pre-decoded audio for the places the transport is likely to be
+ * moved to: the loop start, the composition markers and the last few
+ * positions played from.  For every audio segment playing at (or
+ * starting just after) one of those points, the cache holds the first
+ * fraction of a second of audio from that point on, already decoded
+ * at the target rate and channel count.
+ *
+ * When a PlayableAudioFile is prebuffered after a relocation, it
+ * takes the start of its data from here rather than waiting for the
+ * disk, and the rest is read in the background while that plays.
+ *
+ * The locate points are set from the sequencer thread.  The heads
+ * are built by the AudioFileReader when it has nothing else to do,
+ * and are limited to a total memory budget.  Heads are keyed by audio
+ * file ID.  A head is built outside the lock, so forgetFile() and
+ * clear() wait for any build from a file they are dropping, as the
+ * caller is about to delete that file.
+ */
+class LocateCache
+{
+public:
+    static LocateCache *getInstance();
+
+    /// Set the loop start, or clear it with RealTime::zeroTime
+    void setLoopStart(const RealTime &loopStart);
+
+    /// Set the times of the composition markers
+    void setMarkers(const std::vector<RealTime> &markers);
+
+    /// Record a position that playback has just started from
+    void addRecentPosition(const RealTime &position);
+
+    /**
+     * Bring the cache up to date for the given scheduled files:
+     * discard heads that are no longer needed and build at most
+     * maxHeads of the missing ones.  Reads from disk.  Call from the
+     * disk thread only.
+     */
+    void update(const AudioPlayQueue::FileSet &files, int maxHeads);
+
+    /**
+     * Write cached audio for the given file position into the ring
+     * buffers, up to maxFrames, fading in over the first fadeFrames.
+     * Return the number of frames written, which is 0 if there is no
+     * cached audio for that position.
+     */
+    size_t read(AudioFileId fileId, const RealTime &position,
+                int channels, int sampleRate,
+                RingBuffer<float> **targets, size_t maxFrames,
+                size_t fadeFrames);
+
+    /**
+     * Discard anything cached from the given file, before it is
+     * deleted.  Waits if a head is being built from it.
+     */
+    void forgetFile(AudioFileId fileId);
+
+    /// Discard everything, waiting for any head being built
+    void clear();
+
+    /// Memory budget in bytes
+    size_t getBudget() const;
+    void setBudget(size_t bytes);
+
+    size_t getMemoryUsed() const;
+
+protected:
+    LocateCache();
+    ~LocateCache();
+
+    struct Head
+    {
+        Head() : fileId(0), channels(0), sampleRate(0),
+                 frames(0), wanted(false) { }
+
+        bool matches(AudioFileId f, const RealTime &p, int c, int r) const {
+            return fileId == f && position == p &&
+                channels == c && sampleRate == r;
+        }
+
+        AudioFileId fileId;
+        RealTime position;  // within the audio file
+        int channels;
+        int sampleRate;
+        size_t frames;
+        std::vector<float *> data;
+        bool wanted;
+    };
+
+    typedef std::list<Head *> HeadList;
+
+    bool buildHead(Head *head, AudioFile *audioFile);
+    void deleteHead(Head *head);
+    std::vector<RealTime> getLocatePoints();
+
+    HeadList m_heads;
+    size_t m_memoryUsed;
+    size_t m_budget;
+
+    RealTime m_loopStart;
+    std::vector<RealTime> m_markers;
+    std::vector<RealTime> m_recentPositions;
+
+    // The file a head is being built from, if m_building, and a count
+    // of calls to forgetFile() and clear() so that update() can tell
+    // whether the files it found are still there.  Under m_lock.
+    bool m_building;
+    AudioFileId m_buildingFileId;
+    unsigned int m_forgetCount;
+
+    mutable pthread_mutex_t m_lock;
+    pthread_cond_t m_buildDone;
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@
 
 #include <queue>
 #include <functional>
+#include <algorithm>
 
 //#define DEBUG_META_ITERATOR 1
 //#define DEBUG_PLAYING_AUDIO_FILES 1
@@ -279,128 +280,128 @@ fetchEventsNoncompeting(MappedInserterBase &inserter,
         (*i)->setActive(active, startTime);
     }
 
-    // State variable to allow the outer (round-robin) loop to run until
-    // the inner (segment) loop has nothing to do.
-    bool segmentsHaveMore = false;
-
-    // For each pass through the segments.
-    // On each pass, we only process one event in each segment.
-    // ??? Why not process all the events in each segment?
-    //     for each segment
-    //         for each event
-    //             process the event
-    //         rof
-    //     rof
-    //     Is this round-robin approach intended to spread the locks out?
-    //     Is it really necessary?
-    //     Prior to the auto-channels feature, this routine was called
-    //     MappedSegmentsMetaIterator::fillCompositionWithEventsUntil().
-    //     It has always used this round-robin approach.
-    do {
-        segmentsHaveMore = false;
-
-        // For each segment, process only the first event.
-        for (size_t i = 0; i < m_iterators.size(); ++i) {
-            MappedEventBuffer::iterator *iter = m_iterators[i];
+    // Merge the iterators' events in time order, using a heap that
+    // holds the next event of each active iterator.  Each buffer is
+    // read-locked for the whole slice rather than for every event:
+    // this locks it against writes, lest writing cause reallocating
+    // the buffer while we are holding a pointer into it.
+    std::vector<QReadWriteLock *> locks;
+    m_pendingEvents.clear();
 
-#ifdef DEBUG_META_ITERATOR
-            RG_DEBUG << "fetchEventsNoncompeting() : checking segment #" << i;
-#endif
+    for (size_t i = 0; i < m_iterators.size(); ++i) {
+        MappedEventBuffer::iterator *iter = m_iterators[i];
 
-            // Skip any segments that aren't active.
-            if (!iter->getActive()) {
+        // Skip any segments that aren't active.
+        if (!iter->getActive()) {
 #ifdef DEBUG_META_ITERATOR
-                RG_DEBUG << "fetchEventsNoncompeting() : no more events to get for this slice in segment #" << i;
+            RG_DEBUG << "fetchEventsNoncompeting() : no more events to get for this slice in segment #" << i;
 #endif
+            continue;
+        }
 
-                continue;
-            }
+        QReadWriteLock *lock = iter->getLock();
+        lock->lockForRead();
+        locks.push_back(lock);
 
-            if (iter->atEnd()) {
-#ifdef DEBUG_META_ITERATOR
-                RG_DEBUG << "fetchEventsNoncompeting() : " << endTime << " reached end of segment #" << i;
-#endif
-                // Make this iterator abort early in future
-                // iterations, since we know it's all done.
-                iter->setInactive();
-                continue;
-            }
+        queueNextEvent(i, inserter, startTime, endTime);
+    }
 
-            // This locks the iterator's buffer against writes, lest
-            // writing cause reallocating the buffer while we are
-            // holding a pointer into it.  No function we call will
-            // hold the `event' pointer past its own scope, implying
-            // that nothing holds it past an iteration of this loop,
-            // which is this lock's scope.
-            QReadLocker locker(iter->getLock());
-
-            MappedEvent *event = iter->peek();
-
-            // We couldn't fetch an event or it failed a sanity check.
-            // So proceed to the next iterator but keep looking at
-            // this one - incrementing it does nothing useful, and it
-            // might get more events.  But don't set segmentsHaveMore,
-            // lest we loop forever waiting for a valid event.
-            if (!event  ||  !event->isValid())
-                continue;
+    while (!m_pendingEvents.empty()) {
+        std::pop_heap(m_pendingEvents.begin(), m_pendingEvents.end());
+        const size_t i = m_pendingEvents.back().index;
+        m_pendingEvents.pop_back();
 
-            // If we got this far, make the mapper ready.  Do this
-            // even if the note won't play during this slice, because
-            // sometimes/always we prepare channels slightly ahead of
-            // their first notes, to fix bug #1378
-            if (!iter->isReady())
-                iter->makeReady(inserter, startTime);
-
-            // If this event starts prior to the end of the slice, take it.
-            if (event->getEventTime() < endTime) {
-                // Increment the iterator, since we're taking this
-                // event.  NB, in the other branch it is not yet used
-                // so we leave `iter' where it is.
-                ++(*iter);
-
-                // If we got this far, we'll want to try the next
-                // iteration, so note it.
-                segmentsHaveMore = true;
-                
-#ifdef DEBUG_META_ITERATOR
-                RG_DEBUG << "fetchEventsNoncompeting() : " << endTime
-                         << " seeing evt from segment #" << i
-                         << " : trackId: " << event->getTrackId()
-                         << " channel: " << (unsigned int) event->getRecordedChannel()
-                         << " - inst: " << event->getInstrument()
-                         << " - type: " << event->getType()
-                         << " - time: " << event->getEventTime()
-                         << " - duration: " << event->getDuration()
-                         << " - data1: " << (unsigned int)event->getData1()
-                         << " - data2: " << (unsigned int)event->getData2();
-#endif
+        MappedEventBuffer::iterator *iter = m_iterators[i];
+        MappedEvent *event = iter->peek();
+
+        // Increment the iterator, since we're taking this event.
+        ++(*iter);
 
-                if (iter->shouldPlay(event, startTime)) {
-                    iter->doInsert(inserter, *event);
 #ifdef DEBUG_META_ITERATOR
-                    RG_DEBUG << "  Inserting event";
+        RG_DEBUG << "fetchEventsNoncompeting() : " << endTime
+                 << " seeing evt from segment #" << i
+                 << " : trackId: " << event->getTrackId()
+                 << " channel: " << (unsigned int) event->getRecordedChannel()
+                 << " - inst: " << event->getInstrument()
+                 << " - type: " << event->getType()
+                 << " - time: " << event->getEventTime()
+                 << " - duration: " << event->getDuration()
+                 << " - data1: " << (unsigned int)event->getData1()
+                 << " - data2: " << (unsigned int)event->getData2();
 #endif
 
-                } else {
+        if (iter->shouldPlay(event, startTime)) {
+            iter->doInsert(inserter, *event);
 #ifdef DEBUG_META_ITERATOR
-                    RG_DEBUG << "  Skipping event";
+            RG_DEBUG << "  Inserting event";
 #endif
-                }
-            } else {
-                // This iterator has more events but they only sound
-                // after the end of this slice, so it's done.
-                iter->setInactive();
 
+        } else {
 #ifdef DEBUG_META_ITERATOR
-                RG_DEBUG << "fetchEventsNoncompeting() : Event is past end for segment #" << i;
+            RG_DEBUG << "  Skipping event";
 #endif
-            }
         }
-    } while (segmentsHaveMore);
+
+        queueNextEvent(i, inserter, startTime, endTime);
+    }
+
+    for (size_t i = 0; i < locks.size(); ++i) {
+        locks[i]->unlock();
+    }
 
     return;
 }
 
+void
+MappedBufMetaIterator::
+queueNextEvent(size_t index,
+               MappedInserterBase &inserter,
+               const RealTime &startTime,
+               const RealTime &endTime)
+{
+    MappedEventBuffer::iterator *iter = m_iterators[index];
+
+    if (iter->atEnd()) {
+#ifdef DEBUG_META_ITERATOR
+        RG_DEBUG << "queueNextEvent() : " << endTime << " reached end of segment #" << index;
+#endif
+        iter->setInactive();
+        return;
+    }
+
+    const MappedEvent *event = iter->peek();
+
+    // We couldn't fetch an event or it failed a sanity check.  Leave
+    // the iterator where it is, as it might get more events by the
+    // next slice.
+    if (!event  ||  !event->isValid())
+        return;
+
+    // If we got this far, make the mapper ready.  Do this even if the
+    // note won't play during this slice, because sometimes/always we
+    // prepare channels slightly ahead of their first notes, to fix
+    // bug #1378
+    if (!iter->isReady())
+        iter->makeReady(inserter, startTime);
+
+    // If this event starts prior to the end of the slice, queue it.
+    if (event->getEventTime() < endTime) {
+        PendingEvent pending;
+        pending.time = event->getEventTime();
+        pending.index = index;
+        m_pendingEvents.push_back(pending);
+        std::push_heap(m_pendingEvents.begin(), m_pendingEvents.end());
+    } else {
+        // This iterator has more events but they only sound after the
+        // end of this slice, so it's done.
+        iter->setInactive();
+
+#ifdef DEBUG_META_ITERATOR
+        RG_DEBUG << "queueNextEvent() : Event is past end for segment #" << index;
+#endif
+    }
+}
+
 void
 MappedBufMetaIterator::
 resetIteratorForSegment(QSharedPointer<MappedEventBuffer> mappedEventBuffer, bool immediate)
@@ -125,6 +125,30 @@ private:
     void moveIteratorToTime(MappedEventBuffer::iterator &,
                             const RealTime &);
 
+    /// Queue the next event from m_iterators[index] for this slice.
+    /**
+     * Deactivates the iterator instead if it has nothing more to give
+     * before endTime.  The iterator's buffer must be read-locked.
+     */
+    void queueNextEvent(size_t index,
+                        MappedInserterBase &inserter,
+                        const RealTime &startTime,
+                        const RealTime &endTime);
+
+    /// The next event of one of the iterators, for the merge.
+    struct PendingEvent
+    {
+        RealTime time;
+        /// Index into m_iterators
+        size_t index;
+
+        /// Heap order: earliest first, then in m_iterators order.
+        bool operator<(const PendingEvent &other) const {
+            if (time != other.time) return time > other.time;
+            return index > other.index;
+        }
+    };
+
     //--------------- Data members ---------------------------------
 
     RealTime m_currentTime;
@@ -135,6 +159,10 @@ private:
     typedef std::vector<MappedEventBuffer::iterator *> SegmentIterators;
     SegmentIterators m_iterators;
 
+    /// Min-heap used by fetchEventsNoncompeting().  Kept to save
+    /// reallocating it on every slice.
+    std::vector<PendingEvent> m_pendingEvents;
+
     std::vector<MappedEvent> m_playingAudioSegments;
 };
 
@@ -1303,6 +1303,8 @@ void MidiFile::configureInstrument(
 bool
 MidiFile::convertToMidi(RosegardenDocument *doc, const QString &filename)
 {
+    Profiler profiler("MidiFile::convertToMidi");
+
     Composition &composition = doc->getComposition();
 
     RosegardenMainWindow *mainWindow = RosegardenMainWindow::self();
@@ -23,26 +23,33 @@
 namespace Rosegarden
 {
 
-// Allocate the static return composition
+// Allocate the MIDI IN queue.  At 16K messages this holds well over
+// a second of dense input, and it is emptied on every poll of the
+// driver.
 //
-MappedEventList *MidiThread::m_returnComposition = new MappedEventList();
-pthread_mutex_t MidiThread::m_recLock  = PTHREAD_MUTEX_INITIALIZER;
+RingBuffer<MidiThread::MidiInMessage> *MidiThread::m_midiInQueue =
+    new RingBuffer<MidiThread::MidiInMessage>(16383);
 
-//memcpy(&m_lock, &initialisingMutex, sizeof(pthread_mutex_t));
-//pthread_cond_t initialisingCondition = PTHREAD_COND_INITIALIZER;
-//memcpy(&m_condition, &initialisingCondition, sizeof(pthread_cond_t));
+std::atomic<int> MidiThread::m_droppedMidiIn(0);
+int MidiThread::m_droppedMidiInReported = 0;
 
 // Note on map
 //
 std::map<unsigned int, std::multimap<unsigned int, MappedEvent*> > MidiThread::m_noteOnMap;
 
-// Elapsed time counter
+// Clock for event times, started before any MIDI IN can arrive and
+// never restarted, so that the callback can read it while
+// setElapsedTime() moves the time it counts from
 //
-double MidiThread::m_elapsedTime = 0;
+static QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
 
-// Elapsed time
-//
-//MidiThread::m_elapsedTime = 0;
+const QElapsedTimer MidiThread::m_clock = startedClock();
+std::atomic<qint64> MidiThread::m_clockOffset(0);
 
 MidiThread::MidiThread(std::string name, // for diagnostics
                        SoundDriver *driver,
@@ -242,31 +249,26 @@ void MidiThread::clearBuffersOut()
     releaseLock();
 }
 
-// Returns the captured MID events to the PortableSoundDriver - we do this
-// by copying the static list into a local MappedEventList, clearing the
-// static list and returning the local one.  Might do this a better way.
+// Returns the captured MIDI events to the PortableSoundDriver.  This
+// is the only reader of the MIDI IN queue, so the MappedEvents are
+// made and the note ons and offs are paired up here rather than in
+// the callback.
 //
 MappedEventList
 MidiThread::getReturnComposition()
 {
-    // Might need to get another mutex here
-    //
     MappedEventList mE;
 
-    pthread_mutex_lock(&MidiThread::m_recLock);
-
-    for (MappedEventListIterator it = MidiThread::m_returnComposition->begin(); it != MidiThread::m_returnComposition->end(); it++)
-    {
-        mE.insert(new MappedEvent(*it));
+    MidiInMessage message;
+    while (m_midiInQueue->read(&message, 1) == 1) {
+        processMidiIn(message, mE);
     }
 
-    // clear the local composition
-    //
-    MidiThread::m_returnComposition->clear();
-
-    pthread_mutex_unlock(&MidiThread::m_recLock);
-
-    //QString thing = QString("GetReturnComposition size = %1").arg(mE.size());
+    int dropped = m_droppedMidiIn.load();
+    if (dropped != m_droppedMidiInReported) {
+        SEQUENCER_DEBUG << "MidiThread::getReturnComposition() - MIDI IN queue full, " << dropped << " messages dropped so far" << endl;
+        m_droppedMidiInReported = dropped;
+    }
 
     if (mE.size() > 0)
     {
@@ -278,27 +280,21 @@ MidiThread::getReturnComposition()
     return mE;
 }
 
-// The RTMidi in callback - we use this to identify and push events to the m_returnComposition
-// which can then be queried and copied back into the driver on request.
-//
-// Unlike the AlsaDriver (on which this was originally based) the midiInCallback works on a per
-// event basis - so there's no looping required yet for multiple events - this may well change
-// once things get sticky with controllers and sysexes.
-//
-// Partial implementation compared to AlsaDriver - some stuff missing notably including SysExs
-// and timing stuff for the moment.  Also some events might be incorrectly wired.
+// The RTMidi in callback.  This just stamps the message with the time
+// it arrived and queues it for getReturnComposition(), so that it
+// never waits on the reader or allocates.
 //
 void
-MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *message, void *userData)
+MidiThread::midiInCallback(double /*deltaTime*/, std::vector< unsigned char > *message, void * /*userData*/)
 {
+    // Take the time first, before anything else can delay us
+    //
+    double elapsed = double(m_clock.nsecsElapsed() - m_clockOffset.load()) / 1.0e9;
+
 #ifdef DEBUG_RTMIDI
     SEQUENCER_DEBUG << "MidiThread::midiInCallback - called" << endl;
 #endif
 
-    // Always add on the delta time
-    //
-    MidiThread::m_elapsedTime += deltaTime;
-
     unsigned int nBytes = message->size();
 
     // Do something if there is nothing
@@ -307,35 +303,65 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         return;
     }
 
-    QString msg;
+    MidiInMessage queued;
+    int seconds = (int)elapsed;
+    int nanoSeconds = (elapsed - (double)seconds) * 1000000000;
+    queued.time = RealTime(seconds, nanoSeconds);
 
-    // Some temporary logging
+    // We only handle channel and system common messages, which are
+    // at most three bytes
     //
-    for ( unsigned int i=0; i < nBytes; i++ )
-    {
-      msg = QString("MidiThread::midiInCallback - got MIDI IN Byte %1 = %2").arg(i).arg((int)message->at(i));
-      //std::cout << msg.toStdString() << std::endl;
+    queued.size = (nBytes < 3 ? nBytes : 3);
+    for (unsigned int i = 0; i < 3; ++i) {
+        queued.data[i] = (i < queued.size ? message->at(i) : 0);
     }
 
-    if ( nBytes > 0 )
-    {
-      msg = QString("MidiThread::midiInCallback - got MIDI in timestamp = %1").arg(deltaTime);
-      //std::cout << msg.toStdString() << std::endl;
+    if (m_midiInQueue->getWriteSpace() == 0) {
+        ++m_droppedMidiIn;
+        return;
     }
 
+    m_midiInQueue->write(&queued, 1);
+}
+
+void
+MidiThread::setElapsedTime(double elapsedTime)
+{
+    m_clockOffset.store(m_clock.nsecsElapsed() - qint64(elapsedTime * 1.0e9));
+}
+
+int
+MidiThread::getDroppedMidiIn()
+{
+    return m_droppedMidiIn.load();
+}
+
+// Make a MappedEvent from a queued MIDI IN message, pairing note offs
+// with their note ons.
+//
+// Unlike the AlsaDriver (on which this was originally based) this works on a per
+// event basis - so there's no looping required yet for multiple events - this may well change
+// once things get sticky with controllers and sysexes.
+//
+// Partial implementation compared to AlsaDriver - some stuff missing notably including SysExs
+// and timing stuff for the moment.  Also some events might be incorrectly wired.
+//
+void
+MidiThread::processMidiIn(const MidiInMessage &message, MappedEventList &events)
+{
     // Channel is the lower byte
     //
-    unsigned int channel = ((int)message->at(0)) & 0xF;
+    unsigned int channel = ((int)message.data[0]) & 0xF;
 
     // Bear in mind we might have no note information (no second byte)
     //
     unsigned int chanNoteKey = 0;
 
-    if (message->size() > 1)
+    if (message.size > 1)
     {
         // Set up chanNoteKey
         //
-        chanNoteKey = ( channel << 8 ) + (unsigned int) ((int)message->at(1));
+        chanNoteKey = ( channel << 8 ) + (unsigned int) ((int)message.data[1]);
     }
     bool fromController = false;
 
@@ -369,29 +395,20 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
     }
 */
 
-    // ----------------------------------------------------
-    // Time conversion - deltaTime is in seconds
-    //
-    int seconds = (int)MidiThread::m_elapsedTime;
-    int nanoSeconds = (MidiThread::m_elapsedTime - (double)seconds) * 1000000000;
-    RealTime eventTime(seconds, nanoSeconds);
-
-    // Get a lock to insert into the m_returnComposition
-    //
-    pthread_mutex_lock(&MidiThread::m_recLock);
+    RealTime eventTime = message.time;
 
-    switch (message->at(0) & 0xF0)
+    switch (message.data[0] & 0xF0)
     {
     case MIDI_NOTE_ON:
     case MIDI_NOTE_OFF:
         // Need to handle both here in case we have MIDI_NOTE_ONs with zero vely
         // instead of NOTE_OFFS.
         //
-        if (message->at(2) > 0 && ((message->at(0) & 0xF0) == MIDI_NOTE_ON))
+        if (message.data[2] > 0 && ((message.data[0] & 0xF0) == MIDI_NOTE_ON))
         {
             MappedEvent *mE = new MappedEvent();
-            mE->setPitch(message->at(1));
-            mE->setVelocity(message->at(2));
+            mE->setPitch(message.data[1]);
+            mE->setVelocity(message.data[2]);
             mE->setEventTime(eventTime);
             mE->setRecordedChannel(0);
             mE->setRecordedDevice(0);
@@ -410,12 +427,12 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
             // We shake out the two NOTE Ons after we've recorded
             // them.
             //
-            MidiThread::m_returnComposition->insert(new MappedEvent(*mE));
+            events.insert(new MappedEvent(*mE));
             MidiThread::m_noteOnMap[deviceId].insert(std::pair<unsigned int, MappedEvent*>(chanNoteKey, mE));
 
 #ifdef DEBUG_RTMIDI
             SEQUENCER_DEBUG << "MidiThread::midiInCallback - added NOTE ON event with pitch " << mE->getPitch()
-                            << " and time " << mE->getEventTime() << " (elaspedTime = " << MidiThread::m_elapsedTime << ")"
+                            << " and time " << mE->getEventTime()
                             << " and chanNoteKey = " << chanNoteKey << endl;
 #endif
         }
@@ -452,7 +469,7 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
             mE->setDuration(duration);
 
             // force shut off of note
-            MidiThread::m_returnComposition->insert(mE);
+            events.insert(mE);
 
             // reset the reference
             //
@@ -471,11 +488,11 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         MappedEvent *mE = new MappedEvent();
         mE->setType(MappedEvent::MidiKeyPressure);
         mE->setEventTime(eventTime);
-        mE->setData1(message->at(1));
-        mE->setData2(message->at(2));
+        mE->setData1(message.data[1]);
+        mE->setData2(message.data[2]);
         mE->setRecordedChannel(channel);
         mE->setRecordedDevice(deviceId);
-        MidiThread::m_returnComposition->insert(mE);
+        events.insert(mE);
     }
     break;
 
@@ -484,11 +501,11 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         MappedEvent *mE = new MappedEvent();
         mE->setType(MappedEvent::MidiController);
         mE->setEventTime(eventTime);
-        mE->setData1(message->at(1));
-        mE->setData2(message->at(2));
+        mE->setData1(message.data[1]);
+        mE->setData2(message.data[2]);
         mE->setRecordedChannel(channel);
         mE->setRecordedDevice(deviceId);
-        MidiThread::m_returnComposition->insert(mE);
+        events.insert(mE);
     }
     break;
 
@@ -497,10 +514,10 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         MappedEvent *mE = new MappedEvent();
         mE->setType(MappedEvent::MidiProgramChange);
         mE->setEventTime(eventTime);
-        mE->setData1(message->at(1));
+        mE->setData1(message.data[1]);
         mE->setRecordedChannel(channel);
         mE->setRecordedDevice(deviceId);
-        MidiThread::m_returnComposition->insert(mE);
+        events.insert(mE);
     }
     break;
 
@@ -514,8 +531,8 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         //int s = event->data.control.value + 8192;
         //int d1 = (s >> 7) & 0x7f; // data1 = MSB
         //int d2 = s & 0x7f; // data2 = LSB
-        int d1 = message->at(1);
-        int d2 = message->at(2);
+        int d1 = message.data[1];
+        int d2 = message.data[2];
         MappedEvent *mE = new MappedEvent();
         mE->setType(MappedEvent::MidiPitchBend);
         mE->setEventTime(eventTime);
@@ -523,7 +540,7 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         mE->setData2(d2);
         mE->setRecordedChannel(channel);
         mE->setRecordedDevice(deviceId);
-        MidiThread::m_returnComposition->insert(mE);
+        events.insert(mE);
     }
         break;
 
@@ -534,14 +551,14 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
 
         // Fixed by Pedro Lopez-Cabanillas (20030523)
         //
-        int s = message->at(1) & 0x7f;
+        int s = message.data[1] & 0x7f;
         MappedEvent *mE = new MappedEvent();
         mE->setType(MappedEvent::MidiChannelPressure);
         mE->setEventTime(eventTime);
         mE->setData1(s);
         mE->setRecordedChannel(channel);
         mE->setRecordedDevice(deviceId);
-        MidiThread::m_returnComposition->insert(mE);
+        events.insert(mE);
     }
         break;
 
@@ -647,10 +664,6 @@ MidiThread::midiInCallback(double deltaTime, std::vector< unsigned char > *messa
         }
     }
     */
-
-    // Release lock on shared return structure
-    //
-    pthread_mutex_unlock(&MidiThread::m_recLock);
 }
 
 // Process any pending note offs
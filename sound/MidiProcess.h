@@ -15,6 +15,9 @@
 
 #include "AudioProcess.h"
 #include "MappedEventList.h"
+#include "RingBuffer.h"
+#include <QElapsedTimer>
+#include <atomic>
 #include <string.h>
 
 #ifndef _MIDIPROCESS_H
@@ -58,29 +61,51 @@ public:
     //
     void initialiseMidiIn(unsigned int port);
 
-    // The RTMidi MIDI in callback
+    // The RTMidi MIDI in callback.  Queues the message for
+    // getReturnComposition() without locking or allocating.
     //
     static void midiInCallback(double deltatime, std::vector< unsigned char > *message, void *userData);
 
-    // Static method for accessing any recorded/captured MIDI notes
+    // Static method for accessing any recorded/captured MIDI notes.
+    // This must only be called from one thread at a time, as it is
+    // the single reader of the MIDI IN queue.
     //
     static MappedEventList getReturnComposition();
 
     // Ability to set elapsed time to reset this at start of playback/recording
     //
-    static void setElapsedTime(double elapsedTime) { m_elapsedTime = elapsedTime; }
+    static void setElapsedTime(double elapsedTime);
+
+    // Number of MIDI IN messages lost so far because the queue was full
+    //
+    static int getDroppedMidiIn();
 
 protected:
 
-    // A thread-local MappedEventList which is populated and returned to
-    // the PortableSoundDriver on request.
+    // A MIDI IN message as received, with the time it arrived
+    //
+    struct MidiInMessage
+    {
+        RealTime      time;
+        unsigned char data[3];
+        unsigned char size;
+    };
+
+    // Turn a MIDI IN message into a MappedEvent in events
+    //
+    static void processMidiIn(const MidiInMessage &message, MappedEventList &events);
+
+    // MIDI IN messages waiting for getReturnComposition().  Written
+    // only by the RtMidi callback and read only by
+    // getReturnComposition(), so no lock is needed.
     //
-    static MappedEventList   *m_returnComposition;
+    static RingBuffer<MidiInMessage> *m_midiInQueue;
 
-    // Static locks for the return mappedcomposition thing
+    // Messages lost because m_midiInQueue was full, counted by the
+    // callback, and the count getReturnComposition() last logged
     //
-    static pthread_mutex_t   m_recLock;
-    //static pthread_cond_t    m_condition;
+    static std::atomic<int>   m_droppedMidiIn;
+    static int                m_droppedMidiInReported;
 
     virtual void threadRun();
     void processBuffers();
@@ -110,13 +135,19 @@ protected:
     //
     unsigned int            m_currentRtOutPort;
 
-    // Keep a track of note ons coming in while recording so we can get durations
+    // Keep a track of note ons coming in while recording so we can
+    // get durations.  Only used by getReturnComposition().
     //
     static std::map<unsigned int, std::multimap<unsigned int, MappedEvent*> >  m_noteOnMap;
 
-    // Keep a track of elapsed time for events as we only get deltatimes from RtMidi
+    // Events are timed on a monotonic clock, rather than by adding up
+    // RtMidi's deltatimes.  An event's time is the clock's reading less
+    // m_clockOffset, in nanoseconds, which setElapsedTime() sets.  The
+    // clock itself is never restarted, so the callback only has to
+    // read the one atomic.
     //
-    static double m_elapsedTime;
+    static const QElapsedTimer m_clock;
+    static std::atomic<qint64> m_clockOffset;
 
 };
 
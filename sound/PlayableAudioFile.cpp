@@ -14,6 +14,10 @@
 */
 
 #include "PlayableAudioFile.h"
+#include "LocateCache.h"
+#include "Resampler.h"
+
+#include <cmath>
 
 namespace Rosegarden
 {
@@ -286,13 +290,62 @@ RingBufferPool::returnBuffer(RingBuffer<sample_t> *buffer)
 }
 
 
-AudioCache PlayableAudioFile::m_smallFileCache;
+PlayableAudioFile::ReadBuffers::ReadBuffers() :
+    m_raw(nullptr),
+    m_rawSize(0),
+    m_workSize(0)
+{
+}
+
+PlayableAudioFile::ReadBuffers::~ReadBuffers()
+{
+    delete[] m_raw;
+    for (size_t i = 0; i < m_work.size(); ++i) {
+        delete[] m_work[i];
+    }
+}
+
+char *
+PlayableAudioFile::ReadBuffers::getRawBuffer(size_t bytes)
+{
+    //!!! need to be doing this in initialise, want to avoid allocations here
+    if (bytes > m_rawSize) {
+        delete[] m_raw;
+        m_rawSize = bytes;
+#ifdef DEBUG_PLAYABLE_READ
+        std::cerr << "Expanding raw file buffer to " << m_rawSize << " chars" << std::endl;
+#endif
+        m_raw = new char[m_rawSize];
+    }
+
+    return m_raw;
+}
 
-std::vector<PlayableAudioFile::sample_t *> PlayableAudioFile::m_workBuffers;
-size_t PlayableAudioFile::m_workBufferSize = 0;
+std::vector<PlayableAudioFile::sample_t *> &
+PlayableAudioFile::ReadBuffers::getWorkBuffers(size_t frames, int channels)
+{
+    if (frames > m_workSize) {
 
-char *PlayableAudioFile::m_rawFileBuffer;
-size_t PlayableAudioFile::m_rawFileBufferSize = 0;
+        for (size_t i = 0; i < m_work.size(); ++i) {
+            delete[] m_work[i];
+        }
+
+        m_work.clear();
+        m_workSize = frames;
+#ifdef DEBUG_PLAYABLE_READ
+        std::cerr << "Expanding work buffer to " << m_workSize << " frames" << std::endl;
+#endif
+    }
+
+    while (channels > (int)m_work.size()) {
+        m_work.push_back(new sample_t[m_workSize]);
+    }
+
+    return m_work;
+}
+
+
+PlayableAudioFile::ReadBuffers PlayableAudioFile::m_readBuffers;
 
 RingBufferPool *PlayableAudioFile::m_ringBufferPool = nullptr;
 
@@ -319,11 +372,15 @@ PlayableAudioFile::PlayableAudioFile(InstrumentId instrumentId,
     m_firstRead(true),
     m_runtimeSegmentId( -1),
     m_isSmallFile(false),
+    m_smallFileData(nullptr),
+    m_smallFileFrames(0),
     m_currentScanPoint(RealTime::zeroTime),
     m_smallFileScanFrame(0),
     m_autoFade(false),
     m_fadeInTime(RealTime::zeroTime),
-    m_fadeOutTime(RealTime::zeroTime)
+    m_fadeOutTime(RealTime::zeroTime),
+    m_underruns(0),
+    m_underrunsReported(0)
 {
 #ifdef DEBUG_PLAYABLE
     std::cerr << "PlayableAudioFile::PlayableAudioFile - creating " << this << " for instrument " << instrumentId << " with file " << (m_audioFile ? m_audioFile->getShortFilename() : "(none)") << std::endl;
@@ -363,6 +420,11 @@ PlayableAudioFile::initialise(size_t bufferSize, size_t smallFileSize)
     std::cerr << "PlayableAudioFile::initialise() " << this << std::endl;
 #endif
 
+    if (m_targetChannels <= 0)
+        m_targetChannels = m_audioFile->getChannels();
+    if (m_targetSampleRate <= 0)
+        m_targetSampleRate = m_audioFile->getSampleRate();
+
     checkSmallFileCache(smallFileSize);
 
     if (!m_isSmallFile) {
@@ -389,7 +451,7 @@ PlayableAudioFile::initialise(size_t bufferSize, size_t smallFileSize)
         m_fileEnded = false;
         m_currentScanPoint = m_startIndex;
         m_smallFileScanFrame = (size_t)RealTime::realTime2Frame
-            (m_currentScanPoint, m_audioFile->getSampleRate());
+            (m_currentScanPoint, m_targetSampleRate);
     }
 
 #ifdef DEBUG_PLAYABLE
@@ -398,11 +460,6 @@ PlayableAudioFile::initialise(size_t bufferSize, size_t smallFileSize)
     (void)bufferSize;
 #endif
 
-    if (m_targetChannels <= 0)
-        m_targetChannels = m_audioFile->getChannels();
-    if (m_targetSampleRate <= 0)
-        m_targetSampleRate = m_audioFile->getSampleRate();
-
     m_ringBuffers = new RingBuffer<sample_t> *[m_targetChannels];
     for (int ch = 0; ch < m_targetChannels; ++ch) {
         m_ringBuffers[ch] = nullptr;
@@ -420,8 +477,8 @@ PlayableAudioFile::~PlayableAudioFile()
     delete[] m_ringBuffers;
     m_ringBuffers = nullptr;
 
-    if (m_isSmallFile) {
-        m_smallFileCache.decrementReference(m_audioFile);
+    if (m_smallFileData) {
+        AudioCache::getInstance()->releaseData(m_smallFileData);
     }
 
 #ifdef DEBUG_PLAYABLE 
@@ -456,7 +513,7 @@ PlayableAudioFile::scanTo(const RealTime &time)
 
         m_currentScanPoint = time;
         m_smallFileScanFrame = (size_t)RealTime::realTime2Frame
-            (time, m_audioFile->getSampleRate());
+            (time, m_targetSampleRate);
 #ifdef DEBUG_PLAYABLE_READ
         std::cerr << "... maps to frame " << m_smallFileScanFrame << std::endl;
 #endif
@@ -486,11 +543,8 @@ PlayableAudioFile::getSampleFramesAvailable()
     size_t actual = 0;
 
     if (m_isSmallFile) {
-        size_t cchannels;
-        size_t cframes;
-        (void)m_smallFileCache.getData(m_audioFile, cchannels, cframes);
-        if (cframes > m_smallFileScanFrame)
-            return cframes - m_smallFileScanFrame;
+        if (m_smallFileFrames > m_smallFileScanFrame)
+            return m_smallFileFrames - m_smallFileScanFrame;
         else
             return 0;
     }
@@ -510,6 +564,30 @@ PlayableAudioFile::getSampleFramesAvailable()
     return actual;
 }
 
+float
+PlayableAudioFile::getBufferFillLevel()
+{
+    if (m_isSmallFile) return 1.0;
+    if (!m_ringBuffers[0]) return 0.0;
+
+    size_t readSpace = m_ringBuffers[0]->getReadSpace();
+    size_t size = readSpace + m_ringBuffers[0]->getWriteSpace();
+    if (size == 0) return 0.0;
+
+    return float(readSpace) / float(size);
+}
+
+RealTime
+PlayableAudioFile::getBufferDeadline(const RealTime &currentTime)
+{
+    RealTime from = std::max(currentTime, m_startTime);
+
+    if (isFullyBuffered()) return getEndTime();
+
+    return from + RealTime::frame2RealTime(getSampleFramesAvailable(),
+                                           m_targetSampleRate);
+}
+
 size_t
 PlayableAudioFile::addSamples(std::vector<sample_t *> &destination,
                               size_t channels, size_t nframes, size_t offset)
@@ -553,9 +631,9 @@ PlayableAudioFile::addSamples(std::vector<sample_t *> &destination,
 
     } else {
 
-        size_t cchannels;
-        size_t cframes;
-        float **cached = m_smallFileCache.getData(m_audioFile, cchannels, cframes);
+        size_t cchannels = m_targetChannels;
+        size_t cframes = m_smallFileFrames;
+        float **cached = m_smallFileData;
 
         if (!cached) {
             std::cerr << "WARNING: PlayableAudioFile::addSamples: Failed to find small file in cache" << std::endl;
@@ -631,13 +709,17 @@ PlayableAudioFile::addSamples(std::vector<sample_t *> &destination,
 void
 PlayableAudioFile::checkSmallFileCache(size_t smallFileSize)
 {
-    if (m_smallFileCache.has(m_audioFile)) {
+    AudioCache *cache = AudioCache::getInstance();
+
+    m_smallFileData = cache->acquireData
+        (m_audioFile, m_targetSampleRate, m_targetChannels, m_smallFileFrames);
+
+    if (m_smallFileData) {
 
 #ifdef DEBUG_PLAYABLE
         std::cerr << "PlayableAudioFile::checkSmallFileCache: Found file in small file cache" << std::endl;
 #endif
 
-        m_smallFileCache.incrementReference(m_audioFile);
         m_isSmallFile = true;
 
     } else if (m_audioFile->getSize() <= smallFileSize) {
@@ -654,10 +736,9 @@ PlayableAudioFile::checkSmallFileCache(size_t smallFileSize)
         std::cerr << "PlayableAudioFile::checkSmallFileCache: Adding file to small file cache" << std::endl;
 #endif
 
-        // We always encache files with their original number of
-        // channels (because they might be called for in any channel
-        // configuration subsequently) but with the current sample
-        // rate, not their original one.
+        // We encache files at the current sample rate and channel
+        // count.  Other rates and channel counts are cached as
+        // separate entries if they are ever called for.
 
         m_audioFile->scanTo(&file, RealTime::zeroTime);
 
@@ -667,34 +748,61 @@ PlayableAudioFile::checkSmallFileCache(size_t smallFileSize)
 
 //        std::cerr <<"obtained=" << obtained << std::endl;
 
-        size_t nch = getSourceChannels();
+        size_t nch = m_targetChannels;
         size_t nframes = obtained;
-        if (int(getSourceSampleRate()) != m_targetSampleRate) {
-#ifdef DEBUG_PLAYABLE
-            std::cerr << "PlayableAudioFile::checkSmallFileCache: Resampling badly from " << getSourceSampleRate() << " to " << m_targetSampleRate << std::endl;
-#endif
-            nframes = size_t(float(nframes) * float(m_targetSampleRate) /
-                             float(getSourceSampleRate()));
-        }
 
         std::vector<sample_t *> samples;
         for (size_t ch = 0; ch < nch; ++ch) {
             samples.push_back(new sample_t[nframes]);
         }
 
-        if (!m_audioFile->decode(buffer,
-                                 obtained * m_audioFile->getBytesPerFrame(),
-                                 m_targetSampleRate,
-                                 nch,
-                                 nframes,
-                                 samples)) {
+        // Decode at the file's own rate, then resample properly if
+        // the target rate differs
+
+        bool ok = m_audioFile->decode(buffer,
+                                      obtained * m_audioFile->getBytesPerFrame(),
+                                      getSourceSampleRate(),
+                                      nch,
+                                      nframes,
+                                      samples);
+
+        if (ok && int(getSourceSampleRate()) != m_targetSampleRate) {
+#ifdef DEBUG_PLAYABLE
+            std::cerr << "PlayableAudioFile::checkSmallFileCache: Resampling from " << getSourceSampleRate() << " to " << m_targetSampleRate << std::endl;
+#endif
+            float ratio = float(m_targetSampleRate) / float(getSourceSampleRate());
+
+            Resampler resampler(Resampler::Best, nch, nframes);
+            size_t outframes = resampler.getOutputSize(nframes, ratio, true);
+
+            std::vector<sample_t *> resampled;
+            for (size_t ch = 0; ch < nch; ++ch) {
+                resampled.push_back(new sample_t[outframes]);
+            }
+
+            nframes = resampler.resample(&samples[0], &resampled[0],
+                                         nframes, ratio, true);
+
+            for (size_t ch = 0; ch < nch; ++ch) {
+                delete[] samples[ch];
+            }
+            samples = resampled;
+        }
+
+        if (!ok) {
             std::cerr << "PlayableAudioFile::checkSmallFileCache: failed to decode file" << std::endl;
+            for (size_t ch = 0; ch < nch; ++ch) {
+                delete[] samples[ch];
+            }
         } else {
             sample_t **toCache = new sample_t * [nch];
             for (size_t ch = 0; ch < nch; ++ch) {
                 toCache[ch] = samples[ch];
             }
-            m_smallFileCache.addData(m_audioFile, nch, nframes, toCache);
+            m_smallFileData = cache->addData
+                (m_audioFile, m_targetSampleRate, m_targetChannels,
+                 nframes, toCache);
+            m_smallFileFrames = nframes;
             m_isSmallFile = true;
         }
 
@@ -747,6 +855,13 @@ PlayableAudioFile::clearBuffers()
 
 bool
 PlayableAudioFile::fillBuffers(const RealTime &currentTime)
+{
+    return fillBuffers(currentTime, m_readBuffers);
+}
+
+bool
+PlayableAudioFile::fillBuffers(const RealTime &currentTime,
+                               ReadBuffers &buffers)
 {
 #ifdef DEBUG_PLAYABLE
     if (!m_isSmallFile) {
@@ -799,7 +914,78 @@ PlayableAudioFile::fillBuffers(const RealTime &currentTime)
             if (m_ringBuffers[i])
                 m_ringBuffers[i]->reset();
         }
-        updateBuffers();
+        // If we have the audio from here in memory already, start
+        // with that and leave the disk to catch up on the next update
+        if (!fillFromLocateCache()) {
+            updateBuffers(buffers);
+        }
+    }
+
+    return true;
+}
+
+bool
+PlayableAudioFile::fillFromLocateCache()
+{
+    if (!m_file || m_fileEnded) return false;
+
+    // Leave the end of the file to updateBuffers, which fades it out
+    RealTime remaining = m_startIndex + m_duration - m_currentScanPoint;
+    size_t remainingFrames = 0;
+    if (remaining > RealTime::zeroTime) {
+        remainingFrames = (size_t)RealTime::realTime2Frame
+            (remaining, m_targetSampleRate);
+    }
+    if (remainingFrames <= m_xfadeFrames) return false;
+
+    if (!allocateRingBuffers()) return false;
+
+    size_t space = 0;
+    for (int ch = 0; ch < m_targetChannels; ++ch) {
+        size_t writeSpace = m_ringBuffers[ch]->getWriteSpace();
+        if (ch == 0 || writeSpace < space)
+            space = writeSpace;
+    }
+
+    size_t frames = LocateCache::getInstance()->read
+        (m_audioFile->getId(), m_currentScanPoint,
+         m_targetChannels, m_targetSampleRate,
+         m_ringBuffers, std::min(space, remainingFrames - m_xfadeFrames),
+         m_firstRead ? m_xfadeFrames : 0);
+
+    if (frames == 0) return false;
+
+#ifdef DEBUG_PLAYABLE
+    std::cerr << "PlayableAudioFile::fillFromLocateCache: took " << frames << " frames from cache at " << m_currentScanPoint << std::endl;
+#endif
+
+    // Position the file after the cached audio, ready for the next
+    // update.  This seeks but does not read.
+    RealTime next = m_currentScanPoint +
+        RealTime::frame2RealTime(frames, m_targetSampleRate);
+    if (!scanTo(next)) {
+        // Can't continue from the file: let it run out
+        m_fileEnded = true;
+    }
+    m_firstRead = false;
+
+    return true;
+}
+
+bool
+PlayableAudioFile::allocateRingBuffers()
+{
+    if (m_ringBuffers[0]) return true;
+
+    if (m_targetChannels < 0) {
+        std::cerr << "WARNING: PlayableAudioFile::allocateRingBuffers: m_targetChannels < 0, can't allocate ring buffers" << std::endl;
+        return false;
+    }
+
+    // need a buffer: can we get one?
+    if (!m_ringBufferPool->getBuffers(m_targetChannels, m_ringBuffers)) {
+        std::cerr << "WARNING: PlayableAudioFile::allocateRingBuffers: no ring buffers available" << std::endl;
+        return false;
     }
 
     return true;
@@ -807,6 +993,12 @@ PlayableAudioFile::fillBuffers(const RealTime &currentTime)
 
 bool
 PlayableAudioFile::updateBuffers()
+{
+    return updateBuffers(m_readBuffers);
+}
+
+bool
+PlayableAudioFile::updateBuffers(ReadBuffers &buffers)
 {
     if (m_isSmallFile)
         return false;
@@ -821,19 +1013,7 @@ PlayableAudioFile::updateBuffers()
         return false;
     }
 
-    if (!m_ringBuffers[0]) {
-
-        if (m_targetChannels < 0) {
-            std::cerr << "WARNING: PlayableAudioFile::updateBuffers: m_targetChannels < 0, can't allocate ring buffers" << std::endl;
-            return false;
-        }
-
-        // need a buffer: can we get one?
-        if (!m_ringBufferPool->getBuffers(m_targetChannels, m_ringBuffers)) {
-            std::cerr << "WARNING: PlayableAudioFile::updateBuffers: no ring buffers available" << std::endl;
-            return false;
-        }
-    }
+    if (!allocateRingBuffers()) return false;
 
     size_t nframes = 0;
 
@@ -878,20 +1058,10 @@ PlayableAudioFile::updateBuffers()
     std::cerr << "Want " << fileFrames << " (" << block << ") from file (" << (m_duration + m_startIndex - m_currentScanPoint - block) << " to go)" << std::endl;
 #endif
 
-    //!!! need to be doing this in initialise, want to avoid allocations here
-    if ((getBytesPerFrame() * fileFrames) > m_rawFileBufferSize) {
-        delete[] m_rawFileBuffer;
-        m_rawFileBufferSize = getBytesPerFrame() * fileFrames;
-#ifdef DEBUG_PLAYABLE_READ
-
-        std::cerr << "Expanding raw file buffer to " << m_rawFileBufferSize << " chars" << std::endl;
-#endif
-
-        m_rawFileBuffer = new char[m_rawFileBufferSize];
-    }
+    char *rawFileBuffer = buffers.getRawBuffer(getBytesPerFrame() * fileFrames);
 
     size_t obtained =
-        m_audioFile->getSampleFrames(m_file, m_rawFileBuffer, fileFrames);
+        m_audioFile->getSampleFrames(m_file, rawFileBuffer, fileFrames);
 
     if (obtained < fileFrames || m_file->eof()) {
         m_fileEnded = true;
@@ -901,36 +1071,15 @@ PlayableAudioFile::updateBuffers()
     std::cerr << "requested " << fileFrames << " frames from file for " << nframes << " frames, got " << obtained << " frames" << std::endl;
 #endif
 
-    if (nframes > m_workBufferSize) {
-
-        for (size_t i = 0; i < m_workBuffers.size(); ++i) {
-            delete[] m_workBuffers[i];
-        }
-
-        m_workBuffers.clear();
-        m_workBufferSize = nframes;
-#ifdef DEBUG_PLAYABLE_READ
-
-        std::cerr << "Expanding work buffer to " << m_workBufferSize << " frames" << std::endl;
-#endif
-
-        for (int i = 0; i < m_targetChannels; ++i) {
-            m_workBuffers.push_back(new sample_t[m_workBufferSize]);
-        }
-
-    } else {
-
-        while (m_targetChannels > (int)m_workBuffers.size()) {
-            m_workBuffers.push_back(new sample_t[m_workBufferSize]);
-        }
-    }
+    std::vector<sample_t *> &workBuffers =
+        buffers.getWorkBuffers(nframes, m_targetChannels);
 
-    if (m_audioFile->decode((const unsigned char *)m_rawFileBuffer,
+    if (m_audioFile->decode((const unsigned char *)rawFileBuffer,
                             obtained * getBytesPerFrame(),
                             m_targetSampleRate,
                             m_targetChannels,
                             nframes,
-                            m_workBuffers,
+                            workBuffers,
                             false)) {
 
         /*!!! No -- GUI and notification side of things isn't up to this yet,
@@ -952,7 +1101,7 @@ PlayableAudioFile::updateBuffers()
                     }
                     float gain = float(i + originSamples) / float(fadeSamples);
                     for (int ch = 0; ch < m_targetChannels; ++ch) {
-                        m_workBuffers[ch][i] *= gain;
+                        workBuffers[ch][i] *= gain;
                     }
                 }
             }
@@ -977,7 +1126,7 @@ PlayableAudioFile::updateBuffers()
                         }
                     }
                     for (int ch = 0; ch < m_targetChannels; ++ch) {
-                        m_workBuffers[ch][i] *= gain;
+                        workBuffers[ch][i] *= gain;
                     }
                 }
             }
@@ -992,19 +1141,19 @@ PlayableAudioFile::updateBuffers()
                 float xfade = std::min(m_xfadeFrames, nframes);
                 if (m_firstRead) {
                     for (size_t i = 0; i < xfade; ++i) {
-                        m_workBuffers[ch][i] *= float(i + 1) / xfade;
+                        workBuffers[ch][i] *= float(i + 1) / xfade;
                     }
                 }
                 if (m_fileEnded) {
                     for (size_t i = 0; i < xfade; ++i) {
-                        m_workBuffers[ch][nframes - i - 1] *=
+                        workBuffers[ch][nframes - i - 1] *=
                             float(i + 1) / xfade;
                     }
                 }
             }
 
             if (m_ringBuffers[ch]) {
-                m_ringBuffers[ch]->write(m_workBuffers[ch], nframes);
+                m_ringBuffers[ch]->write(workBuffers[ch], nframes);
             }
         }
     }
@@ -23,6 +23,7 @@
 
 #include <string>
 #include <map>
+#include <atomic>
 
 namespace Rosegarden
 {
@@ -35,6 +36,30 @@ class PlayableAudioFile
 public:
     typedef float sample_t;
 
+    /**
+     * Scratch space for reading and decoding file data.  Each thread
+     * that reads files concurrently with others must pass its own
+     * ReadBuffers to fillBuffers and updateBuffers.
+     */
+    class ReadBuffers
+    {
+    public:
+        ReadBuffers();
+        ~ReadBuffers();
+
+        char *getRawBuffer(size_t bytes);
+        std::vector<sample_t *> &getWorkBuffers(size_t frames, int channels);
+
+    private:
+        char *m_raw;
+        size_t m_rawSize;
+        std::vector<sample_t *> m_work;
+        size_t m_workSize;
+
+        ReadBuffers(const ReadBuffers &); // not provided
+        ReadBuffers &operator=(const ReadBuffers &); // not provided
+    };
+
     PlayableAudioFile(InstrumentId instrumentId,
                       AudioFile *audioFile,
                       const RealTime &startTime,
@@ -106,20 +131,49 @@ public:
     // playback) according to the proposed play time.
     //
     // This call and updateBuffers are not thread-safe (for
-    // performance reasons).  They should be called for all files
-    // sequentially within a single thread.
+    // performance reasons).  A given file must only be filled or
+    // updated by one thread at a time.  Different files may be
+    // filled concurrently, provided that each thread passes its own
+    // ReadBuffers; the versions without a ReadBuffers argument share
+    // a single static set and must all be called from one thread.
     //
     bool fillBuffers(const RealTime &currentTime);
+    bool fillBuffers(const RealTime &currentTime, ReadBuffers &buffers);
 
     void clearBuffers();
 
-    // Update the buffer during playback.
-    //
-    // This call and fillBuffers are not thread-safe (for performance
-    // reasons).  They should be called for all files sequentially
-    // within a single thread.
+    // Update the buffer during playback.  See fillBuffers for the
+    // threading rules.
     //
     bool updateBuffers();
+    bool updateBuffers(ReadBuffers &buffers);
+
+    // Proportion of the ring buffer that currently holds unread
+    // data, from 0.0 to 1.0.  Files played from the small file cache
+    // are always full.
+    //
+    float getBufferFillLevel();
+
+    // The playback time at which this file will run out of buffered
+    // data if it is not refilled, given the current playback time.
+    //
+    RealTime getBufferDeadline(const RealTime &currentTime);
+
+    // Count of blocks for which the mixer found too little data
+    // buffered for this file during playback.
+    //
+    void countUnderrun() { ++m_underruns; }
+    int getUnderrunCount() const { return m_underruns; }
+
+    // Count of underruns since the last call, for the disk reader to
+    // report.  Only the reader thread should call this.
+    //
+    int takeNewUnderruns() {
+        int count = m_underruns;
+        int since = count - m_underrunsReported;
+        m_underrunsReported = count;
+        return since;
+    }
 
     // Has fillBuffers been called and completed yet?
     //
@@ -158,6 +212,8 @@ protected:
     void checkSmallFileCache(size_t smallFileSize);
     bool scanTo(const RealTime &time);
     void returnRingBuffers();
+    bool allocateRingBuffers();
+    bool fillFromLocateCache();
 
     RealTime              m_startTime;
     RealTime              m_startIndex;
@@ -185,14 +241,13 @@ protected:
     static size_t         m_xfadeFrames;
     int                   m_runtimeSegmentId;
 
-    static AudioCache     m_smallFileCache;
+    // Whole file decoded at the target rate and channel count, held
+    // from the AudioCache for as long as we exist
     bool                  m_isSmallFile;
+    float               **m_smallFileData;
+    size_t                m_smallFileFrames;
 
-    static std::vector<sample_t *> m_workBuffers;
-    static size_t         m_workBufferSize;
-    
-    static char          *m_rawFileBuffer;
-    static size_t         m_rawFileBufferSize;
+    static ReadBuffers    m_readBuffers;
 
     RingBuffer<sample_t>  **m_ringBuffers;
     static RingBufferPool  *m_ringBufferPool;
@@ -204,6 +259,9 @@ protected:
     RealTime  m_fadeInTime;
     RealTime  m_fadeOutTime;
 
+    std::atomic<int>      m_underruns;
+    int                   m_underrunsReported;
+
 private:
     PlayableAudioFile(const PlayableAudioFile &pAF); // not provided
 };
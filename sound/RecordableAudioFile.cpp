@@ -16,17 +16,43 @@
 #include "RecordableAudioFile.h"
 
 #include <cstdlib>
+#include <sys/time.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/falloc.h>
+#endif
 
 //#define DEBUG_RECORDABLE 1
 
 namespace Rosegarden
 {
 
+// Disk space is reserved this many bytes at a time
+static const size_t PreallocationSize = 32 * 1024 * 1024;
+
+static RealTime
+getCurrentTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return RealTime(tv.tv_sec, tv.tv_usec * 1000);
+}
+
 RecordableAudioFile::RecordableAudioFile(AudioFile *audioFile,
 					 size_t bufferSize) :
     m_audioFile(audioFile),
-    m_status(IDLE)
+    m_status(IDLE),
+    m_blockFrames(bufferSize / 4),
+    m_bytesWritten(0),
+    m_bytesAllocated(0),
+    m_lastBufferFill(0),
+    m_overruns(0)
 {
+    if (m_blockFrames == 0) m_blockFrames = 1;
+
+
     for (unsigned int ch = 0; ch < audioFile->getChannels(); ++ch) {
 
 	m_ringBuffers.push_back(new RingBuffer<sample_t>(bufferSize));
@@ -39,7 +65,7 @@ RecordableAudioFile::RecordableAudioFile(AudioFile *audioFile,
 
 RecordableAudioFile::~RecordableAudioFile()
 {
-    write();
+    write(true);
     m_audioFile->close();
     delete m_audioFile;
 
@@ -62,6 +88,7 @@ RecordableAudioFile::buffer(const sample_t *data, int channel, size_t frames)
     if (frames > available) {
 	std::cerr << "RecordableAudioFile::buffer: buffer maxed out!" << std::endl;
 	frames = available;
+	m_overruns.fetch_add(1, std::memory_order_relaxed);
     }
 
 #ifdef DEBUG_RECORDABLE
@@ -72,8 +99,43 @@ RecordableAudioFile::buffer(const sample_t *data, int channel, size_t frames)
     return frames;
 }
 
+bool
+RecordableAudioFile::haveBlockToWrite() const
+{
+    // All channels are buffered together, so the first is enough
+    if (m_ringBuffers.empty()) return false;
+    return m_ringBuffers[0]->getReadSpace() >= m_blockFrames;
+}
+
+void
+RecordableAudioFile::preallocate(size_t bytesNeeded)
+{
+    if (bytesNeeded <= m_bytesAllocated) return;
+
+    size_t bytes = m_bytesAllocated + PreallocationSize;
+    if (bytes < bytesNeeded) bytes = bytesNeeded;
+
+#ifdef __linux__
+    // Reserve the space without changing the file's size, so that a
+    // take that stops early isn't left padded.  This is only a hint,
+    // and if the filesystem can't do it the writes work regardless.
+    QByteArray fileName = m_audioFile->getFilename().toLocal8Bit();
+    int fd = ::open(fileName.data(), O_WRONLY);
+    if (fd >= 0) {
+	if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, bytes) != 0) {
+#ifdef DEBUG_RECORDABLE
+	    std::cerr << "RecordableAudioFile::preallocate: fallocate failed" << std::endl;
+#endif
+	}
+	::close(fd);
+    }
+#endif
+
+    m_bytesAllocated = bytes;
+}
+
 void
-RecordableAudioFile::write()
+RecordableAudioFile::write(bool flush)
 {
     // Use a static buffer -- this obviously requires that write() is
     // only called from a single thread
@@ -94,6 +156,7 @@ RecordableAudioFile::write()
 
     // We need the same amount of available data on every channel
     size_t s = 0;
+    float fill = 0;
     for (unsigned int ch = 0; ch < channels; ++ch) {
 	size_t available = m_ringBuffers[ch]->getReadSpace();
 #ifdef DEBUG_RECORDABLE
@@ -103,10 +166,21 @@ RecordableAudioFile::write()
 
 	if (ch == 0 || available < s)
 	    s = available;
+
+	float chFill = float(available) / float(m_ringBuffers[ch]->getSize());
+	if (chFill > fill)
+	    fill = chFill;
     }
+    m_lastBufferFill = fill;
+
+    // Write whole blocks only, unless we're flushing at the end
+    if (!flush)
+	s -= s % m_blockFrames;
     if (s == 0)
 	return ;
 
+    RealTime startTime = getCurrentTime();
+
     size_t bufferReqd = channels * s;
     if (bufferReqd > bufferSize) {
 	if (buffer) {
@@ -151,7 +225,15 @@ RecordableAudioFile::write()
     std::cerr << "RecordableAudioFile::write: writing " << s << " frames at " << channels << " channels and " << bits << " bits to file" << std::endl;
 #endif
 
+    size_t bytes = s * channels * (bits / 8);
+    preallocate(m_bytesWritten + bytes);
+
     m_audioFile->appendSamples(encodeBuffer, s);
+    m_bytesWritten += bytes;
+
+    m_lastWriteTime = getCurrentTime() - startTime;
+    if (m_lastWriteTime > m_worstWriteTime)
+	m_worstWriteTime = m_lastWriteTime;
 }
 
 }
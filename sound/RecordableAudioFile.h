@@ -18,7 +18,9 @@
 
 #include "RingBuffer.h"
 #include "AudioFile.h"
+#include "base/RealTime.h"
 
+#include <atomic>
 #include <vector>
 
 namespace Rosegarden
@@ -48,13 +50,54 @@ public:
     RecordStatus getStatus() const { return m_status; }
 
     size_t buffer(const sample_t *data, int channel, size_t frames);
-    void write();
+
+    // Write buffered audio to the file.  Audio is written in whole
+    // blocks of getBlockFrames() unless flush is true, in which case
+    // everything buffered is written.
+    //
+    void write(bool flush = false);
+
+    // Frames per block written to disk.  This is a quarter of the
+    // buffer size, so the writer has time to catch up once a block is
+    // ready.
+    //
+    size_t getBlockFrames() const { return m_blockFrames; }
+
+    // True if a whole block is buffered and waiting to be written.
+    // Called from the process thread, to wake the disk thread.
+    //
+    bool haveBlockToWrite() const;
+
+    // Telemetry for the disk health meter.  The buffer fill is the
+    // fullest any channel's buffer was at the start of the last
+    // write, as a proportion of its size.  Overruns counts the calls
+    // to buffer() that had to drop audio.
+    //
+    float getLastBufferFill() const { return m_lastBufferFill; }
+    RealTime getLastWriteTime() const { return m_lastWriteTime; }
+    RealTime getWorstWriteTime() const { return m_worstWriteTime; }
+    int getOverruns() const
+        { return m_overruns.load(std::memory_order_relaxed); }
 
 protected:
+    // Reserve disk space for the file ahead of the writes, so that
+    // the filesystem doesn't have to find blocks for it as we go
+    //
+    void preallocate(size_t bytesNeeded);
+
     AudioFile            *m_audioFile;
     RecordStatus          m_status;
 
     std::vector<RingBuffer<sample_t> *> m_ringBuffers; // one per channel
+
+    size_t                m_blockFrames;
+    size_t                m_bytesWritten;
+    size_t                m_bytesAllocated;
+
+    float                 m_lastBufferFill;
+    RealTime              m_lastWriteTime;
+    RealTime              m_worstWriteTime;
+    std::atomic<int>      m_overruns; // bumped by buffer(), on the process thread
 };
 
 }
@@ -12,6 +12,7 @@
     COPYING included with this distribution for more information.
 */
 
+
 #define RG_MODULE_STRING "[Resampler]"
 
 #include "Resampler.h"
@@ -19,8 +20,15 @@
 
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <pthread.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
-//#include <samplerate.h>
 #include <misc/Debug.h>
 
 namespace Rosegarden {
@@ -42,6 +50,9 @@ public:
                                     float ratio,
                                     bool final) = 0;
 
+    virtual int getOutputSize(int incount, float ratio,
+                              bool final) const = 0;
+
     virtual int getChannelCount() const = 0;
 
     virtual void reset() = 0;
@@ -49,12 +60,235 @@ public:
 
 namespace Resamplers {
 
-class D_SRC : public ResamplerImpl
+/**
+ * A table of windowed-sinc interpolation filters, one row per
+ * fractional input offset.  Row p is the filter for an output sample
+ * p / phases of the way between two input samples.  There is one
+ * more row than phases, so that neighbouring rows can always be
+ * interpolated between.
+ *
+ * Banks depend only on quality, phase count and the downsampling
+ * scale, so they are built once and shared between all resamplers.
+ */
+struct FilterBank
+{
+    int phases;
+    int half;   // taps either side of the output position
+    int taps;   // row length, 2 * half rounded up to a multiple of 4
+    std::vector<float> coefficients;
+
+    const float *row(int p) const { return &coefficients[p * taps]; }
+};
+
+// Phase count for ratios that are not a simple fraction
+static const int GenericPhases = 512;
+
+// Largest numerator we will build an exact bank for.  All ratios
+// between 44.1, 48, 88.2 and 96kHz have numerators of 320 or less.
+static const int MaxExactPhases = 1024;
+
+struct QualityParameters
+{
+    int half;       // taps either side, when not downsampling
+    double beta;    // Kaiser window parameter
+    double rolloff; // cutoff as a proportion of the output Nyquist
+};
+
+static QualityParameters
+getQualityParameters(Resampler::Quality quality)
+{
+    QualityParameters params;
+
+    switch (quality) {
+    case Resampler::Best:
+        params.half = 64; params.beta = 10.0; params.rolloff = 0.95;
+        break;
+    case Resampler::FastestTolerable:
+        params.half = 16; params.beta = 7.0; params.rolloff = 0.86;
+        break;
+    case Resampler::Fastest:
+    default:
+        // linear interpolation
+        params.half = 1; params.beta = 0.0; params.rolloff = 1.0;
+        break;
+    }
+
+    return params;
+}
+
+static double
+besselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static FilterBank *
+buildFilterBank(Resampler::Quality quality, int phases, double scale)
+{
+    QualityParameters params = getQualityParameters(quality);
+
+    FilterBank *bank = new FilterBank;
+    bank->phases = phases;
+
+    bool linear = (quality == Resampler::Fastest);
+
+    // When downsampling, the cutoff moves down with the output
+    // Nyquist and the filter gets correspondingly longer
+    if (linear) {
+        bank->half = 1;
+    } else {
+        bank->half = int(ceil(params.half / scale));
+    }
+    bank->taps = ((2 * bank->half + 3) / 4) * 4;
+
+    double cutoff = 0.5 * params.rolloff * scale;
+    double i0beta = besselI0(params.beta);
+
+    bank->coefficients.resize((phases + 1) * bank->taps, 0.f);
+
+    for (int p = 0; p <= phases; ++p) {
+
+        double frac = double(p) / double(phases);
+        float *row = &bank->coefficients[p * bank->taps];
+        double sum = 0.0;
+
+        for (int k = 0; k < 2 * bank->half; ++k) {
+
+            double x = double(k - bank->half + 1) - frac;
+            double h = 0.0;
+
+            if (linear) {
+                h = 1.0 - fabs(x);
+                if (h < 0.0) h = 0.0;
+            } else {
+                double w = x / double(bank->half);
+                if (w > -1.0 && w < 1.0) {
+                    double arg = 2.0 * M_PI * cutoff * x;
+                    double sinc = (x == 0.0 ? 1.0 : sin(arg) / arg);
+                    h = 2.0 * cutoff * sinc *
+                        besselI0(params.beta * sqrt(1.0 - w * w)) / i0beta;
+                }
+            }
+
+            row[k] = float(h);
+            sum += h;
+        }
+
+        // unity gain at DC for every phase
+        if (sum != 0.0) {
+            for (int k = 0; k < 2 * bank->half; ++k) {
+                row[k] = float(row[k] / sum);
+            }
+        }
+    }
+
+    return bank;
+}
+
+struct FilterBankKey
+{
+    Resampler::Quality quality;
+    int phases;
+    double scale;
+
+    bool operator<(const FilterBankKey &k) const {
+        if (quality != k.quality) return quality < k.quality;
+        if (phases != k.phases) return phases < k.phases;
+        return scale < k.scale;
+    }
+};
+
+static pthread_mutex_t filterBankLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<FilterBankKey, FilterBank *> filterBanks;
+
+static const FilterBank *
+getFilterBank(Resampler::Quality quality, int phases, double scale)
+{
+    FilterBankKey key;
+    key.quality = quality;
+    key.phases = phases;
+    key.scale = scale;
+
+    pthread_mutex_lock(&filterBankLock);
+
+    std::map<FilterBankKey, FilterBank *>::iterator i = filterBanks.find(key);
+    FilterBank *bank = nullptr;
+
+    if (i != filterBanks.end()) {
+        bank = i->second;
+    } else {
+        bank = buildFilterBank(quality, phases, scale);
+        filterBanks[key] = bank;
+    }
+
+    pthread_mutex_unlock(&filterBankLock);
+    return bank;
+}
+
+/**
+ * Find a fraction num/denom equal to ratio to within float precision,
+ * with num no larger than MaxExactPhases.  Return false if there is
+ * none.
+ */
+static bool
+getExactRatio(float ratio, int &num, int &denom)
+{
+    for (int d = 1; d <= MaxExactPhases * 4; ++d) {
+        double n = floor(double(ratio) * d + 0.5);
+        if (n < 1.0 || n > MaxExactPhases) continue;
+        if (fabs(n / d - double(ratio)) <= double(ratio) * 1e-6) {
+            num = int(n);
+            denom = d;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline float
+dotProduct(const float *a, const float *b, int n)
+{
+    // n is always a multiple of 4
+
+#ifdef __SSE__
+    __m128 acc = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                         _mm_loadu_ps(b + i)));
+    }
+    float parts[4];
+    _mm_storeu_ps(parts, acc);
+    return (parts[0] + parts[1]) + (parts[2] + parts[3]);
+#else
+    float s0 = 0.f, s1 = 0.f, s2 = 0.f, s3 = 0.f;
+    for (int i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+#endif
+}
+
+/**
+ * Polyphase windowed-sinc resampler.  When the ratio is a fraction
+ * with a small enough numerator (as for all the usual sample rates)
+ * every output sample falls exactly on one row of the filter bank.
+ * Otherwise the two nearest rows of a finer bank are interpolated.
+ */
+class D_Sinc : public ResamplerImpl
 {
 public:
-    D_SRC(Resampler::Quality quality, int channels, int maxBufferSize,
-          int m_debugLevel);
-    ~D_SRC() override;
+    D_Sinc(Resampler::Quality quality, int channels, int maxBufferSize,
+           int debugLevel);
+    ~D_Sinc() override;
 
     int resample(const float *const *const in,
                  float *const *const out,
@@ -68,165 +302,277 @@ public:
                             float ratio,
                             bool final = false) override;
 
+    int getOutputSize(int incount, float ratio, bool final) const override;
+
     int getChannelCount() const override { return m_channels; }
 
     void reset() override;
 
 protected:
-    //SRC_STATE *m_src;
-    float *m_iin;
-    float *m_iout;
+    void setRatio(float ratio);
+    void append(const float *const *const in, const float *const iin,
+                int incount, bool final);
+    int produce(float *const *const out, float *const iout, int maxOut);
+
+    Resampler::Quality m_quality;
+    const FilterBank *m_bank;
     float m_lastRatio;
+    bool m_exact;
+    int m_step;          // exact: input phases per output sample
+    double m_increment;  // generic: input samples per output sample
+
     int m_channels;
-    int m_iinsize;
-    int m_ioutsize;
+    std::vector<std::vector<float> > m_buffers;
+    std::vector<float> m_interpolated;
+    int m_fill;          // valid samples in each buffer
+    int m_centre;        // buffer index at or before current output
+    int m_phase;         // exact: offset past m_centre, in 1/phases
+    double m_frac;       // generic: offset past m_centre
+    int m_end;           // buffer index of end of input, once final
     int m_debugLevel;
 };
 
-D_SRC::D_SRC(Resampler::Quality quality, int channels, int maxBufferSize,
-             int debugLevel) :
-    //m_src(nullptr),
-    m_iin(nullptr),
-    m_iout(nullptr),
-    m_lastRatio(1.f),
+D_Sinc::D_Sinc(Resampler::Quality quality, int channels, int maxBufferSize,
+               int debugLevel) :
+    m_quality(quality),
+    m_bank(nullptr),
+    m_lastRatio(0.f),
+    m_exact(false),
+    m_step(1),
+    m_increment(1.0),
     m_channels(channels),
-    m_iinsize(0),
-    m_ioutsize(0),
+    m_buffers(channels),
+    m_fill(0),
+    m_centre(0),
+    m_phase(0),
+    m_frac(0.0),
+    m_end(-1),
     m_debugLevel(debugLevel)
 {
     if (m_debugLevel > 0) {
-        RG_DEBUG << "Resampler::Resampler: using libsamplerate implementation";
+        RG_DEBUG << "Resampler::Resampler: using polyphase sinc implementation";
     }
 
-    int err = 0;
-    /*
-    m_src = src_new(quality == Resampler::Best ? SRC_SINC_BEST_QUALITY :
-                    quality == Resampler::Fastest ? SRC_LINEAR :
-                    SRC_SINC_FASTEST,
-                    channels, &err);
-*/
-    if (err) {
-/*        RG_WARNING << "Resampler::Resampler: failed to create libsamplerate resampler: "
-                  << src_strerror(err);*/
-        throw Resampler::ImplementationError; //!!! of course, need to catch this!
+    if (channels < 1) {
+        throw Resampler::ImplementationError;
     }
 
-    if (maxBufferSize > 0 && m_channels > 1) {
-        m_iinsize = maxBufferSize * m_channels;
-        m_ioutsize = maxBufferSize * m_channels * 2;
-        m_iin = (float *)malloc(sizeof(float) * m_iinsize);
-        m_iout = (float *)malloc(sizeof(float) * m_ioutsize);
+    if (maxBufferSize > 0) {
+        for (int c = 0; c < m_channels; ++c) {
+            m_buffers[c].reserve(maxBufferSize * 2);
+        }
     }
 
+    setRatio(1.f);
     reset();
 }
 
-D_SRC::~D_SRC()
+D_Sinc::~D_Sinc()
 {
-    //src_delete(m_src);
-    if (m_iin) free(m_iin);
-    if (m_iout) free(m_iout);
 }
 
-int
-D_SRC::resample(const float *const *const in,
-                float *const *const out,
-                int incount,
-                float ratio,
-                bool final)
+void
+D_Sinc::setRatio(float ratio)
 {
-    //SRC_DATA data;
+    if (ratio == m_lastRatio) return;
+
+    if (ratio <= 0.f) {
+        RG_WARNING << "Resampler::resample: invalid ratio" << ratio;
+        throw Resampler::ImplementationError;
+    }
 
-    int outcount = lrintf(ceilf(incount * ratio));
+    double scale = (ratio < 1.f ? double(ratio) : 1.0);
 
-    if (m_channels == 1) {
-      //  data.data_in = const_cast<float *>(*in); //!!!???
-      //  data.data_out = *out;
+    // Carry the current fractional position over to the new bank
+    double position = 0.0;
+    if (m_bank) {
+        position = (m_exact ? double(m_phase) / double(m_bank->phases)
+                            : m_frac);
+    }
+
+    int num = 0, denom = 0;
+    m_exact = getExactRatio(ratio, num, denom);
+
+    if (m_exact) {
+        m_bank = getFilterBank(m_quality, num, scale);
+        m_step = denom;
+        m_phase = int(floor(position * num + 0.5));
+        if (m_phase >= num) m_phase = num - 1;
     } else {
-        if (incount * m_channels > m_iinsize) {
-            m_iin = (float *)realloc(m_iin, sizeof(float) * incount * m_channels);
-            m_iinsize = incount * m_channels;
+        m_bank = getFilterBank(m_quality, GenericPhases, scale);
+        m_increment = 1.0 / double(ratio);
+        m_frac = position;
+    }
+
+    if (m_debugLevel > 1) {
+        RG_DEBUG << "Resampler: ratio" << ratio
+                 << (m_exact ? "exact" : "generic") << "with"
+                 << m_bank->phases << "phases of" << m_bank->taps << "taps";
+    }
+
+    m_interpolated.resize(m_bank->taps);
+    m_lastRatio = ratio;
+}
+
+void
+D_Sinc::append(const float *const *const in, const float *const iin,
+               int incount, bool final)
+{
+    // Drop history that no output can need any more
+    int start = m_centre - m_bank->half + 1;
+    if (start > m_fill) start = m_fill;
+    if (start > 0) {
+        for (int c = 0; c < m_channels; ++c) {
+            std::vector<float> &b = m_buffers[c];
+            memmove(&b[0], &b[start], (m_fill - start) * sizeof(float));
         }
-        if (outcount * m_channels > m_ioutsize) {
-            m_iout = (float *)realloc(m_iout, sizeof(float) * outcount * m_channels);
-            m_ioutsize = outcount * m_channels;
+        m_fill -= start;
+        m_centre -= start;
+        if (m_end >= 0) m_end -= start;
+    } else if (start < 0) {
+        // filter got longer with a change of ratio: add history
+        for (int c = 0; c < m_channels; ++c) {
+            m_buffers[c].insert(m_buffers[c].begin(), -start, 0.f);
         }
-        int idx = 0;
-        for (int i = 0; i < incount; ++i) {
-            for (int j = 0; j < m_channels; ++j) {
-                m_iin[idx++] = in[j][i];
+        m_fill -= start;
+        m_centre -= start;
+        if (m_end >= 0) m_end -= start;
+    }
+
+    if (m_end >= 0) incount = 0; // already had final input
+
+    int padding = (final ? m_bank->taps : 0);
+    int required = m_fill + incount + padding;
+
+    for (int c = 0; c < m_channels; ++c) {
+        std::vector<float> &b = m_buffers[c];
+        if (int(b.size()) < required) b.resize(required);
+        if (in) {
+            memcpy(&b[m_fill], in[c], incount * sizeof(float));
+        } else {
+            for (int i = 0; i < incount; ++i) {
+                b[m_fill + i] = iin[i * m_channels + c];
             }
         }
-
-        /*data.data_in = m_iin;
-        data.data_out = m_iout;
-*/
+        for (int i = 0; i < padding; ++i) {
+            b[m_fill + incount + i] = 0.f;
+        }
     }
-/*
-    data.input_frames = incount;
-    data.output_frames = outcount;
-    data.src_ratio = ratio;
-    data.end_of_input = (final ? 1 : 0);
 
-    int err = src_process(m_src, &data);
+    if (final && m_end < 0) m_end = m_fill + incount;
+    m_fill = required;
+}
 
-    if (err) {
-        RG_WARNING << "Resampler::process: libsamplerate error: "
-                  << src_strerror(err);
-        throw Resampler::ImplementationError; //!!! of course, need to catch this!
-    }
+int
+D_Sinc::produce(float *const *const out, float *const iout, int maxOut)
+{
+    const FilterBank *bank = m_bank;
+    const int taps = bank->taps;
+    int produced = 0;
+
+    while (produced < maxOut) {
+
+        int start = m_centre - bank->half + 1;
+        if (start + taps > m_fill) break;
+        if (m_end >= 0 && m_centre >= m_end) break;
+
+        const float *filter = nullptr;
+
+        if (m_exact) {
+            filter = bank->row(m_phase);
+        } else {
+            double position = m_frac * bank->phases;
+            int p = int(position);
+            float t = float(position - p);
+            const float *r0 = bank->row(p);
+            const float *r1 = bank->row(p + 1);
+            float *f = &m_interpolated[0];
+            for (int k = 0; k < taps; ++k) {
+                f[k] = r0[k] + t * (r1[k] - r0[k]);
+            }
+            filter = f;
+        }
+
+        for (int c = 0; c < m_channels; ++c) {
+            float v = dotProduct(&m_buffers[c][start], filter, taps);
+            if (out) out[c][produced] = v;
+            else iout[produced * m_channels + c] = v;
+        }
 
-    if (m_channels > 1) {
-        int idx = 0;
-        for (int i = 0; i < data.output_frames_gen; ++i) {
-            for (int j = 0; j < m_channels; ++j) {
-                out[j][i] = m_iout[idx++];
+        ++produced;
+
+        if (m_exact) {
+            m_phase += m_step;
+            while (m_phase >= bank->phases) {
+                m_phase -= bank->phases;
+                ++m_centre;
             }
+        } else {
+            m_frac += m_increment;
+            int whole = int(m_frac);
+            m_centre += whole;
+            m_frac -= whole;
         }
     }
 
-    m_lastRatio = ratio;
-*/
-    return 0; //data.output_frames_gen;
+    return produced;
 }
 
 int
-D_SRC::resampleInterleaved(const float *const in,
-                           float *const out,
-                           int incount,
-                           float ratio,
-                           bool final)
+D_Sinc::getOutputSize(int incount, float ratio, bool final) const
 {
-    /*SRC_DATA data;
+    if (!final) return lrintf(ceilf(incount * ratio));
+
+    // Everything not yet consumed comes out, including the input
+    // held back for the filter's lookahead
+    int pending = (m_end >= 0 ? m_end : m_fill + incount) - m_centre;
+    if (pending < 0) pending = 0;
+    return lrint(ceil(pending * double(ratio))) + 1;
+}
 
-    int outcount = lrintf(ceilf(incount * ratio));
+int
+D_Sinc::resample(const float *const *const in,
+                 float *const *const out,
+                 int incount,
+                 float ratio,
+                 bool final)
+{
+    setRatio(ratio);
 
-    data.data_in = const_cast<float *>(in);
-    data.data_out = out;
+    int outcount = getOutputSize(incount, ratio, final);
 
-    data.input_frames = incount;
-    data.output_frames = outcount;
-    data.src_ratio = ratio;
-    data.end_of_input = (final ? 1 : 0);
+    append(in, nullptr, incount, final);
+    return produce(out, nullptr, outcount);
+}
 
-    int err = src_process(m_src, &data);
+int
+D_Sinc::resampleInterleaved(const float *const in,
+                            float *const out,
+                            int incount,
+                            float ratio,
+                            bool final)
+{
+    setRatio(ratio);
 
-    if (err) {
-        RG_WARNING << "Resampler::process: libsamplerate error: "
-                  << src_strerror(err);
-        throw Resampler::ImplementationError; //!!! of course, need to catch this!
-    }
-*/
-    m_lastRatio = ratio;
+    int outcount = getOutputSize(incount, ratio, final);
 
-    //return data.output_frames_gen;
-    return 0;
+    append(nullptr, in, incount, final);
+    return produce(nullptr, out, outcount);
 }
 
 void
-D_SRC::reset()
+D_Sinc::reset()
 {
-    //src_reset(m_src);
+    // Start with enough silent history that the first output sample
+    // lines up with the first input sample
+    m_fill = m_bank->half - 1;
+    for (int c = 0; c < m_channels; ++c) {
+        m_buffers[c].assign(m_fill, 0.f);
+    }
+    m_centre = m_fill;
+    m_phase = 0;
+    m_frac = 0.0;
+    m_end = -1;
 }
 
 
@@ -235,7 +581,7 @@ D_SRC::reset()
 Resampler::Resampler(Resampler::Quality quality, int channels,
                      int maxBufferSize, int debugLevel)
 {
-    d = new Resamplers::D_SRC(quality, channels, maxBufferSize, debugLevel);
+    d = new Resamplers::D_Sinc(quality, channels, maxBufferSize, debugLevel);
 }
 
 Resampler::~Resampler()
@@ -261,6 +607,12 @@ Resampler::resampleInterleaved(const float *const in,
     return d->resampleInterleaved(in, out, incount, ratio, final);
 }
 
+int
+Resampler::getOutputSize(int incount, float ratio, bool final) const
+{
+    return d->getOutputSize(incount, ratio, final);
+}
+
 int
 Resampler::getChannelCount() const
 {
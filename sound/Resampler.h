@@ -20,6 +20,13 @@ namespace Rosegarden {
 
 class ResamplerImpl;
 
+/**
+ * Sample rate converter.  Best and FastestTolerable use a polyphase
+ * windowed-sinc filter (with a longer, sharper filter for Best);
+ * Fastest interpolates linearly.  The filter tables are computed once
+ * per quality and ratio and shared by all resamplers, so there is no
+ * set-up cost per voice beyond the first.
+ */
 class Resampler
 {
 public:
@@ -40,6 +47,10 @@ public:
      * Resample the given multi-channel buffers, where incount is the
      * number of frames in the input buffers.  Returns the number of
      * frames written to the output buffers.
+     *
+     * The output lags the input by the length of the filter.  When
+     * final is set, the frames held back are written too, so the
+     * output buffers must have room for getOutputSize() frames.
      */
     int resample(const float *const *const in,
                  float *const *const out,
@@ -59,6 +70,12 @@ public:
                             float ratio,
                             bool final = false);
 
+    /**
+     * The most frames a call to resample() or resampleInterleaved()
+     * with these arguments can write.
+     */
+    int getOutputSize(int incount, float ratio, bool final) const;
+
     int getChannelCount() const;
 
     void reset();
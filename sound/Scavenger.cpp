@@ -0,0 +1,132 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2018 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "Scavenger.h"
+
+namespace Rosegarden
+{
+
+std::atomic<unsigned int> ScavengerReader::m_epoch(1);
+std::atomic<unsigned int> ScavengerReader::m_readerEpochs[MaxReaders];
+std::atomic<bool> ScavengerReader::m_slotsInUse[MaxReaders];
+std::atomic<int> ScavengerReader::m_untracked(0);
+
+ScavengerReader::ScavengerReader() :
+    m_slot(-1),
+    m_depth(0)
+{
+    for (int i = 0; i < MaxReaders; ++i) {
+        bool expected = false;
+        if (m_slotsInUse[i].compare_exchange_strong(expected, true)) {
+            m_readerEpochs[i] = 0;
+            m_slot = i;
+            return;
+        }
+    }
+
+    std::cerr << "WARNING: ScavengerReader: no reader slot available, "
+              << "scavengers will fall back to time-based disposal"
+              << std::endl;
+    ++m_untracked;
+}
+
+ScavengerReader::~ScavengerReader()
+{
+    if (m_slot < 0) {
+        --m_untracked;
+        return;
+    }
+    m_readerEpochs[m_slot] = 0;
+    m_slotsInUse[m_slot] = false;
+}
+
+void
+ScavengerReader::enter()
+{
+    if (m_slot < 0) return;
+
+    // Publish the epoch we are entering, then check that no claim
+    // slipped in between our reading it and publishing it: if one
+    // did, a scavenger may already have decided that nobody can see
+    // the claimed object.
+
+    unsigned int e;
+    do {
+        e = m_epoch;
+        if (e == 0) continue; // advance() is about to skip past 0
+        m_readerEpochs[m_slot] = e;
+    } while (e == 0 || m_epoch != e);
+}
+
+void
+ScavengerReader::leave()
+{
+    if (m_slot < 0) return;
+    m_readerEpochs[m_slot] = 0;
+}
+
+ScavengerReader &
+ScavengerReader::getThreadReader()
+{
+    static thread_local ScavengerReader reader;
+    return reader;
+}
+
+void
+ScavengerReader::enterThread()
+{
+    ScavengerReader &reader = getThreadReader();
+    if (reader.m_depth++ == 0) reader.enter();
+}
+
+void
+ScavengerReader::leaveThread()
+{
+    ScavengerReader &reader = getThreadReader();
+    if (--reader.m_depth == 0) reader.leave();
+}
+
+unsigned int
+ScavengerReader::advance()
+{
+    unsigned int e = ++m_epoch;
+    if (e == 0) e = ++m_epoch;
+    return e;
+}
+
+unsigned int
+ScavengerReader::getSafeEpoch()
+{
+    // Read the current epoch before looking at the readers, so that
+    // a reader entering during the scan cannot be missed.
+
+    unsigned int safe = m_epoch;
+    if (safe == 0) safe = ++m_epoch;
+
+    for (int i = 0; i < MaxReaders; ++i) {
+        unsigned int e = m_readerEpochs[i];
+        if (e != 0 && !isNoLaterThan(safe, e)) safe = e;
+    }
+
+    return safe;
+}
+
+bool
+ScavengerReader::haveUntrackedReaders()
+{
+    return m_untracked > 0;
+}
+
+}
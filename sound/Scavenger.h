@@ -18,6 +18,7 @@
 
 #include <vector>
 #include <list>
+#include <atomic>
 #include <sys/time.h>
 #include <pthread.h>
 #include <iostream>
@@ -25,21 +26,123 @@
 namespace Rosegarden
 {
 
+/**
+ * A ScavengerReader is held by each real-time thread that may be
+ * using objects passed to a Scavenger, such as plugin instances, ring
+ * buffer storage and audio play queues.  The thread brackets every
+ * processing block with enter() and leave(), and must not keep any
+ * such object pointer from one block to the next.
+ *
+ * Every claim on a Scavenger starts a new epoch.  An object claimed
+ * in epoch e can be deleted as soon as no reader is still inside a
+ * block that it entered before e -- typically within one block,
+ * rather than after a fixed delay.
+ *
+ * enter() and leave() are lock-free and O(1).  The constructor and
+ * destructor are not RT-safe, so a thread's reader should be created
+ * before the thread starts processing.
+ *
+ * Non-RT threads that reach these objects through the driver (the
+ * sequencer thread, the GUI calling into the sequencer, the disk
+ * workers) use a Scope instead, which brackets the work with a reader
+ * belonging to the calling thread.  Any thread that touches a
+ * scavenged object outside both a reader block and a Scope may find
+ * it already deleted.
+ */
+
+class ScavengerReader
+{
+public:
+    ScavengerReader();
+    ~ScavengerReader();
+
+    void enter();
+    void leave();
+
+    /**
+     * Enter or leave the calling thread's own reader, which is
+     * created the first time the thread calls enterThread().  Calls
+     * nest, the outermost pair doing the enter() and leave().  Not
+     * for RT threads, as the first call on a thread allocates.
+     */
+    static void enterThread();
+    static void leaveThread();
+
+    /// Calls enterThread() and leaveThread() for the enclosing block.
+    class Scope
+    {
+    public:
+        Scope() { enterThread(); }
+        ~Scope() { leaveThread(); }
+
+    private:
+        Scope(const Scope &);
+        Scope &operator=(const Scope &);
+    };
+
+    /**
+     * Start a new epoch, returning its number, with which an object
+     * being claimed should be stamped.  Lock-free.
+     */
+    static unsigned int advance();
+
+    /**
+     * Return the epoch number s such that every object stamped with
+     * an epoch e no later than s (in wrapping order) is no longer
+     * visible to any reader.
+     */
+    static unsigned int getSafeEpoch();
+
+    /// Is epoch e no later than epoch s, allowing for wraparound?
+    static bool isNoLaterThan(unsigned int e, unsigned int s) {
+        return int(s - e) >= 0;
+    }
+
+    /**
+     * True if a reader could not be given a slot, in which case
+     * Scavengers fall back to their time-based delay.
+     */
+    static bool haveUntrackedReaders();
+
+private:
+    ScavengerReader(const ScavengerReader &);
+    ScavengerReader &operator=(const ScavengerReader &);
+
+    enum { MaxReaders = 64 };
+
+    int m_slot;
+    int m_depth; // nesting of enterThread(); used by the owning thread
+
+    static ScavengerReader &getThreadReader();
+
+    static std::atomic<unsigned int> m_epoch;
+    static std::atomic<unsigned int> m_readerEpochs[MaxReaders]; // 0 = idle
+    static std::atomic<bool> m_slotsInUse[MaxReaders];
+    static std::atomic<int> m_untracked;
+};
+
 /**
  * A very simple class that facilitates running things like plugins
  * without locking, by collecting unwanted objects and deleting them
- * after a delay so as to be sure nobody's in the middle of using
- * them.  Requires scavenge() to be called regularly from a non-RT
- * thread.
+ * once no ScavengerReader can still be using them.  Requires
+ * scavenge() to be called regularly from a non-RT thread.
  *
- * This is currently not at all suitable for large numbers of objects
- * -- it's just a quick hack for use with things like plugins.
+ * Claimed objects are kept in a single-writer, single-reader FIFO, so
+ * claim() and scavenge() are O(1) per object.  Objects are claimed in
+ * epoch order, so scavenge() can stop at the first one still in use.
  */
 
 template <typename T>
 class Scavenger
 {
 public:
+    /**
+     * sec is the delay after which objects are deleted regardless of
+     * epoch, used only if some reading thread could not be given a
+     * ScavengerReader slot.  defaultObjectListSize is the number of
+     * objects that can await deletion before claim() stops being
+     * lock-free.
+     */
     Scavenger(int sec = 2, int defaultObjectListSize = 200);
     ~Scavenger();
 
@@ -63,20 +166,28 @@ public:
     void scavenge();
 
 protected:
-    typedef std::pair<T *, int> ObjectTimePair;
-    typedef std::vector<ObjectTimePair> ObjectTimeList;
-    ObjectTimeList m_objects;
+    struct Claimed {
+        Claimed() : object(nullptr), epoch(0), sec(0) { }
+        T *object;
+        unsigned int epoch;
+        int sec;
+    };
+    typedef std::vector<Claimed> ObjectList;
+    ObjectList m_objects;
+    std::atomic<size_t> m_writeIndex; // written only by claim()
+    std::atomic<size_t> m_readIndex;  // written only by scavenge()
     int m_sec;
 
-    typedef std::list<T *> ObjectList;
-    ObjectList m_excess;
-    int m_lastExcess;
+    typedef std::list<Claimed> ExcessList;
+    ExcessList m_excess;
+    std::atomic<bool> m_haveExcess;
     pthread_mutex_t m_excessMutex;
-    void pushExcess(T *);
-    void clearExcess(int);
+    void pushExcess(const Claimed &);
+    void clearExcess(unsigned int safeEpoch, int sec, bool all);
 
-    unsigned int m_claimed;
-    unsigned int m_scavenged;
+    bool isDisposable(const Claimed &, unsigned int safeEpoch,
+                      int sec) const;
+    static int getSeconds();
 };
 
 /**
@@ -97,11 +208,11 @@ private:
 
 template <typename T>
 Scavenger<T>::Scavenger(int sec, int defaultObjectListSize) :
-    m_objects(ObjectTimeList(defaultObjectListSize)),
+    m_objects(ObjectList(defaultObjectListSize + 1)),
+    m_writeIndex(0),
+    m_readIndex(0),
     m_sec(sec),
-    m_lastExcess(0),
-    m_claimed(0),
-    m_scavenged(0)
+    m_haveExcess(false)
 {
     pthread_mutex_init(&m_excessMutex, nullptr);
 }
@@ -109,92 +220,115 @@ Scavenger<T>::Scavenger(int sec, int defaultObjectListSize) :
 template <typename T>
 Scavenger<T>::~Scavenger()
 {
-    if (m_scavenged < m_claimed) {
-        for (size_t i = 0; i < m_objects.size(); ++i) {
-            ObjectTimePair &pair = m_objects[i];
-            if (pair.first != nullptr) {
-                delete pair.first;
-                pair.first = nullptr;
-                ++m_scavenged;
-            }
-        }
+    size_t r = m_readIndex;
+    size_t w = m_writeIndex;
+
+    while (r != w) {
+        delete m_objects[r].object;
+        m_objects[r].object = nullptr;
+        r = (r + 1) % m_objects.size();
     }
+    m_readIndex = r;
 
-    clearExcess(0);
+    clearExcess(0, 0, true);
 
     pthread_mutex_destroy(&m_excessMutex);
 }
 
 template <typename T>
-void
-Scavenger<T>::claim(T *t)
+int
+Scavenger<T>::getSeconds()
 {
     struct timeval tv;
     (void)gettimeofday(&tv, nullptr);
-    int sec = tv.tv_sec;
-
-    for (size_t i = 0; i < m_objects.size(); ++i) {
-        ObjectTimePair &pair = m_objects[i];
-        if (pair.first == nullptr) {
-            pair.second = sec;
-            pair.first = t;
-            ++m_claimed;
-            return;
-        }
+    return tv.tv_sec;
+}
+
+template <typename T>
+bool
+Scavenger<T>::isDisposable(const Claimed &claimed, unsigned int safeEpoch,
+                           int sec) const
+{
+    if (!ScavengerReader::isNoLaterThan(claimed.epoch, safeEpoch)) {
+        return false;
+    }
+    if (ScavengerReader::haveUntrackedReaders()) {
+        return claimed.sec + m_sec < sec;
+    }
+    return true;
+}
+
+template <typename T>
+void
+Scavenger<T>::claim(T *t)
+{
+    Claimed claimed;
+    claimed.object = t;
+    claimed.epoch = ScavengerReader::advance();
+    claimed.sec = getSeconds();
+
+    size_t w = m_writeIndex.load(std::memory_order_relaxed);
+    size_t next = (w + 1) % m_objects.size();
+
+    if (next != m_readIndex.load(std::memory_order_acquire)) {
+        m_objects[w] = claimed;
+        m_writeIndex.store(next, std::memory_order_release);
+        return;
     }
 
     std::cerr << "WARNING: Scavenger::claim(" << t << "): run out of slots, "
               << "using non-RT-safe method" << std::endl;
-    pushExcess(t);
+    pushExcess(claimed);
 }
 
 template <typename T>
 void
 Scavenger<T>::scavenge()
 {
-    if (m_scavenged >= m_claimed) return;
-    
-    struct timeval tv;
-    (void)gettimeofday(&tv, nullptr);
-    int sec = tv.tv_sec;
-
-    for (size_t i = 0; i < m_objects.size(); ++i) {
-        ObjectTimePair &pair = m_objects[i];
-        if (pair.first != 0 && pair.second + m_sec < sec) {
-            delete pair.first;
-            pair.first = nullptr;
-            ++m_scavenged;
-        }
+    size_t r = m_readIndex.load(std::memory_order_relaxed);
+    size_t w = m_writeIndex.load(std::memory_order_acquire);
+
+    if (r == w && !m_haveExcess) return;
+
+    unsigned int safeEpoch = ScavengerReader::getSafeEpoch();
+    int sec = getSeconds();
+
+    // Objects were claimed in epoch order, so stop at the first one
+    // that may still be visible.
+
+    while (r != w && isDisposable(m_objects[r], safeEpoch, sec)) {
+        delete m_objects[r].object;
+        m_objects[r].object = nullptr;
+        r = (r + 1) % m_objects.size();
+        m_readIndex.store(r, std::memory_order_release);
     }
 
-    if (sec > m_lastExcess + m_sec) {
-        clearExcess(sec);
+    if (m_haveExcess) {
+        clearExcess(safeEpoch, sec, false);
     }
 }
 
 template <typename T>
 void
-Scavenger<T>::pushExcess(T *t)
+Scavenger<T>::pushExcess(const Claimed &claimed)
 {
     pthread_mutex_lock(&m_excessMutex);
-    m_excess.push_back(t);
-    struct timeval tv;
-    (void)gettimeofday(&tv, nullptr);
-    m_lastExcess = tv.tv_sec;
+    m_excess.push_back(claimed);
+    m_haveExcess = true;
     pthread_mutex_unlock(&m_excessMutex);
 }
 
 template <typename T>
 void
-Scavenger<T>::clearExcess(int sec)
+Scavenger<T>::clearExcess(unsigned int safeEpoch, int sec, bool all)
 {
     pthread_mutex_lock(&m_excessMutex);
-    for (typename ObjectList::iterator i = m_excess.begin();
-         i != m_excess.end(); ++i) {
-        delete *i;
+    while (!m_excess.empty() &&
+           (all || isDisposable(m_excess.front(), safeEpoch, sec))) {
+        delete m_excess.front().object;
+        m_excess.pop_front();
     }
-    m_excess.clear();
-    m_lastExcess = sec;
+    m_haveExcess = !m_excess.empty();
     pthread_mutex_unlock(&m_excessMutex);
 }
 
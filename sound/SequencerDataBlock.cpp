@@ -24,6 +24,133 @@
 namespace Rosegarden
 {
 
+// A peak is held for this long, in milliseconds, unless a higher one
+// comes along.
+static const qint64 peakHoldTime = 1500;
+
+// A reader gives up after this many tries, rather than spin on a
+// writer that has been interrupted half way through.
+static const int maxReadAttempts = 100;
+
+// Make the sequence number odd for writing.  Returns false, without
+// waiting, if another writer has it.
+static bool
+beginWrite(std::atomic<unsigned> &sequence)
+{
+    unsigned s = sequence.load(std::memory_order_relaxed);
+    if (s & 1) return false;
+    if (!sequence.compare_exchange_strong(s, s + 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+        return false;
+    }
+    // Keep the values from being written before the sequence number
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+static void
+endWrite(std::atomic<unsigned> &sequence)
+{
+    sequence.fetch_add(1, std::memory_order_release);
+}
+
+// Whether the values read since the sequence number was s are whole.
+static bool
+endRead(const std::atomic<unsigned> &sequence, unsigned s)
+{
+    // Keep the values from being read after the sequence number
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence.load(std::memory_order_relaxed) == s;
+}
+
+LevelMeter::LevelMeter() :
+    m_sequence(0)
+{
+    for (int i = 0; i < ValueCount; ++i) {
+        m_values[i].store(0, std::memory_order_relaxed);
+    }
+    m_holdSince[0] = m_holdSince[1] = 0;
+}
+
+void
+LevelMeter::set(const LevelInfo &info, qint64 now)
+{
+    if (!beginWrite(m_sequence))
+        return;
+
+    const int peak[2] = { info.level, info.levelRight };
+
+    for (int ch = 0; ch < 2; ++ch) {
+        int hold = m_values[PeakHold + ch].load(std::memory_order_relaxed);
+        if (peak[ch] >= hold || now - m_holdSince[ch] > peakHoldTime) {
+            hold = peak[ch];
+            m_holdSince[ch] = now;
+        }
+        m_values[PeakHold + ch].store(hold, std::memory_order_relaxed);
+    }
+
+    m_values[Level].store(info.level, std::memory_order_relaxed);
+    m_values[LevelRight].store(info.levelRight, std::memory_order_relaxed);
+    m_values[Rms].store(info.rms, std::memory_order_relaxed);
+    m_values[RmsRight].store(info.rmsRight, std::memory_order_relaxed);
+
+    endWrite(m_sequence);
+}
+
+bool
+LevelMeter::get(LevelInfo &info, unsigned &lastSeen, bool *gaveUp) const
+{
+    if (gaveUp) *gaveUp = false;
+
+    for (int attempt = 0; attempt < maxReadAttempts; ++attempt) {
+
+        unsigned s = m_sequence.load(std::memory_order_acquire);
+        if (s & 1)
+            continue;
+
+        int values[ValueCount];
+        for (int i = 0; i < ValueCount; ++i) {
+            values[i] = m_values[i].load(std::memory_order_relaxed);
+        }
+
+        if (!endRead(m_sequence, s))
+            continue;
+
+        info.level = values[Level];
+        info.levelRight = values[LevelRight];
+        info.rms = values[Rms];
+        info.rmsRight = values[RmsRight];
+        info.peakHold = values[PeakHold];
+        info.peakHoldRight = values[PeakHoldRight];
+
+        if (s == lastSeen)
+            return false; // no change
+
+        lastSeen = s;
+        return true;
+    }
+
+    // Leave lastSeen alone, so that the next call tries again
+    info = LevelInfo();
+    if (gaveUp) *gaveUp = true;
+    return false;
+}
+
+void
+LevelMeter::clear()
+{
+    // A writer never waits inside, so this can't be for long
+    while (!beginWrite(m_sequence)) { }
+
+    for (int i = 0; i < ValueCount; ++i) {
+        m_values[i].store(0, std::memory_order_relaxed);
+    }
+    m_holdSince[0] = m_holdSince[1] = 0;
+
+    endWrite(m_sequence);
+}
+
 SequencerDataBlock *
 SequencerDataBlock::getInstance()
 {
@@ -32,57 +159,83 @@ SequencerDataBlock::getInstance()
     return instance;
 }
 
-SequencerDataBlock::SequencerDataBlock()
+SequencerDataBlock::SequencerDataBlock() :
+    m_visualSequence(0),
+    m_lastVisualSequence(0),
+    m_knownInstrumentCount(0)
 {
+    m_clock.start();
+
+    memset(m_lastLevels, 0, sizeof(m_lastLevels));
+    memset(m_lastRecordLevels, 0, sizeof(m_lastRecordLevels));
+    memset(m_lastSubmasterLevels, 0, sizeof(m_lastSubmasterLevels));
+    m_lastMasterLevel = 0;
+
+    for (int reader = 0; reader < MeterReaderCount; ++reader) {
+        for (int word = 0;
+             word < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS / 64; ++word) {
+            m_changedInstruments[reader][word].store
+                (0, std::memory_order_relaxed);
+        }
+    }
+
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        m_recordDiskSequence[i].store(0, std::memory_order_relaxed);
+        for (int v = 0; v < DiskValueCount; ++v) {
+            m_recordDiskInfo[i][v].store(0, std::memory_order_relaxed);
+        }
+    }
+
     clearTemporaries();
 }
 
 bool
 SequencerDataBlock::getVisual(MappedEvent &ev)
 {
-    // If there is no visual event, or setVisual() is working, bail
-    if (!m_haveVisualEvent)
-        return false;
+    for (int attempt = 0; attempt < maxReadAttempts; ++attempt) {
 
-    // Get the index in case setVisual() changes it.
-    int thisEventIndex = m_setVisualIndex;
+        unsigned s = m_visualSequence.load(std::memory_order_acquire);
 
-    // If we've already seen this one, bail.  This prevents reading
-    // before setVisual() is finished updating.
-    if (thisEventIndex == m_getVisualIndex)
-        return false;
+        // If we've already seen this one, bail.
+        if (s == m_lastVisualSequence)
+            return false;
 
-    // ??? A call to setVisual() could happen at this point and modify
-    //     m_visualEvent while we are reading it.  This isn't as safe as
-    //     it appears.  I think we need a mutex for this.  Though since
-    //     it is just the MIDI OUT display on playback, it's probably not
-    //     worth worrying about.
+        // setVisual() is working
+        if (s & 1)
+            continue;
 
-    // Copy the event to the caller.
-    ev = *((MappedEvent *) & m_visualEvent);
+        // Copied aside, as it may be torn if setVisual() starts now
+        MappedEvent event(*((MappedEvent *)&m_visualEvent));
 
-    // Remember where we were for next time.
-    m_getVisualIndex = thisEventIndex;
+        if (!endRead(m_visualSequence, s))
+            continue;
 
-    return true;
+        ev = event;
+
+        // Remember where we were for next time.
+        m_lastVisualSequence = s;
+
+        return true;
+    }
+
+    return false;
 }
 
 void
 SequencerDataBlock::setVisual(const MappedEvent *ev)
 {
-    // Prevent access by getVisual() while we are changing this.
-    m_haveVisualEvent = false;
+    if (!ev)
+        return;
 
-    if (ev) {
-        // Save the visual event
-        *((MappedEvent *)&m_visualEvent) = *ev;
+    // If getVisual() is slow to catch up, it only misses an event, so
+    // there is no need to wait for anyone.
+    if (!beginWrite(m_visualSequence))
+        return;
 
-        // Indicate that it has changed and it is safe to read now.
-        ++m_setVisualIndex;
+    // Save the visual event
+    *((MappedEvent *)&m_visualEvent) = *ev;
 
-        // Allow access once again.
-        m_haveVisualEvent = true;
-    }
+    endWrite(m_visualSequence);
 }
 
 int
@@ -135,9 +288,9 @@ SequencerDataBlock::addRecordedEvents(MappedEventList *mC)
 int
 SequencerDataBlock::instrumentToIndex(InstrumentId id) const
 {
-    int i;
+    int count = m_knownInstrumentCount.load(std::memory_order_acquire);
 
-    for (i = 0; i < m_knownInstrumentCount; ++i) {
+    for (int i = 0; i < count; ++i) {
         if (m_knownInstruments[i] == id)
             return i;
     }
@@ -148,148 +301,199 @@ SequencerDataBlock::instrumentToIndex(InstrumentId id) const
 int
 SequencerDataBlock::instrumentToIndexCreating(InstrumentId id)
 {
-    int i;
+    int index = instrumentToIndex(id);
+    if (index >= 0)
+        return index;
+
+    // Another writer may be adding one too.  This only happens the
+    // first time each instrument is heard from.
+    QMutexLocker locker(&m_knownInstrumentsMutex);
 
-    for (i = 0; i < m_knownInstrumentCount; ++i) {
+    int count = m_knownInstrumentCount.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < count; ++i) {
         if (m_knownInstruments[i] == id)
             return i;
     }
 
-    if (i == SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS) {
+    if (count == SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS) {
         RG_WARNING << "ERROR: SequencerDataBlock::instrumentToIndexCreating("
         << id << "): out of instrument index space";
         return -1;
     }
 
-    m_knownInstruments[i] = id;
-    ++m_knownInstrumentCount;
-    return i;
+    // Readers only look as far as the count, so it is set last
+    m_knownInstruments[count] = id;
+    m_knownInstrumentCount.store(count + 1, std::memory_order_release);
+    return count;
 }
 
 bool
-SequencerDataBlock::getInstrumentLevel(InstrumentId id,
-                                       LevelInfo &info) const
+SequencerDataBlock::getLevel(const LevelMeter *meters, unsigned *lastSeen,
+                             MeterReader reader, InstrumentId id,
+                             LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
     int index = instrumentToIndex(id);
     if (index < 0) {
-        info.level = info.levelRight = 0;
+        info = LevelInfo();
         return false;
     }
 
-    int currentUpdateIndex = m_levelUpdateIndices[index];
-    info = m_levels[index];
+    bool gaveUp;
+    bool changed = meters[index].get(info, lastSeen[index], &gaveUp);
 
-    /*
-    std::cout << "SequencerDataBlock::getInstrumentLevel - "
-              << "id = " << id
-              << ", level = " << info.level << std::endl;
-              */
+    // getChangedInstruments() has taken the bit, and the writer may
+    // not set the meter again for a while, so put it back.
+    if (gaveUp)
+        markChanged(reader, index);
 
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return changed;
 }
 
-bool
-SequencerDataBlock::getInstrumentLevelForMixer(InstrumentId id,
-        LevelInfo &info) const
+void
+SequencerDataBlock::setLevel(LevelMeter *meters, InstrumentId id,
+                             const LevelInfo &info)
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
-    int index = instrumentToIndex(id);
-    if (index < 0) {
-        info.level = info.levelRight = 0;
-        return false;
-    }
+    int index = instrumentToIndexCreating(id);
+    if (index < 0)
+        return ;
 
-    int currentUpdateIndex = m_levelUpdateIndices[index];
-    info = m_levels[index];
+    meters[index].set(info, m_clock.elapsed());
 
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
+    for (int reader = 0; reader < MeterReaderCount; ++reader) {
+        markChanged(MeterReader(reader), index);
     }
 }
 
 void
-SequencerDataBlock::setInstrumentLevel(InstrumentId id, const LevelInfo &info)
+SequencerDataBlock::markChanged(MeterReader reader, int index) const
 {
-    int index = instrumentToIndexCreating(id);
-    if (index < 0)
-        return ;
+    m_changedInstruments[reader][index / 64].fetch_or
+        (quint64(1) << (index % 64), std::memory_order_release);
+}
+
+void
+SequencerDataBlock::getChangedInstruments(MeterReader reader,
+                                          std::set<InstrumentId> &ids)
+{
+    int count = m_knownInstrumentCount.load(std::memory_order_acquire);
+
+    for (int word = 0; word * 64 < count; ++word) {
 
-    m_levels[index] = info;
-    ++m_levelUpdateIndices[index];
+        quint64 bits = m_changedInstruments[reader][word].exchange
+            (0, std::memory_order_acquire);
+
+        for (int bit = 0; bits; ++bit, bits >>= 1) {
+            if (bits & 1)
+                ids.insert(m_knownInstruments[word * 64 + bit]);
+        }
+    }
 }
 
 bool
-SequencerDataBlock::getInstrumentRecordLevel(InstrumentId id, LevelInfo &info) const
+SequencerDataBlock::getInstrumentLevel(InstrumentId id,
+                                       LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    return getLevel(m_levels, m_lastLevels[TrackMeters], TrackMeters,
+                    id, info);
+}
 
-    int index = instrumentToIndex(id);
-    if (index < 0) {
-        info.level = info.levelRight = 0;
-        return false;
-    }
+bool
+SequencerDataBlock::getInstrumentLevelForMixer(InstrumentId id,
+        LevelInfo &info) const
+{
+    return getLevel(m_levels, m_lastLevels[MixerMeters], MixerMeters,
+                    id, info);
+}
 
-    int currentUpdateIndex = m_recordLevelUpdateIndices[index];
-    info = m_recordLevels[index];
+void
+SequencerDataBlock::setInstrumentLevel(InstrumentId id, const LevelInfo &info)
+{
+    setLevel(m_levels, id, info);
+}
 
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+bool
+SequencerDataBlock::getInstrumentRecordLevel(InstrumentId id, LevelInfo &info) const
+{
+    return getLevel(m_recordLevels, m_lastRecordLevels[TrackMeters],
+                    TrackMeters, id, info);
 }
 
 bool
 SequencerDataBlock::getInstrumentRecordLevelForMixer(InstrumentId id, LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    return getLevel(m_recordLevels, m_lastRecordLevels[MixerMeters],
+                    MixerMeters, id, info);
+}
 
+void
+SequencerDataBlock::setInstrumentRecordLevel(InstrumentId id, const LevelInfo &info)
+{
+    setLevel(m_recordLevels, id, info);
+}
+
+bool
+SequencerDataBlock::getInstrumentRecordDiskInfo(InstrumentId id,
+                                                RecordDiskInfo &info) const
+{
     int index = instrumentToIndex(id);
-    if (index < 0) {
-        info.level = info.levelRight = 0;
+    if (index < 0 ||
+        !m_haveRecordDiskInfo[index].load(std::memory_order_acquire)) {
+        memset(&info, 0, sizeof(info));
         return false;
     }
 
-    int currentUpdateIndex = m_recordLevelUpdateIndices[index];
-    info = m_recordLevels[index];
+    const std::atomic<unsigned> &sequence = m_recordDiskSequence[index];
+    const std::atomic<int> *values = m_recordDiskInfo[index];
+
+    for (int attempt = 0; attempt < maxReadAttempts; ++attempt) {
+
+        unsigned s = sequence.load(std::memory_order_acquire);
+        if (s & 1)
+            continue;
+
+        RecordDiskInfo read;
+        read.bufferFill = values[DiskBufferFill].load
+            (std::memory_order_relaxed);
+        read.writeTime = values[DiskWriteTime].load
+            (std::memory_order_relaxed);
+        read.worstWriteTime = values[DiskWorstWriteTime].load
+            (std::memory_order_relaxed);
+        read.overruns = values[DiskOverruns].load
+            (std::memory_order_relaxed);
 
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
+        if (!endRead(sequence, s))
+            continue;
+
+        info = read;
         return true;
-    } else {
-        return false; // no change
     }
+
+    memset(&info, 0, sizeof(info));
+    return false;
 }
 
 void
-SequencerDataBlock::setInstrumentRecordLevel(InstrumentId id, const LevelInfo &info)
+SequencerDataBlock::setInstrumentRecordDiskInfo(InstrumentId id,
+                                                const RecordDiskInfo &info)
 {
     int index = instrumentToIndexCreating(id);
     if (index < 0)
         return ;
 
-    m_recordLevels[index] = info;
-    ++m_recordLevelUpdateIndices[index];
+    if (!beginWrite(m_recordDiskSequence[index]))
+        return;
+
+    std::atomic<int> *values = m_recordDiskInfo[index];
+    values[DiskBufferFill].store(info.bufferFill, std::memory_order_relaxed);
+    values[DiskWriteTime].store(info.writeTime, std::memory_order_relaxed);
+    values[DiskWorstWriteTime].store(info.worstWriteTime,
+                                     std::memory_order_relaxed);
+    values[DiskOverruns].store(info.overruns, std::memory_order_relaxed);
+
+    endWrite(m_recordDiskSequence[index]);
+
+    m_haveRecordDiskInfo[index].store(true, std::memory_order_release);
 }
 
 void
@@ -313,24 +517,13 @@ SequencerDataBlock::getTrackLevel(TrackId id, LevelInfo &info) const
 bool
 SequencerDataBlock::getSubmasterLevel(int submaster, LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
-
     if (submaster < 0 || submaster >= SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS) {
-        info.level = info.levelRight = 0;
+        info = LevelInfo();
         return false;
     }
 
-    int currentUpdateIndex = m_submasterLevelUpdateIndices[submaster];
-    info = m_submasterLevels[submaster];
-
-    if (lastUpdateIndex[submaster] != currentUpdateIndex) {
-        lastUpdateIndex[submaster] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return m_submasterLevels[submaster].get
+        (info, m_lastSubmasterLevels[submaster]);
 }
 
 void
@@ -340,33 +533,19 @@ SequencerDataBlock::setSubmasterLevel(int submaster, const LevelInfo &info)
         return ;
     }
 
-    m_submasterLevels[submaster] = info;
-    ++m_submasterLevelUpdateIndices[submaster];
+    m_submasterLevels[submaster].set(info, m_clock.elapsed());
 }
 
 bool
 SequencerDataBlock::getMasterLevel(LevelInfo &level) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex = 0;
-
-    int currentIndex = m_masterLevelUpdateIndex;
-    level = m_masterLevel;
-
-    if (lastUpdateIndex != currentIndex) {
-        lastUpdateIndex = currentIndex;
-        return true;
-    } else {
-        return false;
-    }
+    return m_masterLevel.get(level, m_lastMasterLevel);
 }
 
 void
 SequencerDataBlock::setMasterLevel(const LevelInfo &info)
 {
-    m_masterLevel = info;
-    ++m_masterLevelUpdateIndex;
+    m_masterLevel.set(info, m_clock.elapsed());
 }
 
 void
@@ -375,31 +554,42 @@ SequencerDataBlock::clearTemporaries()
     m_positionSec = 0;
     m_positionNsec = 0;
 
-    m_setVisualIndex = 0;
-    m_getVisualIndex = 0;
-    m_haveVisualEvent = false;
+    // Cleared as a write, so that getVisual() can't see it half done,
+    // and marked as seen, so that it doesn't show the empty event
+    while (!beginWrite(m_visualSequence)) { }
     *((MappedEvent *)&m_visualEvent) = MappedEvent();
+    endWrite(m_visualSequence);
+    m_lastVisualSequence = m_visualSequence.load(std::memory_order_relaxed);
 
     m_recordEventIndex = 0;
     m_readIndex = 0;
     memset(m_recordBuffer, 0, sizeof(m_recordBuffer));
 
-    memset(m_knownInstruments, 0, sizeof(m_knownInstruments));
-    m_knownInstrumentCount = 0;
-
-    memset(m_levelUpdateIndices, 0, sizeof(m_levelUpdateIndices));
-    memset(m_levels, 0, sizeof(m_levels));
-
-    memset(m_recordLevelUpdateIndices, 0, sizeof(m_recordLevelUpdateIndices));
-    memset(m_recordLevels, 0, sizeof(m_recordLevels));
+    // The known instruments are kept, as the GUI may be reading them
+    // and their change bits.  Clearing a meter is a write, so its
+    // sequence number carries on and each reader sees it drop to
+    // nothing; the instruments are marked changed so that the readers
+    // relying on getChangedInstruments() look.  m_lastLevels and the
+    // like belong to the GUI thread and are left alone.
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        m_levels[i].clear();
+        m_recordLevels[i].clear();
+    }
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS; ++i) {
+        m_submasterLevels[i].clear();
+    }
+    m_masterLevel.clear();
 
-    memset(m_submasterLevelUpdateIndices, 0,
-            sizeof(m_submasterLevelUpdateIndices));
-    memset(m_submasterLevels, 0, sizeof(m_submasterLevels));
+    int count = m_knownInstrumentCount.load(std::memory_order_acquire);
+    for (int index = 0; index < count; ++index) {
+        for (int reader = 0; reader < MeterReaderCount; ++reader) {
+            markChanged(MeterReader(reader), index);
+        }
+    }
 
-    m_masterLevelUpdateIndex = 0;
-    m_masterLevel.level = 0;
-    m_masterLevel.levelRight = 0;
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        m_haveRecordDiskInfo[i].store(false, std::memory_order_release);
+    }
 }
 
 }
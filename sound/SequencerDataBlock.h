@@ -20,22 +20,100 @@
 #include "base/RealTime.h"
 #include "MappedEvent.h"
 
+#include <QElapsedTimer>
 #include <QMutex>
 
+#include <atomic>
+#include <set>
+
 namespace Rosegarden
 {
         
 /**
- * ONLY PUT PLAIN DATA HERE - NO POINTERS EVER
- * (and this struct mustn't have a constructor)
- *
- * Since we no longer use shared memory, it might be safe to lift
- * the POD/no pointer/no ctor restrictions.
+ * A meter reading.  Levels are long fader values (see AudioLevel), or
+ * velocities for MIDI.
  */
 struct LevelInfo
 {
+    LevelInfo() :
+        level(0), levelRight(0),
+        rms(0), rmsRight(0),
+        peakHold(0), peakHoldRight(0) { }
+
+    /// Peak since the last reading
     int level;
     int levelRight; // if stereo audio
+
+    /// Average (RMS) since the last reading.  Zero for MIDI.
+    int rms;
+    int rmsRight;
+
+    /// Highest peak in the last second and a half.  Set by
+    /// SequencerDataBlock, so writers need not fill it in.
+    int peakHold;
+    int peakHoldRight;
+};
+
+/**
+ * Recording disk health for one audio instrument, for the disk meter.
+ * Plain data only.
+ */
+struct RecordDiskInfo
+{
+    /// Fullest the record buffers have been before a write, in percent
+    int bufferFill;
+    /// Time taken by the last write to disk, in microseconds
+    int writeTime;
+    /// Longest time taken by a write to disk, in microseconds
+    int worstWriteTime;
+    /// Number of times audio has been dropped because the buffers were full
+    int overruns;
+};
+
+/**
+ * One meter, set by a sequencer thread and read by the GUI without
+ * either taking a lock.
+ *
+ * This is a seqlock.  The writer makes the sequence number odd while
+ * it changes the values and even again once they are complete, and a
+ * reader tries again if the number was odd, or changed while it read.
+ * Should two writers meet, the second drops its reading rather than
+ * wait, which only leaves the meter a moment behind.
+ */
+class LevelMeter
+{
+public:
+    LevelMeter();
+
+    /// Called by the sequencer, at time now in milliseconds.
+    void set(const LevelInfo &info, qint64 now);
+
+    /**
+     * Called by the GUI.  Returns true if the meter has been set since
+     * the sequence number in lastSeen, which it updates.  If the writer
+     * kept it too busy to read, returns false with gaveUp set.
+     */
+    bool get(LevelInfo &info, unsigned &lastSeen,
+             bool *gaveUp = nullptr) const;
+
+    void clear();
+
+private:
+    LevelMeter(const LevelMeter &);
+    LevelMeter &operator=(const LevelMeter &);
+
+    enum {
+        Level, LevelRight,
+        Rms, RmsRight,
+        PeakHold, PeakHoldRight,
+        ValueCount
+    };
+
+    std::atomic<unsigned> m_sequence;
+    std::atomic<int> m_values[ValueCount];
+
+    /// When each peak hold was last raised.  Writer only.
+    qint64 m_holdSince[2];
 };
 
 class MappedEventList;
@@ -54,7 +132,9 @@ class MappedEventList;
  * RosegardenDocument::insertRecordedMidi().
  *
  * This class needs to be reviewed for thread safety.  See the comments
- * in addRecordedEvents().
+ * in addRecordedEvents().  The meters and the visual event are safe:
+ * each is a seqlock (see LevelMeter), so neither the sequencer nor the
+ * GUI ever waits for the other.
  *
  * This used to be mapped into a shared memory
  * backed file, which had to be of fixed size and layout.  The design
@@ -114,10 +194,23 @@ public:
     bool getTrackLevel(TrackId track, LevelInfo &) const;
     void setTrackLevel(TrackId track, const LevelInfo &);
 
-    // Two of these to rather hamfistedly get around the fact
-    // we need to fetch this value twice - once from IPB, 
-    // and again for the Mixer.
-    //
+    /// The parts of the GUI that read the meters.
+    /**
+     * Each sees changes independently of the others: the track buttons
+     * and instrument parameter box use getInstrumentLevel() and
+     * getInstrumentRecordLevel(), and the mixers the ForMixer versions.
+     */
+    enum MeterReader { TrackMeters, MixerMeters, MeterReaderCount };
+
+    /// Add the instruments whose meters have been set since the last call.
+    /**
+     * So that a reader with many meters need only read the ones that
+     * have changed.  Covers both the playback and the record levels.
+     */
+    void getChangedInstruments(MeterReader reader, std::set<InstrumentId> &);
+
+    // The getters return true if the level has been set since this
+    // reader last asked.
     bool getInstrumentLevel(InstrumentId id, LevelInfo &) const;
     bool getInstrumentLevelForMixer(InstrumentId id, LevelInfo &) const;
 
@@ -128,6 +221,15 @@ public:
 
     void setInstrumentRecordLevel(InstrumentId id, const LevelInfo &);
 
+    /// Get the disk health of the file recording on this instrument.
+    /**
+     * Returns false if the instrument hasn't recorded audio since the
+     * last clearTemporaries().
+     */
+    bool getInstrumentRecordDiskInfo(InstrumentId id, RecordDiskInfo &) const;
+    /// Called by AudioFileWriter after each write.
+    void setInstrumentRecordDiskInfo(InstrumentId id, const RecordDiskInfo &);
+
     bool getSubmasterLevel(int submaster, LevelInfo &) const;
     void setSubmasterLevel(int submaster, const LevelInfo &);
 
@@ -144,14 +246,20 @@ protected:
     int instrumentToIndex(InstrumentId id) const;
     int instrumentToIndexCreating(InstrumentId id);
 
+    bool getLevel(const LevelMeter *meters, unsigned *lastSeen,
+                  MeterReader reader, InstrumentId id, LevelInfo &) const;
+    void setLevel(LevelMeter *meters, InstrumentId id, const LevelInfo &);
+    void markChanged(MeterReader reader, int index) const;
+
     // ??? Thread-safe?  Probably not.  Seems like the worst-case is that
     //     the pointer might jump forward about one second momentarily.
     int m_positionSec;
     int m_positionNsec;
 
-    int m_setVisualIndex;
-    int m_getVisualIndex;
-    bool m_haveVisualEvent;
+    /// Seqlock over m_visualEvent, as for LevelMeter.
+    std::atomic<unsigned> m_visualSequence;
+    /// m_visualSequence when getVisual() last returned an event.
+    unsigned m_lastVisualSequence;
     /// MIDI OUT event for display on the transport during playback.
     char m_visualEvent[sizeof(MappedEvent)];
     
@@ -179,25 +287,63 @@ protected:
     char m_recordBuffer[sizeof(MappedEvent) *
                         SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE];
 
-    // ??? Thread-safe?
+    /// Instruments are only ever added, and the count set after each.
+    /**
+     * clearTemporaries() keeps them, so that an index the GUI has read
+     * never comes to mean another instrument.
+     */
     InstrumentId m_knownInstruments[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-    int m_knownInstrumentCount;
+    std::atomic<int> m_knownInstrumentCount;
+    /// Held by a writer adding an instrument, which is rare.
+    QMutex m_knownInstrumentsMutex;
 
-    // ??? Thread-safe?
-    int m_levelUpdateIndices[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-    LevelInfo m_levels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    /// For the peak holds.
+    QElapsedTimer m_clock;
 
-    // ??? Thread-safe?
-    int m_recordLevelUpdateIndices[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-    LevelInfo m_recordLevels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    LevelMeter m_levels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    LevelMeter m_recordLevels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    LevelMeter m_submasterLevels[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
+    LevelMeter m_masterLevel;
+
+    /// Sequence numbers of the meters as each reader last saw them.
+    /**
+     * Only used on the GUI thread.
+     */
+    mutable unsigned m_lastLevels
+        [MeterReaderCount][SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    mutable unsigned m_lastRecordLevels
+        [MeterReaderCount][SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    mutable unsigned m_lastSubmasterLevels
+        [SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
+    mutable unsigned m_lastMasterLevel;
 
-    // ??? Thread-safe?
-    int m_submasterLevelUpdateIndices[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
-    LevelInfo m_submasterLevels[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
+    /// For getChangedInstruments(), a bit per instrument index.
+    /**
+     * The sequencer sets a bit for every reader after setting a meter,
+     * and getChangedInstruments() takes them a word at a time.  A reader
+     * that can't read a meter sets its bit again, to retry next time.
+     */
+    mutable std::atomic<quint64> m_changedInstruments
+        [MeterReaderCount][SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS / 64];
+
+    /// Disk health of each instrument's recording, as for LevelMeter.
+    /**
+     * Written by AudioFileWriter under a seqlock and read by the GUI.
+     * The flag is set once a write is complete, and cleared by
+     * clearTemporaries().
+     */
+    enum {
+        DiskBufferFill, DiskWriteTime, DiskWorstWriteTime, DiskOverruns,
+        DiskValueCount
+    };
+    std::atomic<unsigned>
+        m_recordDiskSequence[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    std::atomic<int>
+        m_recordDiskInfo[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS]
+                        [DiskValueCount];
+    std::atomic<bool>
+        m_haveRecordDiskInfo[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
 
-    // ??? Thread-safe?
-    int m_masterLevelUpdateIndex;
-    LevelInfo m_masterLevel;
 };
 
 }
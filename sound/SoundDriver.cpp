@@ -22,6 +22,8 @@
 #include "WAVAudioFile.h"
 #include "MappedStudio.h"
 #include "AudioPlayQueue.h"
+#include "LocateCache.h"
+#include "AudioCache.h"
 
 #include <unistd.h>
 #include <sys/time.h>
@@ -329,6 +331,8 @@ SoundDriver::removeAudioFile(unsigned int id)
             RG_DEBUG << "Sequencer::removeAudioFile() = \"" <<
                 (*it)->getFilename() << "\"";
 
+            LocateCache::getInstance()->forgetFile(id);
+            AudioCache::getInstance()->forgetIndex(*it);
             delete (*it);
             m_audioFiles.erase(it);
             return true;
@@ -355,9 +359,18 @@ SoundDriver::clearAudioFiles()
 {
     //RG_DEBUG << "SoundDriver::clearAudioFiles() - clearing down audio files";
 
+    AudioCache *cache = AudioCache::getInstance();
+    RG_DEBUG << "clearAudioFiles(): audio cache had" << cache->getHits()
+             << "hits and" << cache->getMisses() << "misses, using"
+             << cache->getMemoryUsed() << "of" << cache->getBudget() << "bytes";
+
+    LocateCache::getInstance()->clear();
+
     std::vector<AudioFile*>::iterator it;
-    for (it = m_audioFiles.begin(); it != m_audioFiles.end(); ++it)
+    for (it = m_audioFiles.begin(); it != m_audioFiles.end(); ++it) {
+        AudioCache::getInstance()->forgetIndex(*it);
         delete(*it);
+    }
 
     m_audioFiles.erase(m_audioFiles.begin(), m_audioFiles.end());
 }
@@ -79,20 +79,24 @@ AudioReadStream::getInterleavedFrames(size_t count, float *frames)
 
         float ratio = float(m_retrievalRate) / float(m_sampleRate);
         size_t req = size_t(ceil(count / ratio));
-        size_t outSz = size_t(ceil(req * ratio));
 
         float *in  = new float[req * m_channelCount];
-        float *out = new float[(outSz + 1) * m_channelCount];   // take one extra space to be sure
 
         size_t got = getFrames(req, in);
     
+        // A short read, including none at all when the file length is
+        // a multiple of req, is the end of the input.  The final call
+        // also flushes the frames the resampler has been holding back.
         if (got < req) {
             finished = true;
         }
 
-        if (got > 0) {
+        size_t outSz = m_resampler->getOutputSize(got, ratio, finished);
+        float *out = new float[outSz * m_channelCount];
+
+        if (got > 0 || finished) {
             int resampled = m_resampler->resampleInterleaved
-                (in, out, got, ratio, got < req);
+                (in, out, got, ratio, finished);
 
             if (m_resampleBuffer->getWriteSpace() < resampled * m_channelCount) {
                 m_resampleBuffer = m_resampleBuffer->resized